@@ -0,0 +1,172 @@
+/*
+ * MqttQueue.cpp
+ *
+ * MQTT publishes that couldn't be sent straight away, and the last retained payload of each topic
+ *
+ * Paul Derbyshire - https://github.com/proddy/EMS-ESP
+ */
+
+#include "MqttQueue.h"
+
+MqttQueue::MqttQueue() {
+    published  = 0;
+    queued     = 0;
+    coalesced  = 0;
+    dropped    = 0;
+    waiting    = 0;
+    retained   = 0;
+    _send      = NULL;
+    _resend    = 0;
+    _resending = false;
+    memset(_queue, 0, sizeof(_queue));
+    memset(_retained, 0, sizeof(_retained));
+}
+
+MqttQueue::~MqttQueue() {
+    for (uint8_t i = 0; i < MQTT_PUBLISH_QUEUE_MAX; i++) {
+        free(_queue[i].payload);
+    }
+    for (uint8_t i = 0; i < MQTT_RETAINED_MAX; i++) {
+        free(_retained[i].payload);
+    }
+}
+
+void MqttQueue::begin(mqtt_send_f send) {
+    _send = send;
+}
+
+// send a publish, or queue it if MQTT is offline or its send buffer is full, keeping only the latest payload per topic
+// a retained payload is also kept, so it can be sent again after a reconnect
+void MqttQueue::publish(const char * topic, const char * payload, size_t length, bool retain) {
+    if (retain) {
+        _keep(topic, payload, length);
+    }
+
+    // anything already waiting goes first
+    if ((waiting == 0) && (_send != NULL) && _send(topic, payload, length, retain)) {
+        published++;
+        return;
+    }
+
+    _add(topic, payload, length, retain);
+}
+
+// send what's waiting in the queue, and then the retained payloads after a reconnect, as much as MQTT takes
+void MqttQueue::flush() {
+    if (_send == NULL) {
+        return;
+    }
+
+    while (waiting > 0) {
+        if (!_send(_queue[0].topic, _queue[0].payload, _queue[0].length, _queue[0].retain)) {
+            return; // offline or the send buffer is full, try again later
+        }
+        published++;
+        _shift();
+    }
+
+    while (_resending && (_resend < retained)) {
+        if (!_send(_retained[_resend].topic, _retained[_resend].payload, _retained[_resend].length, true)) {
+            return;
+        }
+        published++;
+        _resend++;
+    }
+    _resending = false;
+}
+
+// MQTT is connected again. The broker may have lost the retained payloads, e.g. after a restart, so they are all sent again
+// they are sent from the cache in flush() rather than queued, so they don't push anything else out of the queue
+void MqttQueue::reconnected() {
+    _resend    = 0;
+    _resending = true;
+    flush();
+}
+
+// true if no publishes are waiting to be sent
+bool MqttQueue::empty() {
+    return ((waiting == 0) && !_resending);
+}
+
+// copy a payload into an entry, only allocating when it doesn't fit into what the entry already has
+bool MqttQueue::_copy(mqtt_publish_t * entry, const char * payload, size_t length) {
+    if ((entry->payload == NULL) || (entry->size < length + 1)) {
+        char * p = (char *)realloc(entry->payload, length + 1); // +1 so an empty payload still gets a buffer
+        if (p == NULL) {
+            return false;
+        }
+        entry->payload = p;
+        entry->size    = length + 1;
+    }
+    memcpy(entry->payload, payload, length);
+    entry->payload[length] = '\0';
+    entry->length          = length;
+    return true;
+}
+
+// add a publish to the queue. The payload is only copied here, so when all is well nothing is allocated
+void MqttQueue::_add(const char * topic, const char * payload, size_t length, bool retain) {
+    // a newer value for a topic that's still waiting replaces the old one
+    for (uint8_t i = 0; i < waiting; i++) {
+        if (strcmp(_queue[i].topic, topic) == 0) {
+            if (!_copy(&_queue[i], payload, length)) {
+                dropped++;
+                return;
+            }
+            _queue[i].retain = retain;
+            coalesced++;
+            return;
+        }
+    }
+
+    // full, make room by dropping the oldest
+    if (waiting >= MQTT_PUBLISH_QUEUE_MAX) {
+        _shift();
+        dropped++;
+    }
+
+    mqtt_publish_t * entry = &_queue[waiting];
+    if (!_copy(entry, payload, length)) {
+        dropped++;
+        return;
+    }
+    strlcpy(entry->topic, topic, sizeof(entry->topic));
+    entry->retain = retain;
+    waiting++;
+    queued++;
+}
+
+// remember the last retained payload of a topic. Topics beyond MQTT_RETAINED_MAX are not kept
+void MqttQueue::_keep(const char * topic, const char * payload, size_t length) {
+    mqtt_publish_t * entry = NULL;
+    for (uint8_t i = 0; i < retained; i++) {
+        if (strcmp(_retained[i].topic, topic) == 0) {
+            entry = &_retained[i];
+            break;
+        }
+    }
+
+    if (entry == NULL) {
+        if (retained >= MQTT_RETAINED_MAX) {
+            return;
+        }
+        entry = &_retained[retained];
+        strlcpy(entry->topic, topic, sizeof(entry->topic));
+        entry->retain = true;
+        if (!_copy(entry, payload, length)) {
+            return;
+        }
+        retained++;
+        return;
+    }
+
+    (void)_copy(entry, payload, length); // keeps the older payload if there's no memory
+}
+
+// remove the oldest from the queue, freeing its payload
+void MqttQueue::_shift() {
+    free(_queue[0].payload);
+    memmove(&_queue[0], &_queue[1], (waiting - 1) * sizeof(mqtt_publish_t));
+    waiting--;
+    memset(&_queue[waiting], 0, sizeof(mqtt_publish_t));
+}
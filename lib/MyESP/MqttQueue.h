@@ -0,0 +1,60 @@
+/*
+ * MqttQueue.h
+ *
+ * MQTT publishes that couldn't be sent straight away, and the last retained payload of each topic
+ * Kept apart from MyESP so it can be tested on a PC, see tools/test/test_mqttqueue.cpp
+ *
+ * Paul Derbyshire - https://github.com/proddy/EMS-ESP
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+#define MQTT_MAX_TOPIC_SIZE 50     // max length of MQTT message
+#define MQTT_PUBLISH_QUEUE_MAX 8   // # publishes kept while MQTT is busy or offline, one per topic
+#define MQTT_RETAINED_MAX 16       // # topics whose last retained payload is kept to send again after a reconnect
+
+// sends a publish, topic is without the base and hostname. Returns false if MQTT didn't take it
+typedef std::function<bool(const char * topic, const char * payload, size_t length, bool retain)> mqtt_send_f;
+
+// a publish waiting for MQTT to accept it, or the last retained payload of a topic
+typedef struct {
+    char   topic[MQTT_MAX_TOPIC_SIZE]; // without the base and hostname
+    char * payload;
+    size_t length; // payload may be binary, so not always null terminated
+    size_t size;   // allocated for payload
+    bool   retain;
+} mqtt_publish_t;
+
+class MqttQueue {
+  public:
+    MqttQueue();
+    ~MqttQueue();
+
+    void begin(mqtt_send_f send);
+    void publish(const char * topic, const char * payload, size_t length, bool retain);
+    void flush();
+    void reconnected();
+    bool empty();
+
+    uint32_t published; // # sent, straight away or from the queue
+    uint32_t queued;    // # that had to wait
+    uint32_t coalesced; // # replaced by a newer payload for the same topic before they were sent
+    uint32_t dropped;   // # lost because the queue was full or out of memory
+    uint8_t  waiting;   // # in the queue now
+    uint8_t  retained;  // # topics with a retained payload kept
+
+  private:
+    mqtt_send_f    _send;
+    mqtt_publish_t _queue[MQTT_PUBLISH_QUEUE_MAX]; // oldest first
+    mqtt_publish_t _retained[MQTT_RETAINED_MAX];
+    uint8_t        _resend;    // the next retained payload to send again after a reconnect
+    bool           _resending; // still sending the retained payloads again
+
+    bool _copy(mqtt_publish_t * entry, const char * payload, size_t length);
+    void _add(const char * topic, const char * payload, size_t length, bool retain);
+    void _keep(const char * topic, const char * payload, size_t length);
+    void _shift();
+};
@@ -28,6 +28,15 @@ MyESP::MyESP() {
 
     _fs_callback          = NULL;
     _fs_settings_callback = NULL;
+    _fs_record_callback   = NULL;
+    _config_crc           = 0;
+    memset(&_config, 0, sizeof(_config));
+
+    _fs_dirty           = false;
+    _fs_dirty_timestamp = 0;
+    _fs_writes          = 0;
+    _fs_save_requests   = 0;
+    _fs_save_skipped    = 0;
 
     _helpProjectCmds       = NULL;
     _helpProjectCmds_count = 0;
@@ -42,11 +51,17 @@ MyESP::MyESP() {
     _mqtt_will_online_payload  = NULL;
     _mqtt_will_offline_payload = NULL;
     _mqtt_base                 = NULL;
-    _mqtt_topic                = NULL;
+    _mqtt_prefix[0]            = '\0';
+    _mqtt_prefix_length        = 0;
+    _mqtt_topic[0]             = '\0';
+    _mqtt_will_fulltopic[0]    = '\0';
     _mqtt_qos                  = 0;
     _mqtt_reconnect_delay      = MQTT_RECONNECT_DELAY_MIN;
     _mqtt_last_connection      = 0;
     _mqtt_connecting           = false;
+    _mqtt_rx_head              = 0;
+    _mqtt_rx_tail              = 0;
+    _mqtt_rx_dropped           = 0;
 
     _wifi_password  = NULL;
     _wifi_ssid      = NULL;
@@ -89,6 +104,14 @@ void MyESP::myDebug(const char * format, ...) {
     delete[] buffer;
 }
 
+// print a line that is already formatted, without the buffer myDebug() allocates
+void MyESP::myDebugLine(const char * line) {
+    if (_suspendOutput)
+        return;
+
+    SerialAndTelnet.println(line);
+}
+
 // for flashmemory. Must use PSTR()
 void MyESP::myDebug_P(PGM_P format_P, ...) {
     if (_suspendOutput)
@@ -214,22 +237,54 @@ bool MyESP::isAPmode() {
 }
 
 // received MQTT message
-// we send this to the call back function. Important to parse are the event strings such as MQTT_MESSAGE_EVENT and MQTT_CONNECT_EVENT
-void MyESP::_mqttOnMessage(char * topic, char * payload, size_t len) {
+// this runs in the network callback, so the message is only copied to the queue and handled later in loop()
+void MyESP::_mqttOnMessage(char * topic, char * payload, size_t len, size_t index, size_t total) {
     if (len == 0)
         return;
 
-    char message[len + 1];
-    strlcpy(message, (char *)payload, len + 1);
-
-    // myDebug_P(PSTR("[MQTT] Received %s => %s"), topic, message); // enable for debugging
-
     // topics are in format MQTT_BASE/HOSTNAME/TOPIC
     char * topic_magnitude = strrchr(topic, '/'); // strip out everything until last /
     if (topic_magnitude != nullptr) {
         topic = topic_magnitude + 1;
     }
 
+    // large payloads come in parts, commands are never that big
+    if ((index != 0) || (len != total) || (len > MQTT_RX_PAYLOAD_MAX)) {
+        if (index == 0) {
+            _mqtt_rx_dropped++;
+            myDebug_P(PSTR("[MQTT] Message on %s too long (%d bytes), dropped"), topic, total);
+        }
+        return;
+    }
+
+    if ((uint8_t)(_mqtt_rx_tail - _mqtt_rx_head) >= MQTT_RX_QUEUE_MAX) {
+        _mqtt_rx_dropped++;
+        myDebug_P(PSTR("[MQTT] Too many messages waiting, %s dropped"), topic);
+        return;
+    }
+
+    mqtt_message_t * message = &_mqtt_rx[_mqtt_rx_tail % MQTT_RX_QUEUE_MAX];
+    strlcpy(message->topic, topic, sizeof(message->topic));
+    memcpy(message->payload, payload, len);
+    message->payload[len] = '\0';
+
+    _mqtt_rx_tail++; // only now it can be picked up
+}
+
+// handle the incoming messages that are waiting, called from loop()
+void MyESP::_mqttRxFlush() {
+    while (_mqtt_rx_head != _mqtt_rx_tail) {
+        mqtt_message_t * message = &_mqtt_rx[_mqtt_rx_head % MQTT_RX_QUEUE_MAX];
+        _mqttHandleMessage(message->topic, message->payload);
+        _mqtt_rx_head++;
+    }
+}
+
+// handle a received MQTT message
+// we send this to the call back function. Important to parse are the event strings such as MQTT_MESSAGE_EVENT and MQTT_CONNECT_EVENT
+void MyESP::_mqttHandleMessage(const char * topic, const char * message) {
+    // myDebug_P(PSTR("[MQTT] Received %s => %s"), topic, message); // enable for debugging
+
     // check for standard messages
     // Restart the device
     if (strcmp(topic, MQTT_TOPIC_RESTART) == 0) {
@@ -254,8 +309,9 @@ void MyESP::_mqttOnMessage(char * topic, char * payload, size_t len) {
 // to MQTT_BASE/app_hostname/topic
 void MyESP::mqttSubscribe(const char * topic) {
     if (mqttClient.connected() && (strlen(topic) > 0)) {
-        unsigned int packetId = mqttClient.subscribe(_mqttTopic(topic), _mqtt_qos);
-        myDebug_P(PSTR("[MQTT] Subscribing to %s (PID %d)"), _mqttTopic(topic), packetId);
+        char *       fulltopic = _mqttTopic(topic);
+        unsigned int packetId  = mqttClient.subscribe(fulltopic, _mqtt_qos);
+        myDebug_P(PSTR("[MQTT] Subscribing to %s (PID %d)"), fulltopic, packetId);
     }
 }
 
@@ -263,15 +319,47 @@ void MyESP::mqttSubscribe(const char * topic) {
 // to MQTT_BASE/app_hostname/topic
 void MyESP::mqttUnsubscribe(const char * topic) {
     if (mqttClient.connected() && (strlen(topic) > 0)) {
-        unsigned int packetId = mqttClient.unsubscribe(_mqttTopic(topic));
-        myDebug_P(PSTR("[MQTT] Unsubscribing to %s (PID %d)"), _mqttTopic(topic), packetId);
+        char *       fulltopic = _mqttTopic(topic);
+        unsigned int packetId  = mqttClient.unsubscribe(fulltopic);
+        myDebug_P(PSTR("[MQTT] Unsubscribing to %s (PID %d)"), fulltopic, packetId);
     }
 }
 
 // MQTT Publish
+// if MQTT is offline or its send buffer is full it's queued and sent from loop(), keeping only the latest payload per topic
 void MyESP::mqttPublish(const char * topic, const char * payload) {
+    mqttPublish(topic, payload, strlen(payload));
+}
+
+// same, for a payload that isn't a string, e.g. binary
+void MyESP::mqttPublish(const char * topic, const char * payload, size_t length) {
     // myDebug_P(PSTR("[MQTT] Sending pubish to %s with payload %s"), _mqttTopic(topic), payload);
-    mqttClient.publish(_mqttTopic(topic), _mqtt_qos, _mqtt_retain, payload);
+    _mqtt_queue.publish(topic, payload, length, _mqtt_retain);
+}
+
+// publish to a full topic, without the base and hostname, e.g. for Home Assistant discovery
+// it's not queued, so returns false if MQTT didn't take it
+bool MyESP::mqttPublishDirect(const char * topic, const char * payload, bool retain) {
+    if (!mqttClient.connected()) {
+        return false;
+    }
+
+    if (mqttClient.publish(topic, _mqtt_qos, retain, payload) == 0) {
+        return false;
+    }
+
+    _mqtt_queue.published++;
+    return true;
+}
+
+// true if no publishes are waiting to be sent
+bool MyESP::mqttPublishQueueEmpty() {
+    return _mqtt_queue.empty();
+}
+
+// MQTT_BASE/app_hostname/, what all topics start with
+const char * MyESP::mqttPrefix() {
+    return _mqtt_prefix;
 }
 
 // MQTT onConnect - when a connect is established
@@ -282,7 +370,7 @@ void MyESP::_mqttOnConnect() {
     _mqtt_last_connection = millis();
 
     // say we're alive to the Last Will topic
-    mqttClient.publish(_mqttTopic(_mqtt_will_topic), 1, true, _mqtt_will_online_payload);
+    mqttClient.publish(_mqtt_will_fulltopic, 1, true, _mqtt_will_online_payload);
 
     // subscribe to general subs
     mqttSubscribe(MQTT_TOPIC_RESTART);
@@ -291,6 +379,9 @@ void MyESP::_mqttOnConnect() {
     myESP.mqttSubscribe(MQTT_TOPIC_START);
     myESP.mqttPublish(MQTT_TOPIC_START, MQTT_TOPIC_START_PAYLOAD);
 
+    // the broker may have lost what was retained while we were away
+    _mqtt_queue.reconnected();
+
     // call custom function to handle mqtt receives
     (_mqtt_callback)(MQTT_CONNECT_EVENT, NULL, NULL);
 }
@@ -303,6 +394,10 @@ void MyESP::_mqtt_setup() {
 
     mqttClient.onConnect([this](bool sessionPresent) { _mqttOnConnect(); });
 
+    _mqtt_queue.begin([this](const char * topic, const char * payload, size_t length, bool retain) {
+        return mqttClient.connected() && (mqttClient.publish(_mqttTopic(topic), _mqtt_qos, retain, payload, length) != 0);
+    });
+
     mqttClient.onDisconnect([this](AsyncMqttClientDisconnectReason reason) {
         if (reason == AsyncMqttClientDisconnectReason::TCP_DISCONNECTED) {
             myDebug_P(PSTR("[MQTT] TCP Disconnected"));
@@ -332,7 +427,7 @@ void MyESP::_mqtt_setup() {
 
     mqttClient.onMessage(
         [this](char * topic, char * payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total) {
-            _mqttOnMessage(topic, payload, len);
+            _mqttOnMessage(topic, payload, len, index, total);
         });
 }
 
@@ -525,6 +620,7 @@ void MyESP::_printSetCommands() {
     myDebug_P(PSTR("The following set commands are available:"));
     myDebug_P(PSTR("")); // newline
     myDebug_P(PSTR("*  set erase"));
+    myDebug_P(PSTR("*  set <export | import>"));
     myDebug_P(PSTR("*  set <wifi_ssid | wifi_password> [value]"));
     myDebug_P(PSTR("*  set <mqtt_host | mqtt_username | mqtt_password> [value]"));
     myDebug_P(PSTR("*  set serial <on | off>"));
@@ -587,6 +683,12 @@ void MyESP::_printSetCommands() {
 // reset / restart
 void MyESP::resetESP() {
     myDebug_P(PSTR("* Reboot ESP..."));
+
+    // don't lose any settings still waiting to be written
+    if (_fs_dirty) {
+        (void)fs_saveConfig();
+    }
+
     end();
 #if defined(ARDUINO_ARCH_ESP32)
     ESP.restart();
@@ -616,50 +718,39 @@ bool MyESP::_changeSetting(uint8_t wc, const char * setting, const char * value)
         _fs_eraseConfig();
         return true;
 
-    } else if (strcmp(setting, "wifi_ssid") == 0) {
-        if (_wifi_ssid)
-            free(_wifi_ssid);
-        _wifi_ssid = NULL; // just to be sure
-        if (value) {
-            _wifi_ssid = strdup(value);
+    } else if (strcmp(setting, "export") == 0) {
+        // write all settings as JSON and show them
+        if (_fs_exportConfig()) {
+            _fs_printConfig();
+        }
+        return true;
+
+    } else if (strcmp(setting, "import") == 0) {
+        // take the settings from the JSON file, e.g. after editing an export
+        if (!_fs_importConfig()) {
+            return false;
         }
         ok = true;
+
+    } else if (strcmp(setting, "wifi_ssid") == 0) {
+        _wifi_ssid = _setConfigString(_config.wifi_ssid, sizeof(_config.wifi_ssid), value);
+        ok = true;
         jw.enableSTA(false);
         myDebug_P(PSTR("Note: please reboot to apply new WiFi settings"));
     } else if (strcmp(setting, "wifi_password") == 0) {
-        if (_wifi_password)
-            free(_wifi_password);
-        _wifi_password = NULL; // just to be sure
-        if (value) {
-            _wifi_password = strdup(value);
-        }
+        _wifi_password = _setConfigString(_config.wifi_password, sizeof(_config.wifi_password), value);
         ok = true;
         jw.enableSTA(false);
         myDebug_P(PSTR("Note: please reboot to apply new WiFi settings"));
 
     } else if (strcmp(setting, "mqtt_host") == 0) {
-        if (_mqtt_host)
-            free(_mqtt_host);
-        _mqtt_host = NULL; // just to be sure
-        if (value) {
-            _mqtt_host = strdup(value);
-        }
+        _mqtt_host = _setConfigString(_config.mqtt_host, sizeof(_config.mqtt_host), value);
         ok = true;
     } else if (strcmp(setting, "mqtt_username") == 0) {
-        if (_mqtt_username)
-            free(_mqtt_username);
-        _mqtt_username = NULL; // just to be sure
-        if (value) {
-            _mqtt_username = strdup(value);
-        }
+        _mqtt_username = _setConfigString(_config.mqtt_username, sizeof(_config.mqtt_username), value);
         ok = true;
     } else if (strcmp(setting, "mqtt_password") == 0) {
-        if (_mqtt_password)
-            free(_mqtt_password);
-        _mqtt_password = NULL; // just to be sure
-        if (value) {
-            _mqtt_password = strdup(value);
-        }
+        _mqtt_password = _setConfigString(_config.mqtt_password, sizeof(_config.mqtt_password), value);
         ok = true;
 
     } else if (strcmp(setting, "serial") == 0) {
@@ -697,7 +788,7 @@ bool MyESP::_changeSetting(uint8_t wc, const char * setting, const char * value)
 
         myDebug_P(PSTR("")); // newline
 
-        (void)fs_saveConfig(); // always save the values
+        fs_requestSaveConfig(); // always save the values
     }
 
     return ok;
@@ -921,6 +1012,19 @@ void MyESP::showSystemStats() {
     myDebug_P(PSTR(" [MEM] Max OTA size: %d"), (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000);
     myDebug_P(PSTR(" [MEM] OTA Reserved: %d"), 4 * SPI_FLASH_SEC_SIZE);
     myDebug_P(PSTR(" [MEM] Free Heap: %d"), ESP.getFreeHeap());
+    myDebug_P(PSTR(" [MQTT] Published: %d, had to wait: %d, replaced by a newer value: %d, dropped: %d, waiting: %d, retained kept: %d"),
+              _mqtt_queue.published,
+              _mqtt_queue.queued,
+              _mqtt_queue.coalesced,
+              _mqtt_queue.dropped,
+              _mqtt_queue.waiting,
+              _mqtt_queue.retained);
+    myDebug_P(PSTR(" [MQTT] Incoming messages dropped: %d"), _mqtt_rx_dropped);
+    myDebug_P(PSTR(" [FS] File writes: %d"), _fs_writes);
+    myDebug_P(PSTR(" [FS] Config saves requested: %d, skipped as unchanged: %d%s"),
+              _fs_save_requests,
+              _fs_save_skipped,
+              _fs_dirty ? " (save pending)" : "");
 
     myDebug_P(PSTR(""));
 }
@@ -1013,8 +1117,8 @@ void MyESP::_mqttConnect() {
 
     // last will
     if (_mqtt_will_topic) {
-        //myDebug_P(PSTR("[MQTT] Setting last will topic %s"), _mqttTopic(_mqtt_will_topic));
-        mqttClient.setWill(_mqttTopic(_mqtt_will_topic), 1, true,
+        //myDebug_P(PSTR("[MQTT] Setting last will topic %s"), _mqtt_will_fulltopic);
+        mqttClient.setWill(_mqtt_will_fulltopic, 1, true,
                            _mqtt_will_offline_payload); // retain always true
     }
 
@@ -1033,16 +1137,16 @@ void MyESP::_mqttConnect() {
 void MyESP::setWIFI(const char * wifi_ssid, const char * wifi_password, wifi_callback_f callback) {
     // Check SSID too long or missing
     if (!wifi_ssid || *wifi_ssid == 0x00 || strlen(wifi_ssid) > 31) {
-        _wifi_ssid = NULL;
+        _wifi_ssid = _setConfigString(_config.wifi_ssid, sizeof(_config.wifi_ssid), NULL);
     } else {
-        _wifi_ssid = strdup(wifi_ssid);
+        _wifi_ssid = _setConfigString(_config.wifi_ssid, sizeof(_config.wifi_ssid), wifi_ssid);
     }
 
     // Check PASS too long
     if (!wifi_password || *wifi_ssid == 0x00 || strlen(wifi_password) > 31) {
-        _wifi_password = NULL;
+        _wifi_password = _setConfigString(_config.wifi_password, sizeof(_config.wifi_password), NULL);
     } else {
-        _wifi_password = strdup(wifi_password);
+        _wifi_password = _setConfigString(_config.wifi_password, sizeof(_config.wifi_password), wifi_password);
     }
 
     // callback
@@ -1063,23 +1167,23 @@ void MyESP::setMQTT(const char *    mqtt_host,
                     mqtt_callback_f callback) {
     // can be empty
     if (!mqtt_host || *mqtt_host == 0x00) {
-        _mqtt_host = NULL;
+        _mqtt_host = _setConfigString(_config.mqtt_host, sizeof(_config.mqtt_host), NULL);
     } else {
-        _mqtt_host = strdup(mqtt_host);
+        _mqtt_host = _setConfigString(_config.mqtt_host, sizeof(_config.mqtt_host), mqtt_host);
     }
 
     // mqtt username and password can be empty
     if (!mqtt_username || *mqtt_username == 0x00) {
-        _mqtt_username = NULL;
+        _mqtt_username = _setConfigString(_config.mqtt_username, sizeof(_config.mqtt_username), NULL);
     } else {
-        _mqtt_username = strdup(mqtt_username);
+        _mqtt_username = _setConfigString(_config.mqtt_username, sizeof(_config.mqtt_username), mqtt_username);
     }
 
     // can be empty
     if (!mqtt_password || *mqtt_password == 0x00) {
-        _mqtt_password = NULL;
+        _mqtt_password = _setConfigString(_config.mqtt_password, sizeof(_config.mqtt_password), NULL);
     } else {
-        _mqtt_password = strdup(mqtt_password);
+        _mqtt_password = _setConfigString(_config.mqtt_password, sizeof(_config.mqtt_password), mqtt_password);
     }
 
     // base
@@ -1114,22 +1218,28 @@ void MyESP::setMQTT(const char *    mqtt_host,
     } else {
         _mqtt_will_offline_payload = strdup(mqtt_will_offline_payload);
     }
-}
 
-// builds up a topic by prefixing the base and hostname
-char * MyESP::_mqttTopic(const char * topic) {
-    char buffer[MQTT_MAX_TOPIC_SIZE] = {0};
+    _mqttSetPrefix();
+}
 
-    strlcpy(buffer, _mqtt_base, sizeof(buffer));
-    strlcat(buffer, "/", sizeof(buffer));
-    strlcat(buffer, _app_hostname, sizeof(buffer));
-    strlcat(buffer, "/", sizeof(buffer));
-    strlcat(buffer, topic, sizeof(buffer));
+// works out MQTT_BASE/app_hostname/ once, whenever the base or hostname change
+// and the full will topic, which is used on every connect
+void MyESP::_mqttSetPrefix() {
+    snprintf(_mqtt_prefix, sizeof(_mqtt_prefix), "%s/%s/", _mqtt_base ? _mqtt_base : "", _app_hostname);
+    _mqtt_prefix_length = strlen(_mqtt_prefix);
 
-    if (_mqtt_topic) {
-        free(_mqtt_topic);
+    if (_mqtt_will_topic) {
+        strlcpy(_mqtt_will_fulltopic, _mqttTopic(_mqtt_will_topic), sizeof(_mqtt_will_fulltopic));
+    } else {
+        _mqtt_will_fulltopic[0] = '\0';
     }
-    _mqtt_topic = strdup(buffer);
+}
+
+// builds up a topic by prefixing the base and hostname
+// the result is only valid until the next call
+char * MyESP::_mqttTopic(const char * topic) {
+    memcpy(_mqtt_topic, _mqtt_prefix, _mqtt_prefix_length);
+    strlcpy(_mqtt_topic + _mqtt_prefix_length, topic, sizeof(_mqtt_topic) - _mqtt_prefix_length);
 
     return _mqtt_topic;
 }
@@ -1158,29 +1268,102 @@ void MyESP::_fs_eraseConfig() {
     myDebug_P(PSTR("[FS] Erasing settings, please wait a few seconds. ESP will "
                    "automatically restart when finished."));
 
+    _fs_dirty = false; // nothing to save anymore
+
     if (SPIFFS.format()) {
         delay(1000); // wait 1 seconds
         resetESP();
     }
 }
 
-void MyESP::setSettings(fs_callback_f callback_fs, fs_settings_callback_f callback_settings_fs) {
+void MyESP::setSettings(fs_callback_f callback_fs, fs_settings_callback_f callback_settings_fs, fs_record_callback_f callback_record_fs) {
     _fs_callback          = callback_fs;
     _fs_settings_callback = callback_settings_fs;
+    _fs_record_callback   = callback_record_fs;
+}
+
+// copy a setting into its fixed slot in the config record
+// returns the slot, or NULL if the setting is empty so the existing 'not set' checks keep working
+char * MyESP::_setConfigString(char * store, size_t size, const char * value) {
+    if (!value || *value == '\0') {
+        store[0] = '\0';
+        return NULL;
+    }
+
+    if (value != store) {
+        strlcpy(store, value, size);
+    }
+    store[size - 1] = '\0';
+
+    return store;
 }
 
-// load from spiffs
+// load the settings from the binary config record in spiffs
+// returns false if it's missing or corrupt, so the caller can write a fresh one
 bool MyESP::_fs_loadConfig() {
+    uint8_t                 buffer[sizeof(myesp_config_header_t) + sizeof(myesp_config_t) + MYESP_CONFIG_APP_MAXSIZE];
+    myesp_config_header_t * header = (myesp_config_header_t *)buffer;
+    uint8_t *               data   = buffer + sizeof(myesp_config_header_t);
+
+    size_t size = fs_loadFile(MYESP_CONFIG_BIN_FILE, buffer, sizeof(buffer));
+    if (size == 0) {
+        // no binary config yet, so take the settings from an old config.json if there is one
+        if (!_fs_importConfig()) {
+            // file does not exist, so assume its the first install. Set serial to on
+            _use_serial = true;
+        }
+        return false;
+    }
+
+    if ((size < sizeof(myesp_config_header_t) + sizeof(myesp_config_t)) || (header->magic != MYESP_CONFIG_MAGIC)
+        || (header->version != MYESP_CONFIG_VERSION) || (header->app_size > MYESP_CONFIG_APP_MAXSIZE)
+        || (size != sizeof(myesp_config_header_t) + sizeof(myesp_config_t) + header->app_size)) {
+        myDebug_P(PSTR("[FS] Config file has an unknown layout"));
+        return false;
+    }
+
+    if (CRC32::calculate(data, sizeof(myesp_config_t) + header->app_size) != header->crc) {
+        myDebug_P(PSTR("[FS] Config file is corrupt"));
+        return false;
+    }
+
+    memcpy(&_config, data, sizeof(myesp_config_t));
+
+    // point the settings at the record, a string that fills its slot is cut off
+    _wifi_ssid     = _setConfigString(_config.wifi_ssid, sizeof(_config.wifi_ssid), _config.wifi_ssid);
+    _wifi_password = _setConfigString(_config.wifi_password, sizeof(_config.wifi_password), _config.wifi_password);
+    _mqtt_host     = _setConfigString(_config.mqtt_host, sizeof(_config.mqtt_host), _config.mqtt_host);
+    _mqtt_username = _setConfigString(_config.mqtt_username, sizeof(_config.mqtt_username), _config.mqtt_username);
+    _mqtt_password = _setConfigString(_config.mqtt_password, sizeof(_config.mqtt_password), _config.mqtt_password);
+    _use_serial    = _config.use_serial;
+
+    _config_crc = header->crc;
+
+    // callback for loading custom settings
+    // returns false if the record doesn't match what the application expects, which rewrites it with the defaults
+    if (!_fs_record_callback) {
+        return true;
+    }
+    return ((_fs_record_callback)(MYESP_FSACTION_LOAD, data + sizeof(myesp_config_t), header->app_size) != 0);
+}
+
+// load settings from the JSON config file
+// used by 'set import' and to migrate from older versions which only had config.json
+bool MyESP::_fs_importConfig() {
+    if (!SPIFFS.exists(MYEMS_CONFIG_FILE)) {
+        return false;
+    }
+
     File configFile = SPIFFS.open(MYEMS_CONFIG_FILE, "r");
 
     size_t size = configFile.size();
     if (size > 1024) {
         myDebug_P(PSTR("[FS] Config file size is too large"));
+        configFile.close();
         return false;
     } else if (size == 0) {
         myDebug_P(PSTR("[FS] Failed to open config file"));
-        // file does not exist, so assume its the first install. Set serial to on
-        _use_serial = true;
+        configFile.close();
         return false;
     }
 
@@ -1189,42 +1372,88 @@ bool MyESP::_fs_loadConfig() {
 
     // Deserialize the JSON document
     DeserializationError error = deserializeJson(doc, configFile);
+    configFile.close();
     if (error) {
         myDebug_P(PSTR("[FS] Failed to read config file"));
         return false;
     }
 
-    const char * value;
-
     // fetch the standard system parameters
-    value      = json["wifi_ssid"];
-    _wifi_ssid = (value) ? strdup(value) : NULL;
+    _wifi_ssid     = _setConfigString(_config.wifi_ssid, sizeof(_config.wifi_ssid), json["wifi_ssid"].as<const char *>());
+    _wifi_password = _setConfigString(_config.wifi_password, sizeof(_config.wifi_password), json["wifi_password"].as<const char *>());
+    _mqtt_host     = _setConfigString(_config.mqtt_host, sizeof(_config.mqtt_host), json["mqtt_host"].as<const char *>());
+    _mqtt_username = _setConfigString(_config.mqtt_username, sizeof(_config.mqtt_username), json["mqtt_username"].as<const char *>());
+    _mqtt_password = _setConfigString(_config.mqtt_password, sizeof(_config.mqtt_password), json["mqtt_password"].as<const char *>());
 
-    value          = json["wifi_password"];
-    _wifi_password = (value) ? strdup(value) : NULL;
+    _use_serial = (bool)json["use_serial"];
 
-    value      = json["mqtt_host"];
-    _mqtt_host = (value) ? strdup(value) : NULL;
+    // callback for loading custom settings
+    (void)(_fs_callback)(MYESP_FSACTION_LOAD, json);
 
-    value          = json["mqtt_username"];
-    _mqtt_username = (value) ? strdup(value) : NULL;
+    myDebug_P(PSTR("[FS] Settings imported from %s"), MYEMS_CONFIG_FILE);
 
-    value          = json["mqtt_password"];
-    _mqtt_password = (value) ? strdup(value) : NULL;
+    return true;
+}
 
-    _use_serial = (bool)json["use_serial"];
+// save settings to spiffs as a binary record
+// the application's settings are added by the record callback
+// nothing is written if the settings haven't changed since the last save
+bool MyESP::fs_saveConfig() {
+    uint8_t                 buffer[sizeof(myesp_config_header_t) + sizeof(myesp_config_t) + MYESP_CONFIG_APP_MAXSIZE];
+    myesp_config_header_t * header = (myesp_config_header_t *)buffer;
+    uint8_t *               data   = buffer + sizeof(myesp_config_header_t);
+
+    _config.use_serial = _use_serial;
+    memcpy(data, &_config, sizeof(myesp_config_t));
+
+    // callback for saving custom settings, returns the size used
+    size_t app_size = 0;
+    if (_fs_record_callback) {
+        memset(data + sizeof(myesp_config_t), 0, MYESP_CONFIG_APP_MAXSIZE);
+        app_size = (_fs_record_callback)(MYESP_FSACTION_SAVE, data + sizeof(myesp_config_t), MYESP_CONFIG_APP_MAXSIZE);
+        if (app_size > MYESP_CONFIG_APP_MAXSIZE) {
+            app_size = MYESP_CONFIG_APP_MAXSIZE;
+        }
+    }
 
-    // callback for loading custom settings
-    // ok is false if there's a problem loading a custom setting (e.g. does not exist)
-    bool ok = (_fs_callback)(MYESP_FSACTION_LOAD, json);
+    _fs_dirty = false;
 
-    configFile.close();
+    uint32_t crc = CRC32::calculate(data, sizeof(myesp_config_t) + app_size);
+    if (crc == _config_crc) {
+        _fs_save_skipped++;
+        return true; // unchanged, spare the flash
+    }
+
+    header->magic    = MYESP_CONFIG_MAGIC;
+    header->version  = MYESP_CONFIG_VERSION;
+    header->app_size = app_size;
+    header->crc      = crc;
+
+    bool ok = fs_saveFile(MYESP_CONFIG_BIN_FILE, buffer, sizeof(myesp_config_header_t) + sizeof(myesp_config_t) + app_size);
+    if (ok) {
+        _config_crc = crc;
+    }
 
     return ok;
 }
 
-// save settings to spiffs
-bool MyESP::fs_saveConfig() {
+// mark the config as changed. It is written from loop() once there have been no further changes
+// for MYESP_CONFIG_SAVE_DELAY, so a burst of changes costs a single flash write
+void MyESP::fs_requestSaveConfig() {
+    _fs_dirty           = true;
+    _fs_dirty_timestamp = millis();
+    _fs_save_requests++;
+}
+
+// write the config if a save was requested and things have settled down
+void MyESP::_fs_loop() {
+    if (_fs_dirty && ((millis() - _fs_dirty_timestamp) >= MYESP_CONFIG_SAVE_DELAY)) {
+        (void)fs_saveConfig();
+    }
+}
+
+// save settings to the JSON config file, used by 'set export'
+bool MyESP::_fs_exportConfig() {
     bool ok = true;
 
     // call any custom functions before handling SPIFFS
@@ -1246,33 +1475,75 @@ bool MyESP::fs_saveConfig() {
     // callback for saving custom settings
     (void)(_fs_callback)(MYESP_FSACTION_SAVE, json);
 
-    // if file exists, remove it just to be safe
-    if (SPIFFS.exists(MYEMS_CONFIG_FILE)) {
-        SPIFFS.remove(MYEMS_CONFIG_FILE);
-    }
-
     // open for writing
     File configFile = SPIFFS.open(MYEMS_CONFIG_FILE, "w");
     if (!configFile) {
         myDebug_P(PSTR("[FS] Failed to open config file for writing"));
-        return false;
+        ok = false;
+    } else {
+        // Serialize JSON to file
+        if (serializeJson(json, configFile) == 0) {
+            myDebug_P(PSTR("[FS] Failed to write config file"));
+            ok = false;
+        }
+        configFile.close();
+        _fs_writes++;
     }
 
-
-    // Serialize JSON to file
-    if (serializeJson(json, configFile) == 0) {
-        myDebug_P(PSTR("[FS] Failed to write config file"));
-        ok = false;
+    // call any custom functions after handling SPIFFS
+    if (_ota_post_callback) {
+        (_ota_post_callback)();
     }
 
-    configFile.close();
+    return ok;
+}
+
+// save a binary blob to spiffs, e.g. a snapshot of the application state
+bool MyESP::fs_saveFile(const char * filename, const uint8_t * data, size_t size) {
+    bool ok = true;
 
     // call any custom functions before handling SPIFFS
+    if (_ota_pre_callback) {
+        (_ota_pre_callback)();
+    }
+
+    File file = SPIFFS.open(filename, "w");
+    if (!file) {
+        myDebug_P(PSTR("[FS] Failed to open %s for writing"), filename);
+        ok = false;
+    } else {
+        if (file.write(data, size) != size) {
+            myDebug_P(PSTR("[FS] Failed to write %s"), filename);
+            ok = false;
+        }
+        file.close();
+        _fs_writes++;
+    }
+
+    // call any custom functions after handling SPIFFS
     if (_ota_post_callback) {
         (_ota_post_callback)();
     }
 
-    return ok; // it worked
+    return ok;
+}
+
+// read a binary blob from spiffs into data, up to size bytes
+// returns the number of bytes read, 0 if the file doesn't exist
+size_t MyESP::fs_loadFile(const char * filename, uint8_t * data, size_t size) {
+    if (!SPIFFS.exists(filename)) {
+        return 0;
+    }
+
+    File file = SPIFFS.open(filename, "r");
+    if (!file) {
+        return 0;
+    }
+
+    size_t len = file.read(data, size);
+    file.close();
+
+    return len;
 }
 
 // init the SPIFF file system and load the config
@@ -1287,7 +1558,10 @@ void MyESP::_fs_setup() {
     // load the config file. if it doesn't exist (function returns false) create it
     if (!_fs_loadConfig()) {
         //myDebug_P(PSTR("[FS] Re-creating config file"));
-        fs_saveConfig();
+        _config_crc = 0; // force the write
+        if (fs_saveConfig() && SPIFFS.exists(MYEMS_CONFIG_FILE)) {
+            SPIFFS.remove(MYEMS_CONFIG_FILE); // migrated to the binary config
+        }
     }
 
     // _fs_printConfig(); // enable for debugging
@@ -1509,6 +1783,8 @@ void MyESP::begin(const char * app_hostname, const char * app_name, const char *
     _app_name     = strdup(app_name);
     _app_version  = strdup(app_version);
 
+    _mqttSetPrefix(); // the hostname is part of every topic
+
     _telnet_setup(); // Telnet setup, does first to set Serial
     _eeprom_setup(); // set up eeprom for storing crash data
     _fs_setup();     // SPIFFS setup, do this first to get values
@@ -1522,6 +1798,7 @@ void MyESP::begin(const char * app_hostname, const char * app_name, const char *
 void MyESP::loop() {
     _calculateLoad();
     _telnetHandle();
+    _fs_loop(); // deferred config saving
 
     jw.loop(); // WiFi
 
@@ -1532,6 +1809,8 @@ void MyESP::loop() {
 
     ArduinoOTA.handle(); // OTA
     _mqttConnect();      // MQTT
+    _mqttRxFlush();      // incoming commands
+    _mqtt_queue.flush(); // publishes that had to wait
 
     yield(); // ...and breath
 }
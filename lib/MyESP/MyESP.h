@@ -14,9 +14,11 @@
 #include <ArduinoJson.h>
 #include <ArduinoOTA.h>
 #include <AsyncMqttClient.h> // https://github.com/marvinroger/async-mqtt-client and for ESP32 see https://github.com/marvinroger/async-mqtt-client/issues/127
+#include <CRC32.h>           // https://github.com/bakercp/CRC32
 #include <DNSServer.h>
 #include <FS.h>
 #include <JustWifi.h>  // https://github.com/xoseperez/justwifi
+#include <MqttQueue.h>
 #include <TelnetSpy.h> // modified from https://github.com/yasheena/telnetspy
 
 #ifdef CRASH
@@ -36,7 +38,14 @@ void custom_crash_callback(struct rst_info *, uint32_t, uint32_t);
 #define OTA_PORT 3232
 #endif
 
-#define MYEMS_CONFIG_FILE "/config.json"
+#define MYEMS_CONFIG_FILE "/config.json" // only used for import/export and to migrate old installs
+
+// binary config record, see fs_saveConfig()
+#define MYESP_CONFIG_BIN_FILE "/config.bin"
+#define MYESP_CONFIG_MAGIC 0x4D594346 // "MYCF"
+#define MYESP_CONFIG_VERSION 1        // bump when myesp_config_t changes
+#define MYESP_CONFIG_APP_MAXSIZE 256  // max size of the application's own settings record
+#define MYESP_CONFIG_SAVE_DELAY 5000  // quiet time in ms after the last change before the config is written
 
 #define LOADAVG_INTERVAL 30000 // Interval between calculating load average (in ms)
 
@@ -49,7 +58,8 @@ void custom_crash_callback(struct rst_info *, uint32_t, uint32_t);
 #define MQTT_RECONNECT_DELAY_MIN 2000   // Try to reconnect in 3 seconds upon disconnection
 #define MQTT_RECONNECT_DELAY_STEP 3000  // Increase the reconnect delay in 3 seconds after each failed attempt
 #define MQTT_RECONNECT_DELAY_MAX 120000 // Set reconnect time to 2 minutes at most
-#define MQTT_MAX_TOPIC_SIZE 50          // max length of MQTT message
+#define MQTT_RX_QUEUE_MAX 4             // # incoming messages waiting to be handled in loop(), must be a power of 2
+#define MQTT_RX_PAYLOAD_MAX 256         // longest incoming payload, longer ones are dropped
 #define MQTT_TOPIC_START "start"
 #define MQTT_TOPIC_START_PAYLOAD "start"
 #define MQTT_TOPIC_RESTART "restart"
@@ -87,7 +97,7 @@ void custom_crash_callback(struct rst_info *, uint32_t, uint32_t);
 #define COLOR_BRIGHT_WHITE "\x1B[0;97m"
 
 // SPIFFS
-#define SPIFFS_MAXSIZE 600 // https://arduinojson.org/v6/assistant/
+#define SPIFFS_MAXSIZE 800 // https://arduinojson.org/v6/assistant/
 
 // CRASH
 /**
@@ -125,8 +135,32 @@ typedef struct {
     char description[100];
 } command_t;
 
+// an incoming message waiting to be handled in loop(), see _mqttOnMessage()
+typedef struct {
+    char topic[MQTT_MAX_TOPIC_SIZE]; // without the base and hostname
+    char payload[MQTT_RX_PAYLOAD_MAX + 1];
+} mqtt_message_t;
+
 typedef enum { MYESP_FSACTION_SET, MYESP_FSACTION_LIST, MYESP_FSACTION_SAVE, MYESP_FSACTION_LOAD } MYESP_FSACTION;
 
+// header of the binary config file, followed by myesp_config_t and the application's record
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t app_size; // size of the application's record
+    uint32_t crc;      // CRC32 of everything after the header
+} myesp_config_header_t;
+
+// system settings, stored as fixed size strings so nothing is allocated on the heap
+typedef struct {
+    char wifi_ssid[33];
+    char wifi_password[65];
+    char mqtt_host[65];
+    char mqtt_username[33];
+    char mqtt_password[65];
+    bool use_serial;
+} myesp_config_t;
+
 typedef std::function<void(unsigned int, const char *, const char *)>            mqtt_callback_f;
 typedef std::function<void()>                                                    wifi_callback_f;
 typedef std::function<void()>                                                    ota_callback_f;
@@ -134,6 +168,7 @@ typedef std::function<void(uint8_t, const char *)>
 typedef std::function<void(uint8_t)>                                             telnet_callback_f;
 typedef std::function<bool(MYESP_FSACTION, const JsonObject json)>               fs_callback_f;
 typedef std::function<bool(MYESP_FSACTION, uint8_t, const char *, const char *)> fs_settings_callback_f;
+typedef std::function<size_t(MYESP_FSACTION, uint8_t *, size_t)>                 fs_record_callback_f;
 
 // calculates size of an 2d array at compile time
 template <typename T, size_t N>
@@ -160,6 +195,10 @@ class MyESP {
     void mqttSubscribe(const char * topic);
     void mqttUnsubscribe(const char * topic);
     void mqttPublish(const char * topic, const char * payload);
+    void mqttPublish(const char * topic, const char * payload, size_t length);
+    bool mqttPublishDirect(const char * topic, const char * payload, bool retain);
+    bool mqttPublishQueueEmpty();
+    const char * mqttPrefix();
     void setMQTT(const char *    mqtt_host,
                  const char *    mqtt_username,
                  const char *    mqtt_password,
@@ -178,13 +217,17 @@ class MyESP {
     // debug & telnet
     void myDebug(const char * format, ...);
     void myDebug_P(PGM_P format_P, ...);
+    void myDebugLine(const char * line);
     void setTelnet(command_t * cmds, uint8_t count, telnetcommand_callback_f callback_cmd, telnet_callback_f callback);
     bool getUseSerial();
     void setUseSerial(bool toggle);
 
     // FS
-    void setSettings(fs_callback_f callback, fs_settings_callback_f fs_settings_callback);
-    bool fs_saveConfig();
+    void setSettings(fs_callback_f callback, fs_settings_callback_f fs_settings_callback, fs_record_callback_f fs_record_callback = nullptr);
+    bool   fs_saveConfig();
+    void   fs_requestSaveConfig();
+    bool   fs_saveFile(const char * filename, const uint8_t * data, size_t size);
+    size_t fs_loadFile(const char * filename, uint8_t * data, size_t size);
 
     // Crash
     void crashClear();
@@ -206,13 +249,16 @@ class MyESP {
     // mqtt
     AsyncMqttClient mqttClient;
     unsigned long   _mqtt_reconnect_delay;
-    void            _mqttOnMessage(char * topic, char * payload, size_t len);
+    void            _mqttOnMessage(char * topic, char * payload, size_t len, size_t index, size_t total);
+    void            _mqttHandleMessage(const char * topic, const char * message);
+    void            _mqttRxFlush();
     void            _mqttConnect();
     void            _mqtt_setup();
     mqtt_callback_f _mqtt_callback;
     void            _mqttOnConnect();
     void            _sendStart();
     char *          _mqttTopic(const char * topic);
+    void            _mqttSetPrefix();
     char *          _mqtt_host;
     char *          _mqtt_username;
     char *          _mqtt_password;
@@ -223,9 +269,17 @@ class MyESP {
     char *          _mqtt_will_topic;
     char *          _mqtt_will_online_payload;
     char *          _mqtt_will_offline_payload;
-    char *          _mqtt_topic;
+    char            _mqtt_prefix[MQTT_MAX_TOPIC_SIZE];         // MQTT_BASE/app_hostname/, see _mqttSetPrefix()
+    uint8_t         _mqtt_prefix_length;
+    char            _mqtt_topic[MQTT_MAX_TOPIC_SIZE];          // scratch for _mqttTopic()
+    char            _mqtt_will_fulltopic[MQTT_MAX_TOPIC_SIZE]; // kept by AsyncMqttClient, so it has its own buffer
     unsigned long   _mqtt_last_connection;
     bool            _mqtt_connecting;
+    MqttQueue       _mqtt_queue; // publishes that had to wait and the retained payloads
+    mqtt_message_t   _mqtt_rx[MQTT_RX_QUEUE_MAX];
+    volatile uint8_t _mqtt_rx_head;    // next to handle, only changed in loop()
+    volatile uint8_t _mqtt_rx_tail;    // next free, only changed by the MQTT callback
+    uint32_t         _mqtt_rx_dropped; // # incoming messages dropped, too long or the queue was full
 
     // wifi
     DNSServer       dnsServer; // For Access Point (AP) support
@@ -263,14 +317,28 @@ class MyESP {
     bool                     _changeSetting(uint8_t wc, const char * setting, const char * value);
 
     // fs
-    void _fs_setup();
-    bool _fs_loadConfig();
-    void _fs_printConfig();
-    void _fs_eraseConfig();
+    void   _fs_setup();
+    bool   _fs_loadConfig();
+    bool   _fs_importConfig();
+    bool   _fs_exportConfig();
+    void   _fs_printConfig();
+    void   _fs_eraseConfig();
+    void   _fs_loop();
+    char * _setConfigString(char * store, size_t size, const char * value);
 
     // settings
     fs_callback_f          _fs_callback;
     fs_settings_callback_f _fs_settings_callback;
+    fs_record_callback_f   _fs_record_callback;
+    myesp_config_t         _config;     // backing store for the wifi, mqtt and serial settings
+    uint32_t               _config_crc; // CRC of the config last written to SPIFFS
+
+    // deferred config saving and flash wear counters
+    bool          _fs_dirty;              // a config save has been requested
+    unsigned long _fs_dirty_timestamp;    // time of the last request, the write waits for a quiet period
+    uint16_t      _fs_writes;             // # files written to SPIFFS since boot
+    uint16_t      _fs_save_requests;      // # config saves requested
+    uint16_t      _fs_save_skipped;       // # config saves skipped because nothing had changed
     void                   _printSetCommands();
 
     // general
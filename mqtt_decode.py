@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+
+"""Decode the MessagePack payloads published on the *_bin MQTT topics back to JSON
+
+The keys are indexes in HA_Fields (src/ha_discovery.h), which is read from the source tree.
+The first byte of a payload is the catalogue version of the firmware that sent it, a payload
+from a firmware with different HA_Fields is refused rather than decoded with the wrong keys.
+
+  mqtt_decode.py payload.bin                       decode a payload saved from MQTT, e.g. with mosquitto_sub -C 1 -N
+  mqtt_decode.py --benchmark boiler_data.json      compare the size and decode time against the JSON package
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+import timeit
+import zlib
+
+SRC = os.path.join(os.path.dirname(os.path.abspath(__file__)), "src")
+
+
+def read_defines():
+    defines = {}
+    for line in open(os.path.join(SRC, "my_config.h"), encoding="utf-8"):
+        m = re.match(r'\s*#define\s+(\w+)\s+"([^"]*)"', line)
+        if m:
+            defines[m.group(1)] = m.group(2)
+    return defines
+
+
+def read_catalogue():
+    """list of (topic, key) in the order of HA_Fields, key is None for a plain payload"""
+    defines = read_defines()
+
+    def resolve(token):
+        token = token.strip()
+        if token == "NULL":
+            return None
+        if token.startswith('"'):
+            return token.strip('"')
+        return defines[token]
+
+    source = open(os.path.join(SRC, "ha_discovery.h"), encoding="utf-8").read()
+    table = source[source.index("HA_Fields[]"):]
+    fields = []
+    for m in re.finditer(r"\{\s*HA_\w+\s*,\s*(\w+)\s*,\s*(\"[^\"]*\"|\w+)\s*,", table):
+        fields.append((resolve(m.group(1)), resolve(m.group(2))))
+    return fields
+
+
+def catalogue_version(fields):
+    """low byte of the CRC32 of each topic and key followed by a 0, as _binaryVersion() in the firmware"""
+    data = b"".join(topic.encode("utf-8") + (key or "").encode("utf-8") + b"\0" for topic, key in fields)
+    return zlib.crc32(data) & 0xFF
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, n):
+        if self.pos + n > len(self.data):
+            raise ValueError("payload is truncated")
+        b = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return b
+
+    def unpack(self, fmt):
+        return struct.unpack(fmt, self.take(struct.calcsize(fmt)))[0]
+
+    def value(self):
+        t = self.take(1)[0]
+        if t <= 0x7F:
+            return t
+        if t >= 0xE0:
+            return t - 0x100
+        if 0x80 <= t <= 0x8F:
+            return self.map(t & 0x0F)
+        if 0xA0 <= t <= 0xBF:
+            return self.take(t & 0x1F).decode("utf-8")
+        simple = {0xC0: None, 0xC2: False, 0xC3: True}
+        if t in simple:
+            return simple[t]
+        formats = {0xCA: ">f", 0xCB: ">d", 0xCC: ">B", 0xCD: ">H", 0xCE: ">I", 0xD0: ">b", 0xD1: ">h", 0xD2: ">i"}
+        if t in formats:
+            v = self.unpack(formats[t])
+            return round(v, 3) if t == 0xCA else v
+        if t == 0xD9:
+            return self.take(self.unpack(">B")).decode("utf-8")
+        if t == 0xDE:
+            return self.map(self.unpack(">H"))
+        raise ValueError("unsupported MessagePack type 0x%02X" % t)
+
+    def map(self, count):
+        return [(self.value(), self.value()) for _ in range(count)]
+
+
+def decode(data, fields, version):
+    """payload to a dict with the same keys as the JSON package, version is catalogue_version(fields)"""
+    reader = Reader(data)
+    sent = reader.take(1)[0]
+    if sent != version:
+        raise ValueError("payload is from a firmware with a different HA_Fields (version 0x%02X, expected 0x%02X)" % (sent, version))
+    pairs = reader.value()
+    result = {}
+    for key, value in pairs:
+        if isinstance(key, int):
+            key = fields[key][1]
+        if isinstance(value, bool):
+            value = "on" if value else "off"
+        result[key] = value
+    return result
+
+
+def encode(obj, fields, topic):
+    """the same encoding as publishBinaryValues() in the firmware, for the benchmark"""
+    index = {f: i for i, f in enumerate(fields)}
+
+    def int_(v):
+        if -32 <= v <= 127:
+            return struct.pack(">b", v) if v < 0 else bytes([v])
+        for fmt, t, lo, hi in ((">b", 0xD0, -128, 127), (">h", 0xD1, -32768, 32767)):
+            if lo <= v <= hi:
+                return bytes([t]) + struct.pack(fmt, v)
+        return b"\xd2" + struct.pack(">i", v)
+
+    def str_(s):
+        b = s.encode("utf-8")
+        return (bytes([0xA0 | len(b)]) if len(b) < 32 else bytes([0xD9, len(b)])) + b
+
+    def value(v):
+        if isinstance(v, int):
+            return int_(v)
+        if v in ("", "?"):
+            return b"\xc0"
+        if v in ("on", "off"):
+            return b"\xc3" if v == "on" else b"\xc2"
+        if re.fullmatch(r"-?\d+", v):
+            return int_(int(v))
+        try:
+            return b"\xca" + struct.pack(">f", float(v))
+        except ValueError:
+            return str_(v)
+
+    out = bytes([catalogue_version(fields)])
+    out += bytes([0x80 | len(obj)]) if len(obj) < 16 else b"\xde" + struct.pack(">H", len(obj))
+    for k, v in obj.items():
+        out += int_(index[(topic, k)]) if (topic, k) in index else str_(k)
+        out += value(v)
+    return out
+
+
+def benchmark(path, fields, topic):
+    text = open(path, encoding="utf-8").read().strip()
+    binary = encode(json.loads(text), fields, topic)
+    runs = 10000
+    t_json = timeit.timeit(lambda: json.loads(text), number=runs) / runs * 1e6
+    version = catalogue_version(fields)
+    t_bin = timeit.timeit(lambda: decode(binary, fields, version), number=runs) / runs * 1e6
+    print("topic:   %s" % topic)
+    print("JSON:    %4d bytes, decoded in %.1f us" % (len(text), t_json))
+    print("binary:  %4d bytes, decoded in %.1f us (%d%% of JSON)" % (len(binary), t_bin, len(binary) * 100 // len(text)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="decode EMS-ESP MessagePack MQTT payloads")
+    parser.add_argument("file", help="binary payload, or a JSON package with --benchmark")
+    parser.add_argument("--benchmark", action="store_true", help="compare size and decode time with the JSON package")
+    parser.add_argument("--topic", default="boiler_data", help="JSON topic the package is from, for --benchmark")
+    args = parser.parse_args()
+
+    fields = read_catalogue()
+    if args.benchmark:
+        benchmark(args.file, fields, args.topic)
+        return
+
+    data = sys.stdin.buffer.read() if args.file == "-" else open(args.file, "rb").read()
+    print(json.dumps(decode(data, fields, catalogue_version(fields))))
+
+
+if __name__ == "__main__":
+    main()
@@ -11,7 +11,9 @@
 #include "ds18.h"
 #include "ems.h"
 #include "ems_devices.h"
+#include "ems_print.h"
 #include "emsuart.h"
+#include "ha_discovery.h"
 #include "my_config.h"
 #include "version.h"
 
@@ -44,12 +46,25 @@ Ticker publishSensorValuesTimer;
 #define SYSTEMCHECK_TIME 20 // every 20 seconds check if Boiler is online
 Ticker systemCheckTimer;
 
-#define REGULARUPDATES_TIME 30 // every minute a call is made to fetch data from EMS devices manually
+#define REGULARUPDATES_TIME 5 // every 5 seconds check which EMS types are due to be read, see ems_pollDue()
 Ticker regularUpdatesTimer;
 
 #define LEDCHECK_TIME 500 // every 1/2 second blink the heartbeat LED
 Ticker ledcheckTimer;
 
+#define SNIFFER_PUBLISH_TIME 60 // every minute publish the sniffer summary to MQTT while it's on
+Ticker publishSnifferTimer;
+
+#define BURNER_PUBLISH_TIME 900 // every 15 minutes publish the burner analytics of the last 15 minutes
+Ticker publishBurnerTimer;
+
+// MQTT commands with an id get an ack or nack once their writes are done, see commandRequest()
+#define CMD_PENDING_MAX 4     // # commands that can wait for their outcome at the same time
+#define CMD_TIMEOUT 60000     // in ms. give up on a command if its writes were lost, e.g. the Tx queue was cleared
+
+// Home Assistant discovery, see publishDiscovery()
+#define HA_DISCOVERY_WAIT_TIME 5000 // in ms. how long to wait for the retained hash from the broker after connecting
+
 // thermostat scan - for debugging
 Ticker scanThermostat;
 #define SCANTHERMOSTAT_TIME 1
@@ -77,7 +92,7 @@ typedef struct {
     uint8_t  led_gpio;        // pin for LED
     uint8_t  dallas_gpio;     // pin for attaching external dallas temperature sensors
     bool     dallas_parasite; // on/off is using parasite
-    uint8_t  heating_circuit; // number of heating circuit, 1 or 2
+    uint8_t  heating_circuit; // number of heating circuit, 1 to 4
 } _EMSESP_Status;
 
 typedef struct {
@@ -88,6 +103,50 @@ typedef struct {
     bool     doingColdShot; // true if we've just sent a jolt of cold water
 } _EMSESP_Shower;
 
+// a raw telegram from MQTT waiting for its reply, see rawCommandBatch()
+typedef struct {
+    uint16_t tag; // passed to ems_sendRawTelegram(), 0 if free
+    uint8_t  index;
+    char     id[24];
+} _EMSESP_RawRequest;
+
+// an MQTT command with an id waiting for the outcome of its writes, see commandRequest()
+typedef struct {
+    uint16_t tag;       // passed to ems_setTxTag(), 0 if free
+    uint8_t  writes;    // # writes still to be done
+    bool     failed;    // one of the writes failed
+    bool     raw;       // one of the writes was a raw telegram, so it's only known to be sent
+    uint8_t  retries;   // highest # retries of the writes
+    uint32_t start;     // when the command came in, from millis()
+    char     topic[32]; // the command topic
+    char     id[24];
+} _EMSESP_CmdRequest;
+
+// where publishing the Home Assistant discovery configs is at
+typedef enum {
+    HA_DISCOVERY_DONE,    // up to date, or disabled
+    HA_DISCOVERY_WAIT,    // connected, waiting for the retained hash
+    HA_DISCOVERY_SENDING, // publishing the configs one by one
+} _HA_DISCOVERY_STATE;
+
+// the custom params as stored in the binary config record, see FSRecordCallback()
+#define EMSESP_SETTINGS_VERSION 1 // bump when _EMSESP_Settings changes
+typedef struct {
+    uint8_t  version;
+    uint8_t  thermostat_type;
+    uint8_t  boiler_type;
+    bool     led;
+    uint8_t  led_gpio;
+    uint8_t  dallas_gpio;
+    bool     dallas_parasite;
+    bool     silent_mode;
+    bool     shower_timer;
+    bool     shower_alert;
+    uint16_t publish_wait;
+    uint8_t  heating_circuit;
+    char     ems_devices[120]; // devices identified last time, see ems_getDeviceCache()
+} _EMSESP_Settings;
+
 command_t PROGMEM project_cmds[] = {
 
     {true, "led <on | off>", "toggle status LED on/off"},
@@ -100,15 +159,20 @@ command_t PROGMEM project_cmds[] = {
     {true, "shower_timer <on | off>", "notify via MQTT all shower durations"},
     {true, "shower_alert <on | off>", "send a warning of cold water after shower time is exceeded"},
     {true, "publish_wait <seconds>", "set frequency for publishing to MQTT"},
-    {true, "heating_circuit <1 | 2>", "set the thermostat HC to work with if using multiple heating circuits"},
+    {true, "heating_circuit <1 | 2 | 3 | 4>", "set the thermostat HC to work with if using multiple heating circuits"},
 
     {false, "info", "show data captured on the EMS bus"},
     {false, "log <n | b | t | r | v>", "set logging mode to none, basic, thermostat only, raw or verbose"},
+    {false, "filter [src | dest | type | dir <val> | clear]", "only log these telegrams, e.g. filter type 47"},
     {false, "publish", "publish all values to MQTT"},
     {false, "refresh", "fetch values from the EMS devices"},
+    {false, "polls", "show when each EMS type is read next"},
     {false, "types", "list supported EMS telegram type IDs"},
     {false, "queue", "show current Tx queue"},
     {false, "autodetect", "detect EMS devices and attempt to automatically set boiler and thermostat types"},
+    {false, "devices", "list the devices seen on the EMS bus"},
+    {false, "sniffer [on | off | listen | clear]", "count all telegram types on the bus, listen also stops Tx"},
+    {false, "history [10s | 1m | 15m <value>]", "show the min/avg/max history of a value, e.g. history 1m curFlowTemp"},
     {false, "shower <timer | alert>", "toggle either timer or alert on/off"},
     {false, "send XX ...", "send raw telegram data as hex to EMS bus"},
     {false, "thermostat read <type ID>", "send read request to the thermostat"},
@@ -127,6 +191,14 @@ command_t PROGMEM project_cmds[] = {
 _EMSESP_Status EMSESP_Status;
 _EMSESP_Shower EMSESP_Shower;
 
+_EMSESP_RawRequest EMSESP_RawRequests[EMS_RAW_PENDING_MAX]; // raw telegrams from MQTT waiting for a reply
+_EMSESP_CmdRequest EMSESP_CmdRequests[CMD_PENDING_MAX];     // MQTT commands waiting for an ack or nack
+uint16_t           EMSESP_Tag = 0;                          // last tag handed out
+
+_HA_DISCOVERY_STATE EMSESP_DiscoveryState     = HA_DISCOVERY_DONE;
+uint8_t             EMSESP_DiscoveryIndex     = 0; // next config to publish
+uint32_t            EMSESP_DiscoveryTimestamp = 0; // when we connected
+
 // logging messages with fixed strings
 void myDebugLog(const char * s) {
     if (ems_getLogging() >= EMS_SYS_LOGGING_BASIC) {
@@ -340,10 +412,38 @@ void showInfo() {
                 EMS_Sys_Status.emxCrcErr);
 
         if (ems_getTxCapable()) {
-            myDebug("  Tx: available, # Tx telegrams sent=%d", EMS_Sys_Status.emsTxPkgs);
+            myDebug("  Tx: available, # Tx telegrams sent=%d, # collisions=%d, # dropped as UART busy=%d",
+                    EMS_Sys_Status.emsTxPkgs,
+                    EMS_Sys_Status.emsTxCollisions,
+                    emsuart_tx_dropped());
+            ems_printTxDeviceStats();
         } else {
             myDebug("  Tx: no signal");
         }
+
+        _EMS_BusHealth health;
+        ems_getBusHealth(&health);
+        myDebug("  Last minute: %d.%d frames/s, %d bytes/s, bus load=%d.%d%%",
+                health.framesPerSec / 10,
+                health.framesPerSec % 10,
+                health.bytesPerSec,
+                health.load / 10,
+                health.load % 10);
+        myDebug("  Last minute: CRC errors=%d.%d%%, noise=%d.%d%%, poll misses=%d.%d%%, failed writes=%d.%d%%",
+                health.crcErrRate / 10,
+                health.crcErrRate % 10,
+                health.noiseRate / 10,
+                health.noiseRate % 10,
+                health.pollMissRate / 10,
+                health.pollMissRate % 10,
+                health.writeFailRate / 10,
+                health.writeFailRate % 10);
+        myDebug("  Since power on: # noise=%d, # poll rounds=%d, # poll misses=%d, # writes=%d, # failed writes=%d",
+                ems_getBusTotal(EMS_BUSSTATS_NOISE),
+                ems_getBusTotal(EMS_BUSSTATS_POLLROUNDS),
+                ems_getBusTotal(EMS_BUSSTATS_POLLMISSES),
+                ems_getBusTotal(EMS_BUSSTATS_WRITES),
+                ems_getBusTotal(EMS_BUSSTATS_WRITEFAILS));
     } else {
         myDebug("  No connection can be made to the EMS bus");
     }
@@ -441,6 +541,36 @@ void showInfo() {
                 EMS_Boiler.UBAuptime % 60);
     }
 
+    // burner analytics
+    _EMS_BurnerSummary burner;
+    ems_getBurnerSummary(&burner);
+    myDebug("  Burner in the last %d minutes: %d starts (%d.%d/h), on %d.%d%% of the time at %d%% on average",
+            burner.interval / 60,
+            burner.starts,
+            burner.startsPerHour / 10,
+            burner.startsPerHour % 10,
+            burner.duty / 10,
+            burner.duty % 10,
+            burner.modulation);
+    if (burner.cycles != 0) {
+        myDebug("  Burner cycles: %d, average %d seconds (%d-%d), %d seconds off in between",
+                burner.cycles,
+                burner.cycleAvg,
+                burner.cycleMin,
+                burner.cycleMax,
+                burner.pauseAvg);
+    }
+    if (burner.deltaT != (int16_t)EMS_VALUE_SHORT_NOTSET) {
+        _renderShortValue("Flow - return temperature while burning", "C", burner.deltaT);
+    }
+    myDebug("  Estimated energy: %d.%03d kWh, %d.%03d kWh since power on, gas %d.%03d m3",
+            burner.energy / 1000,
+            burner.energy % 1000,
+            burner.energyTotal / 1000,
+            burner.energyTotal % 1000,
+            burner.gas / 1000,
+            burner.gas % 1000);
+
     // For SM10 Solar Module
     if (EMS_Other.SM10) {
         myDebug(""); // newline
@@ -451,6 +581,16 @@ void showInfo() {
         _renderBoolValue("  Pump active", EMS_Other.SM10pump);
     }
 
+    // For MM10 Mixer Module
+    if (EMS_Mixer.MM10) {
+        myDebug(""); // newline
+        myDebug("%sMixer Module stats:%s", COLOR_BOLD_ON, COLOR_BOLD_OFF);
+        _renderIntValue("  Selected flow temperature", "C", EMS_Mixer.flowSetTemp);
+        _renderShortValue("  Current flow temperature", "C", EMS_Mixer.flowTemp);
+        _renderIntValue("  Pump modulation", "%", EMS_Mixer.pumpMod);
+        _renderIntValue("  Valve position", "%", EMS_Mixer.valveStatus);
+    }
+
     // Thermostat stats
     if (ems_getThermostatEnabled()) {
         myDebug(""); // newline
@@ -459,21 +599,45 @@ void showInfo() {
         if ((ems_getThermostatModel() == EMS_MODEL_EASY) || (ems_getThermostatModel() == EMS_MODEL_BOSCHEASY)) {
             // for easy temps are * 100
             // also we don't have the time or mode
-            _renderShortValue("Set room temperature", "C", EMS_Thermostat.setpoint_roomTemp, 10);
-            _renderShortValue("Current room temperature", "C", EMS_Thermostat.curr_roomTemp, 10);
+            _EMS_Thermostat_HC * thermostat = ems_getThermostatCircuit(1);
+            _renderShortValue("Set room temperature", "C", thermostat->setpoint_roomTemp, 10);
+            _renderShortValue("Current room temperature", "C", thermostat->curr_roomTemp, 10);
         } else {
-            // because we store in 2 bytes short, when converting to a single byte we'll loose the negative value if its unset
-            if ((EMS_Thermostat.setpoint_roomTemp <= 0) || (EMS_Thermostat.curr_roomTemp <= 0)) {
-                EMS_Thermostat.setpoint_roomTemp = EMS_VALUE_INT_NOTSET;
-                EMS_Thermostat.curr_roomTemp     = EMS_VALUE_INT_NOTSET;
-            }
-            _renderIntValue("Setpoint room temperature", "C", EMS_Thermostat.setpoint_roomTemp, 2); // convert to a single byte * 2
-            _renderIntValue("Current room temperature", "C", EMS_Thermostat.curr_roomTemp, 10);     // is *10
+            // the selected heating circuit and any others we've seen
+            for (uint8_t hc = 1; hc <= EMS_THERMOSTAT_MAXHC; hc++) {
+                _EMS_Thermostat_HC * thermostat = ems_getThermostatCircuit(hc);
+                if ((hc != EMSESP_Status.heating_circuit) && (!thermostat->active)) {
+                    continue;
+                }
+
+                myDebug("  Heating circuit %d%s:", hc, (hc == EMSESP_Status.heating_circuit) ? " (selected)" : "");
+
+                // because we store in 2 bytes short, when converting to a single byte we'll loose the negative value if its unset
+                // only shown that way, the circuit is left as it is since it's also published
+                uint8_t setpoint_roomTemp = thermostat->setpoint_roomTemp;
+                uint8_t curr_roomTemp     = thermostat->curr_roomTemp;
+                if ((thermostat->setpoint_roomTemp <= 0) || (thermostat->curr_roomTemp <= 0)) {
+                    setpoint_roomTemp = EMS_VALUE_INT_NOTSET;
+                    curr_roomTemp     = EMS_VALUE_INT_NOTSET;
+                }
+                _renderIntValue("Setpoint room temperature", "C", setpoint_roomTemp, 2); // convert to a single byte * 2
+                _renderIntValue("Current room temperature", "C", curr_roomTemp, 10);     // is *10
+
+                if (thermostat->holidaytemp > 0) {                                                 // only if we are on a RC35 we show more info
+                    _renderIntValue("Day temperature", "C", thermostat->daytemp, 2);          // convert to a single byte * 2
+                    _renderIntValue("Night temperature", "C", thermostat->nighttemp, 2);      // convert to a single byte * 2
+                    _renderIntValue("Vacation temperature", "C", thermostat->holidaytemp, 2); // convert to a single byte * 2
+                }
 
-            if ((EMS_Thermostat.holidaytemp > 0) && (EMSESP_Status.heating_circuit == 2)) {  // only if we are on a RC35 we show more info
-                _renderIntValue("Day temperature", "C", EMS_Thermostat.daytemp, 2);          // convert to a single byte * 2
-                _renderIntValue("Night temperature", "C", EMS_Thermostat.nighttemp, 2);      // convert to a single byte * 2
-                _renderIntValue("Vacation temperature", "C", EMS_Thermostat.holidaytemp, 2); // convert to a single byte * 2
+                if (thermostat->mode == 0) {
+                    myDebug("  Mode is set to low");
+                } else if (thermostat->mode == 1) {
+                    myDebug("  Mode is set to manual");
+                } else if (thermostat->mode == 2) {
+                    myDebug("  Mode is set to auto");
+                } else {
+                    myDebug("  Mode is set to ?");
+                }
             }
 
             myDebug("  Thermostat time is %02d:%02d:%02d %d/%d/%d",
@@ -483,15 +647,24 @@ void showInfo() {
                     EMS_Thermostat.day,
                     EMS_Thermostat.month,
                     EMS_Thermostat.year + 2000);
+        }
+    }
 
-            if (EMS_Thermostat.mode == 0) {
-                myDebug("  Mode is set to low");
-            } else if (EMS_Thermostat.mode == 1) {
-                myDebug("  Mode is set to manual");
-            } else if (EMS_Thermostat.mode == 2) {
-                myDebug("  Mode is set to auto");
-            } else {
-                myDebug("  Mode is set to ?");
+    // any further thermostats from the device registry
+    for (uint8_t i = 0; i < EMS_Devices_count; i++) {
+        _EMS_Device * device = &EMS_Devices[i];
+        if ((device->device_class != EMS_DEVICE_CLASS_THERMOSTAT) || (device->state == NULL) || (device->state == &EMS_Thermostat)) {
+            continue;
+        }
+
+        _EMS_Thermostat * thermostat = (_EMS_Thermostat *)device->state;
+        myDebug(""); // newline
+        myDebug("%sThermostat 0x%02X stats:%s", COLOR_BOLD_ON, device->device_id, COLOR_BOLD_OFF);
+        for (uint8_t hc = 0; hc < EMS_THERMOSTAT_MAXHC; hc++) {
+            if (thermostat->circuit[hc].active) {
+                myDebug("  Heating circuit %d:", hc + 1);
+                _renderIntValue("Setpoint room temperature", "C", thermostat->circuit[hc].setpoint_roomTemp, 2);
+                _renderShortValue("Current room temperature", "C", thermostat->circuit[hc].curr_roomTemp);
             }
         }
     }
@@ -517,6 +690,182 @@ void showInfo() {
     myDebug(""); // newline
 }
 
+// MessagePack encoding of a JSON package, for sites where every byte over MQTT counts
+// keys are the index in HA_Fields, so the decoder needs the same catalogue (see mqtt_decode.py and _binaryVersion())
+// values are converted back from the strings they're stored as in the JSON: numbers, on/off as bool, "?" as nil
+typedef struct {
+    uint8_t * buf;
+    size_t    size;
+    size_t    len;
+    bool      overflow;
+} _MsgPack;
+
+void _msgpack_write(_MsgPack * mp, const uint8_t * data, size_t len) {
+    if (mp->len + len > mp->size) {
+        mp->overflow = true;
+        return;
+    }
+    memcpy(mp->buf + mp->len, data, len);
+    mp->len += len;
+}
+
+void _msgpack_byte(_MsgPack * mp, uint8_t value) {
+    _msgpack_write(mp, &value, 1);
+}
+
+// big-endian, with the type byte first
+void _msgpack_be(_MsgPack * mp, uint8_t type, uint32_t value, uint8_t bytes) {
+    uint8_t b[5];
+    b[0] = type;
+    for (uint8_t i = 0; i < bytes; i++) {
+        b[bytes - i] = (value >> (i * 8)) & 0xFF;
+    }
+    _msgpack_write(mp, b, bytes + 1);
+}
+
+// smallest encoding that holds the value
+void _msgpack_int(_MsgPack * mp, int32_t value) {
+    if ((value >= -32) && (value <= 127)) {
+        _msgpack_byte(mp, (uint8_t)value); // positive or negative fixint
+    } else if ((value >= -128) && (value <= 127)) {
+        _msgpack_be(mp, 0xD0, (uint8_t)value, 1);
+    } else if ((value >= -32768) && (value <= 32767)) {
+        _msgpack_be(mp, 0xD1, (uint16_t)value, 2);
+    } else {
+        _msgpack_be(mp, 0xD2, (uint32_t)value, 4);
+    }
+}
+
+void _msgpack_float(_MsgPack * mp, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    _msgpack_be(mp, 0xCA, bits, 4);
+}
+
+void _msgpack_str(_MsgPack * mp, const char * s) {
+    size_t len = strlen(s);
+    if (len < 32) {
+        _msgpack_byte(mp, 0xA0 | len);
+    } else {
+        _msgpack_be(mp, 0xD9, len, 1); // our strings are never longer than 255
+    }
+    _msgpack_write(mp, (const uint8_t *)s, len);
+}
+
+// a value as it was put in the JSON, mostly strings from _int_to_char() and friends
+void _msgpack_value(_MsgPack * mp, JsonVariant value) {
+    if (value.is<int>()) {
+        _msgpack_int(mp, value.as<int>());
+        return;
+    }
+
+    const char * s = value.as<const char *>();
+    if ((s == NULL) || (*s == '\0') || (strcmp(s, "?") == 0)) {
+        _msgpack_byte(mp, 0xC0); // nil
+        return;
+    }
+
+    if (strcmp(s, "on") == 0) {
+        _msgpack_byte(mp, 0xC3); // true
+        return;
+    }
+
+    if (strcmp(s, "off") == 0) {
+        _msgpack_byte(mp, 0xC2); // false
+        return;
+    }
+
+    char * end;
+    long   l = strtol(s, &end, 10);
+    if (*end == '\0') {
+        _msgpack_int(mp, l);
+        return;
+    }
+
+    float f = strtod(s, &end);
+    if (*end == '\0') {
+        _msgpack_float(mp, f);
+        return;
+    }
+
+    _msgpack_str(mp, s);
+}
+
+// index of the field in HA_Fields, or -1 if it's not in the catalogue
+int8_t _binaryKey(const char * topic, const char * key) {
+    for (uint8_t i = 0; i < (sizeof(HA_Fields) / sizeof(_HA_Field)); i++) {
+        if ((HA_Fields[i].key != NULL) && (strcmp(HA_Fields[i].topic, topic) == 0) && (strcmp(HA_Fields[i].key, key) == 0)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// sent before the map so a decoder can tell if its HA_Fields has the same keys in the same order
+// low byte of the CRC32 of each topic and key followed by a 0, see catalogue_version() in mqtt_decode.py
+uint8_t _binaryVersion() {
+    static bool    done    = false;
+    static uint8_t version = 0;
+
+    if (!done) {
+        CRC32 crc;
+        for (uint8_t i = 0; i < ArraySize(HA_Fields); i++) {
+            crc.update(HA_Fields[i].topic, strlen(HA_Fields[i].topic));
+            if (HA_Fields[i].key) {
+                crc.update(HA_Fields[i].key, strlen(HA_Fields[i].key));
+            }
+            crc.update((uint8_t)0);
+        }
+        version = crc.finalize() & 0xFF;
+        done    = true;
+    }
+
+    return version;
+}
+
+// publish the same values as the JSON package on <topic>_bin, as the catalogue version byte and a MessagePack map
+// keys not in the catalogue (e.g. "stale") are sent as strings
+// data holds the JSON package that was just published, it's overwritten so there's no second buffer on the stack
+void publishBinaryValues(const char * topic, JsonObject root, char * data, size_t size) {
+    size_t   json_len = strlen(data);
+    _MsgPack mp       = {(uint8_t *)data, size, 0, false};
+    uint32_t start    = micros();
+
+    _msgpack_byte(&mp, _binaryVersion());
+
+    size_t count = root.size();
+    if (count < 16) {
+        _msgpack_byte(&mp, 0x80 | count);
+    } else {
+        _msgpack_be(&mp, 0xDE, count, 2);
+    }
+
+    for (JsonPair kv : root) {
+        int8_t index = _binaryKey(topic, kv.key().c_str());
+        if (index < 0) {
+            _msgpack_str(&mp, kv.key().c_str());
+        } else {
+            _msgpack_int(&mp, index);
+        }
+        _msgpack_value(&mp, kv.value());
+    }
+
+    if (mp.overflow) {
+        myDebug("Binary payload for %s is too big, not sent", topic);
+        return;
+    }
+
+    char bin_topic[MQTT_MAX_TOPIC_SIZE];
+    strlcpy(bin_topic, topic, sizeof(bin_topic));
+    strlcat(bin_topic, MQTT_BINARY_SUFFIX, sizeof(bin_topic));
+
+    if (ems_getLogging() == EMS_SYS_LOGGING_VERBOSE) {
+        myDebug("Binary payload for %s is %d bytes, JSON is %d bytes (encoded in %lu us)", topic, mp.len, json_len, micros() - start);
+    }
+
+    myESP.mqttPublish(bin_topic, data, mp.len);
+}
+
 // send all dallas sensor values as a JSON package to MQTT
 void publishSensorValues() {
     StaticJsonDocument<200> doc;
@@ -596,10 +945,129 @@ void publishValuesData2(bool force) {
             myDebugLog("Publishing thermostat2 data via MQTT");
             // send values via MQTT
             myESP.mqttPublish(TOPIC_THERMOSTAT2_DATA, data);
+#if MQTT_BINARY_PAYLOAD
+            publishBinaryValues(TOPIC_THERMOSTAT2_DATA, rootThermostat2, data, sizeof(data));
+#endif
         }
 }
 
 
+// publish the values of each RC35 heating circuit we've seen to its own topic, thermostat_data_hc1 to _hc4
+void publishThermostatCircuits(bool force) {
+    static uint32_t previousCircuitPublishCRC[EMS_THERMOSTAT_MAXHC] = {0}; // CRC check per heating circuit
+
+    if (ems_getThermostatModel() != EMS_MODEL_RC35) {
+        return; // only one heating circuit, it's all in thermostat_data
+    }
+
+    char                              s[20] = {0}; // for formatting strings
+    char                              topic[30];
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              data[MQTT_MAX_SIZE] = {0};
+    CRC32                             crc;
+
+    for (uint8_t hc = 1; hc <= EMS_THERMOSTAT_MAXHC; hc++) {
+        _EMS_Thermostat_HC * thermostat = ems_getThermostatCircuit(hc);
+        if (!thermostat->active) {
+            continue;
+        }
+
+        doc.clear();
+        JsonObject rootCircuit = doc.to<JsonObject>();
+
+        rootCircuit[THERMOSTAT_HC]              = _int_to_char(s, hc);
+        rootCircuit[THERMOSTAT_SELTEMP]         = _int_to_char(s, thermostat->setpoint_roomTemp, 2);
+        rootCircuit[THERMOSTAT_CURRTEMP]        = _short_to_char(s, thermostat->curr_roomTemp);
+        rootCircuit[THERMOSTAT_DAYTEMP]         = _int_to_char(s, thermostat->daytemp, 2);
+        rootCircuit[THERMOSTAT_NIGHTTEMP]       = _int_to_char(s, thermostat->nighttemp, 2);
+        rootCircuit[THERMOSTAT_HOLIDAYTEMP]     = _int_to_char(s, thermostat->holidaytemp, 2);
+        rootCircuit[THERMOSTAT_HEATINGTYPE]     = _int_to_char(s, thermostat->heatingtype);
+        rootCircuit[THERMOSTAT_CIRCUITCALCTEMP] = _int_to_char(s, thermostat->circuitcalctemp);
+
+        if (thermostat->mode == 0) {
+            rootCircuit[THERMOSTAT_MODE] = "night";
+        } else if (thermostat->mode == 1) {
+            rootCircuit[THERMOSTAT_MODE] = "day";
+        } else {
+            rootCircuit[THERMOSTAT_MODE] = "auto";
+        }
+
+        data[0] = '\0'; // reset data for next package
+        serializeJson(doc, data, sizeof(data));
+
+        crc.reset();
+        for (size_t i = 0; i < measureJson(doc) - 1; i++) {
+            crc.update(data[i]);
+        }
+        uint32_t fchecksum = crc.finalize();
+
+        if ((previousCircuitPublishCRC[hc - 1] != fchecksum) || force) {
+            previousCircuitPublishCRC[hc - 1] = fchecksum;
+            snprintf(topic, sizeof(topic), "%s%d", TOPIC_THERMOSTAT_HC_DATA, hc);
+            myDebugLog("Publishing thermostat heating circuit data via MQTT");
+            myESP.mqttPublish(topic, data);
+        }
+    }
+}
+
+// publish the values of any further thermostats in the device registry, each to thermostat_data_<bus ID>
+void publishThermostatDevices(bool force) {
+    static uint32_t previousDevicePublishCRC[EMS_DEVICES_MAX] = {0}; // CRC check per registry entry
+
+    char                              s[20] = {0}; // for formatting strings
+    char                              topic[30];
+    char                              hc_name[4] = "hc0";
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              data[MQTT_MAX_SIZE] = {0};
+    CRC32                             crc;
+
+    for (uint8_t i = 0; i < EMS_Devices_count; i++) {
+        _EMS_Device * device = &EMS_Devices[i];
+        if ((device->device_class != EMS_DEVICE_CLASS_THERMOSTAT) || (device->state == NULL) || (device->state == &EMS_Thermostat)) {
+            continue;
+        }
+
+        _EMS_Thermostat * thermostat = (_EMS_Thermostat *)device->state;
+
+        doc.clear();
+        JsonObject rootThermostat = doc.to<JsonObject>();
+        for (uint8_t hc = 0; hc < EMS_THERMOSTAT_MAXHC; hc++) {
+            _EMS_Thermostat_HC * circuit = &thermostat->circuit[hc];
+            if (!circuit->active) {
+                continue;
+            }
+
+            hc_name[2]            = '1' + hc;
+            JsonObject rootCircuit = rootThermostat.createNestedObject(hc_name);
+            rootCircuit[THERMOSTAT_SELTEMP]  = _int_to_char(s, circuit->setpoint_roomTemp, 2);
+            rootCircuit[THERMOSTAT_CURRTEMP] = _short_to_char(s, circuit->curr_roomTemp);
+            if (circuit->mode != 255) {
+                rootCircuit[THERMOSTAT_MODE] = _int_to_char(s, circuit->mode);
+            }
+        }
+
+        if (rootThermostat.size() == 0) {
+            continue; // nothing received yet
+        }
+
+        data[0] = '\0'; // reset data for next package
+        serializeJson(doc, data, sizeof(data));
+
+        crc.reset();
+        for (size_t j = 0; j < measureJson(doc) - 1; j++) {
+            crc.update(data[j]);
+        }
+        uint32_t fchecksum = crc.finalize();
+
+        if ((previousDevicePublishCRC[i] != fchecksum) || force) {
+            previousDevicePublishCRC[i] = fchecksum;
+            snprintf(topic, sizeof(topic), "%s%02X", TOPIC_THERMOSTAT_DEVICE_DATA, device->device_id);
+            myDebugLog("Publishing further thermostat data via MQTT");
+            myESP.mqttPublish(topic, data);
+        }
+    }
+}
+
 void publishValuesData1(bool force) {
     char                              s[20] = {0}; // for formatting strings
     StaticJsonDocument<MQTT_MAX_SIZE> doc;
@@ -613,8 +1081,10 @@ void publishValuesData1(bool force) {
 
     // handle the thermostat values separately
     if (ems_getThermostatEnabled()) {
+        _EMS_Thermostat_HC * thermostat = ems_getThermostatCircuit(); // the selected heating circuit
+
         // only send thermostat values if we actually have them
-        if (EMS_Thermostat.nighttemp <= 0 && EMS_Thermostat.daytemp <=0) {//lobocobra prevent due to bug, no mqtt
+        if (thermostat->nighttemp <= 0 && thermostat->daytemp <=0) {//lobocobra prevent due to bug, no mqtt
            return;
         }
         // build new json object
@@ -622,16 +1092,16 @@ void publishValuesData1(bool force) {
         JsonObject rootThermostat = doc.to<JsonObject>();
         rootThermostat[THERMOSTAT_HC] = _int_to_char(s, EMSESP_Status.heating_circuit);
         if ((ems_getThermostatModel() == EMS_MODEL_EASY) || (ems_getThermostatModel() == EMS_MODEL_BOSCHEASY)) {
-            rootThermostat[THERMOSTAT_SELTEMP]         = _short_to_char(s, EMS_Thermostat.setpoint_roomTemp, 10);
-            rootThermostat[THERMOSTAT_CURRTEMP]        = _short_to_char(s, EMS_Thermostat.curr_roomTemp, 10);
+            rootThermostat[THERMOSTAT_SELTEMP]         = _short_to_char(s, thermostat->setpoint_roomTemp, 10);
+            rootThermostat[THERMOSTAT_CURRTEMP]        = _short_to_char(s, thermostat->curr_roomTemp, 10);
         } else {
-            rootThermostat[THERMOSTAT_SELTEMP]         = _int_to_char(s, EMS_Thermostat.setpoint_roomTemp, 2);
-            rootThermostat[THERMOSTAT_CURRTEMP]        = _int_to_char(s, EMS_Thermostat.curr_roomTemp, 10);
-            rootThermostat[THERMOSTAT_DAYTEMP]         = _int_to_char(s, EMS_Thermostat.daytemp, 2);
-            rootThermostat[THERMOSTAT_NIGHTTEMP]       = _int_to_char(s, EMS_Thermostat.nighttemp, 2);
-            rootThermostat[THERMOSTAT_HOLIDAYTEMP]     = _int_to_char(s, EMS_Thermostat.holidaytemp, 2);
-            rootThermostat[THERMOSTAT_HEATINGTYPE]     = _int_to_char(s, EMS_Thermostat.heatingtype);
-            rootThermostat[THERMOSTAT_CIRCUITCALCTEMP] = _int_to_char(s, EMS_Thermostat.circuitcalctemp);
+            rootThermostat[THERMOSTAT_SELTEMP]         = _int_to_char(s, thermostat->setpoint_roomTemp, 2);
+            rootThermostat[THERMOSTAT_CURRTEMP]        = _short_to_char(s, thermostat->curr_roomTemp);
+            rootThermostat[THERMOSTAT_DAYTEMP]         = _int_to_char(s, thermostat->daytemp, 2);
+            rootThermostat[THERMOSTAT_NIGHTTEMP]       = _int_to_char(s, thermostat->nighttemp, 2);
+            rootThermostat[THERMOSTAT_HOLIDAYTEMP]     = _int_to_char(s, thermostat->holidaytemp, 2);
+            rootThermostat[THERMOSTAT_HEATINGTYPE]     = _int_to_char(s, thermostat->heatingtype);
+            rootThermostat[THERMOSTAT_CIRCUITCALCTEMP] = _int_to_char(s, thermostat->circuitcalctemp);
             // lobocobra start
             rootThermostat[THERMOSTAT_MINVORLAUF]      = _int_to_char(s, EMS_Thermostat.minvorlauf);       // 0x47,1
             rootThermostat[THERMOSTAT_MAXVORLAUF]      = _int_to_char(s, EMS_Thermostat.maxvorlauf);       // 0x47,2  
@@ -650,23 +1120,28 @@ void publishValuesData1(bool force) {
  
         // RC20 has different mode settings
         if (ems_getThermostatModel() == EMS_MODEL_RC20) {
-            if (EMS_Thermostat.mode == 0) {
+            if (thermostat->mode == 0) {
                 rootThermostat[THERMOSTAT_MODE] = "low";
-            } else if (EMS_Thermostat.mode == 1) {
+            } else if (thermostat->mode == 1) {
                 rootThermostat[THERMOSTAT_MODE] = "manual";
             } else {
                 rootThermostat[THERMOSTAT_MODE] = "auto";
             }
         } else {
-            if (EMS_Thermostat.mode == 0) {
+            if (thermostat->mode == 0) {
                 rootThermostat[THERMOSTAT_MODE] = "night";
-            } else if (EMS_Thermostat.mode == 1) {
+            } else if (thermostat->mode == 1) {
                 rootThermostat[THERMOSTAT_MODE] = "day";
             } else {
                 rootThermostat[THERMOSTAT_MODE] = "auto";
             }
         }
 
+        // values restored from the snapshot and not yet refreshed by the thermostat
+        if (EMS_Sys_Status.emsStale & EMS_STALE_THERMOSTAT) {
+            rootThermostat["stale"] = "1";
+        }
+
         data[0] = '\0'; // reset data for next package
         serializeJson(doc, data, sizeof(data));
 
@@ -682,6 +1157,9 @@ void publishValuesData1(bool force) {
             myDebugLog("Publishing thermostat data via MQTT");
             // send values via MQTT
         myESP.mqttPublish(TOPIC_THERMOSTAT_DATA, data);
+#if MQTT_BINARY_PAYLOAD
+            publishBinaryValues(TOPIC_THERMOSTAT_DATA, rootThermostat, data, sizeof(data));
+#endif
         }
     }
 }
@@ -699,8 +1177,13 @@ void publishValues(bool force) {
     static uint16_t LastFlameMemory               = 0;    // send last Flame to avoid MQTT issues in Openhab
 
     //lobocobra moved to own procedures to ensure MQTT is published
+    // each has its own JSON document on the stack, so they are called one after the other and never nested
     publishValuesData1(force);
+    if (ems_getThermostatEnabled()) {
+        publishThermostatCircuits(force); // each heating circuit also goes to its own topic
+    }
     publishValuesData2(force);
+    publishThermostatDevices(force);
 
     JsonObject rootBoiler = doc.to<JsonObject>();
 
@@ -750,6 +1233,11 @@ void publishValues(bool force) {
 
  // lobocobra end  
 
+    // values restored from the snapshot and not yet refreshed by the boiler
+    if (EMS_Sys_Status.emsStale & EMS_STALE_BOILER) {
+        rootBoiler["stale"] = "1";
+    }
+
     serializeJson(doc, data, sizeof(data));
 
     // calculate hash and send values if something has changed, to save unnecessary wifi traffic
@@ -763,6 +1251,9 @@ void publishValues(bool force) {
 
         // send values via MQTT
         myESP.mqttPublish(TOPIC_BOILER_DATA, data);
+#if MQTT_BINARY_PAYLOAD
+        publishBinaryValues(TOPIC_BOILER_DATA, rootBoiler, data, sizeof(data));
+#endif
     }
 
     // see if the heating or hot tap water has changed, if so send
@@ -800,6 +1291,36 @@ void publishValues(bool force) {
 
             // send values via MQTT
             myESP.mqttPublish(TOPIC_SM10_DATA, data);
+#if MQTT_BINARY_PAYLOAD
+            publishBinaryValues(TOPIC_SM10_DATA, rootSM10, data, sizeof(data));
+#endif
+        }
+    }
+
+    // For MM10 Mixer Module
+    if (EMS_Mixer.MM10) {
+        static uint32_t previousMixerPublishCRC = 0; // CRC check for MM10 values
+
+        doc.clear();
+        JsonObject rootMM10 = doc.to<JsonObject>();
+
+        rootMM10[MM10_FLOWSETTEMP] = _int_to_char(s, EMS_Mixer.flowSetTemp);
+        rootMM10[MM10_FLOWTEMP]    = _short_to_char(s, EMS_Mixer.flowTemp);
+        rootMM10[MM10_PUMPMOD]     = _int_to_char(s, EMS_Mixer.pumpMod);
+        rootMM10[MM10_VALVESTATUS] = _int_to_char(s, EMS_Mixer.valveStatus);
+
+        data[0] = '\0'; // reset data for next package
+        serializeJson(doc, data, sizeof(data));
+
+        crc.reset();
+        for (size_t i = 0; i < measureJson(doc) - 1; i++) {
+            crc.update(data[i]);
+        }
+        fchecksum = crc.finalize();
+        if ((previousMixerPublishCRC != fchecksum) || force) {
+            previousMixerPublishCRC = fchecksum;
+            myDebugLog("Publishing MM10 data via MQTT");
+            myESP.mqttPublish(TOPIC_MM10_DATA, data);
         }
     }
 }
@@ -818,6 +1339,14 @@ void set_showerAlert() {
     }
 }
 
+// a new tag for raw telegrams and commands that want to know their outcome. never 0
+uint16_t _nextTag() {
+    if (++EMSESP_Tag == 0) {
+        EMSESP_Tag = 1;
+    }
+    return EMSESP_Tag;
+}
+
 // used to read the next string from an input buffer and convert to an 8 bit int
 uint8_t _readIntNumber() {
     char * numTextPtr = strtok(NULL, ", \n");
@@ -836,13 +1365,13 @@ float _readFloatNumber() {
     return atof(numTextPtr);
 }
 
-// used to read the next string from an input buffer as a hex value and convert to an 8 bit int
-uint8_t _readHexNumber() {
+// used to read the next string from an input buffer as a hex value and convert to a 16 bit int, so EMS+ types fit
+uint16_t _readHexNumber() {
     char * numTextPtr = strtok(NULL, ", \n");
     if (numTextPtr == nullptr) {
         return 0;
     }
-    return (uint8_t)strtol(numTextPtr, 0, 16);
+    return (uint16_t)strtol(numTextPtr, 0, 16);
 }
 
 // used to read the next string from an input buffer
@@ -851,6 +1380,420 @@ char * _readWord() {
     return word;
 }
 
+// raw telegrams from MQTT as a JSON batch, either ["0B 88 02 00 20", ...]
+// or {"id":"x", "reply":true, "telegrams":["0B 88 02 00 20", ...]} to get the reply of each read
+// what was queued and what was refused (e.g. queue full) is published straight away to TOPIC_MQTT_RAW_RESPONSE
+void rawCommandBatch(const char * message) {
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              data[MQTT_MAX_SIZE] = {0};
+    char                              telegram[EMS_MAX_TELEGRAM_LENGTH * 3 + 1];
+    char                              id[sizeof(EMSESP_RawRequests[0].id)] = {0};
+    JsonArray                         telegrams;
+    bool                              reply = false;
+    uint8_t                           failed_index[EMS_TX_TELEGRAM_QUEUE_MAX];
+    _EMS_RAW_STATUS                   failed_status[EMS_TX_TELEGRAM_QUEUE_MAX];
+    uint8_t                           failed = 0;
+    uint8_t                           queued = 0;
+    size_t                            count;
+
+    DeserializationError error = deserializeJson(doc, message);
+    if (error) {
+        myDebug("MQTT topic: RAW telegrams not valid JSON: %s", error.c_str());
+        return;
+    }
+
+    if (message[0] == '[') {
+        telegrams = doc.as<JsonArray>();
+    } else {
+        JsonObject root = doc.as<JsonObject>();
+        telegrams       = root[RAW_TELEGRAMS];
+        reply           = root[RAW_REPLY] | false;
+        strlcpy(id, root[RAW_ID] | "", sizeof(id));
+    }
+
+    // there is no room in the Tx queue for more than EMS_TX_TELEGRAM_QUEUE_MAX, the rest are reported as queue full
+    count = telegrams.size();
+    for (uint8_t i = 0; (i < count) && (i < EMS_TX_TELEGRAM_QUEUE_MAX); i++) {
+        strlcpy(telegram, telegrams[i] | "", sizeof(telegram));
+
+        // a free slot to remember the id in
+        _EMSESP_RawRequest * request = NULL;
+        if (reply) {
+            for (uint8_t j = 0; j < EMS_RAW_PENDING_MAX; j++) {
+                if (EMSESP_RawRequests[j].tag == 0) {
+                    request = &EMSESP_RawRequests[j];
+                    break;
+                }
+            }
+        }
+
+        uint16_t tag = (request != NULL) ? _nextTag() : 0;
+
+        _EMS_RAW_STATUS status = (reply && (request == NULL)) ? EMS_RAW_BUSY : ems_sendRawTelegram(telegram, tag);
+        if (status == EMS_RAW_OK) {
+            queued++;
+            if (request != NULL) {
+                request->tag   = tag;
+                request->index = i;
+                strlcpy(request->id, id, sizeof(request->id));
+            }
+        } else {
+            failed_index[failed]  = i;
+            failed_status[failed] = status;
+            failed++;
+        }
+    }
+
+    // the telegrams aren't needed anymore, so the same document is used for the response
+    doc.clear();
+    JsonObject rootResponse  = doc.to<JsonObject>();
+    rootResponse[RAW_ID]     = id;
+    rootResponse[RAW_QUEUED] = queued;
+    JsonArray rootFailed     = rootResponse.createNestedArray(RAW_FAILED);
+    for (uint8_t i = 0; i < failed; i++) {
+        JsonObject rootTelegram  = rootFailed.createNestedObject();
+        rootTelegram[RAW_INDEX]  = failed_index[i];
+        rootTelegram[RAW_STATUS] = ems_getRawStatusString(failed_status[i]);
+    }
+    for (size_t i = EMS_TX_TELEGRAM_QUEUE_MAX; i < count; i++) {
+        JsonObject rootTelegram  = rootFailed.createNestedObject();
+        rootTelegram[RAW_INDEX]  = i;
+        rootTelegram[RAW_STATUS] = ems_getRawStatusString(EMS_RAW_QUEUE_FULL);
+    }
+
+    serializeJson(doc, data, sizeof(data));
+    myESP.mqttPublish(TOPIC_MQTT_RAW_RESPONSE, data);
+}
+
+// publish the outcome of each raw telegram from MQTT that wanted a reply
+void publishRawReplies() {
+    _EMS_RawPending reply;
+    char            telegram[EMS_MAX_TELEGRAM_LENGTH * 3 + 1];
+    char            data[MQTT_MAX_SIZE] = {0};
+
+    while (ems_getRawReply(&reply)) {
+        _EMSESP_RawRequest * request = NULL;
+        for (uint8_t i = 0; i < EMS_RAW_PENDING_MAX; i++) {
+            if (EMSESP_RawRequests[i].tag == reply.tag) {
+                request = &EMSESP_RawRequests[i];
+                break;
+            }
+        }
+        if (request == NULL) {
+            continue; // not one of ours
+        }
+
+        StaticJsonDocument<MQTT_MAX_SIZE> doc;
+        JsonObject                        rootReply = doc.to<JsonObject>();
+        rootReply[RAW_ID]                           = request->id;
+        rootReply[RAW_INDEX]                        = request->index;
+        rootReply[RAW_STATUS]                       = ems_getRawStatusString(reply.status);
+
+        // the reply without its CRC
+        if (reply.status == EMS_RAW_REPLY) {
+            _EMS_PrintCursor c;
+            _printBegin(&c, telegram, sizeof(telegram));
+            if (reply.length > 1) {
+                _printHexBytes(&c, reply.data, reply.length - 1);
+            }
+            rootReply[RAW_TELEGRAM] = telegram;
+        }
+
+        request->tag = 0;
+
+        serializeJson(doc, data, sizeof(data));
+        myESP.mqttPublish(TOPIC_MQTT_RAW_RESPONSE, data);
+    }
+}
+
+// hash of everything that goes into the Home Assistant discovery configs, so they're only published again when it changes
+uint32_t _discoveryHash() {
+    CRC32 crc;
+
+    crc.update(myESP.mqttPrefix(), strlen(myESP.mqttPrefix()));
+    crc.update(APP_VERSION, strlen(APP_VERSION));
+    crc.update(EMSESP_Status.dallas_sensors);
+    for (uint8_t i = 0; i < ArraySize(HA_Fields); i++) {
+        crc.update((uint8_t)HA_Fields[i].component);
+        crc.update(HA_Fields[i].topic, strlen(HA_Fields[i].topic));
+        if (HA_Fields[i].key) {
+            crc.update(HA_Fields[i].key, strlen(HA_Fields[i].key));
+        }
+        crc.update(HA_Fields[i].name, strlen(HA_Fields[i].name));
+        if (HA_Fields[i].unit) {
+            crc.update(HA_Fields[i].unit, strlen(HA_Fields[i].unit));
+        }
+    }
+
+    return crc.finalize();
+}
+
+// publish the Home Assistant discovery config of a single value, the Dallas sensors come after HA_Fields
+// returns false if MQTT didn't take it
+bool _publishDiscoveryField(uint8_t index) {
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              data[MQTT_MAX_SIZE] = {0};
+    char                              topic[100];
+    char                              key[12];
+    char                              name[40];
+    char                              stat_t[MQTT_MAX_TOPIC_SIZE];
+    char                              val_tpl[50];
+    char                              uniq_id[80];
+    char                              avty_t[MQTT_MAX_TOPIC_SIZE];
+    _HA_Field                         field;
+
+    if (index < ArraySize(HA_Fields)) {
+        field = HA_Fields[index];
+    } else {
+        uint8_t sensor = index - ArraySize(HA_Fields) + 1;
+        snprintf(key, sizeof(key), PAYLOAD_EXTERNAL_SENSORS, sensor);
+        snprintf(name, sizeof(name), "Dallas sensor %d", sensor);
+        field.component = HA_SENSOR;
+        field.topic     = TOPIC_EXTERNAL_SENSORS;
+        field.key       = key;
+        field.name      = name;
+        field.unit      = "°C";
+    }
+
+    const char * component = (field.component == HA_BINARY_SENSOR) ? "binary_sensor" : "sensor";
+    if (field.key) {
+        snprintf(topic, sizeof(topic), "%s/%s/%s/%s_%s/config", HA_DISCOVERY_PREFIX, component, APP_HOSTNAME, field.topic, field.key);
+        snprintf(uniq_id, sizeof(uniq_id), "%s_%s_%s", APP_HOSTNAME, field.topic, field.key);
+        snprintf(val_tpl, sizeof(val_tpl), "{{value_json.%s}}", field.key);
+    } else {
+        snprintf(topic, sizeof(topic), "%s/%s/%s/%s/config", HA_DISCOVERY_PREFIX, component, APP_HOSTNAME, field.topic);
+        snprintf(uniq_id, sizeof(uniq_id), "%s_%s", APP_HOSTNAME, field.topic);
+    }
+    snprintf(stat_t, sizeof(stat_t), "~%s", field.topic);
+    snprintf(avty_t, sizeof(avty_t), "~%s", MQTT_WILL_TOPIC);
+
+    // using the abbreviations Home Assistant knows to keep it short. ~ stands for MQTT_BASE/hostname/
+    JsonObject rootConfig      = doc.to<JsonObject>();
+    rootConfig["~"]            = myESP.mqttPrefix();
+    rootConfig["name"]         = field.name;
+    rootConfig["uniq_id"]      = uniq_id;
+    rootConfig["stat_t"]       = stat_t;
+    rootConfig["avty_t"]       = avty_t;
+    rootConfig["pl_avail"]     = MQTT_WILL_ONLINE_PAYLOAD;
+    rootConfig["pl_not_avail"] = MQTT_WILL_OFFLINE_PAYLOAD;
+    if (field.key) {
+        rootConfig["val_tpl"] = val_tpl;
+    }
+    if (field.unit) {
+        rootConfig["unit_of_meas"] = field.unit;
+    }
+    if (field.component == HA_BINARY_SENSOR) {
+        rootConfig["pl_on"]  = "on";
+        rootConfig["pl_off"] = "off";
+    }
+
+    JsonObject rootDevice = rootConfig.createNestedObject("dev");
+    rootDevice["ids"]     = APP_HOSTNAME;
+    rootDevice["name"]    = APP_NAME;
+    rootDevice["sw"]      = APP_VERSION;
+
+    serializeJson(doc, data, sizeof(data));
+    return myESP.mqttPublishDirect(topic, data, true); // retained, so Home Assistant finds them after a restart
+}
+
+// publish the Home Assistant discovery configs after connecting, unless the broker has the hash of the same configs
+// one config per call and only when nothing else is waiting to be published, so connecting and the heap aren't affected
+void publishDiscovery() {
+    if ((EMSESP_DiscoveryState == HA_DISCOVERY_DONE) || !myESP.isMQTTConnected()) {
+        return;
+    }
+
+    // no retained hash came, so they were never published
+    if (EMSESP_DiscoveryState == HA_DISCOVERY_WAIT) {
+        if ((millis() - EMSESP_DiscoveryTimestamp) < HA_DISCOVERY_WAIT_TIME) {
+            return;
+        }
+        EMSESP_DiscoveryState = HA_DISCOVERY_SENDING;
+        EMSESP_DiscoveryIndex = 0;
+    }
+
+    if (!myESP.mqttPublishQueueEmpty()) {
+        return;
+    }
+
+    if (EMSESP_DiscoveryIndex == 0) {
+        myDebugLog("Publishing Home Assistant discovery via MQTT");
+    }
+
+    if (EMSESP_DiscoveryIndex < (ArraySize(HA_Fields) + EMSESP_Status.dallas_sensors)) {
+        if (_publishDiscoveryField(EMSESP_DiscoveryIndex)) {
+            EMSESP_DiscoveryIndex++;
+        }
+        return;
+    }
+
+    // all done, keep the hash on the broker
+    char topic[MQTT_MAX_TOPIC_SIZE];
+    char hash[10];
+    snprintf(topic, sizeof(topic), "%s%s", myESP.mqttPrefix(), TOPIC_HA_DISCOVERY);
+    snprintf(hash, sizeof(hash), "%08X", _discoveryHash());
+    if (myESP.mqttPublishDirect(topic, hash, true)) {
+        EMSESP_DiscoveryState = HA_DISCOVERY_DONE;
+    }
+}
+
+// publish the EMS bus health over the last minute
+// the rates change all the time so there is no CRC check
+void publishBusValues() {
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              data[MQTT_MAX_SIZE] = {0};
+    _EMS_BusHealth                    health;
+
+    ems_getBusHealth(&health);
+
+    JsonObject rootBus      = doc.to<JsonObject>();
+    rootBus[BUS_FRAMES]     = health.framesPerSec / 10.0;
+    rootBus[BUS_BYTES]      = health.bytesPerSec;
+    rootBus[BUS_LOAD]       = health.load / 10.0;
+    rootBus[BUS_CRCERRORS]  = health.crcErrRate / 10.0;
+    rootBus[BUS_NOISE]      = health.noiseRate / 10.0;
+    rootBus[BUS_POLLMISSES] = health.pollMissRate / 10.0;
+    rootBus[BUS_WRITEFAILS] = health.writeFailRate / 10.0;
+    rootBus[BUS_RXTOTAL]    = EMS_Sys_Status.emsRxPgks;
+    rootBus[BUS_CRCTOTAL]   = EMS_Sys_Status.emxCrcErr;
+
+    rootBus[BUS_NOISETOTAL]     = ems_getBusTotal(EMS_BUSSTATS_NOISE);
+    rootBus[BUS_POLLMISSTOTAL]  = ems_getBusTotal(EMS_BUSSTATS_POLLMISSES);
+    rootBus[BUS_WRITETOTAL]     = ems_getBusTotal(EMS_BUSSTATS_WRITES);
+    rootBus[BUS_WRITEFAILTOTAL] = ems_getBusTotal(EMS_BUSSTATS_WRITEFAILS);
+
+    serializeJson(doc, data, sizeof(data));
+    myESP.mqttPublish(TOPIC_BUS_DATA, data);
+}
+
+// tier, value, interval, age and the min, avg and max arrays, which take a slot per value
+#define HISTORY_JSON_SIZE (JSON_OBJECT_SIZE(7) + 3 * JSON_ARRAY_SIZE(HISTORY_MQTT_POINTS))
+
+// publish the newest buckets of a value in the history, in reply to TOPIC_HISTORY_CMD
+void publishHistory(uint8_t tier, uint8_t value, uint8_t count) {
+    StaticJsonDocument<HISTORY_JSON_SIZE> doc;
+    char                                  data[MQTT_MAX_SIZE] = {0};
+    _EMS_HistoryBucket                    bucket;
+    uint16_t                              n = 0;
+
+    if ((count == 0) || (count > HISTORY_MQTT_POINTS)) {
+        count = HISTORY_MQTT_POINTS;
+    }
+
+    // only the buckets with samples for this value count
+    ems_historyFirst(&bucket, tier);
+    while (ems_historyNext(&bucket)) {
+        if (bucket.present & (1 << value)) {
+            n++;
+        }
+    }
+
+    JsonObject rootHistory        = doc.to<JsonObject>();
+    rootHistory[HISTORY_TIER]     = ems_historyTierName(tier);
+    rootHistory[HISTORY_VALUE]    = ems_historyValueName(value);
+    rootHistory[HISTORY_INTERVAL] = EMS_History[tier].bucketTime / 1000;
+    rootHistory[HISTORY_AGE]      = (millis() - EMS_History[tier].bucketStart) / 1000;
+    JsonArray rootMin             = rootHistory.createNestedArray(HISTORY_MIN);
+    JsonArray rootAvg             = rootHistory.createNestedArray(HISTORY_AVG);
+    JsonArray rootMax             = rootHistory.createNestedArray(HISTORY_MAX);
+
+    ems_historyFirst(&bucket, tier);
+    while (ems_historyNext(&bucket)) {
+        if (!(bucket.present & (1 << value))) {
+            continue;
+        }
+        if (n-- > count) {
+            continue; // older than asked for
+        }
+        rootMin.add(bucket.value[value][0] / 10.0);
+        rootAvg.add(bucket.value[value][1] / 10.0);
+        rootMax.add(bucket.value[value][2] / 10.0);
+    }
+
+    serializeJson(doc, data, sizeof(data));
+    myESP.mqttPublish(TOPIC_HISTORY_DATA, data);
+}
+
+// publish the burner analytics of the interval since the last time, and start a new one
+void publishBurnerValues() {
+    char                              s[50] = {0};
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              data[MQTT_MAX_SIZE] = {0};
+    _EMS_BurnerSummary                burner;
+
+    ems_getBurnerSummary(&burner);
+    ems_startBurnerInterval();
+
+    JsonObject rootBurner            = doc.to<JsonObject>();
+    rootBurner[BURNER_INTERVAL]      = burner.interval;
+    rootBurner[BURNER_STARTS]        = burner.starts;
+    rootBurner[BURNER_STARTSPERHOUR] = burner.startsPerHour / 10.0;
+    rootBurner[BURNER_DUTY]          = burner.duty / 10.0;
+    rootBurner[BURNER_MODULATION]    = burner.modulation;
+    rootBurner[BURNER_CYCLES]        = burner.cycles;
+    rootBurner[BURNER_CYCLEAVG]      = burner.cycleAvg;
+    rootBurner[BURNER_CYCLEMIN]      = burner.cycleMin;
+    rootBurner[BURNER_CYCLEMAX]      = burner.cycleMax;
+    rootBurner[BURNER_PAUSEAVG]      = burner.pauseAvg;
+    if (burner.deltaT != (int16_t)EMS_VALUE_SHORT_NOTSET) {
+        rootBurner[BURNER_DELTAT] = burner.deltaT / 10.0;
+    }
+    rootBurner[BURNER_ENERGY]      = burner.energy / 1000.0;
+    rootBurner[BURNER_ENERGYTOTAL] = burner.energyTotal / 1000.0;
+    rootBurner[BURNER_GAS]         = burner.gas / 1000.0;
+
+    // as "a,b,c,..." to keep it short
+    char * p = s;
+    for (uint8_t i = 0; i < EMS_BURNER_MOD_BANDS; i++) {
+        p += snprintf(p, sizeof(s) - (p - s), (i == 0) ? "%d" : ",%d", burner.modBands[i]);
+    }
+    rootBurner[BURNER_MODBANDS] = s;
+
+    serializeJson(doc, data, sizeof(data));
+    myESP.mqttPublish(TOPIC_BURNER_DATA, data);
+}
+
+// publish the burner analytics, called via Ticker
+void do_publishBurnerValues() {
+    if (ems_getBoilerEnabled()) {
+        publishBurnerValues();
+    }
+}
+
+// publish a summary of the sniffer statistics with the busiest telegram types
+void publishSnifferValues() {
+    char                              s[20] = {0};
+    char                              key[8];
+    uint8_t                           slots[EMS_SNIFFER_TOP];
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              data[MQTT_MAX_SIZE] = {0};
+
+    JsonObject rootSniffer         = doc.to<JsonObject>();
+    rootSniffer[SNIFFER_TELEGRAMS] = EMS_Sniffer.telegrams;
+    rootSniffer[SNIFFER_LOAD]      = ems_getSnifferLoad();
+    rootSniffer[SNIFFER_TYPES]     = EMS_Sniffer.used;
+    rootSniffer[SNIFFER_DROPPED]   = EMS_Sniffer.dropped;
+
+    JsonObject rootTop = rootSniffer.createNestedObject(SNIFFER_TOP);
+    uint8_t    n       = ems_getSnifferTop(slots, EMS_SNIFFER_TOP);
+    for (uint8_t i = 0; i < n; i++) {
+        _EMS_SnifferEntry * entry = &EMS_Sniffer.table[slots[i]];
+        snprintf(key, sizeof(key), "%02X.%0*X", entry->src, EMS_TYPE_DIGITS(entry->type), entry->type);
+        snprintf(s, sizeof(s), "%d,%d,%d", entry->count, entry->changes, entry->length);
+        rootTop[key] = s;
+    }
+
+    serializeJson(doc, data, sizeof(data));
+    myESP.mqttPublish(TOPIC_SNIFFER_DATA, data);
+}
+
+// publish the sniffer summary, called via Ticker
+void do_publishSnifferValues() {
+    if (myESP.isMQTTConnected()) {
+        publishSnifferValues();
+    }
+}
+
 // publish external dallas sensor temperature values to MQTT
 void do_publishSensorValues() {
     if (EMSESP_Status.dallas_sensors != 0) {
@@ -858,11 +1801,29 @@ void do_publishSensorValues() {
     }
 }
 
+// add the Dallas sensors to the history, at the rate they're read
+void historySensors() {
+    static uint32_t last = 0;
+
+    if ((millis() - last) < DS18_READ_INTERVAL) {
+        return;
+    }
+    last = millis();
+
+    for (uint8_t i = 0; (i < EMSESP_Status.dallas_sensors) && (i < EMS_HISTORY_SENSORS_MAX); i++) {
+        double sensorValue = ds18.getValue(i);
+        if (sensorValue != DS18_DISCONNECTED && sensorValue != DS18_CRC_ERROR) {
+            ems_historyAdd((_EMS_HISTORY)(EMS_HISTORY_SENSOR1 + i), (int16_t)(sensorValue * 10));
+        }
+    }
+}
+
 // call PublishValues without forcing, so using CRC to see if we really need to publish
 void do_publishValues() {
     // don't publish if we're not connected to the EMS bus
     if ((ems_getBusConnected()) && (!myESP.getUseSerial()) && myESP.isMQTTConnected()) {
         publishValues(true); // force publish
+        publishBusValues();
     }
 }
 
@@ -895,14 +1856,11 @@ void do_systemCheck() {
     }
 }
 
-// force calls to get data from EMS for the types that aren't sent as broadcasts
+// read the EMS types that are due, each on its own interval
 // only if we have a EMS connection
 void do_regularUpdates() {
     if ((ems_getBusConnected()) && (!myESP.getUseSerial())) {
-        myDebugLog("Requesting scheduled EMS device data");
-        ems_getThermostatValues();
-        ems_getBoilerValues();
-        ems_getOtherValues();
+        ems_pollDue();
     }
 }
 
@@ -939,7 +1897,7 @@ void _showerColdShotStart() {
     }
 }
 
-// callback for loading/saving settings to the file system (SPIFFS)
+// callback for importing/exporting settings as JSON with "set import" and "set export", and migrating old config.json files
 bool FSCallback(MYESP_FSACTION action, const JsonObject json) {
     if (action == MYESP_FSACTION_LOAD) {
         bool recreate_config = true;
@@ -991,6 +1949,9 @@ bool FSCallback(MYESP_FSACTION action, const JsonObject json) {
         }
         ems_setThermostatHC(EMSESP_Status.heating_circuit);
 
+        // devices identified last time
+        ems_setDeviceCache(json["ems_devices"]);
+
         return recreate_config; // return false if some settings are missing and we need to rebuild the file
     }
 
@@ -1008,12 +1969,78 @@ bool FSCallback(MYESP_FSACTION action, const JsonObject json) {
         json["publish_wait"]    = EMSESP_Status.publish_wait;
         json["heating_circuit"] = EMSESP_Status.heating_circuit;
 
+        char buffer[120] = {0};
+        json["ems_devices"] = ems_getDeviceCache(buffer, sizeof(buffer));
+
         return true;
     }
 
     return false;
 }
 
+// callback for the binary settings record kept in SPIFFS by MyESP
+// on save it fills data and returns the size used, on load it returns 0 if the record can't be used
+size_t FSRecordCallback(MYESP_FSACTION action, uint8_t * data, size_t size) {
+    _EMSESP_Settings settings;
+
+    if (action == MYESP_FSACTION_SAVE) {
+        if (size < sizeof(_EMSESP_Settings)) {
+            return 0;
+        }
+
+        memset(&settings, 0, sizeof(_EMSESP_Settings));
+        settings.version         = EMSESP_SETTINGS_VERSION;
+        settings.thermostat_type = EMS_Thermostat.type_id;
+        settings.boiler_type     = EMS_Boiler.type_id;
+        settings.led             = EMSESP_Status.led;
+        settings.led_gpio        = EMSESP_Status.led_gpio;
+        settings.dallas_gpio     = EMSESP_Status.dallas_gpio;
+        settings.dallas_parasite = EMSESP_Status.dallas_parasite;
+        settings.silent_mode     = EMSESP_Status.silent_mode;
+        settings.shower_timer    = EMSESP_Status.shower_timer;
+        settings.shower_alert    = EMSESP_Status.shower_alert;
+        settings.publish_wait    = EMSESP_Status.publish_wait;
+        settings.heating_circuit = EMSESP_Status.heating_circuit;
+        (void)ems_getDeviceCache(settings.ems_devices, sizeof(settings.ems_devices));
+
+        memcpy(data, &settings, sizeof(_EMSESP_Settings));
+        return sizeof(_EMSESP_Settings);
+    }
+
+    if (action == MYESP_FSACTION_LOAD) {
+        if (size != sizeof(_EMSESP_Settings)) {
+            return 0; // written by a different build, fall back to the defaults
+        }
+
+        memcpy(&settings, data, sizeof(_EMSESP_Settings));
+        if (settings.version != EMSESP_SETTINGS_VERSION) {
+            return 0;
+        }
+
+        EMSESP_Status.led             = settings.led;
+        EMSESP_Status.led_gpio        = (settings.led_gpio) ? settings.led_gpio : EMSESP_LED_GPIO;
+        EMSESP_Status.dallas_gpio     = (settings.dallas_gpio) ? settings.dallas_gpio : EMSESP_DALLAS_GPIO;
+        EMSESP_Status.dallas_parasite = settings.dallas_parasite;
+        EMS_Thermostat.type_id        = (settings.thermostat_type) ? settings.thermostat_type : EMSESP_THERMOSTAT_TYPE;
+        EMS_Boiler.type_id            = (settings.boiler_type) ? settings.boiler_type : EMSESP_BOILER_TYPE;
+        EMSESP_Status.silent_mode     = settings.silent_mode;
+        EMSESP_Status.shower_timer    = settings.shower_timer;
+        EMSESP_Status.shower_alert    = settings.shower_alert;
+        EMSESP_Status.publish_wait    = (settings.publish_wait) ? settings.publish_wait : DEFAULT_PUBLISHWAIT;
+        EMSESP_Status.heating_circuit = (settings.heating_circuit) ? settings.heating_circuit : DEFAULT_HEATINGCIRCUIT;
+
+        ems_setTxDisabled(EMSESP_Status.silent_mode);
+        ems_setThermostatHC(EMSESP_Status.heating_circuit);
+
+        settings.ems_devices[sizeof(settings.ems_devices) - 1] = '\0';
+        ems_setDeviceCache(settings.ems_devices);
+
+        return sizeof(_EMSESP_Settings);
+    }
+
+    return 0;
+}
+
 // callback for custom settings when showing Stored Settings with the 'set' command
 // wc is number of arguments after the 'set' command
 // returns true if the setting was recognized and changed and should be saved back to SPIFFs
@@ -1128,12 +2155,12 @@ bool SettingsCallback(MYESP_FSACTION action, uint8_t wc, const char * setting, c
         // heating_circuit
         if ((strcmp(setting, "heating_circuit") == 0) && (wc == 2)) {
             uint8_t hc = atoi(value);
-            if ((hc >= 1) && (hc <= 2)) {
+            if ((hc >= 1) && (hc <= EMS_THERMOSTAT_MAXHC)) {
                 EMSESP_Status.heating_circuit = hc;
                 ems_setThermostatHC(hc);
                 ok = true;
             } else {
-                myDebug("Error. Usage: set heating_circuit <1 | 2>");
+                myDebug("Error. Usage: set heating_circuit <1 | 2 | 3 | 4>");
             }
         }
     }
@@ -1195,8 +2222,19 @@ void TelnetCommandCallback(uint8_t wc, const char * commandLine) {
     }
 
     if (strcmp(first_cmd, "refresh") == 0) {
-        myDebug("Fetching data from EMS devices...");
-        do_regularUpdates();
+        if ((ems_getBusConnected()) && (!myESP.getUseSerial())) {
+            myDebug("Fetching data from EMS devices...");
+            ems_getThermostatValues();
+            ems_getBoilerValues();
+            ems_getOtherValues();
+        } else {
+            myDebug("Not connected to the EMS bus, nothing fetched");
+        }
+        ok = true;
+    }
+
+    if (strcmp(first_cmd, "polls") == 0) {
+        ems_printPollSchedule();
         ok = true;
     }
 
@@ -1215,6 +2253,48 @@ void TelnetCommandCallback(uint8_t wc, const char * commandLine) {
         ok = true;
     }
 
+    if (strcmp(first_cmd, "devices") == 0) {
+        ems_printDiscovery();
+        ok = true;
+    }
+
+    // sniffer statistics
+    if (strcmp(first_cmd, "sniffer") == 0) {
+        if (wc == 1) {
+            ems_printSniffer();
+            ok = true;
+        } else if (wc == 2) {
+            char * second_cmd = _readWord();
+            if ((strcmp(second_cmd, "on") == 0) || (strcmp(second_cmd, "listen") == 0)) {
+                ems_setSniffer(true, (strcmp(second_cmd, "listen") == 0));
+                publishSnifferTimer.attach(SNIFFER_PUBLISH_TIME, do_publishSnifferValues);
+                ok = true;
+            } else if (strcmp(second_cmd, "off") == 0) {
+                ems_setSniffer(false);
+                publishSnifferTimer.detach();
+                ok = true;
+            } else if (strcmp(second_cmd, "clear") == 0) {
+                ems_clearSniffer();
+                ok = true;
+            }
+        }
+    }
+
+    // history of the main boiler values
+    if (strcmp(first_cmd, "history") == 0) {
+        if (wc == 1) {
+            ems_printHistory(0, -1);
+            ok = true;
+        } else if (wc == 3) {
+            int8_t tier  = ems_historyFindTier(_readWord());
+            int8_t value = ems_historyFindValue(_readWord());
+            if ((tier >= 0) && (value >= 0)) {
+                ems_printHistory(tier, value);
+                ok = true;
+            }
+        }
+    }
+
     if (strcmp(first_cmd, "startup") == 0) {
         ems_startupTelegrams();
         ok = true;
@@ -1255,6 +2335,43 @@ void TelnetCommandCallback(uint8_t wc, const char * commandLine) {
         }
     }
 
+    // log filter, IDs and types in hex
+    if (strcmp(first_cmd, "filter") == 0) {
+        if (wc == 1) {
+            ems_printLogFilter();
+            ok = true;
+        } else if (wc == 2) {
+            if (strcmp(_readWord(), "clear") == 0) {
+                ems_clearLogFilter();
+                ok = true;
+            }
+        } else if (wc == 3) {
+            char * second_cmd = _readWord();
+            char * value      = _readWord();
+            char * end;
+            long   id    = strtol(value, &end, 16);
+            bool   valid = (end != value) && (*end == '\0') && (id >= 0) && (id <= 0xFFFF); // not garbage taken as 0
+            if (strcmp(second_cmd, "src") == 0) {
+                ok = valid && ems_addLogFilter(EMS_LOGFILTER_SRC, id);
+            } else if (strcmp(second_cmd, "dest") == 0) {
+                ok = valid && ems_addLogFilter(EMS_LOGFILTER_DEST, id);
+            } else if (strcmp(second_cmd, "type") == 0) {
+                ok = valid && ems_addLogFilter(EMS_LOGFILTER_TYPE, id);
+            } else if (strcmp(second_cmd, "dir") == 0) {
+                if (strcmp(value, "read") == 0) {
+                    ok = ems_addLogFilter(EMS_LOGFILTER_DIR, EMS_LOGFILTER_DIR_READ);
+                } else if (strcmp(value, "write") == 0) {
+                    ok = ems_addLogFilter(EMS_LOGFILTER_DIR, EMS_LOGFILTER_DIR_WRITE);
+                } else if (strcmp(value, "broadcast") == 0) {
+                    ok = ems_addLogFilter(EMS_LOGFILTER_DIR, EMS_LOGFILTER_DIR_BROADCAST);
+                }
+            }
+            if (ok) {
+                ems_printLogFilter();
+            }
+        }
+    }
+
     // thermostat commands
     if ((strcmp(first_cmd, "thermostat") == 0) && (wc == 3)) {
         char * second_cmd = _readWord();
@@ -1311,7 +2428,10 @@ void TelnetCommandCallback(uint8_t wc, const char * commandLine) {
 
     // send raw
     if (strcmp(first_cmd, "send") == 0) {
-        ems_sendRawTelegram((char *)&commandLine[5]);
+        _EMS_RAW_STATUS status = ems_sendRawTelegram((char *)&commandLine[5]);
+        if (status != EMS_RAW_OK) {
+            myDebug("Raw telegram not sent: %s", ems_getRawStatusString(status));
+        }
         ok = true;
     }
 
@@ -1333,6 +2453,511 @@ void OTACallback_post() {
     emsuart_start();
 }
 
+// handle an incoming MQTT command, message is the plain value
+void MQTTCommand(const char * topic, const char * message) {
+    // thermostat temp changes
+    if (strcmp(topic, TOPIC_THERMOSTAT_CMD_TEMP) == 0) {
+        float f     = strtof((char *)message, 0);
+        char  s[10] = {0};
+        myDebug("MQTT topic: thermostat temperature value %s", _float_to_char(s, f));
+        ems_setThermostatTemp(f);
+        publishValues(true); // publish back immediately, can't remember why I do this?!
+    }
+
+    // thermostat mode changes
+    if (strcmp(topic, TOPIC_THERMOSTAT_CMD_MODE) == 0) {
+        myDebug("MQTT topic: thermostat mode value %s", message);
+        if (strcmp((char *)message, "auto") == 0) {
+            ems_setThermostatMode(2);
+        } else if (strcmp((char *)message, "day") == 0 || strcmp((char *)message, "manual") == 0) {
+            ems_setThermostatMode(1);
+        } else if (strcmp((char *)message, "night") == 0 || strcmp((char *)message, "off") == 0) {
+            ems_setThermostatMode(0);
+        }
+    }
+
+    // hash of the Home Assistant discovery configs on the broker, only publish them again if they changed
+    if (strcmp(topic, TOPIC_HA_DISCOVERY) == 0) {
+        if (EMSESP_DiscoveryState == HA_DISCOVERY_WAIT) {
+            if (strtoul(message, 0, 16) == _discoveryHash()) {
+                EMSESP_DiscoveryState = HA_DISCOVERY_DONE;
+            } else {
+                EMSESP_DiscoveryState = HA_DISCOVERY_SENDING;
+                EMSESP_DiscoveryIndex = 0;
+            }
+        }
+    }
+
+    // history request, "<tier> <value> [count]"
+    if (strcmp(topic, TOPIC_HISTORY_CMD) == 0) {
+        char   request[40];
+        strlcpy(request, message, sizeof(request));
+        char * tier  = strtok(request, " ");
+        char * value = strtok(NULL, " ");
+        char * count = strtok(NULL, " ");
+        int8_t t     = tier ? ems_historyFindTier(tier) : -1;
+        int8_t v     = value ? ems_historyFindValue(value) : -1;
+        int    n     = count ? atoi(count) : 0;
+        if ((n < 0) || (n > HISTORY_MQTT_POINTS)) {
+            n = 0; // all there is, clamped before it's narrowed to a uint8_t
+        }
+        if ((t >= 0) && (v >= 0)) {
+            publishHistory(t, v, n);
+        } else {
+            myDebug("MQTT topic: history request %s not valid", message);
+        }
+    }
+
+    // thermostat heating circuit change
+    if (strcmp(topic, TOPIC_THERMOSTAT_CMD_HC) == 0) {
+        myDebug("MQTT topic: thermostat heating circuit value %s", message);
+        uint8_t hc = atoi((char *)message);
+        if ((hc >= 1) && (hc <= EMS_THERMOSTAT_MAXHC)) {
+            EMSESP_Status.heating_circuit = hc;
+            ems_setThermostatHC(hc);
+            // TODO: save setting to SPIFFS??
+        }
+    }
+    // lobocobra start // send mqtt to raw 
+    if (strcmp(topic, TOPIC_MQTT_CMD_RAW) == 0) {
+        myDebug("MQTT topic: RAW telegram: %s", message);
+        if ((message[0] == '[') || (message[0] == '{')) {
+            rawCommandBatch(message);
+        } else {
+            ems_sendRawTelegram((char *)&message[0]);
+        }
+    }
+    if (strcmp(topic,THERMOSTAT_CMD_AUSSCHALTHYSTERESE ) == 0) { 
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<5 || t> 12) {
+            myDebug("MQTT topic: Ausschalthysterese outside 5-12C, abort on C: %s", message);    
+            return;
+        }
+        // code to change send 0B 08 16 04  xx (temp)
+        char Atemp[]           = "0b 08 16 04 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: New Ausschalthysterese C %s", message);  
+    }          
+    if (strcmp(topic,THERMOSTAT_CMD_EINSCHALTHYSTERESE ) == 0) { // negative VALUE!
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<244 || t> 251) {
+            myDebug("MQTT topic: Einschalthysterese outside 5-12C, abort on C: %d", t);    
+            return;
+        }
+        // code to change send 0B 08 16 05  xx (temp)
+        char Atemp[]           = "0b 08 16 05 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa( t, buffer)) );  //negative value, substract from 256
+        myDebug("MQTT topic: New Einschalthysterese ° above %s", message); 
+    }
+    if (strcmp(topic,THERMOSTAT_CMD_ANTIPENDELZEIT ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<5 || t> 30) {
+            myDebug("MQTT topic: Antipendelzeit outside 5-30 min, abort on min: %s", message);    
+            return;
+        }
+        // code to change send 0B 08 16 06  xx (temp)
+        char Atemp[]           = "0b 08 16 06 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: New Antipendelzeit min %s", message);  
+    }
+    if (strcmp(topic,THERMOSTAT_CMD_AUSLEGUNGSTEMP ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<30 || t> 60) {
+            myDebug("MQTT topic: Auslegungstemperatur not accepted, abort on temp: %s", message);    
+            return;
+        }
+        // code to change send 0b 10 47 24 xx (temp)
+        char Atemp[]           = "0b 10 47 24 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: New Auslegungstemperatur %s", message);  
+    }  
+    if (strcmp(topic,THERMOSTAT_CMD_HEIZTURBO_TILL_NEXT ) == 0) {
+        //convert message to INT and control it
+        char buffer[16]      = {0};
+        float t     = strtof((char *)message, 0);
+        if ((t<15 && t !=0) || t> 35) {
+           myDebug("MQTT topic: Max Turbo temp not accepted (0 and 15-35), abort on temp: %s", _float_to_char(buffer, t));
+           return;
+        }
+        // convert temp and multiplicate it by 2 for EMS bus
+        t = (t*2); 
+        // code to change send send 0b 10 47 06 xx (temp*2)
+        char Atemp[]         = "0b 10 47 25 ";
+        //convert INT to hex & prepare HEX string to send 
+        ems_sendRawTelegram( strcat (Atemp, _hextoa((int)t, buffer)) );  
+        myDebug("MQTT topic: New Turbo Temp %s", _float_to_char(buffer, t/2));
+    } 
+    if (strcmp(topic,THERMOSTAT_CMD_MAXVORLAUF ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<30 || t> 65) {
+            myDebug("MQTT topic: Max Vorlauf not accepted (30-65°), abort on temp: %s", message);
+            return;
+        }
+        // code to change send 0b 10 47 23 xx (temp)
+        char Atemp[]         = "0b 10 47 23 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: New Max Vorlauf %s", message);
+    } 
+    if (strcmp(topic,THERMOSTAT_CMD_MINVORLAUF ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<5|| t> 25) {
+            myDebug("MQTT topic: Min Vorlauf not accepted (5-26°), abort on temp: %s", message);
+            return;
+        }
+        // code to change send 0b 10 47 10 xx (temp)
+        char Atemp[]         = "0b 10 47 10 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: New Min Vorlauf %s", message);
+    }          
+    if (strcmp(topic,THERMOSTAT_CMD_ROOMOFFSET ) == 0) {
+        //convert message to INT and control it
+        char buffer[16]      = {0};
+        float t     = strtof((char *)message, 0);
+        if (t<-5 || t> 5) {
+           myDebug("MQTT topic: Max RoomOffset not accepted, abort on temp: %s", _float_to_char(buffer, t));
+            return;
+        }
+        // convert negative numbers and multiplicate it by 2 for EMS bus
+        (t<0) ? t = 256 - (t*-2) : t = (t*2); 
+        // code to change send send 0b 10 47 06 xx (temp*2)
+        char Atemp[]         = "0b 10 47 06 ";
+        //convert INT to hex & prepare HEX string to send 
+        ems_sendRawTelegram( strcat (Atemp, _hextoa((int)t, buffer)) );  
+        myDebug("MQTT topic: New RoomOffset %s", _float_to_char(buffer, t));
+    }    
+    if (strcmp(topic,THERMOSTAT_CMD_MINOUTSIDETEMP ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);    
+        if (t<236 || t> 254) { // we accept -20 to -2 (255 would be No_DATA)
+            myDebug("MQTT topic: Minusoutsidetemp not within -20 to -2c, abort on: %d", t);    
+            return;
+        }
+        // code to change send 0B 10 A5 05  xx (temp)
+        char Atemp[]           = "0b 10 A5 05 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa( (t), buffer)) );  //negative value, substract from 256
+        //myDebug("MQTT topic: New Minusoutsidetemp ° above %s", strcat (Atemp, _hextoa( (t), buffer)));
+        myDebug("MQTT topic: New Minusoutsidetemp at %s", message); 
+    }       
+    if (strcmp(topic,THERMOSTAT_CMD_HOUSETYPE ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<0 || t> 2) {
+            myDebug("MQTT topic: 0=leicht 1=mittel 2=schwer abort on type: %d", t);
+            return;
+        }
+        // code to change send 0b 10 A5 06 xx (type 0/1/2)
+        char Atemp[]         = "0b 10 A5 06 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: New House type %s", message);
+    } 
+    if (strcmp(topic,THERMOSTAT_CMD_PAUSEZEIT) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<0 || t> 12) {
+            myDebug("MQTT topic: outside time 0-12h abort PAUSE on type: %d", t);
+            return;
+        }
+        // code to change send 0b 10 49 55 xx (!!! outside range for read see below)
+        char Atemp[]         = "0b 10 49 55 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: PAUSEZEIT for %s hours", message);
+    }   
+    if (strcmp(topic,THERMOSTAT_CMD_PARTYZEIT) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<0 || t> 12) {
+            myDebug("MQTT topic: outside time 0-12h abort PARTY on type: %d", t);
+            return;
+        }
+        // code to change send 0b 10 49 56 xx (!!! outside range for read see below)
+        char Atemp[]         = "0b 10 49 56 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: PARTYZEIT for %s hours", message);
+    }               
+    if (strcmp(topic,THERMOSTAT_CMD_TEMPAVERAGEBOOL ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<0 || t> 1) {
+            myDebug("MQTT topic: TempDämpfung ON/OFF: %d", t);
+            return;
+        }
+        //code to change send 0b 10 a5 15 xx (position 21= hex 15)
+        char Atemp[]         = "0b 10 A5 15 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t*255, buffer)) );  // on =255 off=0
+        myDebug("MQTT topic: TempDaempung ON/OFF %s", message);
+    }      
+    if (strcmp(topic,THERMOSTAT_CMD_KESSELPUMENNACHLAUF ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<0 || t> 10) {
+            myDebug("MQTT topic: Kesselpumpennachlauf outside 5-10 min, abort on min: %s", message);    
+            return;
+        }
+        // code to change send 0B 08 16 08  xx (temp)
+        char Atemp[]           = "0b 08 16 08 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: Kesselpumpennachlauf min %s", message);  
+    }
+    if (strcmp(topic,THERMOSTAT_CMD_SOMMERSCHWELLE_TEMP ) == 0) {
+        //convert message to INT and control it
+        uint8_t t = atoi((char *)message);
+        if (t<10 || t> 30) {
+            myDebug("MQTT topic: Sommerschwelle not accepted (10-30°), abort on temp: %s", message);
+            return;
+        }
+        // code to change send 0b 10 47 16 xx (temp)
+        char Atemp[]         = "0b 10 47 16 ";
+        //convert INT to hex & prepare HEX string to send 
+        char buffer[16]      = {0};
+        ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
+        myDebug("MQTT topic: New Sommerschwelle Temp %s", message);
+    }  
+    //lobocobra end 
+
+    // set night temp value
+    if (strcmp(topic, TOPIC_THERMOSTAT_CMD_NIGHTTEMP) == 0) {
+        float f     = strtof((char *)message, 0);
+        char  s[10] = {0};
+        myDebug("MQTT topic: new thermostat night temperature value %s", _float_to_char(s, f));
+        ems_setThermostatTemp(f, 1);
+    }
+
+    // set daytemp value
+    if (strcmp(topic, TOPIC_THERMOSTAT_CMD_DAYTEMP) == 0) {
+        float f     = strtof((char *)message, 0);
+        char  s[10] = {0};
+        myDebug("MQTT topic: new thermostat day temperature value %s", _float_to_char(s, f));
+        ems_setThermostatTemp(f, 2);
+    }
+
+    // set holiday value
+    if (strcmp(topic, TOPIC_THERMOSTAT_CMD_HOLIDAYTEMP) == 0) {
+        float f     = strtof((char *)message, 0);
+        char  s[10] = {0};
+        myDebug("MQTT topic: new thermostat holiday temperature value %s", _float_to_char(s, f));
+        ems_setThermostatTemp(f, 3);
+    }
+
+    // wwActivated
+    if (strcmp(topic, TOPIC_BOILER_WWACTIVATED) == 0) {
+        if (message[0] == '1' || strcmp(message, "on") == 0) {
+            ems_setWarmWaterActivated(true);
+        } else if (message[0] == '0' || strcmp(message, "off") == 0) {
+            ems_setWarmWaterActivated(false);
+        }
+    }
+
+    // boiler wwtemp changes
+    if (strcmp(topic, TOPIC_BOILER_CMD_WWTEMP) == 0) {
+        uint8_t t = atoi((char *)message);
+        myDebug("MQTT topic: boiler warm water temperature value %d", t);
+        ems_setWarmWaterTemp(t);
+        publishValues(true); // publish back immediately, can't remember why I do this?!
+    }
+
+    // boiler ww comfort setting
+    if (strcmp(topic, TOPIC_BOILER_CMD_COMFORT) == 0) {
+        myDebug("MQTT topic: boiler warm water comfort value is %s", message);
+        if (strcmp((char *)message, "hot") == 0) {
+            ems_setWarmWaterModeComfort(1);
+        } else if (strcmp((char *)message, "comfort") == 0) {
+            ems_setWarmWaterModeComfort(2);
+        } else if (strcmp((char *)message, "intelligent") == 0) {
+            ems_setWarmWaterModeComfort(3);
+        }
+    }
+
+    // shower timer
+    if (strcmp(topic, TOPIC_SHOWER_TIMER) == 0) {
+        if (message[0] == '1') {
+            EMSESP_Status.shower_timer = true;
+        } else if (message[0] == '0') {
+            EMSESP_Status.shower_timer = false;
+        }
+        set_showerTimer();
+    }
+
+    // shower alert
+    if (strcmp(topic, TOPIC_SHOWER_ALERT) == 0) {
+        if (message[0] == '1') {
+            EMSESP_Status.shower_alert = true;
+        } else if (message[0] == '0') {
+            EMSESP_Status.shower_alert = false;
+        }
+        set_showerAlert();
+    }
+
+    // shower cold shot
+    if (strcmp(topic, TOPIC_SHOWER_COLDSHOT) == 0) {
+        _showerColdShotStart();
+    }
+}
+
+// publish the outcome of an MQTT command that came with an id
+void publishCmdResponse(const char * id, const char * topic, const char * status, uint32_t latency, uint8_t retries) {
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              data[MQTT_MAX_SIZE] = {0};
+
+    JsonObject rootCmd   = doc.to<JsonObject>();
+    rootCmd[CMD_ID]      = id;
+    rootCmd[CMD_TOPIC]   = topic;
+    rootCmd[CMD_STATUS]  = status;
+    rootCmd[CMD_LATENCY] = latency;
+    rootCmd[CMD_RETRIES] = retries;
+
+    serializeJson(doc, data, sizeof(data));
+    myESP.mqttPublish(TOPIC_CMD_RESPONSE, data);
+}
+
+// an incoming MQTT command, either the plain value or {"id":"x", "value":21.5}
+// with an id an ack or nack is published to TOPIC_CMD_RESPONSE once the writes it caused are verified on the bus
+void commandRequest(const char * topic, const char * message) {
+    // raw telegrams have their own JSON format, see rawCommandBatch()
+    if ((message[0] != '{') || (strcmp(topic, TOPIC_MQTT_CMD_RAW) == 0)) {
+        MQTTCommand(topic, message);
+        return;
+    }
+
+    StaticJsonDocument<MQTT_MAX_SIZE> doc;
+    char                              value[32] = {0};
+    char                              id[sizeof(EMSESP_CmdRequests[0].id)];
+
+    DeserializationError error = deserializeJson(doc, message);
+    if (error) {
+        myDebug("MQTT topic: %s not valid JSON: %s", topic, error.c_str());
+        return;
+    }
+
+    JsonObject  root      = doc.as<JsonObject>();
+    JsonVariant rootValue = root[CMD_VALUE];
+    strlcpy(id, root[CMD_ID] | "", sizeof(id));
+
+    if (rootValue.isNull()) {
+        myDebug("MQTT topic: %s has no %s", topic, CMD_VALUE);
+        if (id[0] != '\0') {
+            publishCmdResponse(id, topic, "invalid", 0, 0);
+        }
+        return;
+    }
+
+    if (rootValue.is<const char *>()) {
+        strlcpy(value, rootValue.as<const char *>(), sizeof(value));
+    } else {
+        serializeJson(rootValue, value, sizeof(value)); // a number
+    }
+
+    if (id[0] == '\0') {
+        MQTTCommand(topic, value);
+        return;
+    }
+
+    _EMSESP_CmdRequest * request = NULL;
+    for (uint8_t i = 0; i < CMD_PENDING_MAX; i++) {
+        if (EMSESP_CmdRequests[i].tag == 0) {
+            request = &EMSESP_CmdRequests[i];
+            break;
+        }
+    }
+    if (request == NULL) {
+        publishCmdResponse(id, topic, "busy", 0, 0); // too many commands waiting, nothing is done
+        return;
+    }
+
+    uint16_t tag   = _nextTag();
+    uint32_t start = millis();
+    ems_setTxTag(tag);
+    MQTTCommand(topic, value);
+    uint8_t writes = ems_setTxTag(0);
+
+    // nothing was sent to the bus, e.g. the value was out of range or it's only a setting
+    if (writes == 0) {
+        publishCmdResponse(id, topic, "none", 0, 0);
+        return;
+    }
+
+    request->tag     = tag;
+    request->writes  = writes;
+    request->failed  = false;
+    request->raw     = false;
+    request->retries = 0;
+    request->start   = start;
+    strlcpy(request->topic, topic, sizeof(request->topic));
+    strlcpy(request->id, id, sizeof(request->id));
+}
+
+// publish an ack or nack for each MQTT command whose writes are all done
+void publishCmdResults() {
+    _EMS_TxResult result;
+
+    while (ems_getTxResult(&result)) {
+        _EMSESP_CmdRequest * request = NULL;
+        for (uint8_t i = 0; i < CMD_PENDING_MAX; i++) {
+            if (EMSESP_CmdRequests[i].tag == result.tag) {
+                request = &EMSESP_CmdRequests[i];
+                break;
+            }
+        }
+        if (request == NULL) {
+            continue; // not one of ours
+        }
+
+        if (!result.success) {
+            request->failed = true;
+        }
+        if (result.raw) {
+            request->raw = true;
+        }
+        if (result.retries > request->retries) {
+            request->retries = result.retries;
+        }
+
+        if (--request->writes == 0) {
+            const char * status = request->failed ? "nack" : (request->raw ? "sent" : "ack");
+            publishCmdResponse(request->id, request->topic, status, result.timestamp - request->start, request->retries);
+            request->tag = 0;
+        }
+    }
+
+    // the writes were lost without an outcome
+    for (uint8_t i = 0; i < CMD_PENDING_MAX; i++) {
+        _EMSESP_CmdRequest * request = &EMSESP_CmdRequests[i];
+        if ((request->tag != 0) && ((millis() - request->start) > CMD_TIMEOUT)) {
+            publishCmdResponse(request->id, request->topic, "timeout", millis() - request->start, request->retries);
+            request->tag = 0;
+        }
+    }
+}
+
 // MQTT Callback to handle incoming/outgoing changes
 void MQTTCallback(unsigned int type, const char * topic, const char * message) {
     // we're connected. lets subscribe to some topics
@@ -1349,6 +2974,14 @@ void MQTTCallback(unsigned int type, const char * topic, const char * message) {
         myESP.mqttSubscribe(TOPIC_THERMOSTAT_CMD_DAYTEMP);
         myESP.mqttSubscribe(TOPIC_THERMOSTAT_CMD_NIGHTTEMP);
         myESP.mqttSubscribe(TOPIC_THERMOSTAT_CMD_HOLIDAYTEMP);
+        myESP.mqttSubscribe(TOPIC_HISTORY_CMD);
+
+        // the broker sends the retained hash of the last discovery configs, if there is one
+        if (strlen(HA_DISCOVERY_PREFIX)) {
+            myESP.mqttSubscribe(TOPIC_HA_DISCOVERY);
+            EMSESP_DiscoveryState     = HA_DISCOVERY_WAIT;
+            EMSESP_DiscoveryTimestamp = millis();
+        }
         //lobocobra start
         myESP.mqttSubscribe(TOPIC_MQTT_CMD_RAW);
         myESP.mqttSubscribe(THERMOSTAT_CMD_AUSSCHALTHYSTERESE);
@@ -1375,336 +3008,7 @@ void MQTTCallback(unsigned int type, const char * topic, const char * message) {
 
     // handle incoming MQTT publish events
     if (type == MQTT_MESSAGE_EVENT) {
-        // thermostat temp changes
-        if (strcmp(topic, TOPIC_THERMOSTAT_CMD_TEMP) == 0) {
-            float f     = strtof((char *)message, 0);
-            char  s[10] = {0};
-            myDebug("MQTT topic: thermostat temperature value %s", _float_to_char(s, f));
-            ems_setThermostatTemp(f);
-            publishValues(true); // publish back immediately, can't remember why I do this?!
-        }
-
-        // thermostat mode changes
-        if (strcmp(topic, TOPIC_THERMOSTAT_CMD_MODE) == 0) {
-            myDebug("MQTT topic: thermostat mode value %s", message);
-            if (strcmp((char *)message, "auto") == 0) {
-                ems_setThermostatMode(2);
-            } else if (strcmp((char *)message, "day") == 0 || strcmp((char *)message, "manual") == 0) {
-                ems_setThermostatMode(1);
-            } else if (strcmp((char *)message, "night") == 0 || strcmp((char *)message, "off") == 0) {
-                ems_setThermostatMode(0);
-            }
-        }
-
-        // thermostat heating circuit change
-        if (strcmp(topic, TOPIC_THERMOSTAT_CMD_HC) == 0) {
-            myDebug("MQTT topic: thermostat heating circuit value %s", message);
-            uint8_t hc = atoi((char *)message);
-            if ((hc >= 1) && (hc <= 2)) {
-                EMSESP_Status.heating_circuit = hc;
-                ems_setThermostatHC(hc);
-                // TODO: save setting to SPIFFS??
-            }
-        }
-        // lobocobra start // send mqtt to raw 
-        if (strcmp(topic, TOPIC_MQTT_CMD_RAW) == 0) {
-            myDebug("MQTT topic: RAW telegram: %s", message);
-            ems_sendRawTelegram((char *)&message[0]); 
-        }
-        if (strcmp(topic,THERMOSTAT_CMD_AUSSCHALTHYSTERESE ) == 0) { 
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<5 || t> 12) {
-                myDebug("MQTT topic: Ausschalthysterese outside 5-12C, abort on C: %s", message);    
-                return;
-            }
-            // code to change send 0B 08 16 04  xx (temp)
-            char Atemp[]           = "0b 08 16 04 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: New Ausschalthysterese C %s", message);  
-        }          
-        if (strcmp(topic,THERMOSTAT_CMD_EINSCHALTHYSTERESE ) == 0) { // negative VALUE!
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<244 || t> 251) {
-                myDebug("MQTT topic: Einschalthysterese outside 5-12C, abort on C: %d", t);    
-                return;
-            }
-            // code to change send 0B 08 16 05  xx (temp)
-            char Atemp[]           = "0b 08 16 05 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa( t, buffer)) );  //negative value, substract from 256
-            myDebug("MQTT topic: New Einschalthysterese ° above %s", message); 
-        }
-        if (strcmp(topic,THERMOSTAT_CMD_ANTIPENDELZEIT ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<5 || t> 30) {
-                myDebug("MQTT topic: Antipendelzeit outside 5-30 min, abort on min: %s", message);    
-                return;
-            }
-            // code to change send 0B 08 16 06  xx (temp)
-            char Atemp[]           = "0b 08 16 06 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: New Antipendelzeit min %s", message);  
-        }
-        if (strcmp(topic,THERMOSTAT_CMD_AUSLEGUNGSTEMP ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<30 || t> 60) {
-                myDebug("MQTT topic: Auslegungstemperatur not accepted, abort on temp: %s", message);    
-                return;
-            }
-            // code to change send 0b 10 47 24 xx (temp)
-            char Atemp[]           = "0b 10 47 24 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: New Auslegungstemperatur %s", message);  
-        }  
-        if (strcmp(topic,THERMOSTAT_CMD_HEIZTURBO_TILL_NEXT ) == 0) {
-            //convert message to INT and control it
-            char buffer[16]      = {0};
-            float t     = strtof((char *)message, 0);
-            if ((t<15 && t !=0) || t> 35) {
-               myDebug("MQTT topic: Max Turbo temp not accepted (0 and 15-35), abort on temp: %s", _float_to_char(buffer, t));
-               return;
-            }
-            // convert temp and multiplicate it by 2 for EMS bus
-            t = (t*2); 
-            // code to change send send 0b 10 47 06 xx (temp*2)
-            char Atemp[]         = "0b 10 47 25 ";
-            //convert INT to hex & prepare HEX string to send 
-            ems_sendRawTelegram( strcat (Atemp, _hextoa((int)t, buffer)) );  
-            myDebug("MQTT topic: New Turbo Temp %s", _float_to_char(buffer, t/2));
-        } 
-        if (strcmp(topic,THERMOSTAT_CMD_MAXVORLAUF ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<30 || t> 65) {
-                myDebug("MQTT topic: Max Vorlauf not accepted (30-65°), abort on temp: %s", message);
-                return;
-            }
-            // code to change send 0b 10 47 23 xx (temp)
-            char Atemp[]         = "0b 10 47 23 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: New Max Vorlauf %s", message);
-        } 
-        if (strcmp(topic,THERMOSTAT_CMD_MINVORLAUF ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<5|| t> 25) {
-                myDebug("MQTT topic: Min Vorlauf not accepted (5-26°), abort on temp: %s", message);
-                return;
-            }
-            // code to change send 0b 10 47 10 xx (temp)
-            char Atemp[]         = "0b 10 47 10 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: New Min Vorlauf %s", message);
-        }          
-        if (strcmp(topic,THERMOSTAT_CMD_ROOMOFFSET ) == 0) {
-            //convert message to INT and control it
-            char buffer[16]      = {0};
-            float t     = strtof((char *)message, 0);
-            if (t<-5 || t> 5) {
-               myDebug("MQTT topic: Max RoomOffset not accepted, abort on temp: %s", _float_to_char(buffer, t));
-                return;
-            }
-            // convert negative numbers and multiplicate it by 2 for EMS bus
-            (t<0) ? t = 256 - (t*-2) : t = (t*2); 
-            // code to change send send 0b 10 47 06 xx (temp*2)
-            char Atemp[]         = "0b 10 47 06 ";
-            //convert INT to hex & prepare HEX string to send 
-            ems_sendRawTelegram( strcat (Atemp, _hextoa((int)t, buffer)) );  
-            myDebug("MQTT topic: New RoomOffset %s", _float_to_char(buffer, t));
-        }    
-        if (strcmp(topic,THERMOSTAT_CMD_MINOUTSIDETEMP ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);    
-            if (t<236 || t> 254) { // we accept -20 to -2 (255 would be No_DATA)
-                myDebug("MQTT topic: Minusoutsidetemp not within -20 to -2c, abort on: %d", t);    
-                return;
-            }
-            // code to change send 0B 10 A5 05  xx (temp)
-            char Atemp[]           = "0b 10 A5 05 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa( (t), buffer)) );  //negative value, substract from 256
-            //myDebug("MQTT topic: New Minusoutsidetemp ° above %s", strcat (Atemp, _hextoa( (t), buffer)));
-            myDebug("MQTT topic: New Minusoutsidetemp at %s", message); 
-        }       
-        if (strcmp(topic,THERMOSTAT_CMD_HOUSETYPE ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<0 || t> 2) {
-                myDebug("MQTT topic: 0=leicht 1=mittel 2=schwer abort on type: %d", t);
-                return;
-            }
-            // code to change send 0b 10 A5 06 xx (type 0/1/2)
-            char Atemp[]         = "0b 10 A5 06 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: New House type %s", message);
-        } 
-        if (strcmp(topic,THERMOSTAT_CMD_PAUSEZEIT) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<0 || t> 12) {
-                myDebug("MQTT topic: outside time 0-12h abort PAUSE on type: %d", t);
-                return;
-            }
-            // code to change send 0b 10 49 55 xx (!!! outside range for read see below)
-            char Atemp[]         = "0b 10 49 55 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: PAUSEZEIT for %s hours", message);
-        }   
-        if (strcmp(topic,THERMOSTAT_CMD_PARTYZEIT) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<0 || t> 12) {
-                myDebug("MQTT topic: outside time 0-12h abort PARTY on type: %d", t);
-                return;
-            }
-            // code to change send 0b 10 49 56 xx (!!! outside range for read see below)
-            char Atemp[]         = "0b 10 49 56 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: PARTYZEIT for %s hours", message);
-        }               
-        if (strcmp(topic,THERMOSTAT_CMD_TEMPAVERAGEBOOL ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<0 || t> 1) {
-                myDebug("MQTT topic: TempDämpfung ON/OFF: %d", t);
-                return;
-            }
-            //code to change send 0b 10 a5 15 xx (position 21= hex 15)
-            char Atemp[]         = "0b 10 A5 15 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t*255, buffer)) );  // on =255 off=0
-            myDebug("MQTT topic: TempDaempung ON/OFF %s", message);
-        }      
-        if (strcmp(topic,THERMOSTAT_CMD_KESSELPUMENNACHLAUF ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<0 || t> 10) {
-                myDebug("MQTT topic: Kesselpumpennachlauf outside 5-10 min, abort on min: %s", message);    
-                return;
-            }
-            // code to change send 0B 08 16 08  xx (temp)
-            char Atemp[]           = "0b 08 16 08 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: Kesselpumpennachlauf min %s", message);  
-        }
-        if (strcmp(topic,THERMOSTAT_CMD_SOMMERSCHWELLE_TEMP ) == 0) {
-            //convert message to INT and control it
-            uint8_t t = atoi((char *)message);
-            if (t<10 || t> 30) {
-                myDebug("MQTT topic: Sommerschwelle not accepted (10-30°), abort on temp: %s", message);
-                return;
-            }
-            // code to change send 0b 10 47 16 xx (temp)
-            char Atemp[]         = "0b 10 47 16 ";
-            //convert INT to hex & prepare HEX string to send 
-            char buffer[16]      = {0};
-            ems_sendRawTelegram( strcat (Atemp, _hextoa(t, buffer)) );  
-            myDebug("MQTT topic: New Sommerschwelle Temp %s", message);
-        }  
-        //lobocobra end 
-
-        // set night temp value
-        if (strcmp(topic, TOPIC_THERMOSTAT_CMD_NIGHTTEMP) == 0) {
-            float f     = strtof((char *)message, 0);
-            char  s[10] = {0};
-            myDebug("MQTT topic: new thermostat night temperature value %s", _float_to_char(s, f));
-            ems_setThermostatTemp(f, 1);
-        }
-
-        // set daytemp value
-        if (strcmp(topic, TOPIC_THERMOSTAT_CMD_DAYTEMP) == 0) {
-            float f     = strtof((char *)message, 0);
-            char  s[10] = {0};
-            myDebug("MQTT topic: new thermostat day temperature value %s", _float_to_char(s, f));
-            ems_setThermostatTemp(f, 2);
-        }
-
-        // set holiday value
-        if (strcmp(topic, TOPIC_THERMOSTAT_CMD_HOLIDAYTEMP) == 0) {
-            float f     = strtof((char *)message, 0);
-            char  s[10] = {0};
-            myDebug("MQTT topic: new thermostat holiday temperature value %s", _float_to_char(s, f));
-            ems_setThermostatTemp(f, 3);
-        }
-
-        // wwActivated
-        if (strcmp(topic, TOPIC_BOILER_WWACTIVATED) == 0) {
-            if (message[0] == '1' || strcmp(message, "on") == 0) {
-                ems_setWarmWaterActivated(true);
-            } else if (message[0] == '0' || strcmp(message, "off") == 0) {
-                ems_setWarmWaterActivated(false);
-            }
-        }
-
-        // boiler wwtemp changes
-        if (strcmp(topic, TOPIC_BOILER_CMD_WWTEMP) == 0) {
-            uint8_t t = atoi((char *)message);
-            myDebug("MQTT topic: boiler warm water temperature value %d", t);
-            ems_setWarmWaterTemp(t);
-            publishValues(true); // publish back immediately, can't remember why I do this?!
-        }
-
-        // boiler ww comfort setting
-        if (strcmp(topic, TOPIC_BOILER_CMD_COMFORT) == 0) {
-            myDebug("MQTT topic: boiler warm water comfort value is %s", message);
-            if (strcmp((char *)message, "hot") == 0) {
-                ems_setWarmWaterModeComfort(1);
-            } else if (strcmp((char *)message, "comfort") == 0) {
-                ems_setWarmWaterModeComfort(2);
-            } else if (strcmp((char *)message, "intelligent") == 0) {
-                ems_setWarmWaterModeComfort(3);
-            }
-        }
-
-        // shower timer
-        if (strcmp(topic, TOPIC_SHOWER_TIMER) == 0) {
-            if (message[0] == '1') {
-                EMSESP_Status.shower_timer = true;
-            } else if (message[0] == '0') {
-                EMSESP_Status.shower_timer = false;
-            }
-            set_showerTimer();
-        }
-
-        // shower alert
-        if (strcmp(topic, TOPIC_SHOWER_ALERT) == 0) {
-            if (message[0] == '1') {
-                EMSESP_Status.shower_alert = true;
-            } else if (message[0] == '0') {
-                EMSESP_Status.shower_alert = false;
-            }
-            set_showerAlert();
-        }
-
-        // shower cold shot
-        if (strcmp(topic, TOPIC_SHOWER_COLDSHOT) == 0) {
-            _showerColdShotStart();
-        }
+        commandRequest(topic, message);
     }
 }
 
@@ -1850,18 +3154,22 @@ void setup() {
     myESP.setOTA(OTACallback_pre, OTACallback_post);
 
     // custom settings in SPIFFS
-    myESP.setSettings(FSCallback, SettingsCallback);
+    myESP.setSettings(FSCallback, SettingsCallback, FSRecordCallback);
 
     // start up all the services
     myESP.begin(APP_HOSTNAME, APP_NAME, APP_VERSION);
 
     // at this point we have the settings from our internall SPIFFS config file
 
+    // restore the last known EMS values so there is something to publish before the bus has been read
+    ems_loadSnapshot();
+
     // enable regular checks if not in test mode
     if (!EMSESP_Status.silent_mode) {
         publishValuesTimer.attach(EMSESP_Status.publish_wait, do_publishValues);             // post MQTT EMS values
         publishSensorValuesTimer.attach(EMSESP_Status.publish_wait, do_publishSensorValues); // post MQTT sensor values
         regularUpdatesTimer.attach(REGULARUPDATES_TIME, do_regularUpdates);                  // regular reads from the EMS
+        publishBurnerTimer.attach(BURNER_PUBLISH_TIME, do_publishBurnerValues);              // post MQTT burner analytics
     }
 
     // set pin for LED
@@ -1888,8 +3196,12 @@ void loop() {
     // these values are published to MQTT seperately via the timer publishSensorValuesTimer
     if (EMSESP_Status.dallas_sensors != 0) {
         ds18.loop();
+        historySensors();
     }
 
+    // close the history buckets that are due, also when no telegrams come in
+    ems_historyLoop();
+
     // publish the values to MQTT, only if the values have changed
     // although we don't want to publish when doing a deep scan of the thermostat
     if (ems_getEmsRefreshed() && (scanThermostat_count == 0) && (!EMSESP_Status.silent_mode)) {
@@ -1897,6 +3209,16 @@ void loop() {
         ems_setEmsRefreshed(false); // reset
     }
 
+    // keep a snapshot of the EMS values in SPIFFS for the next boot
+    ems_saveSnapshot(false);
+
+    // replies to raw telegrams and commands from MQTT
+    publishRawReplies();
+    publishCmdResults();
+
+    // Home Assistant discovery, after connecting to MQTT
+    publishDiscovery();
+
     // do shower logic, if enabled
     if (EMSESP_Status.shower_timer) {
         showerCheck();
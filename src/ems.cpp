@@ -8,8 +8,10 @@
 
 #include "ems.h"
 #include "ems_devices.h"
+#include "ems_print.h"
 #include "emsuart.h"
 #include <Arduino.h>
+#include <CRC32.h>          // https://github.com/bakercp/CRC32
 #include <CircularBuffer.h> // https://github.com/rlogiacco/CircularBuffer
 #include <MyESP.h>
 #include <list> // std::list
@@ -21,130 +23,162 @@ _EMS_Sys_Status EMS_Sys_Status; // EMS Status
 
 CircularBuffer<_EMS_TxTelegram, EMS_TX_TELEGRAM_QUEUE_MAX> EMS_TxQueue; // FIFO queue for Tx send buffer
 
+_EMS_TxEcho EMS_TxEcho; // what we last sent, to detect bus collisions
+
+_EMS_TxValidateBatch EMS_TxValidateBatches[EMS_TX_VALIDATE_BATCHES];  // writes waiting to be verified, each tied to its validate telegram
+uint8_t              EMS_TxValidateOpen = EMS_TX_VALIDATE_NONE;         // the batch still collecting writes, not yet queued as a validate
+
+_EMS_Discovery   EMS_Discovery;                                 // which devices are on the bus and which we know
+_EMS_DeviceCache EMS_DeviceCache[EMS_DISCOVERY_CACHE_MAX];      // product id and version of identified devices
+uint8_t          EMS_DeviceCache_count = 0;                      // # devices in the cache
+
+_EMS_TxDeviceStats EMS_TxDeviceStats[EMS_TX_DEVICES_MAX]; // Tx stats per destination
+uint8_t            EMS_TxDeviceStats_count = 0;           // # devices in use
+uint32_t           EMS_TxSentTimestamp     = 0;           // when the last read/write/validate was sent
+
+uint32_t EMS_SnapshotCRC       = 0; // CRC of the last snapshot written to SPIFFS
+uint32_t EMS_SnapshotTimestamp = 0; // when we last checked if the snapshot needed writing
+
 // macros used in the _process* functions
 #define _toByte(i) (data[i])
 #define _toShort(i) ((data[i] << 8) + data[i + 1])
 #define _toLong(i) ((data[i] << 16) + (data[i + 1] << 8) + (data[i + 2]))
 #define _bitRead(i, bit) (((data[i]) >> (bit)) & 0x01)
 
+// macros for the 128-bit device bitmaps, one bit per bus ID
+#define _bitmapSet(map, id) ((map)[((id)&0x7F) >> 5] |= (1UL << ((id)&0x1F)))
+#define _bitmapClear(map, id) ((map)[((id)&0x7F) >> 5] &= ~(1UL << ((id)&0x1F)))
+#define _bitmapRead(map, id) (((map)[((id)&0x7F) >> 5] >> ((id)&0x1F)) & 0x01)
+
+// RC35 telegram types for each heating circuit, HC1 first
+const uint8_t EMS_RC35Set_HC[EMS_THERMOSTAT_MAXHC] = {EMS_TYPE_RC35Set_HC1, EMS_TYPE_RC35Set_HC2, EMS_TYPE_RC35Set_HC3, EMS_TYPE_RC35Set_HC4};
+const uint8_t EMS_RC35StatusMessage_HC[EMS_THERMOSTAT_MAXHC] =
+    {EMS_TYPE_RC35StatusMessage_HC1, EMS_TYPE_RC35StatusMessage_HC2, EMS_TYPE_RC35StatusMessage_HC3, EMS_TYPE_RC35StatusMessage_HC4};
+
 //
 // process callbacks per type
 //
 
 // generic
-void _process_Version(uint8_t src, uint8_t * data, uint8_t length);
+void _process_Version(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 // Boiler and Buderus devices
-void _process_UBAMonitorFast(uint8_t src, uint8_t * data, uint8_t length);
-void _process_UBAMonitorSlow(uint8_t src, uint8_t * data, uint8_t length);
-void _process_UBAMonitorWWMessage(uint8_t src, uint8_t * data, uint8_t length);
-void _process_UBAParameterWW(uint8_t src, uint8_t * data, uint8_t length);
-void _process_UBATotalUptimeMessage(uint8_t src, uint8_t * data, uint8_t length);
-void _process_UBAParametersMessage(uint8_t src, uint8_t * data, uint8_t length);
-void _process_SetPoints(uint8_t src, uint8_t * data, uint8_t length);
-void _process_SM10Monitor(uint8_t src, uint8_t * data, uint8_t length);
+void _process_UBAMonitorFast(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_UBAMonitorSlow(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_UBAMonitorWWMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_UBAParameterWW(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_UBATotalUptimeMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_UBAParametersMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_SetPoints(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_SM10Monitor(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_MMStatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 // Common for most thermostats
-void _process_RCTime(uint8_t src, uint8_t * data, uint8_t length);
-void _process_RCOutdoorTempMessage(uint8_t src, uint8_t * data, uint8_t length);
+void _process_RCTime(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_RCOutdoorTempMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 // RC10
-void _process_RC10Set(uint8_t src, uint8_t * data, uint8_t length);
-void _process_RC10StatusMessage(uint8_t src, uint8_t * data, uint8_t length);
+void _process_RC10Set(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_RC10StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 // RC20
-void _process_RC20Set(uint8_t src, uint8_t * data, uint8_t length);
-void _process_RC20StatusMessage(uint8_t src, uint8_t * data, uint8_t length);
+void _process_RC20Set(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_RC20StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 // RC30
-void _process_RC30Set(uint8_t src, uint8_t * data, uint8_t length);
-void _process_RC30StatusMessage(uint8_t src, uint8_t * data, uint8_t length);
+void _process_RC30Set(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_RC30StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 // RC35
-void _process_RC35Set(uint8_t src, uint8_t * data, uint8_t length);
-void _process_RC35StatusMessage(uint8_t src, uint8_t * data, uint8_t length);
+void _process_RC35Set(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_RC35StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 //lobocobra start
-void _process_AnlageParamSet(uint8_t src, uint8_t * data, uint8_t length);
-void _process_HK2Schaltzeiten(uint8_t src, uint8_t * data, uint8_t length);
+void _process_AnlageParamSet(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_HK2Schaltzeiten(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 //lobocobra end
 
 // Easy
-void _process_EasyStatusMessage(uint8_t type, uint8_t * data, uint8_t length);
+void _process_EasyStatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 //RC1010
-void _process_RC1010StatusMessage(uint8_t type, uint8_t * data, uint8_t length);
-void _process_RC1010SetMessage(uint8_t type, uint8_t * data, uint8_t length);
+void _process_RC1010StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
+void _process_RC1010SetMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 /*
  * Recognized EMS types and the functions they call to process the telegrams
- * Format: MODEL ID, TYPE ID, Description, function, emsplus
+ * Format: MODEL ID, TYPE ID, Description, function
  */
 const _EMS_Type EMS_Types[] = {
 
     // common
-    {EMS_MODEL_ALL, EMS_TYPE_Version, "Version", _process_Version, false},
+    {EMS_MODEL_ALL, EMS_TYPE_Version, "Version", _process_Version},
 
     // Boiler commands
-    {EMS_MODEL_UBA, EMS_TYPE_UBAMonitorFast, "UBAMonitorFast", _process_UBAMonitorFast, false},
-    {EMS_MODEL_UBA, EMS_TYPE_UBAMonitorSlow, "UBAMonitorSlow", _process_UBAMonitorSlow, false},
-    {EMS_MODEL_UBA, EMS_TYPE_UBAMonitorWWMessage, "UBAMonitorWWMessage", _process_UBAMonitorWWMessage, false},
-    {EMS_MODEL_UBA, EMS_TYPE_UBAParameterWW, "UBAParameterWW", _process_UBAParameterWW, false},
-    {EMS_MODEL_UBA, EMS_TYPE_UBATotalUptimeMessage, "UBATotalUptimeMessage", _process_UBATotalUptimeMessage, false},
-    {EMS_MODEL_UBA, EMS_TYPE_UBAMaintenanceSettingsMessage, "UBAMaintenanceSettingsMessage", NULL, false},
-    {EMS_MODEL_UBA, EMS_TYPE_UBAParametersMessage, "UBAParametersMessage", _process_UBAParametersMessage, false},
-    {EMS_MODEL_UBA, EMS_TYPE_UBASetPoints, "UBASetPoints", _process_SetPoints, false},
+    {EMS_MODEL_UBA, EMS_TYPE_UBAMonitorFast, "UBAMonitorFast", _process_UBAMonitorFast},
+    {EMS_MODEL_UBA, EMS_TYPE_UBAMonitorSlow, "UBAMonitorSlow", _process_UBAMonitorSlow},
+    {EMS_MODEL_UBA, EMS_TYPE_UBAMonitorWWMessage, "UBAMonitorWWMessage", _process_UBAMonitorWWMessage},
+    {EMS_MODEL_UBA, EMS_TYPE_UBAParameterWW, "UBAParameterWW", _process_UBAParameterWW},
+    {EMS_MODEL_UBA, EMS_TYPE_UBATotalUptimeMessage, "UBATotalUptimeMessage", _process_UBATotalUptimeMessage},
+    {EMS_MODEL_UBA, EMS_TYPE_UBAMaintenanceSettingsMessage, "UBAMaintenanceSettingsMessage", NULL},
+    {EMS_MODEL_UBA, EMS_TYPE_UBAParametersMessage, "UBAParametersMessage", _process_UBAParametersMessage},
+    {EMS_MODEL_UBA, EMS_TYPE_UBASetPoints, "UBASetPoints", _process_SetPoints},
 
     // Other devices
     {EMS_MODEL_OTHER, EMS_TYPE_SM10Monitor, "SM10Monitor", _process_SM10Monitor},
+    {EMS_MODEL_OTHER, EMS_TYPE_MMStatusMessage, "MMStatusMessage", _process_MMStatusMessage},
 
     // RC10
-    {EMS_MODEL_RC10, EMS_TYPE_RCTime, "RCTime", _process_RCTime, false},
-    {EMS_MODEL_RC10, EMS_TYPE_RC10Set, "RC10Set", _process_RC10Set, false},
-    {EMS_MODEL_RC10, EMS_TYPE_RC10StatusMessage, "RC10StatusMessage", _process_RC10StatusMessage, false},
+    {EMS_MODEL_RC10, EMS_TYPE_RCTime, "RCTime", _process_RCTime},
+    {EMS_MODEL_RC10, EMS_TYPE_RC10Set, "RC10Set", _process_RC10Set},
+    {EMS_MODEL_RC10, EMS_TYPE_RC10StatusMessage, "RC10StatusMessage", _process_RC10StatusMessage},
 
     // RC20 and RC20F
-    {EMS_MODEL_RC20, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage, false},
-    {EMS_MODEL_RC20, EMS_TYPE_RCTime, "RCTime", _process_RCTime, false},
-    {EMS_MODEL_RC20, EMS_TYPE_RC20Set, "RC20Set", _process_RC20Set, false},
-    {EMS_MODEL_RC20, EMS_TYPE_RC20StatusMessage, "RC20StatusMessage", _process_RC20StatusMessage, false},
+    {EMS_MODEL_RC20, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage},
+    {EMS_MODEL_RC20, EMS_TYPE_RCTime, "RCTime", _process_RCTime},
+    {EMS_MODEL_RC20, EMS_TYPE_RC20Set, "RC20Set", _process_RC20Set},
+    {EMS_MODEL_RC20, EMS_TYPE_RC20StatusMessage, "RC20StatusMessage", _process_RC20StatusMessage},
 
-    {EMS_MODEL_RC20F, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage, false},
-    {EMS_MODEL_RC20F, EMS_TYPE_RCTime, "RCTime", _process_RCTime, false},
-    {EMS_MODEL_RC20F, EMS_TYPE_RC20Set, "RC20Set", _process_RC20Set, false},
-    {EMS_MODEL_RC20F, EMS_TYPE_RC20StatusMessage, "RC20StatusMessage", _process_RC20StatusMessage, false},
+    {EMS_MODEL_RC20F, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage},
+    {EMS_MODEL_RC20F, EMS_TYPE_RCTime, "RCTime", _process_RCTime},
+    {EMS_MODEL_RC20F, EMS_TYPE_RC20Set, "RC20Set", _process_RC20Set},
+    {EMS_MODEL_RC20F, EMS_TYPE_RC20StatusMessage, "RC20StatusMessage", _process_RC20StatusMessage},
 
     // RC30
-    {EMS_MODEL_RC30, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage, false},
-    {EMS_MODEL_RC30, EMS_TYPE_RCTime, "RCTime", _process_RCTime, false},
-    {EMS_MODEL_RC30, EMS_TYPE_RC30Set, "RC30Set", _process_RC30Set, false},
-    {EMS_MODEL_RC30, EMS_TYPE_RC30StatusMessage, "RC30StatusMessage", _process_RC30StatusMessage, false},
+    {EMS_MODEL_RC30, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage},
+    {EMS_MODEL_RC30, EMS_TYPE_RCTime, "RCTime", _process_RCTime},
+    {EMS_MODEL_RC30, EMS_TYPE_RC30Set, "RC30Set", _process_RC30Set},
+    {EMS_MODEL_RC30, EMS_TYPE_RC30StatusMessage, "RC30StatusMessage", _process_RC30StatusMessage},
 
     // RC35
-    {EMS_MODEL_RC35, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage, false},
-    {EMS_MODEL_RC35, EMS_TYPE_RCTime, "RCTime", _process_RCTime, false},
-    {EMS_MODEL_RC35, EMS_TYPE_RC35Set_HC1, "RC35Set_HC1", _process_RC35Set, false},
-    {EMS_MODEL_RC35, EMS_TYPE_RC35StatusMessage_HC1, "RC35StatusMessage_HC1", _process_RC35StatusMessage, false},
-    {EMS_MODEL_RC35, EMS_TYPE_RC35Set_HC2, "RC35Set_HC2", _process_RC35Set, false},
-    {EMS_MODEL_RC35, EMS_TYPE_RC35StatusMessage_HC2, "RC35StatusMessage_HC2", _process_RC35StatusMessage, false},
+    {EMS_MODEL_RC35, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage},
+    {EMS_MODEL_RC35, EMS_TYPE_RCTime, "RCTime", _process_RCTime},
+    {EMS_MODEL_RC35, EMS_TYPE_RC35Set_HC1, "RC35Set_HC1", _process_RC35Set},
+    {EMS_MODEL_RC35, EMS_TYPE_RC35StatusMessage_HC1, "RC35StatusMessage_HC1", _process_RC35StatusMessage},
+    {EMS_MODEL_RC35, EMS_TYPE_RC35Set_HC2, "RC35Set_HC2", _process_RC35Set},
+    {EMS_MODEL_RC35, EMS_TYPE_RC35StatusMessage_HC2, "RC35StatusMessage_HC2", _process_RC35StatusMessage},
+    {EMS_MODEL_RC35, EMS_TYPE_RC35Set_HC3, "RC35Set_HC3", _process_RC35Set},
+    {EMS_MODEL_RC35, EMS_TYPE_RC35StatusMessage_HC3, "RC35StatusMessage_HC3", _process_RC35StatusMessage},
+    {EMS_MODEL_RC35, EMS_TYPE_RC35Set_HC4, "RC35Set_HC4", _process_RC35Set},
+    {EMS_MODEL_RC35, EMS_TYPE_RC35StatusMessage_HC4, "RC35StatusMessage_HC4", _process_RC35StatusMessage},
     //lobocobra start
-    {EMS_MODEL_RC35, EMS_TYPE_AnlageParamSet, "AnlageParamSet", _process_AnlageParamSet, false},
-    {EMS_MODEL_RC35, EMS_TYPE_HK2Schaltzeiten, "HK2Schaltzeiten", _process_HK2Schaltzeiten, false},
+    {EMS_MODEL_RC35, EMS_TYPE_AnlageParamSet, "AnlageParamSet", _process_AnlageParamSet},
+    {EMS_MODEL_RC35, EMS_TYPE_HK2Schaltzeiten, "HK2Schaltzeiten", _process_HK2Schaltzeiten},
     //lobocobra end
 
     // ES73
-    {EMS_MODEL_ES73, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage, false},
-    {EMS_MODEL_ES73, EMS_TYPE_RCTime, "RCTime", _process_RCTime, false},
-    {EMS_MODEL_ES73, EMS_TYPE_RC35Set_HC1, "RC35Set", _process_RC35Set, false},
-    {EMS_MODEL_ES73, EMS_TYPE_RC35StatusMessage_HC1, "RC35StatusMessage", _process_RC35StatusMessage, false},
+    {EMS_MODEL_ES73, EMS_TYPE_RCOutdoorTempMessage, "RCOutdoorTempMessage", _process_RCOutdoorTempMessage},
+    {EMS_MODEL_ES73, EMS_TYPE_RCTime, "RCTime", _process_RCTime},
+    {EMS_MODEL_ES73, EMS_TYPE_RC35Set_HC1, "RC35Set", _process_RC35Set},
+    {EMS_MODEL_ES73, EMS_TYPE_RC35StatusMessage_HC1, "RC35StatusMessage", _process_RC35StatusMessage},
 
     // Easy
-    {EMS_MODEL_EASY, EMS_TYPE_EasyStatusMessage, "EasyStatusMessage", _process_EasyStatusMessage, false},
-    {EMS_MODEL_BOSCHEASY, EMS_TYPE_EasyStatusMessage, "EasyStatusMessage", _process_EasyStatusMessage, false},
+    {EMS_MODEL_EASY, EMS_TYPE_EasyStatusMessage, "EasyStatusMessage", _process_EasyStatusMessage},
+    {EMS_MODEL_BOSCHEASY, EMS_TYPE_EasyStatusMessage, "EasyStatusMessage", _process_EasyStatusMessage},
 
-    //Ems plus
-    //Nefit 1010
-    {EMS_MODEL_RC1010, EMS_TYPE_RC1010StatusMessage, "RC1010StatusMessage", _process_RC1010StatusMessage, true},
-    {EMS_MODEL_RC1010, EMS_TYPE_RC1010Set, "RC1010SetMessage", _process_RC1010SetMessage, true}
+    // EMS+
+    // Nefit 1010
+    {EMS_MODEL_RC1010, EMS_TYPE_RC1010StatusMessage, "RC1010StatusMessage", _process_RC1010StatusMessage},
+    {EMS_MODEL_RC1010, EMS_TYPE_RC1010Set, "RC1010SetMessage", _process_RC1010SetMessage}
 
 };
 
@@ -154,10 +188,75 @@ uint8_t _Boiler_Types_max     = ArraySize(Boiler_Types);     // number of boiler
 uint8_t _Other_Types_max      = ArraySize(Other_Types);      // number of other ems devices
 uint8_t _Thermostat_Types_max = ArraySize(Thermostat_Types); // number of defined thermostat types
 
+uint8_t EMS_TypeIndex[ArraySize(EMS_Types)]; // positions in EMS_Types sorted on type, see _ems_buildTypeIndex()
+
 // these structs contain the data we store from the Boiler and Thermostat
 _EMS_Boiler     EMS_Boiler;     // for boiler
 _EMS_Thermostat EMS_Thermostat; // for thermostat
 _EMS_Other      EMS_Other;      // for other known EMS devices
+_EMS_Mixer      EMS_Mixer;      // for the MM10 mixer module
+
+_EMS_Thermostat EMS_ThermostatPool[EMS_THERMOSTATS_MAX - 1]; // for any thermostats besides EMS_Thermostat
+uint8_t         EMS_ThermostatPool_count = 0;                // # in use
+
+_EMS_Device EMS_Devices[EMS_DEVICES_MAX]; // registry of the devices we decode, see _ems_addDevice()
+uint8_t     EMS_Devices_count = 0;        // # devices in the registry
+
+_EMS_Sniffer EMS_Sniffer; // statistics of every telegram type on the bus, see _snifferRecord()
+
+_EMS_BusStats EMS_BusStats; // bus health counters, see _busStatsAdd()
+
+_EMS_HistoryTier EMS_History[EMS_HISTORY_TIERS]; // min/avg/max of the main values over time, see ems_historyAdd()
+
+_EMS_LogFilter EMS_LogFilter; // which telegrams are printed, see _logFilterPass()
+
+// how often each type needs reading, see _EMS_PollPolicy. Types not listed get EMS_PollDefault
+const _EMS_PollPolicy EMS_PollPolicies[] = {
+
+    {EMS_TYPE_UBAMonitorFast, 30000, 35000},                 // broadcast every 10 seconds
+    {EMS_TYPE_UBAMonitorSlow, 60000, 150000},                // broadcast every 60 seconds
+    {EMS_TYPE_UBAParameterWW, 60000, 1800000},               // settings
+    {EMS_TYPE_UBAParametersMessage, 300000, 3600000},        // settings on the boiler itself
+    {EMS_TYPE_UBATotalUptimeMessage, 3600000, 3600000},      // only counts up
+    {EMS_TYPE_RCTime, 3600000, 3600000},                     // changes every time, only shown
+    {EMS_TYPE_RC10StatusMessage, 60000, 150000},             // broadcast every 60 seconds
+    {EMS_TYPE_RC20StatusMessage, 60000, 150000},             // broadcast every 60 seconds
+    {EMS_TYPE_RC30StatusMessage, 60000, 150000},             // broadcast every 60 seconds
+    {EMS_TYPE_RC35StatusMessage_HC1, 60000, 150000},         // broadcast every 60 seconds
+    {EMS_TYPE_RC35StatusMessage_HC2, 60000, 150000},         // broadcast every 60 seconds
+    {EMS_TYPE_RC35StatusMessage_HC3, 60000, 150000},         // broadcast every 60 seconds
+    {EMS_TYPE_RC35StatusMessage_HC4, 60000, 150000},         // broadcast every 60 seconds
+    {EMS_TYPE_EasyStatusMessage, 60000, 300000},             // temperatures
+    {EMS_TYPE_RC20Set, 60000, 1800000},                      // mode and setpoints, changed on the thermostat
+    {EMS_TYPE_RC30Set, 60000, 1800000},                      // mode and setpoints, changed on the thermostat
+    {EMS_TYPE_RC35Set_HC1, 60000, 1800000},                  // mode and setpoints, changed on the thermostat
+    {EMS_TYPE_RC35Set_HC2, 60000, 1800000},                  // mode and setpoints, changed on the thermostat
+    {EMS_TYPE_RC35Set_HC3, 60000, 1800000},                  // mode and setpoints, changed on the thermostat
+    {EMS_TYPE_RC35Set_HC4, 60000, 1800000},                  // mode and setpoints, changed on the thermostat
+    {EMS_TYPE_AnlageParamSet, 600000, 21600000},             // installation parameters, hardly ever change
+    {EMS_TYPE_HK2Schaltzeiten, 600000, 21600000},            // programs, hardly ever change
+    {EMS_TYPE_SM10Monitor, 30000, 150000},                   // broadcast every minute
+    {EMS_TYPE_MMStatusMessage, 30000, 150000}                // broadcast every minute
+
+};
+
+const _EMS_PollPolicy EMS_PollDefault = {0, 60000, 600000};
+
+_EMS_PollEntry EMS_Poll[EMS_POLL_MAX]; // the types read so far, see _pollRead()
+uint8_t        EMS_Poll_count     = 0;
+bool           EMS_PollScheduled  = false; // set while ems_pollDue() runs, then only the reads that are due are done
+
+_EMS_BurnerStats EMS_BurnerStats; // burner cycles, modulation and energy in the current interval, see _burnerStatsFrame()
+
+const uint32_t EMS_HistoryBucketTime[EMS_HISTORY_TIERS] = {10000, 60000, 900000}; // in ms
+const char *   EMS_HistoryTierNames[EMS_HISTORY_TIERS]  = {"10s", "1m", "15m"};
+const char *   EMS_HistoryValueNames[EMS_HISTORY_SENSOR1] = {"curFlowTemp", "retTemp", "curBurnPow", "sysPress", "wWCurTmp", "outdoorTemp"};
+
+_EMS_RawPending EMS_RawPending[EMS_RAW_PENDING_MAX]; // raw telegrams waiting for a reply
+
+uint16_t                                            EMS_TxTag      = 0; // tag for the writes being queued, see ems_setTxTag()
+uint8_t                                             EMS_TxTagCount = 0; // # writes queued with it
+CircularBuffer<_EMS_TxResult, EMS_TX_RESULTS_MAX> EMS_TxResults;        // outcomes of tagged writes, see ems_getTxResult()
 
 // CRC lookup table with poly 12 for faster checking
 const uint8_t ems_crc_table[] = {0x00, 0x02, 0x04, 0x06, 0x08, 0x0A, 0x0C, 0x0E, 0x10, 0x12, 0x14, 0x16, 0x18, 0x1A, 0x1C, 0x1E, 0x20, 0x22,
@@ -176,10 +275,40 @@ const uint8_t ems_crc_table[] = {0x00, 0x02, 0x04, 0x06, 0x08, 0x0A, 0x0C, 0x0E,
                                  0xCD, 0xCF, 0xC1, 0xC3, 0xC5, 0xC7, 0xF9, 0xFB, 0xFD, 0xFF, 0xF1, 0xF3, 0xF5, 0xF7, 0xE9, 0xEB, 0xED, 0xEF,
                                  0xE1, 0xE3, 0xE5, 0xE7};
 
-const uint8_t  TX_WRITE_TIMEOUT_COUNT = 2;     // 3 retries before timeout
 const uint32_t EMS_BUS_TIMEOUT        = 15000; // timeout in ms before recognizing the ems bus is offline (15 seconds)
 const uint32_t EMS_POLL_TIMEOUT       = 5000;  // timeout in ms before recognizing the ems bus is offline (5 seconds)
 
+// reset the values of a thermostat, also used for the extra ones in EMS_ThermostatPool
+void _ems_initThermostat(_EMS_Thermostat * thermostat) {
+    thermostat->hour            = 0;
+    thermostat->minute          = 0;
+    thermostat->second          = 0;
+    thermostat->day             = 0;
+    thermostat->month           = 0;
+    thermostat->year            = 0;
+    thermostat->type_id         = EMS_ID_NONE;
+    thermostat->model_id        = EMS_MODEL_NONE;
+    thermostat->product_id      = EMS_ID_NONE;
+    thermostat->read_supported  = false;
+    thermostat->write_supported = false;
+    thermostat->hc              = 1;
+    strlcpy(thermostat->version, "?", sizeof(thermostat->version));
+
+    for (uint8_t i = 0; i < EMS_THERMOSTAT_MAXHC; i++) {
+        _EMS_Thermostat_HC * circuit = &thermostat->circuit[i];
+        circuit->active              = false;
+        circuit->setpoint_roomTemp   = EMS_VALUE_SHORT_NOTSET;
+        circuit->curr_roomTemp       = EMS_VALUE_SHORT_NOTSET;
+        circuit->mode                = 255; // dummy value
+        circuit->day_mode            = 255; // dummy value
+        circuit->daytemp             = EMS_VALUE_INT_NOTSET; // 0x47 byte
+        circuit->nighttemp           = EMS_VALUE_INT_NOTSET; // 0x47 byte
+        circuit->holidaytemp         = EMS_VALUE_INT_NOTSET; // 0x47 byte
+        circuit->heatingtype         = EMS_VALUE_INT_NOTSET; // 0x47 byte floor heating = 3
+        circuit->circuitcalctemp     = EMS_VALUE_INT_NOTSET; // 0x48 byte 14
+    }
+}
+
 // init stats and counters and buffers
 // uses -255 or 255 for values that haven't been set yet (EMS_VALUE_INT_NOTSET and EMS_VALUE_FLOAT_NOTSET)
 void ems_init() {
@@ -187,6 +316,7 @@ void ems_init() {
     EMS_Sys_Status.emsRxPgks        = 0;
     EMS_Sys_Status.emsTxPkgs        = 0;
     EMS_Sys_Status.emxCrcErr        = 0;
+    EMS_Sys_Status.emsTxCollisions  = 0;
     EMS_Sys_Status.emsRxStatus      = EMS_RX_STATUS_IDLE;
     EMS_Sys_Status.emsTxStatus      = EMS_TX_STATUS_IDLE;
     EMS_Sys_Status.emsRefreshed     = false;
@@ -196,28 +326,48 @@ void ems_init() {
     EMS_Sys_Status.emsTxCapable     = false;
     EMS_Sys_Status.emsTxDisabled    = false;
     EMS_Sys_Status.emsPollFrequency = 0;
-    EMS_Sys_Status.txRetryCount     = 0;
+    EMS_Sys_Status.emsStale         = 0;
+
+    EMS_TxEcho.pending = false;
+    EMS_TxEcho.length  = 0;
+
+    memset(EMS_TxValidateBatches, 0, sizeof(EMS_TxValidateBatches));
+    EMS_TxValidateOpen = EMS_TX_VALIDATE_NONE;
+
+    EMS_TxDeviceStats_count = 0;
+
+    memset(&EMS_Discovery, 0, sizeof(_EMS_Discovery));
+    EMS_DeviceCache_count = 0;
+
+    _ems_buildTypeIndex();
+
+    memset(&EMS_Sniffer, 0, sizeof(_EMS_Sniffer));
+    ems_clearLogFilter();
+    ems_clearSniffer();
+
+    memset(EMS_RawPending, 0, sizeof(EMS_RawPending));
+
+    EMS_TxTag      = 0;
+    EMS_TxTagCount = 0;
+    EMS_TxResults.clear();
+
+    memset(&EMS_BusStats, 0, sizeof(_EMS_BusStats));
+    EMS_BusStats.started   = millis();
+    EMS_BusStats.slotStart = EMS_BusStats.started;
+
+    memset(&EMS_BurnerStats, 0, sizeof(_EMS_BurnerStats));
+    EMS_BurnerStats.intervalStart = EMS_BusStats.started;
+    EMS_BurnerStats.startsFirst   = EMS_VALUE_LONG_NOTSET;
+    EMS_BurnerStats.startsLast    = EMS_VALUE_LONG_NOTSET;
+
+    memset(EMS_History, 0, sizeof(EMS_History));
+    for (uint8_t i = 0; i < EMS_HISTORY_TIERS; i++) {
+        EMS_History[i].bucketTime  = EMS_HistoryBucketTime[i];
+        EMS_History[i].bucketStart = EMS_BusStats.started;
+    }
 
     // thermostat
-    EMS_Thermostat.setpoint_roomTemp = EMS_VALUE_SHORT_NOTSET;
-    EMS_Thermostat.curr_roomTemp     = EMS_VALUE_SHORT_NOTSET;
-    EMS_Thermostat.hour              = 0;
-    EMS_Thermostat.minute            = 0;
-    EMS_Thermostat.second            = 0;
-    EMS_Thermostat.day               = 0;
-    EMS_Thermostat.month             = 0;
-    EMS_Thermostat.year              = 0;
-    EMS_Thermostat.mode              = 255; // dummy value
-    EMS_Thermostat.day_mode          = 255; // dummy value
-    EMS_Thermostat.type_id           = EMS_ID_NONE;
-    EMS_Thermostat.read_supported    = false;
-    EMS_Thermostat.write_supported   = false;
-    EMS_Thermostat.hc                = 1; 
-    EMS_Thermostat.daytemp           = EMS_VALUE_INT_NOTSET; // 0x47 byte
-    EMS_Thermostat.nighttemp         = EMS_VALUE_INT_NOTSET; // 0x47 byte
-    EMS_Thermostat.holidaytemp       = EMS_VALUE_INT_NOTSET; // 0x47 byte
-    EMS_Thermostat.heatingtype       = EMS_VALUE_INT_NOTSET; // 0x47 byte floor heating = 3
-    EMS_Thermostat.circuitcalctemp   = EMS_VALUE_INT_NOTSET; // 0x48 byte 14
+    _ems_initThermostat(&EMS_Thermostat);
     //lobocobra start
     EMS_Thermostat.ausschalthysterese   = EMS_VALUE_INT_NOTSET; // positive value heating off when above x°
     EMS_Thermostat.einschalthysterese   = 196; // negative value heating on when below x° 
@@ -307,14 +457,20 @@ void ems_init() {
     EMS_Boiler.product_id = EMS_ID_NONE;
     strlcpy(EMS_Boiler.version, "?", sizeof(EMS_Boiler.version));
 
-    // set thermostat model
-    EMS_Thermostat.model_id   = EMS_MODEL_NONE;
-    EMS_Thermostat.product_id = EMS_ID_NONE;
-    strlcpy(EMS_Thermostat.version, "?", sizeof(EMS_Thermostat.version));
-
     // set other types
     EMS_Other.SM10 = false;
 
+    // MM10 Mixer Module values
+    EMS_Mixer.MM10        = false;
+    EMS_Mixer.flowSetTemp = EMS_VALUE_INT_NOTSET;
+    EMS_Mixer.flowTemp    = EMS_VALUE_SHORT_NOTSET;
+    EMS_Mixer.pumpMod     = EMS_VALUE_INT_NOTSET;
+    EMS_Mixer.valveStatus = EMS_VALUE_INT_NOTSET;
+
+    // forget the devices, they are added again as they are identified
+    EMS_Devices_count        = 0;
+    EMS_ThermostatPool_count = 0;
+
     // default logging is none
     ems_setLogging(EMS_SYS_LOGGING_DEFAULT);
 }
@@ -338,7 +494,31 @@ void ems_setEmsRefreshed(bool b) {
 }
 
 void ems_setThermostatHC(uint8_t hc) {
-    EMS_Thermostat.hc = hc;
+    if ((hc >= 1) && (hc <= EMS_THERMOSTAT_MAXHC)) {
+        EMS_Thermostat.hc = hc;
+    }
+}
+
+/**
+ * the values of a heating circuit (1-4), or of the selected one if hc is 0
+ */
+_EMS_Thermostat_HC * ems_getThermostatCircuit(uint8_t hc) {
+    if ((hc < 1) || (hc > EMS_THERMOSTAT_MAXHC)) {
+        hc = EMS_Thermostat.hc;
+    }
+    return &EMS_Thermostat.circuit[hc - 1];
+}
+
+/**
+ * the heating circuit (1-4) an RC35 telegram type belongs to
+ */
+uint8_t _getRC35Circuit(uint8_t type) {
+    for (uint8_t i = 0; i < EMS_THERMOSTAT_MAXHC; i++) {
+        if ((EMS_RC35Set_HC[i] == type) || (EMS_RC35StatusMessage_HC[i] == type)) {
+            return i + 1;
+        }
+    }
+    return 1;
 }
 
 bool ems_getBoilerEnabled() {
@@ -424,1128 +604,3265 @@ char * _hextoa(uint8_t value, char * buffer) {
     return buffer;
 }
 
-// for decimals 0 to 99, printed as a string
-char * _smallitoa(uint8_t value, char * buffer) {
-    buffer[0] = ((value / 10) == 0) ? '0' : (value / 10) + '0';
-    buffer[1] = (value % 10) + '0';
-    buffer[2] = '\0';
-    return buffer;
+/**
+ * sorts the positions of EMS_Types on type so a type can be found with a binary search
+ * entries with the same type stay in the order of EMS_Types
+ */
+void _ems_buildTypeIndex() {
+    for (uint8_t i = 0; i < _EMS_Types_max; i++) {
+        uint8_t j = i;
+        while ((j > 0) && (EMS_Types[EMS_TypeIndex[j - 1]].type > EMS_Types[i].type)) {
+            EMS_TypeIndex[j] = EMS_TypeIndex[j - 1];
+            j--;
+        }
+        EMS_TypeIndex[j] = i;
+    }
 }
 
-/* for decimals 0 to 999, printed as a string
- * From @nomis
+/**
+ * position in EMS_TypeIndex of the first entry for a type
+ * or _EMS_Types_max if there is none
  */
-char * _smallitoa3(uint16_t value, char * buffer) {
-    buffer[0] = ((value / 100) == 0) ? '0' : (value / 100) + '0';
-    buffer[1] = (((value % 100) / 10) == 0) ? '0' : ((value % 100) / 10) + '0';
-    buffer[2] = (value % 10) + '0';
-    buffer[3] = '\0';
-    return buffer;
+uint8_t _ems_findTypeIndex(uint16_t type) {
+    uint8_t low  = 0;
+    uint8_t high = _EMS_Types_max;
+
+    while (low < high) {
+        uint8_t mid = (low + high) / 2;
+        if (EMS_Types[EMS_TypeIndex[mid]].type < type) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return ((low < _EMS_Types_max) && (EMS_Types[EMS_TypeIndex[low]].type == type)) ? low : _EMS_Types_max;
 }
 
 /**
  * Find the pointer to the EMS_Types array for a given type ID
  * or -1 if not found
  */
-int _ems_findType(uint8_t type) {
-    uint8_t i         = 0;
-    bool    typeFound = false;
-    // scan through known ID types
-    while (i < _EMS_Types_max) {
-        if (EMS_Types[i].type == type) {
-            typeFound = true; // we have a match
-            break;
-        }
-        i++;
+int _ems_findType(uint16_t type) {
+    uint8_t pos = _ems_findTypeIndex(type);
+    return (pos < _EMS_Types_max) ? EMS_TypeIndex[pos] : -1;
+}
+
+/**
+ * the class of device the telegram types of a model in EMS_Types are for
+ */
+_EMS_DEVICE_CLASS _ems_modelClass(uint8_t model_id) {
+    if (model_id == EMS_MODEL_UBA) {
+        return EMS_DEVICE_CLASS_BOILER;
     }
+    if (model_id == EMS_MODEL_OTHER) {
+        return EMS_DEVICE_CLASS_OTHER;
+    }
+    if ((model_id == EMS_MODEL_NONE) || (model_id == EMS_MODEL_ALL)) {
+        return EMS_DEVICE_CLASS_NONE;
+    }
+    return EMS_DEVICE_CLASS_THERMOSTAT;
+}
 
-    return (typeFound ? i : -1);
+/**
+ * find a device in the registry by its bus ID
+ * returns NULL if it's not there
+ */
+_EMS_Device * ems_getDevice(uint8_t device_id) {
+    device_id &= 0x7F;
+    for (uint8_t i = 0; i < EMS_Devices_count; i++) {
+        if (EMS_Devices[i].device_id == device_id) {
+            return &EMS_Devices[i];
+        }
+    }
+    return NULL;
 }
 
 /**
- * debug print a telegram to telnet/serial including the CRC
- * len is length in bytes including the CRC
+ * where the decoded values of a new device go
+ * the boiler, thermostat, SM10 and MM10 use their global structs, further thermostats get one from the pool
+ * returns NULL if there is nowhere to put them, the device is then only tracked
  */
-void _debugPrintTelegram(const char * prefix, _EMS_RxTelegram * EMS_RxTelegram, const char * color) {
-    if (EMS_Sys_Status.emsLogging <= EMS_SYS_LOGGING_BASIC)
-        return;
+void * _ems_deviceState(uint8_t device_id, _EMS_DEVICE_CLASS device_class) {
+    if (device_class == EMS_DEVICE_CLASS_BOILER) {
+        return (device_id == EMS_Boiler.type_id) ? &EMS_Boiler : NULL;
+    }
 
-    char      output_str[200] = {0};
-    char      buffer[16]      = {0};
-    uint8_t   len             = EMS_RxTelegram->length;
-    uint8_t * data            = EMS_RxTelegram->telegram;
-
-    strlcpy(output_str, "(", sizeof(output_str));
-    strlcat(output_str, COLOR_CYAN, sizeof(output_str));
-    strlcat(output_str, _smallitoa((uint8_t)((EMS_RxTelegram->timestamp / 3600000) % 24), buffer), sizeof(output_str));
-    strlcat(output_str, ":", sizeof(output_str));
-    strlcat(output_str, _smallitoa((uint8_t)((EMS_RxTelegram->timestamp / 60000) % 60), buffer), sizeof(output_str));
-    strlcat(output_str, ":", sizeof(output_str));
-    strlcat(output_str, _smallitoa((uint8_t)((EMS_RxTelegram->timestamp / 1000) % 60), buffer), sizeof(output_str));
-    strlcat(output_str, ".", sizeof(output_str));
-    strlcat(output_str, _smallitoa3(EMS_RxTelegram->timestamp % 1000, buffer), sizeof(output_str));
-    strlcat(output_str, COLOR_RESET, sizeof(output_str));
-    strlcat(output_str, ") ", sizeof(output_str));
-
-    strlcat(output_str, color, sizeof(output_str));
-    strlcat(output_str, prefix, sizeof(output_str));
-    strlcat(output_str, " telegram: ", sizeof(output_str));
+    if (device_class == EMS_DEVICE_CLASS_THERMOSTAT) {
+        if (device_id == EMS_Thermostat.type_id) {
+            return &EMS_Thermostat;
+        }
+        if (EMS_ThermostatPool_count >= (EMS_THERMOSTATS_MAX - 1)) {
+            return NULL;
+        }
+        _EMS_Thermostat * thermostat = &EMS_ThermostatPool[EMS_ThermostatPool_count++];
+        _ems_initThermostat(thermostat);
+        thermostat->type_id = device_id;
+        return thermostat;
+    }
 
-    for (int i = 0; i < len - 1; i++) {
-        strlcat(output_str, _hextoa(data[i], buffer), sizeof(output_str));
-        strlcat(output_str, " ", sizeof(output_str)); // add space
+    if (device_class == EMS_DEVICE_CLASS_OTHER) {
+        if (device_id == EMS_ID_SM10) {
+            return &EMS_Other;
+        }
+        if (device_id == EMS_ID_MM10) {
+            return &EMS_Mixer;
+        }
     }
 
-    strlcat(output_str, "(CRC=", sizeof(output_str));
-    strlcat(output_str, _hextoa(data[len - 1], buffer), sizeof(output_str));
-    strlcat(output_str, ")", sizeof(output_str));
+    return NULL;
+}
 
-    // print number of data bytes only if its a valid telegram
-    if (len > 5) {
-        strlcat(output_str, ", #data=", sizeof(output_str));
-        strlcat(output_str, itoa(len - 5, buffer, 10), sizeof(output_str));
+/**
+ * add a device to the registry, or update its model, product id and version if it's already there
+ * version can be NULL if it's not known yet
+ * returns NULL if there is no room left
+ */
+_EMS_Device * _ems_addDevice(uint8_t device_id, _EMS_DEVICE_CLASS device_class, uint8_t model_id, uint8_t product_id, const char * version) {
+    _EMS_Device * device = ems_getDevice(device_id);
+
+    if (device == NULL) {
+        if (EMS_Devices_count >= EMS_DEVICES_MAX) {
+            return NULL;
+        }
+        device = &EMS_Devices[EMS_Devices_count++];
+        memset(device, 0, sizeof(_EMS_Device));
+        device->device_id       = device_id & 0x7F;
+        device->device_class    = EMS_DEVICE_CLASS_NONE;
+        device->read_supported  = true;
+        device->write_supported = (device_class == EMS_DEVICE_CLASS_BOILER);
+        strlcpy(device->version, "?", sizeof(device->version));
+    }
+
+    // new, turned out to be something else than we thought, or only tracked so far
+    if ((device->device_class != device_class) || (device->state == NULL)) {
+        device->device_class = device_class;
+        device->state        = _ems_deviceState(device->device_id, device_class);
     }
 
-    strlcat(output_str, COLOR_RESET, sizeof(output_str));
+    device->model_id   = model_id;
+    device->product_id = product_id;
+    if (version != NULL) {
+        strlcpy(device->version, version, sizeof(device->version));
+    }
 
-    myDebug(output_str);
+    return device;
 }
 
 /**
- * send the contents of the Tx buffer to the UART
- * we take telegram from the queue and send it, but don't remove it until later when its confirmed successful
+ * the registry entry of the device that sent a telegram
+ * the boiler, thermostat and SM10 from the settings are added the first time they talk,
+ * so their telegrams are decoded before they have been identified
+ * returns NULL for devices we don't know
  */
-void _ems_sendTelegram() {
-    // check if we have something in the queue to send
-    if (EMS_TxQueue.isEmpty()) {
-        return;
+_EMS_Device * _ems_findSender(uint8_t src) {
+    _EMS_Device * device = ems_getDevice(src);
+    if (device != NULL) {
+        return device;
     }
 
-    // get the first in the queue, which is at the head
-    // we don't remove from the queue yet
-    _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.first();
-
-    // if there is no destination, also delete it from the queue
-    if (EMS_TxTelegram.dest == EMS_ID_NONE) {
-        EMS_TxQueue.shift(); // remove from queue
-        return;
+    if (src == EMS_Boiler.type_id) {
+        return _ems_addDevice(src, EMS_DEVICE_CLASS_BOILER, EMS_MODEL_UBA, EMS_Boiler.product_id, NULL);
     }
 
+    if (src == EMS_Thermostat.type_id) {
+        device = _ems_addDevice(src, EMS_DEVICE_CLASS_THERMOSTAT, EMS_Thermostat.model_id, EMS_Thermostat.product_id, NULL);
+        if (device != NULL) {
+            device->read_supported  = EMS_Thermostat.read_supported;
+            device->write_supported = EMS_Thermostat.write_supported;
+        }
+        return device;
+    }
 
-    // if we're in raw mode just fire and forget
-    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_RAW) {
-        EMS_TxTelegram.data[EMS_TxTelegram.length - 1] = _crcCalculator(EMS_TxTelegram.data, EMS_TxTelegram.length); // add the CRC
-        _EMS_RxTelegram EMS_RxTelegram;
-        EMS_RxTelegram.length    = EMS_TxTelegram.length;
-        EMS_RxTelegram.telegram  = EMS_TxTelegram.data;
-        EMS_RxTelegram.timestamp = millis();                             // now
-        _debugPrintTelegram("Sending raw", &EMS_RxTelegram, COLOR_CYAN); // always show
-        emsuart_tx_buffer(EMS_TxTelegram.data, EMS_TxTelegram.length);   // send the telegram to the UART Tx
-        EMS_TxQueue.shift();                                             // remove from queue
-        return;
+    if (src == EMS_ID_SM10) {
+        return _ems_addDevice(src, EMS_DEVICE_CLASS_OTHER, EMS_MODEL_OTHER, EMS_ID_NONE, NULL);
     }
 
-    // create header
-    EMS_TxTelegram.data[0] = EMS_ID_ME; // src
-    // dest
-    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_WRITE) {
-        EMS_TxTelegram.data[1] = EMS_TxTelegram.dest;
-    } else {
-        // for a READ or VALIDATE
-        EMS_TxTelegram.data[1] = EMS_TxTelegram.dest | 0x80; // read has 8th bit set
+    return NULL;
+}
+
+/**
+ * find the EMS_Types entry for a telegram type sent by a device, or -1 if we don't handle it
+ * an entry for the device's own model comes first, then one for any model of the same class
+ * (e.g. a thermostat that hasn't been identified yet) and then the common ones like Version
+ * device can be NULL, then only the common types are found
+ */
+int _ems_findDeviceType(_EMS_Device * device, uint16_t type) {
+    int found_class = -1;
+    int found_all   = -1;
+
+    // all the entries for the type are next to each other in the index
+    for (uint8_t pos = _ems_findTypeIndex(type); (pos < _EMS_Types_max) && (EMS_Types[EMS_TypeIndex[pos]].type == type); pos++) {
+        uint8_t i = EMS_TypeIndex[pos];
+
+        if (EMS_Types[i].model_id == EMS_MODEL_ALL) {
+            if (found_all == -1) {
+                found_all = i;
+            }
+            continue;
+        }
+
+        if (device == NULL) {
+            continue;
+        }
+
+        if (EMS_Types[i].model_id == device->model_id) {
+            return i; // exact match
+        }
+
+        if ((found_class == -1) && (_ems_modelClass(EMS_Types[i].model_id) == device->device_class)) {
+            found_class = i;
+        }
     }
-    EMS_TxTelegram.data[2] = EMS_TxTelegram.type;   // type
-    EMS_TxTelegram.data[3] = EMS_TxTelegram.offset; // offset
 
-    // see if it has data, add the single data value byte
-    // otherwise leave it alone and assume the data has been pre-populated
-    if (EMS_TxTelegram.length == EMS_MIN_TELEGRAM_LENGTH) {
-        // for reading this is #bytes we want to read (the size)
-        // for writing its the value we want to write
-        EMS_TxTelegram.data[4] = EMS_TxTelegram.dataValue;
+    return (found_class != -1) ? found_class : found_all;
+}
+
+/**
+ * remember the last telegram of each type a device sent, replacing the oldest type when full
+ */
+void _ems_updateShadow(_EMS_Device * device, uint16_t type, uint8_t offset, _EMS_RxTelegram * EMS_RxTelegram) {
+    _EMS_DeviceShadow * shadow = NULL;
+
+    for (uint8_t i = 0; i < device->shadow_count; i++) {
+        if (device->shadow[i].type == type) {
+            shadow = &device->shadow[i];
+            break;
+        }
     }
-    // finally calculate CRC and add it to the end
-    uint8_t crc                                    = _crcCalculator(EMS_TxTelegram.data, EMS_TxTelegram.length);
-    EMS_TxTelegram.data[EMS_TxTelegram.length - 1] = crc;
 
-    // print debug info
-    if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE) {
-        char s[64] = {0};
-        if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_WRITE) {
-            snprintf(s, sizeof(s), "Sending write of type 0x%02X to 0x%02X:", EMS_TxTelegram.type, EMS_TxTelegram.dest & 0x7F);
-        } else if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_READ) {
-            snprintf(s, sizeof(s), "Sending read of type 0x%02X to 0x%02X:", EMS_TxTelegram.type, EMS_TxTelegram.dest & 0x7F);
-        } else if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_VALIDATE) {
-            snprintf(s, sizeof(s), "Sending validate of type 0x%02X to 0x%02X:", EMS_TxTelegram.type, EMS_TxTelegram.dest & 0x7F);
+    if (shadow == NULL) {
+        if (device->shadow_count < EMS_DEVICE_SHADOW_MAX) {
+            shadow = &device->shadow[device->shadow_count++];
+        } else {
+            shadow = &device->shadow[0];
+            for (uint8_t i = 1; i < EMS_DEVICE_SHADOW_MAX; i++) {
+                if (device->shadow[i].timestamp < shadow->timestamp) {
+                    shadow = &device->shadow[i];
+                }
+            }
         }
+        shadow->type  = type;
+        shadow->count = 0;
+    }
 
-        _EMS_RxTelegram EMS_RxTelegram;
-        EMS_RxTelegram.length    = EMS_TxTelegram.length;
-        EMS_RxTelegram.telegram  = EMS_TxTelegram.data;
-        EMS_RxTelegram.timestamp = millis(); // now
-        _debugPrintTelegram(s, &EMS_RxTelegram, COLOR_CYAN);
+    shadow->offset    = offset;
+    shadow->length    = EMS_RxTelegram->data_length;
+    shadow->crc       = EMS_RxTelegram->data_crc;
+    shadow->timestamp = EMS_RxTelegram->timestamp;
+    shadow->count++;
+}
+
+/**
+ * where the values of the device that sent a telegram go
+ * returns NULL if the sender isn't registered as that class of device, or is only tracked
+ */
+void * _ems_getState(uint8_t src, _EMS_DEVICE_CLASS device_class) {
+    _EMS_Device * device = ems_getDevice(src);
+    if ((device != NULL) && (device->device_class == device_class)) {
+        return device->state;
     }
+    return NULL;
+}
+
+/**
+ * the values of the thermostat that sent a telegram
+ * EMS_Thermostat, or one of the extra thermostats in the registry. NULL if it has nowhere to put them
+ */
+_EMS_Thermostat * _ems_getThermostat(uint8_t src) {
+    return (_EMS_Thermostat *)_ems_getState(src, EMS_DEVICE_CLASS_THERMOSTAT);
+}
 
-    // send the telegram to the UART Tx
-    emsuart_tx_buffer(EMS_TxTelegram.data, EMS_TxTelegram.length);
+// EMS_Boiler if the sender is our boiler, else NULL
+_EMS_Boiler * _ems_getBoiler(uint8_t src) {
+    return (_EMS_Boiler *)_ems_getState(src, EMS_DEVICE_CLASS_BOILER);
+}
 
-    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_WAIT;
+// EMS_Other if the sender is the SM10, else NULL
+_EMS_Other * _ems_getOther(uint8_t src) {
+    return (_ems_getState(src, EMS_DEVICE_CLASS_OTHER) == &EMS_Other) ? &EMS_Other : NULL;
 }
 
+// EMS_Mixer if the sender is the MM10, else NULL
+_EMS_Mixer * _ems_getMixer(uint8_t src) {
+    return (_ems_getState(src, EMS_DEVICE_CLASS_OTHER) == &EMS_Mixer) ? &EMS_Mixer : NULL;
+}
 
 /**
- * Takes the last write command and turns into a validate request
- * placing it on the queue
+ * the start of a telegram log line, the time it was received and the color of the line
  */
-void _createValidate() {
-    if (EMS_TxQueue.isEmpty()) {
-        return;
+void _printTelegramStart(_EMS_PrintCursor * c, uint32_t timestamp, const char * color) {
+    _printChar(c, '(');
+    _printStr(c, COLOR_CYAN);
+    _printDec(c, (timestamp / 3600000) % 24, 2);
+    _printChar(c, ':');
+    _printDec(c, (timestamp / 60000) % 60, 2);
+    _printChar(c, ':');
+    _printDec(c, (timestamp / 1000) % 60, 2);
+    _printChar(c, '.');
+    _printDec(c, timestamp % 1000, 3);
+    _printStr(c, COLOR_RESET);
+    _printStr(c, ") ");
+    _printStr(c, color);
+}
+
+/**
+ * the end of a telegram log line, the bytes in hex including the CRC
+ */
+void _printTelegramData(_EMS_PrintCursor * c, _EMS_RxTelegram * EMS_RxTelegram) {
+    uint8_t   len  = EMS_RxTelegram->length;
+    uint8_t * data = EMS_RxTelegram->telegram;
+
+    _printStr(c, " telegram: ");
+    for (int i = 0; i < len - 1; i++) {
+        _printHex(c, data[i]);
+        _printChar(c, ' ');
     }
 
-    // release the Tx lock
-    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+    _printStr(c, "(CRC=");
+    _printHex(c, data[len - 1]);
+    _printChar(c, ')');
 
-    // get the first in the queue, which is at the head
-    _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.first();
+    // print number of data bytes only if its a valid telegram
+    if (len > 5) {
+        _printStr(c, ", #data=");
+        _printDec(c, len - 5);
+    }
 
-    // safety check: only do a validate after a write and when we have a type to validate
-    if ((EMS_TxTelegram.action != EMS_TX_TELEGRAM_WRITE) || (EMS_TxTelegram.type_validate == EMS_ID_NONE)) {
-        EMS_TxQueue.shift(); // remove from queue
+    _printStr(c, COLOR_RESET);
+}
+
+/**
+ * debug print a telegram to telnet/serial including the CRC
+ * len is length in bytes including the CRC
+ */
+void _debugPrintTelegram(const char * prefix, _EMS_RxTelegram * EMS_RxTelegram, const char * color) {
+    if (EMS_Sys_Status.emsLogging <= EMS_SYS_LOGGING_BASIC)
         return;
-    }
 
-    // create a new Telegram copying from the last write
-    _EMS_TxTelegram new_EMS_TxTelegram;
-    new_EMS_TxTelegram.action = EMS_TX_TELEGRAM_VALIDATE;
+    char             output_str[200];
+    _EMS_PrintCursor c;
 
-    // copy old Write record
-    new_EMS_TxTelegram.type_validate      = EMS_TxTelegram.type_validate;
-    new_EMS_TxTelegram.dest               = EMS_TxTelegram.dest;
-    new_EMS_TxTelegram.type               = EMS_TxTelegram.type;
-    new_EMS_TxTelegram.comparisonValue    = EMS_TxTelegram.comparisonValue;
-    new_EMS_TxTelegram.comparisonPostRead = EMS_TxTelegram.comparisonPostRead;
-    new_EMS_TxTelegram.comparisonOffset   = EMS_TxTelegram.comparisonOffset;
+    _printBegin(&c, output_str, sizeof(output_str));
+    _printTelegramStart(&c, EMS_RxTelegram->timestamp, color);
+    _printStr(&c, prefix);
+    _printTelegramData(&c, EMS_RxTelegram);
 
-    // this is what is different
-    new_EMS_TxTelegram.offset    = EMS_TxTelegram.comparisonOffset; // location of byte to fetch
-    new_EMS_TxTelegram.dataValue = 1;                               // fetch single byte
-    new_EMS_TxTelegram.length    = EMS_MIN_TELEGRAM_LENGTH;         // is always 6 bytes long (including CRC at end)
+    myESP.myDebugLine(output_str);
+}
 
-    // remove old telegram from queue and add this new read one
-    EMS_TxQueue.shift();                     // remove from queue
-    EMS_TxQueue.unshift(new_EMS_TxTelegram); // add back to queue making it first to be picked up next (FIFO)
+/**
+ * queue a Version read for the next device that is on the bus but not yet identified
+ * only one at a time, so discovery doesn't get in the way of other traffic
+ */
+void _discoveryNext() {
+    if (EMS_Sys_Status.emsTxDisabled) {
+        return;
+    }
+
+    // the last one got no answer, give the bus some time
+    if ((EMS_Discovery.holdUntil != 0) && ((int32_t)(millis() - EMS_Discovery.holdUntil) < 0)) {
+        return;
+    }
+    EMS_Discovery.holdUntil = 0;
+
+    for (uint8_t id = 1; id < 0x80; id++) {
+        if ((id == EMS_ID_ME) || !(_bitmapRead(EMS_Discovery.present, id) || _bitmapRead(EMS_Discovery.probe, id))
+            || _bitmapRead(EMS_Discovery.identified, id) || _bitmapRead(EMS_Discovery.requested, id)) {
+            continue;
+        }
+
+        if (ems_doReadCommand(EMS_TYPE_Version, id)) {
+            _bitmapSet(EMS_Discovery.requested, id); // only ask once, unless it gets lost
+            _bitmapClear(EMS_Discovery.probe, id);   // asked again only once it's heard on the bus
+        }
+        return;
+    }
 }
 
-/*
- * Entry point triggered by an interrupt in emsuart.cpp
- * length is only data bytes, excluding the BRK
- * Read commands are asynchronous as they're handled by the interrupt
- * When a telegram is processed we forcefully erase it from the stack to prevent overflow
+/**
+ * a Version read got no answer, so ask again later
+ * a probed ID that was never heard on the bus probably isn't there, so it's not asked again and the next probe goes straight on
  */
-void ems_parseTelegram(uint8_t * telegram, uint8_t length) {
-    if ((length != 0) && (telegram[0] != 0x00)) {
-        _ems_readTelegram(telegram, length);
+void _discoveryLost(uint8_t id) {
+    if (_bitmapRead(EMS_Discovery.identified, id)) {
+        return;
     }
 
-    // clear the Rx buffer just be safe and prevent duplicates
-    memset(telegram, 0, EMS_MAXBUFFERSIZE);
+    _bitmapClear(EMS_Discovery.requested, id);
+    if (_bitmapRead(EMS_Discovery.present, id)) {
+        EMS_Discovery.holdUntil = millis() + EMS_DISCOVERY_RETRY_TIME;
+    }
 }
 
 /**
- * the main logic that parses the telegram message
- * When we receive a Poll Request we need to send any Tx packages quickly within a 200ms window
+ * add a device to the cache of identified devices
+ * returns true if it wasn't there before
  */
-void _ems_readTelegram(uint8_t * telegram, uint8_t length) {
-    // create the Rx package
-    static _EMS_RxTelegram EMS_RxTelegram;
-    static uint32_t        _last_emsPollFrequency = 0;
-    EMS_RxTelegram.length                         = length;
-    EMS_RxTelegram.telegram                       = telegram;
-    EMS_RxTelegram.timestamp                      = millis();
+bool _addDeviceCache(uint8_t type_id, uint8_t product_id, const char * version) {
+    for (uint8_t i = 0; i < EMS_DeviceCache_count; i++) {
+        if (EMS_DeviceCache[i].type_id == type_id) {
+            if ((EMS_DeviceCache[i].product_id == product_id) && (strcmp(EMS_DeviceCache[i].version, version) == 0)) {
+                return false; // nothing new
+            }
+            EMS_DeviceCache[i].product_id = product_id;
+            strlcpy(EMS_DeviceCache[i].version, version, sizeof(EMS_DeviceCache[i].version));
+            return true;
+        }
+    }
 
-    // check if we just received a single byte
-    // it could well be a Poll request from the boiler for us, which will have a value of 0x8B (0x0B | 0x80)
-    // or either a return code like 0x01 or 0x04 from the last Write command
-    if (length == 1) {
-        uint8_t value = telegram[0]; // 1st byte of data package
+    if (EMS_DeviceCache_count >= EMS_DISCOVERY_CACHE_MAX) {
+        return false; // no room
+    }
 
-        EMS_Sys_Status.emsPollFrequency = (EMS_RxTelegram.timestamp - _last_emsPollFrequency);
-        _last_emsPollFrequency          = EMS_RxTelegram.timestamp;
+    EMS_DeviceCache[EMS_DeviceCache_count].type_id    = type_id;
+    EMS_DeviceCache[EMS_DeviceCache_count].product_id = product_id;
+    strlcpy(EMS_DeviceCache[EMS_DeviceCache_count].version, version, sizeof(EMS_DeviceCache[EMS_DeviceCache_count].version));
+    EMS_DeviceCache_count++;
 
-        // check first for a Poll for us
-        if (value == (EMS_ID_ME | 0x80)) {
-            EMS_Sys_Status.emsTxCapable = true;
+    return true;
+}
 
-            // do we have something to send thats waiting in the Tx queue?
-            // if so send it if the Queue is not in a wait state
-            if ((!EMS_TxQueue.isEmpty()) && (EMS_Sys_Status.emsTxStatus == EMS_TX_STATUS_IDLE)) {
-                _ems_sendTelegram(); // perform the read/write command immediately
-            } else {
-                // nothing to send so just send a poll acknowledgement back
-                if (EMS_Sys_Status.emsPollEnabled) {
-                    emsaurt_tx_poll();
-                }
-            }
-        } else if (EMS_Sys_Status.emsTxStatus == EMS_TX_STATUS_WAIT) {
-            // this may be a single byte 01 (success) or 04 (error) from a recent write command?
-            if (value == EMS_TX_SUCCESS) {
-                EMS_Sys_Status.emsTxPkgs++;
-                // got a success 01. Send a validate to check the value of the last write
-                emsaurt_tx_poll(); // send a poll to free the EMS bus
-                _createValidate(); // create a validate Tx request (if needed)
-            } else if (value == EMS_TX_ERROR) {
-                // last write failed (04), delete it from queue and dont bother to retry
-                if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE) {
-                    myDebug("** Write command failed from host");
-                }
-                emsaurt_tx_poll(); // send a poll to free the EMS bus
-                _removeTxQueue();  // remove from queue
-            }
+/**
+ * the device cache as a string for storing in SPIFFS
+ * format is <type id in hex>:<product id>:<version> separated by commas, e.g. 08:123:01.03,10:86:01.12
+ */
+char * ems_getDeviceCache(char * buffer, size_t size) {
+    char entry[20] = {0};
+
+    buffer[0] = '\0';
+    for (uint8_t i = 0; i < EMS_DeviceCache_count; i++) {
+        snprintf(entry,
+                 sizeof(entry),
+                 "%s%02X:%d:%s",
+                 (i == 0) ? "" : ",",
+                 EMS_DeviceCache[i].type_id,
+                 EMS_DeviceCache[i].product_id,
+                 EMS_DeviceCache[i].version);
+        strlcat(buffer, entry, size);
+    }
+
+    return buffer;
+}
+
+/**
+ * load the device cache from the string stored in SPIFFS, see ems_getDeviceCache()
+ */
+void ems_setDeviceCache(const char * cache) {
+    EMS_DeviceCache_count = 0;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    char         version[10] = {0};
+    unsigned int type_id, product_id;
+    const char * p = cache;
+
+    while (*p) {
+        if (sscanf(p, "%x:%u:%9[^,]", &type_id, &product_id, version) == 3) {
+            (void)_addDeviceCache(type_id, product_id, version);
         }
 
-        return; // all done here
+        // next entry
+        p = strchr(p, ',');
+        if (p == NULL) {
+            break;
+        }
+        p++;
+    }
+}
+
+/**
+ * layout of the warm-start snapshot file, see ems_saveSnapshot()
+ */
+#define EMS_SNAPSHOT_DATA_SIZE (sizeof(_EMS_Boiler) + sizeof(_EMS_Thermostat) + sizeof(_EMS_Other))
+#define EMS_SNAPSHOT_FILE_SIZE (sizeof(_EMS_SnapshotHeader) + EMS_SNAPSHOT_DATA_SIZE)
+
+/**
+ * restore the last known boiler, thermostat and other values from SPIFFS so MQTT has something to publish
+ * straight after a reboot. The values are flagged as stale until the device sends them again.
+ * The type and product IDs, versions and thermostat capabilities are kept as they come from the config.
+ */
+void ems_loadSnapshot() {
+    uint8_t               buffer[EMS_SNAPSHOT_FILE_SIZE];
+    _EMS_SnapshotHeader * header = (_EMS_SnapshotHeader *)buffer;
+    uint8_t *             data   = buffer + sizeof(_EMS_SnapshotHeader);
+
+    if (myESP.fs_loadFile(EMS_SNAPSHOT_FILE, buffer, sizeof(buffer)) != sizeof(buffer)) {
+        return; // missing or from a different build
     }
 
-    // ignore anything that doesn't resemble a proper telegram package
-    // minimal is 5 bytes, excluding CRC at the end
-    if (length <= 4) {
-        //_debugPrintTelegram("Noisy data:", &EMS_RxTelegram COLOR_RED);
+    if ((header->magic != EMS_SNAPSHOT_MAGIC) || (header->version != EMS_SNAPSHOT_VERSION) || (header->size != EMS_SNAPSHOT_DATA_SIZE)) {
+        myDebug("Ignoring EMS snapshot, layout has changed");
         return;
     }
 
-    // Assume at this point we have something that vaguely resembles a telegram in the format [src] [dest] [type] [offset] [data] [crc]
-    // validate the CRC, if its bad ignore it
-    uint8_t crc = _crcCalculator(telegram, length);
-    if (telegram[length - 1] != crc) {
-        EMS_Sys_Status.emxCrcErr++;
-        if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE) {
-            _debugPrintTelegram("Corrupt telegram:", &EMS_RxTelegram, COLOR_RED);
-        }
+    if (CRC32::calculate(data, EMS_SNAPSHOT_DATA_SIZE) != header->crc) {
+        myDebug("Ignoring EMS snapshot, CRC error");
         return;
     }
 
-    // if we are in raw logging mode then just print out the telegram as it is
-    // but still continue to process it
-    if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_RAW) {
-        char raw[300]   = {0};
-        char buffer[16] = {0};
-        for (int i = 0; i < length; i++) {
-            strlcat(raw, _hextoa(telegram[i], buffer), sizeof(raw));
-            strlcat(raw, " ", sizeof(raw)); // add space
+    _EMS_Boiler     boiler;
+    _EMS_Thermostat thermostat;
+    memcpy(&boiler, data, sizeof(_EMS_Boiler));
+    data += sizeof(_EMS_Boiler);
+    memcpy(&thermostat, data, sizeof(_EMS_Thermostat));
+    data += sizeof(_EMS_Thermostat);
+
+    // keep the identity of the devices
+    boiler.type_id    = EMS_Boiler.type_id;
+    boiler.product_id = EMS_Boiler.product_id;
+    strlcpy(boiler.version, EMS_Boiler.version, sizeof(boiler.version));
+    EMS_Boiler = boiler;
+
+    thermostat.type_id         = EMS_Thermostat.type_id;
+    thermostat.model_id        = EMS_Thermostat.model_id;
+    thermostat.product_id      = EMS_Thermostat.product_id;
+    thermostat.read_supported  = EMS_Thermostat.read_supported;
+    thermostat.write_supported = EMS_Thermostat.write_supported;
+    thermostat.hc              = EMS_Thermostat.hc;
+    strlcpy(thermostat.version, EMS_Thermostat.version, sizeof(thermostat.version));
+    EMS_Thermostat = thermostat;
+
+    memcpy(&EMS_Other, data, sizeof(_EMS_Other));
+
+    EMS_SnapshotCRC       = header->crc;
+    EMS_SnapshotTimestamp = millis();
+
+    EMS_Sys_Status.emsStale     = EMS_STALE_ALL;
+    EMS_Sys_Status.emsRefreshed = true; // publish the restored values
+
+    myDebug("Restored last known EMS values from snapshot");
+}
+
+/**
+ * write the decoded boiler, thermostat and other values to SPIFFS
+ * only when something has changed and at most every EMS_SNAPSHOT_INTERVAL, unless forced
+ */
+void ems_saveSnapshot(bool force) {
+    if (!force && ((millis() - EMS_SnapshotTimestamp) < EMS_SNAPSHOT_INTERVAL)) {
+        return;
+    }
+    EMS_SnapshotTimestamp = millis();
+
+    // nothing new since the boot
+    if (EMS_Sys_Status.emsStale == EMS_STALE_ALL) {
+        return;
+    }
+
+    uint8_t               buffer[EMS_SNAPSHOT_FILE_SIZE];
+    _EMS_SnapshotHeader * header = (_EMS_SnapshotHeader *)buffer;
+    uint8_t *             data   = buffer + sizeof(_EMS_SnapshotHeader);
+
+    memcpy(data, &EMS_Boiler, sizeof(_EMS_Boiler));
+    memcpy(data + sizeof(_EMS_Boiler), &EMS_Thermostat, sizeof(_EMS_Thermostat));
+    memcpy(data + sizeof(_EMS_Boiler) + sizeof(_EMS_Thermostat), &EMS_Other, sizeof(_EMS_Other));
+
+    uint32_t crc = CRC32::calculate(data, EMS_SNAPSHOT_DATA_SIZE);
+    if (crc == EMS_SnapshotCRC) {
+        return; // unchanged, save a flash write
+    }
+
+    header->magic   = EMS_SNAPSHOT_MAGIC;
+    header->version = EMS_SNAPSHOT_VERSION;
+    header->size    = EMS_SNAPSHOT_DATA_SIZE;
+    header->crc     = crc;
+
+    if (myESP.fs_saveFile(EMS_SNAPSHOT_FILE, buffer, sizeof(buffer))) {
+        EMS_SnapshotCRC = crc;
+    }
+}
+
+/**
+ * find the Tx stats for a device, adding it if it's new
+ * returns NULL if there is no room left
+ */
+_EMS_TxDeviceStats * _getTxDeviceStats(uint8_t dest) {
+    dest &= 0x7F;
+    for (uint8_t i = 0; i < EMS_TxDeviceStats_count; i++) {
+        if (EMS_TxDeviceStats[i].dest == dest) {
+            return &EMS_TxDeviceStats[i];
         }
-        myDebug(raw);
     }
 
-    // here we know its a valid incoming telegram of at least 6 bytes
-    // we use this to see if we always have a connection to the boiler, in case of drop outs
-    EMS_Sys_Status.emsRxTimestamp  = EMS_RxTelegram.timestamp; // timestamp of last read
-    EMS_Sys_Status.emsBusConnected = true;
-//lobocobra info check incoming telegram
-    // now lets process it and see what to do next
+    if (EMS_TxDeviceStats_count >= EMS_TX_DEVICES_MAX) {
+        return NULL;
+    }
 
-    //lobocobra info here we have the lenght of the telegram.... if we need it longer... hack here if it is 20hex or 32
-    //    myDebug("<<<<<<<<<<<<<<<<<<<length: %d data %s",EMS_RxTelegram.length,EMS_RxTelegram.telegram);
-    //lobocobra end
-    _processType(&EMS_RxTelegram);
+    _EMS_TxDeviceStats * stats = &EMS_TxDeviceStats[EMS_TxDeviceStats_count++];
+    memset(stats, 0, sizeof(_EMS_TxDeviceStats));
+    stats->dest = dest;
+    return stats;
 }
 
-/*
- * print the telegram
+/**
+ * the device answered our last Tx. Update its response time and clear any backoff
  */
-void _printMessage(_EMS_RxTelegram * EMS_RxTelegram) {
-    uint8_t * telegram = EMS_RxTelegram->telegram;
+void _txDeviceResponse(uint8_t dest) {
+    _EMS_TxDeviceStats * stats = _getTxDeviceStats(dest);
+    if (stats == NULL) {
+        return;
+    }
 
-    // header info
-    uint8_t   src  = telegram[0] & 0x7F;
-    uint8_t   dest = telegram[1] & 0x7F; // remove 8th bit to handle both reads and writes
-    uint8_t   type;
-    bool      emsp;
-
-    // check if EMS or EMS+ by checking 3rd byte of telegram
-    if (telegram[2] >= 0xF0) {
-        // EMS+
-        type   = telegram[3];
-        emsp   = true;
+    uint32_t latency = millis() - EMS_TxSentTimestamp;
+    if (latency > 0xFFFF) {
+        latency = 0xFFFF;
+    }
+
+    // moving average over the last 8 or so responses
+    if (stats->success == 0) {
+        stats->latencyAvg = latency;
     } else {
-        type   = telegram[2];
-        emsp   = false;
+        stats->latencyAvg = ((stats->latencyAvg * 7) + latency) / 8;
+    }
+    if (latency > stats->latencyMax) {
+        stats->latencyMax = latency;
     }
 
-    char output_str[200] = {0};
-    char buffer[16]      = {0};
-    char color_s[20]     = {0};
+    stats->success++;
+    stats->failStreak   = 0;
+    stats->backoffUntil = 0;
+}
 
-    // source
-    if (src == EMS_Boiler.type_id) {
-        strlcpy(output_str, "Boiler", sizeof(output_str));
-    } else if (src == EMS_Thermostat.type_id) {
-        if (emsp)
-            strlcpy(output_str, "Thermostat+", sizeof(output_str));
-        else
-            strlcpy(output_str, "Thermostat", sizeof(output_str));
-    } else {
-        strlcpy(output_str, "0x", sizeof(output_str));
-        strlcat(output_str, _hextoa(src, buffer), sizeof(output_str));
+/**
+ * the device didn't answer our last Tx
+ * after a few failures in a row we back off, doubling the wait each time
+ */
+void _txDeviceFailed(uint8_t dest) {
+    _EMS_TxDeviceStats * stats = _getTxDeviceStats(dest);
+    if (stats == NULL) {
+        return;
     }
 
-    strlcat(output_str, " -> ", sizeof(output_str));
+    stats->failed++;
+    if (stats->failStreak < 0xFF) {
+        stats->failStreak++;
+    }
 
-    // destination
-    if (dest == EMS_ID_ME) {
-        if (emsp) {
-            strlcat(output_str, "me", sizeof(output_str));
-            strlcpy(color_s, COLOR_BRIGHT_YELLOW, sizeof(color_s));
-        } else {
-            strlcat(output_str, "me", sizeof(output_str));
-            strlcpy(color_s, COLOR_YELLOW, sizeof(color_s));
-        }
-    } else if (dest == EMS_ID_NONE) {
-        if (emsp) {
-            strlcat(output_str, "all", sizeof(output_str));
-            strlcpy(color_s, COLOR_BRIGHT_GREEN, sizeof(color_s));
-        } else {
-            strlcat(output_str, "all", sizeof(output_str));
-            strlcpy(color_s, COLOR_GREEN, sizeof(color_s));
-        }
-    } else if (dest == EMS_Boiler.type_id) {
-        if (emsp) {
-            strlcat(output_str, "Boiler+", sizeof(output_str));
-            strlcpy(color_s, COLOR_BRIGHT_MAGENTA, sizeof(color_s));
-        } else {
-            strlcat(output_str, "Boiler", sizeof(output_str));
-            strlcpy(color_s, COLOR_MAGENTA, sizeof(color_s));
+    if (stats->failStreak >= EMS_TX_BACKOFF_THRESHOLD) {
+        uint8_t  shift   = stats->failStreak - EMS_TX_BACKOFF_THRESHOLD;
+        uint32_t backoff = (shift >= 6) ? EMS_TX_BACKOFF_MAX : (EMS_TX_BACKOFF_BASE << shift);
+        if (backoff > EMS_TX_BACKOFF_MAX) {
+            backoff = EMS_TX_BACKOFF_MAX;
         }
-    } else if (dest == EMS_ID_SM10) {
-        strlcat(output_str, "SM10", sizeof(output_str));
-        strlcpy(color_s, COLOR_MAGENTA, sizeof(color_s));
-    } else if (dest == EMS_Thermostat.type_id) {
-        if (emsp) {
-            strlcat(output_str, "Thermostat+", sizeof(output_str));
-            strlcpy(color_s, COLOR_BRIGHT_MAGENTA, sizeof(color_s));
-        } else {
-            strlcat(output_str, "Thermostat", sizeof(output_str));
-            strlcpy(color_s, COLOR_MAGENTA, sizeof(color_s));
+        stats->backoffUntil = millis() + backoff;
+        if (stats->backoffUntil == 0) {
+            stats->backoffUntil = 1; // 0 means no backoff
         }
-    } else {
-        if (emsp) {
-            strlcat(output_str, "0x", sizeof(output_str));
-            strlcat(output_str, _hextoa(dest, buffer), sizeof(output_str));
-            strlcpy(color_s, COLOR_BRIGHT_MAGENTA, sizeof(color_s));
-        } else {
-            strlcat(output_str, "0x", sizeof(output_str));
-            strlcat(output_str, _hextoa(dest, buffer), sizeof(output_str));
-            strlcpy(color_s, COLOR_MAGENTA, sizeof(color_s));
+
+        if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+            myDebug("No response from 0x%02X %d times in a row, backing off for %d seconds", stats->dest, stats->failStreak, backoff / 1000);
         }
     }
+}
 
-    // type
-    strlcat(output_str, ", type 0x", sizeof(output_str));
-    strlcat(output_str, _hextoa(type, buffer), sizeof(output_str));
+/**
+ * how long to wait for a response, based on how fast the device answered before
+ */
+uint32_t _txDeviceTimeout(uint8_t dest) {
+    _EMS_TxDeviceStats * stats = _getTxDeviceStats(dest);
+    if ((stats == NULL) || (stats->success == 0)) {
+        return EMS_TX_TIMEOUT_DEFAULT;
+    }
 
-    if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_THERMOSTAT) {
-        // only print ones to/from thermostat if logging is set to thermostat only
-        if ((src == EMS_Thermostat.type_id) || (dest == EMS_Thermostat.type_id)) {
-            _debugPrintTelegram(output_str, EMS_RxTelegram, color_s);
-        }
-    } else {
-        // always print
-        _debugPrintTelegram(output_str, EMS_RxTelegram, color_s);
+    uint32_t timeout = stats->latencyAvg * EMS_TX_TIMEOUT_FACTOR;
+    if (timeout < EMS_TX_TIMEOUT_MIN) {
+        return EMS_TX_TIMEOUT_MIN;
+    }
+    if (timeout > EMS_TX_TIMEOUT_MAX) {
+        return EMS_TX_TIMEOUT_MAX;
     }
+    return timeout;
 }
 
 /**
- * print detailed telegram
- * and then call its callback if there is one defined
+ * true if the device has failed too often and we should leave it alone for a while
  */
-void _ems_processTelegram(_EMS_RxTelegram * EMS_RxTelegram) {
-    // header
-    uint8_t * telegram = EMS_RxTelegram->telegram;
-    uint8_t   length   = EMS_RxTelegram->length;
-    uint8_t   src      = telegram[0] & 0x7F;
-    uint8_t   type     = telegram[2];
-    uint8_t   offset   = telegram[3];
-    uint8_t * data     = &telegram[4]; // data block starts at position 4
+bool _txDeviceBackoff(uint8_t dest) {
+    _EMS_TxDeviceStats * stats = _getTxDeviceStats(dest);
+    if ((stats == NULL) || (stats->backoffUntil == 0)) {
+        return false;
+    }
 
-    // EMS Plus support
-    uint8_t   ptype   = telegram[3];
-    uint8_t   poffset = telegram[4];
-    uint8_t * pdata   = &telegram[5 + poffset]; // data block starts at position 5 plus the offset
+    if ((int32_t)(millis() - stats->backoffUntil) >= 0) {
+        stats->backoffUntil = 0; // time is up, try again
+        return false;
+    }
 
-    // print out the telegram
-    if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_THERMOSTAT) {
-        _printMessage(EMS_RxTelegram);
+    return true;
+}
+
+/**
+ * increment the retry counter of the telegram at the head of the queue
+ * returns the new count
+ */
+uint8_t _incrementTxRetry() {
+    if (EMS_TxQueue.isEmpty()) {
+        return 0;
     }
 
-    // see if we recognize the type first by scanning our known EMS types list
-    bool    typeFound = false;
-    uint8_t i         = 0;
+    _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.shift();
+    EMS_TxTelegram.retryCount++;
+    EMS_TxQueue.unshift(EMS_TxTelegram);
 
-    while (i < _EMS_Types_max) {
-        if (EMS_Types[i].type == type) {
-            // is it common type for everyone?
-            // is it for us? So the src must match with either the boiler, thermostat or other devices
-            if ((EMS_Types[i].model_id == EMS_MODEL_ALL)
-                || ((src == EMS_Boiler.type_id) || (src == EMS_Thermostat.type_id) || (src == EMS_ID_SM10))) { //lobocobra
-                typeFound = true;
-                break;
-            }
-        }
-        i++;
+    return EMS_TxTelegram.retryCount;
+}
+
+/**
+ * called on a poll while we're still waiting for an answer to the last Tx
+ * if the device took longer than its timeout, count it as a failure and release the Tx lock
+ */
+void _checkTxTimeout() {
+    if (EMS_TxQueue.isEmpty()) {
+        EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+        return;
     }
-    //myDebug("TTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTT OFFSET %d type: %d src:%d", offset,type,src); //lobocobra info
-    if ( src == 16 && type == 73 && offset == 85) { // lobocobra, ok we get the 0x49... handle it
-    //lobocobra start
-    EMS_Thermostat.pausezeit  = _toByte(0); //send 0b 90 49 55 01 (pos 0 as we read from 55)
-    EMS_Thermostat.partyzeit  = _toByte(1); //send 0b 90 49 56 01 (pos 1 as we read from 55)
-    //lobocobra end
-    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;  
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
-    return;
+
+    _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.first();
+    if ((millis() - EMS_TxSentTimestamp) < _txDeviceTimeout(EMS_TxTelegram.dest)) {
+        return; // keep waiting
     }
 
-    if ( src == 16 && type == 71 && offset == 22) { // lobocobra, ok we get the 2nd part of 0x47... handle it
-    EMS_Thermostat.maxvorlauf         = _toByte(13); // read max temp temp send 0b 90 47 23 01 !!RC35 other offset
-    EMS_Thermostat.auslegungstemp     = _toByte(14); // read max temp at min outside temp send 0b 90 47 24 01 !!RC36 other offset
-    EMS_Thermostat.heizturbo_till_next =_toByte(15); // read max temp temp send 0b 90 47 25 01 !!RC35 other offset x2
-    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;  
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
-    return; // we exit as we are done
+    _txDeviceFailed(EMS_TxTelegram.dest);
+    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_WRITE) {
+        _busStatsAdd(EMS_BUSSTATS_WRITEFAILS);
     }
-    // if it's a common type (across ems devices) or something specifically for us process it.
-    // dest will be EMS_ID_NONE and offset 0x00 for a broadcast message
-    if (typeFound) {
-        if ((EMS_Types[i].processType_cb) != (void *)NULL) {
-            // print non-verbose message
-            if ((EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_BASIC) || (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE)) {
-                if (EMS_Types[i].emsplus)
-                    myDebug("<--- %s(0x%02X) received", EMS_Types[i].typeString, ptype);
-                else
-                    myDebug("<--- %s(0x%02X) received", EMS_Types[i].typeString, type);
-            }
-            // call callback function to process it
-            if (EMS_Types[i].emsplus && poffset == EMS_PLUS_ID_NONE)
-                (void)EMS_Types[i].processType_cb(ptype, pdata, length - 6 - poffset);
-            // as we only handle complete telegrams (not partial) check that the offset is 0
-            else if (offset == EMS_ID_NONE && !EMS_Types[i].emsplus) { 
-                (void)EMS_Types[i].processType_cb(type, data, length - 5);
-            }
+
+    // a read gets EMS_TX_RETRY_MAX attempts in all, as it always had, anything else EMS_TX_RETRY_MAX retries
+    uint8_t retries = _incrementTxRetry();
+    if ((retries > EMS_TX_RETRY_MAX) || ((EMS_TxTelegram.action == EMS_TX_TELEGRAM_READ) && (retries >= EMS_TX_RETRY_MAX))) {
+        if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+            myDebug("No response from 0x%02X. Giving up, removing from queue", EMS_TxTelegram.dest & 0x7F);
+        }
+        _removeTxQueue();
+    } else {
+        if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+            myDebug("...No response from 0x%02X. Attempt %d/%d...", EMS_TxTelegram.dest & 0x7F, retries, EMS_TX_RETRY_MAX);
         }
+        EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE; // release the lock, try again next time
     }
-
-    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
 }
 
 /**
- * Remove current Tx telegram from queue and release lock on Tx
+ * keep a copy of what we're about to send so it can be compared with the echo from the bus
  */
-void _removeTxQueue() {
-    if (!EMS_TxQueue.isEmpty()) {
-        EMS_TxQueue.shift(); // remove item from top of the queue
-    }
-    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+void _recordTxEcho(uint8_t * data, uint8_t length, bool retry) {
+    EMS_TxEcho.length  = length;
+    EMS_TxEcho.retry   = retry;
+    EMS_TxEcho.pending = true;
+    memcpy(EMS_TxEcho.data, data, length);
 }
 
 /**
- * deciphers the telegram packet, which has already been checked for valid CRC and has a complete header (min of 5 bytes)
- * length is only data bytes, excluding the BRK
- * We only remove from the Tx queue if the read or write was successful
+ * The first telegram after a Tx should be the echo of what we sent, ended by our own BRK
+ * The echo may be cut short by the Rx FIFO reset at the start of the BRK so only the bytes received are compared
+ * If the echo was lost the telegram is from another device, e.g. a reply or a 01/04, and is processed as usual
+ * If it starts with our ID but doesn't match then another device was sending at the same time (a collision)
+ * and the lock is released so the telegram is sent again on the next poll
+ * Returns true if the telegram was the echo and should not be processed any further
  */
-void _processType(_EMS_RxTelegram * EMS_RxTelegram) {
-    uint8_t * telegram = EMS_RxTelegram->telegram;
+bool _checkTxEcho(_EMS_RxTelegram * EMS_RxTelegram) {
+    EMS_TxEcho.pending = false;
 
-    // header
-    uint8_t src = telegram[0] & 0x7F; // removing 8th bit as we deal with both reads and writes here
+    uint8_t length = EMS_RxTelegram->length;
+    if ((length == 0) || (EMS_RxTelegram->telegram[0] != EMS_ID_ME)) {
+        return false; // not ours, the echo was lost
+    }
 
-    // if its an echo of ourselves from the master UBA, ignore
-    if (src == EMS_ID_ME) {
-        // _debugPrintTelegram("echo:", EMS_RxTelegram, COLOR_WHITE);
-        return;
+    if ((length <= EMS_TxEcho.length) && (memcmp(EMS_RxTelegram->telegram, EMS_TxEcho.data, length) == 0)) {
+        return true; // clean echo, nothing more to do
     }
 
-    // if its a broadcast and we didn't just send anything, process it and exit
-    if (EMS_Sys_Status.emsTxStatus == EMS_TX_STATUS_IDLE) {
-        _ems_processTelegram(EMS_RxTelegram);
-        return;
+    EMS_Sys_Status.emsTxCollisions++;
+
+    if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+        _debugPrintTelegram("Tx collision, echo was", EMS_RxTelegram, COLOR_RED);
     }
 
-    // release the lock on the TxQueue
-    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+    // nothing to retry if it was a raw telegram or we're not waiting on a response
+    // the garbled telegram is still processed as usual, where its CRC will fail
+    if ((!EMS_TxEcho.retry) || (EMS_Sys_Status.emsTxStatus != EMS_TX_STATUS_WAIT)) {
+        return false;
+    }
 
-    // at this point we can assume Txstatus is EMS_TX_STATUS_WAIT so we just sent a read/write/validate
-    // for READ, WRITE or VALIDATE the dest (telegram[1]) is always us, so check for this
-    // and if not we probably didn't get any response so remove the last Tx from the queue and process the telegram anyway
-    if ((telegram[1] & 0x7F) != EMS_ID_ME) {
+    // release the lock so the telegram at the head of the queue is sent again on the next poll
+    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+    uint8_t retries            = _incrementTxRetry();
+    if (retries > EMS_TX_RETRY_MAX) {
+        if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+            myDebug("Tx collision. Giving up, removing from queue");
+        }
         _removeTxQueue();
-        _ems_processTelegram(EMS_RxTelegram);
-        return;
+    } else if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+        myDebug("...Retrying after collision. Attempt %d/%d...", retries, EMS_TX_RETRY_MAX);
     }
 
-    // first double check we actually have something in the queue
+    return false;
+}
+
+/**
+ * send the contents of the Tx buffer to the UART
+ * we take telegram from the queue and send it, but don't remove it until later when its confirmed successful
+ */
+void _ems_sendTelegram() {
+    // check if we have something in the queue to send
     if (EMS_TxQueue.isEmpty()) {
-        _ems_processTelegram(EMS_RxTelegram);
         return;
     }
 
-    // get the Tx telegram we just sent
-    _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.first();
+    // the UART is still busy sending the last telegram or BRK, wait for the next poll
+    if (emsuart_tx_busy()) {
+        return;
+    }
 
-    // check action
-    // if READ, match the current inbound telegram to what we sent
-    // if WRITE, should not happen
-    // if VALIDATE, check the contents
-    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_READ) {
-        uint8_t type = telegram[2];
-        if ((src == EMS_TxTelegram.dest) && (type == EMS_TxTelegram.type)) {
-            // all checks out, read was successful, remove tx from queue and continue to process telegram
-            _removeTxQueue();
-            EMS_Sys_Status.emsRxPgks++; // increment counter
-            // myDebug("** Read from 0x%02X ok", type);
-            ems_setEmsRefreshed(EMS_TxTelegram.forceRefresh); // does mqtt need refreshing?
-        } else {
-            // read not OK, we didn't get back a telegram we expected
-            // leave on queue and try again, but continue to process what we received as it may be important
-            EMS_Sys_Status.txRetryCount++;
-            // if retried too many times, give up and remove it
-            if (EMS_Sys_Status.txRetryCount >= TX_WRITE_TIMEOUT_COUNT) {
-                if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
-                    myDebug("Read failed. Giving up, removing from queue");
-                }
-                _removeTxQueue();
-            } else {
-                if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
-                    myDebug("...Retrying read. Attempt %d/%d...", EMS_Sys_Status.txRetryCount, TX_WRITE_TIMEOUT_COUNT);
-                }
-            }
+    // get the first in the queue, which is at the head
+    // we don't remove from the queue yet
+    _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.first();
+
+    // if there is no destination, also delete it from the queue
+    if (EMS_TxTelegram.dest == EMS_ID_NONE) {
+        _removeTxQueue(); // remove from queue
+        return;
+    }
+
+
+    // if we're in raw mode just fire and forget
+    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_RAW) {
+        EMS_TxTelegram.data[EMS_TxTelegram.length - 1] = _crcCalculator(EMS_TxTelegram.data, EMS_TxTelegram.length); // add the CRC
+        _EMS_RxTelegram EMS_RxTelegram;
+        EMS_RxTelegram.length    = EMS_TxTelegram.length;
+        EMS_RxTelegram.telegram  = EMS_TxTelegram.data;
+        EMS_RxTelegram.timestamp = millis();                             // now
+        if (!emsuart_tx_buffer(EMS_TxTelegram.data, EMS_TxTelegram.length)) {
+            return; // UART still busy, stays in the queue for the next poll
         }
-        _ems_processTelegram(EMS_RxTelegram); // process it always
+        _debugPrintTelegram("Sending raw", &EMS_RxTelegram, COLOR_CYAN); // always show
+        _recordTxEcho(EMS_TxTelegram.data, EMS_TxTelegram.length, false); // raw is not re-sent on a collision
+        EMS_TxQueue.shift();                                             // remove from queue
+        _rawSent(&EMS_TxTelegram);                                       // start waiting for the reply
+        return;
+    }
+
+    // the device keeps failing, let anything else in the queue go first
+    if (_txDeviceBackoff(EMS_TxTelegram.dest)) {
+        if (EMS_TxQueue.size() > 1) {
+            EMS_TxQueue.shift();
+            EMS_TxQueue.push(EMS_TxTelegram);
+        }
+        if (EMS_Sys_Status.emsPollEnabled) {
+            emsaurt_tx_poll();
+        }
+        return;
     }
 
+    // create header
+    EMS_TxTelegram.data[0] = EMS_ID_ME; // src
+    // dest
     if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_WRITE) {
-        // should not get here, since this is handled earlier receiving a 01 or 04
-        myDebug("** Error ! Write - should not be here");
+        EMS_TxTelegram.data[1] = EMS_TxTelegram.dest;
+    } else {
+        // for a READ or VALIDATE
+        EMS_TxTelegram.data[1] = EMS_TxTelegram.dest | 0x80; // read has 8th bit set
+    }
+    if (EMS_TxTelegram.type >= EMS_TYPE_PLUS) {
+        _ems_setPlusHeader(&EMS_TxTelegram);
+    } else {
+        EMS_TxTelegram.data[2] = EMS_TxTelegram.type;   // type
+        EMS_TxTelegram.data[3] = EMS_TxTelegram.offset; // offset
+
+        // see if it has data, add the single data value byte
+        // otherwise leave it alone and assume the data has been pre-populated
+        if (EMS_TxTelegram.length == EMS_MIN_TELEGRAM_LENGTH) {
+            // for reading this is #bytes we want to read (the size)
+            // for writing its the value we want to write
+            EMS_TxTelegram.data[4] = EMS_TxTelegram.dataValue;
+        }
     }
+    // finally calculate CRC and add it to the end
+    uint8_t crc                                    = _crcCalculator(EMS_TxTelegram.data, EMS_TxTelegram.length);
+    EMS_TxTelegram.data[EMS_TxTelegram.length - 1] = crc;
 
-    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_VALIDATE) {
-        // this is a read telegram which we use to validate the last write
-        uint8_t * data         = telegram + 4; // data block starts at position 5
-        uint8_t   dataReceived = data[0];      // only a single byte is returned after a read
-        if (EMS_TxTelegram.comparisonValue == dataReceived) {
-            // validate was successful, the write changed the value
-            _removeTxQueue(); // now we can remove the Tx validate command the queue
-            if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
-                myDebug("Write to 0x%02X was successful", EMS_TxTelegram.dest);
-            }
-            // follow up with the post read command
-            ems_doReadCommand(EMS_TxTelegram.comparisonPostRead, EMS_TxTelegram.dest, true);
-        } else {
-            // write failed
-            if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
-                myDebug("Last write failed. Compared set value 0x%02X with received value 0x%02X",
-                        EMS_TxTelegram.comparisonValue,
-                        dataReceived);
-            }
-            if (++EMS_Sys_Status.txRetryCount > TX_WRITE_TIMEOUT_COUNT) {
-                if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
-                    myDebug("Write failed. Giving up, removing from queue");
-                }
-                _removeTxQueue();
-            } else {
-                // retry, turn the validate back into a write and try again
-                if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
-                    myDebug("...Retrying write. Attempt %d/%d...", EMS_Sys_Status.txRetryCount, TX_WRITE_TIMEOUT_COUNT);
-                }
-                EMS_TxTelegram.action    = EMS_TX_TELEGRAM_WRITE;
-                EMS_TxTelegram.dataValue = EMS_TxTelegram.comparisonValue;  // restore old value
-                EMS_TxTelegram.offset    = EMS_TxTelegram.comparisonOffset; // restore old value
-                EMS_TxQueue.shift();                                        // remove validate from queue
-                EMS_TxQueue.unshift(EMS_TxTelegram);                        // add back to queue making it next in line
-            }
+    // print debug info
+    if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE) {
+        char s[64] = {0};
+        if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_WRITE) {
+            snprintf(s, sizeof(s), "Sending write of type 0x%0*X to 0x%02X:", EMS_TYPE_DIGITS(EMS_TxTelegram.type), EMS_TxTelegram.type, EMS_TxTelegram.dest & 0x7F);
+        } else if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_READ) {
+            snprintf(s, sizeof(s), "Sending read of type 0x%0*X to 0x%02X:", EMS_TYPE_DIGITS(EMS_TxTelegram.type), EMS_TxTelegram.type, EMS_TxTelegram.dest & 0x7F);
+        } else if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_VALIDATE) {
+            snprintf(s, sizeof(s), "Sending validate of type 0x%0*X to 0x%02X:", EMS_TYPE_DIGITS(EMS_TxTelegram.type), EMS_TxTelegram.type, EMS_TxTelegram.dest & 0x7F);
         }
+
+        _EMS_RxTelegram EMS_RxTelegram;
+        EMS_RxTelegram.length    = EMS_TxTelegram.length;
+        EMS_RxTelegram.telegram  = EMS_TxTelegram.data;
+        EMS_RxTelegram.timestamp = millis(); // now
+        _debugPrintTelegram(s, &EMS_RxTelegram, COLOR_CYAN);
     }
 
-    emsaurt_tx_poll(); // send Acknowledgement back to free the EMS bus since we have the telegram
+    // send the telegram to the UART Tx. If it's still busy the telegram stays in the queue for the next poll
+    if (!emsuart_tx_buffer(EMS_TxTelegram.data, EMS_TxTelegram.length)) {
+        return;
+    }
+    _recordTxEcho(EMS_TxTelegram.data, EMS_TxTelegram.length, true);
+    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_WRITE) {
+        _busStatsAdd(EMS_BUSSTATS_WRITES);
+    }
+
+    EMS_TxSentTimestamp        = millis();
+    _EMS_TxDeviceStats * stats = _getTxDeviceStats(EMS_TxTelegram.dest);
+    if (stats != NULL) {
+        stats->sent++;
+    }
+
+    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_WAIT;
 }
 
 
 /**
- * Check if hot tap water or heating is active
- * using a quick hack for checking the heating. Selected Flow Temp >= 70
+ * fills in the EMS+ header of a Tx, which is 2 bytes longer as the 16-bit type follows the offset
+ * write: [src] [dest] [0xFF] [offset] [type high] [type low] [data...] [crc]
+ * read:  [src] [dest|0x80] [0xFF] [offset] [length] [type high] [type low] [crc]
+ * data that was filled in before is moved up to make room
  */
-void _checkActive() {
-    // hot tap water, using flow to check instead of the burner power
-    if (EMS_Boiler.wWCurFlow != EMS_VALUE_INT_NOTSET && EMS_Boiler.burnGas != EMS_VALUE_INT_NOTSET) {
-        EMS_Boiler.tapwaterActive = ((EMS_Boiler.wWCurFlow != 0) && (EMS_Boiler.burnGas == EMS_VALUE_INT_ON));
+void _ems_setPlusHeader(_EMS_TxTelegram * EMS_TxTelegram) {
+    uint8_t * data   = EMS_TxTelegram->data;
+    uint16_t  type   = EMS_TxTelegram->type;
+    uint8_t   length = EMS_TxTelegram->length;
+
+    if (length > EMS_MAX_TELEGRAM_LENGTH - EMS_PLUS_HEADER_EXTRA) {
+        length = EMS_MAX_TELEGRAM_LENGTH - EMS_PLUS_HEADER_EXTRA; // drop what doesn't fit
     }
 
-    // heating
-    if (EMS_Boiler.selFlowTemp != EMS_VALUE_INT_NOTSET && EMS_Boiler.burnGas != EMS_VALUE_INT_NOTSET) {
-        EMS_Boiler.heatingActive = ((EMS_Boiler.selFlowTemp >= EMS_BOILER_SELFLOWTEMP_HEATING) && (EMS_Boiler.burnGas == EMS_VALUE_INT_ON));
+    if (length == EMS_MIN_TELEGRAM_LENGTH) {
+        data[4] = EMS_TxTelegram->dataValue;
+    }
+    memmove(&data[4 + EMS_PLUS_HEADER_EXTRA], &data[4], length - 5);
+
+    data[2] = EMS_PLUS_FRAME;
+    data[3] = EMS_TxTelegram->offset;
+    if (EMS_TxTelegram->action == EMS_TX_TELEGRAM_WRITE) {
+        data[4] = type >> 8;
+        data[5] = type & 0xFF;
+    } else {
+        data[4] = data[6]; // # bytes to read
+        data[5] = type >> 8;
+        data[6] = type & 0xFF;
     }
+
+    EMS_TxTelegram->length = length + EMS_PLUS_HEADER_EXTRA;
 }
 
 /**
- * UBAParameterWW - type 0x33 - warm water parameters
- * received only after requested (not broadcasted)
+ * the position of a write to offset in the batch, -1 if there is none
  */
-void _process_UBAParameterWW(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Boiler.wWActivated   = (_toByte(1) == 0xFF); // 0xFF means on
-    EMS_Boiler.wWSelTemp     = _toByte(2);
-    EMS_Boiler.wWCircPump    = (_toByte(6) == 0xFF); // 0xFF means on
-    EMS_Boiler.wWDesiredTemp = _toByte(8);
-    EMS_Boiler.wWComfort     = _toByte(EMS_OFFSET_UBAParameterWW_wwComfort);
+int8_t _findValidateItem(_EMS_TxValidateBatch * batch, uint8_t offset) {
+    for (uint8_t i = 0; i < batch->count; i++) {
+        if (batch->items[i].offset == offset) {
+            return i;
+        }
+    }
+    return -1;
+}
 
-    EMS_Sys_Status.emsRefreshed = true; // when we receieve this, lets force an MQTT publish
+/**
+ * check if a write can be verified in the same read as the writes already in the open batch
+ * it must go to the same dest and type, and the read must still fit into a single telegram
+ */
+bool _canAddValidateBatch(const _EMS_TxTelegram & EMS_TxTelegram) {
+    if ((EMS_TxTelegram.action != EMS_TX_TELEGRAM_WRITE) || (EMS_TxTelegram.type_validate == EMS_ID_NONE)) {
+        return false;
+    }
+
+    if (EMS_TxValidateOpen == EMS_TX_VALIDATE_NONE) {
+        return true;
+    }
+
+    _EMS_TxValidateBatch * batch = &EMS_TxValidateBatches[EMS_TxValidateOpen];
+    if ((EMS_TxTelegram.dest != batch->dest) || (EMS_TxTelegram.type_validate != batch->type)) {
+        return false;
+    }
+
+    // replaces an older write to the same offset
+    if (_findValidateItem(batch, EMS_TxTelegram.comparisonOffset) >= 0) {
+        return true;
+    }
+
+    if (batch->count >= EMS_TX_VALIDATE_BATCH_MAX) {
+        return false;
+    }
+
+    uint8_t min_offset = EMS_TxTelegram.comparisonOffset;
+    uint8_t max_offset = EMS_TxTelegram.comparisonOffset;
+    for (uint8_t i = 0; i < batch->count; i++) {
+        if (batch->items[i].offset < min_offset) {
+            min_offset = batch->items[i].offset;
+        }
+        if (batch->items[i].offset > max_offset) {
+            max_offset = batch->items[i].offset;
+        }
+    }
+
+    // the reply to an EMS+ read has 2 data bytes less room
+    uint8_t span_max = EMS_TX_VALIDATE_SPAN_MAX - ((batch->type >= EMS_TYPE_PLUS) ? EMS_PLUS_HEADER_EXTRA : 0);
+    return ((max_offset - min_offset + 1) <= span_max);
 }
 
 /**
- * UBATotalUptimeMessage - type 0x14 - total uptime
- * received only after requested (not broadcasted)
+ * queue a read after a successful write, unless the same read is already in the queue
  */
-void _process_UBATotalUptimeMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Boiler.UBAuptime        = _toLong(0);
-    EMS_Sys_Status.emsRefreshed = true; // when we receieve this, lets force an MQTT publish
+void _queuePostRead(uint16_t type, uint8_t dest) {
+    if (type == EMS_ID_NONE) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < EMS_TxQueue.size(); i++) {
+        _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue[i];
+        if ((EMS_TxTelegram.action == EMS_TX_TELEGRAM_READ) && (EMS_TxTelegram.type == type) && (EMS_TxTelegram.dest == dest)) {
+            return; // already queued
+        }
+    }
+
+    ems_doReadCommand(type, dest, true);
 }
 
-/*
- * UBAParametersMessage - type 0x16
+/**
+ * Turn all the writes in the open batch into a single validate request, placing it on the queue
+ * The read covers all the offsets that were written to, and the batch stays with the validate telegram
  */
-void _process_UBAParametersMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Boiler.heating_temp = _toByte(1);
-    EMS_Boiler.pump_mod_max = _toByte(9);
-    EMS_Boiler.pump_mod_min = _toByte(10);
-    // lobocobra start read values MC10
-    EMS_Thermostat.ausschalthysterese   = _toByte(4);
-    EMS_Thermostat.einschalthysterese   = _toByte(5);
-    EMS_Thermostat.antipendelzeit       = _toByte(6);
-    EMS_Thermostat.kesselpumennachlauf  = _toByte(8);
-    // lobocobra end
+void _flushValidateBatch() {
+    if (EMS_TxValidateOpen == EMS_TX_VALIDATE_NONE) {
+        return;
+    }
+
+    _EMS_TxValidateBatch * batch = &EMS_TxValidateBatches[EMS_TxValidateOpen];
+
+    uint8_t min_offset = batch->items[0].offset;
+    uint8_t max_offset = batch->items[0].offset;
+    for (uint8_t i = 1; i < batch->count; i++) {
+        if (batch->items[i].offset < min_offset) {
+            min_offset = batch->items[i].offset;
+        }
+        if (batch->items[i].offset > max_offset) {
+            max_offset = batch->items[i].offset;
+        }
+    }
+
+    _EMS_TxTelegram new_EMS_TxTelegram = EMS_TX_TELEGRAM_NEW;
+    new_EMS_TxTelegram.action          = EMS_TX_TELEGRAM_VALIDATE;
+    new_EMS_TxTelegram.timestamp       = millis();
+
+    new_EMS_TxTelegram.dest               = batch->dest;
+    new_EMS_TxTelegram.type               = batch->type;
+    new_EMS_TxTelegram.type_validate      = batch->type;
+    new_EMS_TxTelegram.comparisonOffset   = batch->items[0].offset;
+    new_EMS_TxTelegram.comparisonValue    = batch->items[0].value;
+    new_EMS_TxTelegram.comparisonPostRead = batch->items[0].postRead;
+    new_EMS_TxTelegram.retryCount         = batch->retryCount;
+    new_EMS_TxTelegram.validateBatch      = EMS_TxValidateOpen;
+
+    new_EMS_TxTelegram.offset    = min_offset;                  // location of first byte to fetch
+    new_EMS_TxTelegram.dataValue = max_offset - min_offset + 1; // # bytes to fetch
+    new_EMS_TxTelegram.length    = EMS_MIN_TELEGRAM_LENGTH;     // is always 6 bytes long (including CRC at end)
+
+    EMS_TxQueue.unshift(new_EMS_TxTelegram); // add back to queue making it first to be picked up next (FIFO)
+    EMS_TxValidateOpen = EMS_TX_VALIDATE_NONE;
 }
 
 /**
- * UBAMonitorWWMessage - type 0x34 - warm water monitor. 19 bytes long
- * received every 10 seconds
+ * a free batch for the next writes, EMS_TX_VALIDATE_NONE if they're all waiting on a validate
  */
-void _process_UBAMonitorWWMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Boiler.wWCurTmp  = _toShort(1);
-    EMS_Boiler.wWStarts  = _toLong(13);
-    EMS_Boiler.wWWorkM   = _toLong(10);
-    EMS_Boiler.wWOneTime = _bitRead(5, 1);
-    EMS_Boiler.wWCurFlow = _toByte(9);
+uint8_t _newValidateBatch(uint8_t dest, uint16_t type) {
+    for (uint8_t i = 0; i < EMS_TX_VALIDATE_BATCHES; i++) {
+        if (EMS_TxValidateBatches[i].count == 0) {
+            EMS_TxValidateBatches[i].dest       = dest;
+            EMS_TxValidateBatches[i].type       = type;
+            EMS_TxValidateBatches[i].retryCount = 0;
+            return i;
+        }
+    }
+    return EMS_TX_VALIDATE_NONE;
 }
 
 /**
- * UBAMonitorFast - type 0x18 - central heating monitor part 1 (25 bytes long)
- * received every 10 seconds
+ * Takes the last write command and adds it to the batch of writes to validate
+ * If the next in the queue is a write to the same type it's sent first so both are verified with a single read,
+ * otherwise the validate request is placed on the queue
  */
-void _process_UBAMonitorFast(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Boiler.selFlowTemp = _toByte(0);
-    EMS_Boiler.curFlowTemp = _toShort(1);
-    EMS_Boiler.retTemp     = _toShort(13);
+void _createValidate() {
+    if (EMS_TxQueue.isEmpty()) {
+        return;
+    }
+
+    // release the Tx lock
+    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+
+    // get the first in the queue, which is at the head
+    _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.first();
+
+    // safety check: only do a validate after a write and when we have a type to validate
+    if ((EMS_TxTelegram.action != EMS_TX_TELEGRAM_WRITE) || (EMS_TxTelegram.type_validate == EMS_ID_NONE)) {
+        EMS_TxQueue.shift(); // remove from queue
+        _txResult(EMS_TxTelegram.tag, true, EMS_TxTelegram.retryCount); // the 01 is all we get
+        _flushValidateBatch();
+        return;
+    }
+
+    // add the write to the open batch, starting a new one if it doesn't belong to it
+    if (!_canAddValidateBatch(EMS_TxTelegram)) {
+        _flushValidateBatch();
+    }
+    if (EMS_TxValidateOpen == EMS_TX_VALIDATE_NONE) {
+        EMS_TxValidateOpen = _newValidateBatch(EMS_TxTelegram.dest, EMS_TxTelegram.type_validate);
+    }
+    if (EMS_TxValidateOpen == EMS_TX_VALIDATE_NONE) {
+        // every batch is still waiting on its validate, so the 01 is all we get
+        EMS_TxQueue.shift();
+        _txResult(EMS_TxTelegram.tag, true, EMS_TxTelegram.retryCount);
+        return;
+    }
+
+    _EMS_TxValidateBatch * batch = &EMS_TxValidateBatches[EMS_TxValidateOpen];
+    if (EMS_TxTelegram.retryCount > batch->retryCount) {
+        batch->retryCount = EMS_TxTelegram.retryCount;
+    }
+
+    // a newer write to the same offset replaces the older one, which is done as its value was overwritten anyway
+    int8_t                index = _findValidateItem(batch, EMS_TxTelegram.comparisonOffset);
+    _EMS_TxValidateItem * item  = &batch->items[(index >= 0) ? index : batch->count++];
+    if (index >= 0) {
+        _txResult(item->tag, true, EMS_TxTelegram.retryCount);
+    }
+    item->offset   = EMS_TxTelegram.comparisonOffset;
+    item->value    = EMS_TxTelegram.comparisonValue;
+    item->postRead = EMS_TxTelegram.comparisonPostRead;
+    item->tag      = EMS_TxTelegram.tag;
+
+    EMS_TxQueue.shift(); // remove write from queue
+
+    // more writes to the same type to follow, so hold back the validate
+    if ((!EMS_TxQueue.isEmpty()) && _canAddValidateBatch(EMS_TxQueue.first())) {
+        return;
+    }
+
+    _flushValidateBatch();
+}
+
+/**
+ * checks the value of a batched write in the data returned by the validate read
+ * offset is where the data block starts, length the # of data bytes
+ */
+bool _checkValidateItem(_EMS_TxValidateItem * item, uint8_t offset, uint8_t * data, uint8_t length) {
+    if ((item->offset < offset) || ((item->offset - offset) >= length)) {
+        return false; // not in the data we got back
+    }
+
+    return (data[item->offset - offset] == item->value);
+}
+
+/**
+ * works out the type, offset and data block of a telegram with a valid CRC
+ * EMS 1.0: [src] [dest] [type] [offset] [data...] [crc]
+ * EMS+:    [src] [dest] [0xFF] [offset] [type high] [type low] [data...] [crc]
+ * an EMS+ read request has the # bytes wanted before the type and no data: [src] [dest|0x80] [0xFF] [offset] [length] [type high] [type low] [crc]
+ * the other EMS+ frames (0xF0-0xFE) are laid out differently, they keep the frame byte as type and everything after it as data
+ * returns false if the telegram is too short for its header
+ */
+bool _ems_parseHeader(_EMS_RxTelegram * EMS_RxTelegram) {
+    uint8_t * telegram = EMS_RxTelegram->telegram;
+    uint8_t   length   = EMS_RxTelegram->length;
+
+    EMS_RxTelegram->offset  = telegram[3];
+    EMS_RxTelegram->emsplus = (telegram[2] >= EMS_PLUS_FRAME_MIN);
+
+    if (telegram[2] != EMS_PLUS_FRAME) {
+        EMS_RxTelegram->type        = telegram[2];
+        EMS_RxTelegram->data        = &telegram[4];
+        EMS_RxTelegram->data_length = length - 5;
+        return true;
+    }
+
+    // EMS+ read request
+    if (telegram[1] & 0x80) {
+        if (length < 8) {
+            return false;
+        }
+        EMS_RxTelegram->type        = (telegram[5] << 8) | telegram[6];
+        EMS_RxTelegram->data        = &telegram[4]; // the # bytes wanted
+        EMS_RxTelegram->data_length = 1;
+        return true;
+    }
+
+    if (length < 7) {
+        return false;
+    }
+    EMS_RxTelegram->type        = (telegram[4] << 8) | telegram[5];
+    EMS_RxTelegram->data        = &telegram[6];
+    EMS_RxTelegram->data_length = length - 7;
+    return true;
+}
+
+/*
+ * Entry point triggered by an interrupt in emsuart.cpp
+ * length is only data bytes, excluding the BRK
+ * Read commands are asynchronous as they're handled by the interrupt
+ * When a telegram is processed we forcefully erase it from the stack to prevent overflow
+ */
+void ems_parseTelegram(uint8_t * telegram, uint8_t length) {
+    if ((length != 0) && (telegram[0] != 0x00)) {
+        _ems_readTelegram(telegram, length);
+    } else {
+        // an empty frame after a Tx means the echo was lost completely, so there is nothing to compare
+        EMS_TxEcho.pending = false;
+    }
+
+    // clear the Rx buffer just be safe and prevent duplicates
+    memset(telegram, 0, EMS_MAXBUFFERSIZE);
+}
+
+/**
+ * the main logic that parses the telegram message
+ * When we receive a Poll Request we need to send any Tx packages quickly within a 200ms window
+ */
+void _ems_readTelegram(uint8_t * telegram, uint8_t length) {
+    // create the Rx package
+    static _EMS_RxTelegram EMS_RxTelegram;
+    static uint32_t        _last_emsPollFrequency = 0;
+    EMS_RxTelegram.length                         = length;
+    EMS_RxTelegram.telegram                       = telegram;
+    EMS_RxTelegram.timestamp                      = millis();
+
+    // bus load, every byte counts including the BRK
+    if (EMS_Sniffer.enabled) {
+        EMS_Sniffer.bytes += length + 1;
+    }
+    _busStatsAdd(EMS_BUSSTATS_FRAMES);
+    _busStatsAdd(EMS_BUSSTATS_BYTES, length + 1);
+
+    // is this the echo of what we just sent?
+    if (EMS_TxEcho.pending && _checkTxEcho(&EMS_RxTelegram)) {
+        return;
+    }
+
+    // check if we just received a single byte
+    // it could well be a Poll request from the boiler for us, which will have a value of 0x8B (0x0B | 0x80)
+    // or either a return code like 0x01 or 0x04 from the last Write command
+    if (length == 1) {
+        uint8_t value = telegram[0]; // 1st byte of data package
+
+        if (value & 0x80) {
+            _busStatsPoll(value & 0x7F);
+        }
+
+        EMS_Sys_Status.emsPollFrequency = (EMS_RxTelegram.timestamp - _last_emsPollFrequency);
+        _last_emsPollFrequency          = EMS_RxTelegram.timestamp;
+
+        // check first for a Poll for us
+        if (value == (EMS_ID_ME | 0x80)) {
+            EMS_Sys_Status.emsTxCapable = true;
+
+            // still waiting for an answer to the last Tx?
+            if (EMS_Sys_Status.emsTxStatus == EMS_TX_STATUS_WAIT) {
+                _checkTxTimeout();
+            }
+
+            // nothing else to do, so use this poll to identify the next unknown device
+            if ((EMS_TxQueue.isEmpty()) && (EMS_Sys_Status.emsTxStatus == EMS_TX_STATUS_IDLE)) {
+                _discoveryNext();
+            }
+
+            // do we have something to send thats waiting in the Tx queue?
+            // if so send it if the Queue is not in a wait state
+            if ((!EMS_TxQueue.isEmpty()) && (EMS_Sys_Status.emsTxStatus == EMS_TX_STATUS_IDLE)) {
+                _ems_sendTelegram(); // perform the read/write command immediately
+            } else {
+                // nothing to send so just send a poll acknowledgement back
+                if (EMS_Sys_Status.emsPollEnabled) {
+                    emsaurt_tx_poll();
+                }
+            }
+        } else if (EMS_Sys_Status.emsTxStatus == EMS_TX_STATUS_WAIT) {
+            // this may be a single byte 01 (success) or 04 (error) from a recent write command?
+            if ((value == EMS_TX_SUCCESS) || (value == EMS_TX_ERROR)) {
+                if (!EMS_TxQueue.isEmpty()) {
+                    _txDeviceResponse(EMS_TxQueue.first().dest); // the device is alive
+                }
+            }
+
+            if (value == EMS_TX_SUCCESS) {
+                EMS_Sys_Status.emsTxPkgs++;
+                // got a success 01. Send a validate to check the value of the last write
+                emsaurt_tx_poll(); // send a poll to free the EMS bus
+                _createValidate(); // create a validate Tx request (if needed)
+            } else if (value == EMS_TX_ERROR) {
+                // last write failed (04), delete it from queue and dont bother to retry
+                _busStatsAdd(EMS_BUSSTATS_WRITEFAILS);
+                if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE) {
+                    myDebug("** Write command failed from host");
+                }
+                emsaurt_tx_poll();     // send a poll to free the EMS bus
+                _removeTxQueue();      // remove from queue
+                _flushValidateBatch(); // still verify any earlier writes in the batch
+            }
+        }
+
+        return; // all done here
+    }
+
+    // ignore anything that doesn't resemble a proper telegram package
+    // minimal is 5 bytes, excluding CRC at the end
+    if (length <= 4) {
+        _busStatsAdd(EMS_BUSSTATS_NOISE);
+        //_debugPrintTelegram("Noisy data:", &EMS_RxTelegram COLOR_RED);
+        return;
+    }
+
+    // Assume at this point we have something that vaguely resembles a telegram in the format [src] [dest] [type] [offset] [data] [crc]
+    // validate the CRC, if its bad ignore it
+    uint8_t crc = _crcCalculator(telegram, length);
+    if (telegram[length - 1] != crc) {
+        EMS_Sys_Status.emxCrcErr++;
+        _busStatsAdd(EMS_BUSSTATS_CRCERR);
+        if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE) {
+            _debugPrintTelegram("Corrupt telegram:", &EMS_RxTelegram, COLOR_RED);
+        }
+        return;
+    }
+
+    // work out the type and where the data is
+    if (!_ems_parseHeader(&EMS_RxTelegram)) {
+        _busStatsAdd(EMS_BUSSTATS_NOISE);
+        return;
+    }
+
+    // the 1 byte telegram CRC also changes with the header, and too easily collides to spot changed values
+    EMS_RxTelegram.data_crc = CRC32::calculate(EMS_RxTelegram.data, EMS_RxTelegram.data_length);
+
+    // if we are in raw logging mode then just print out the telegram as it is
+    // but still continue to process it
+    if ((EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_RAW) && _logFilterPass(&EMS_RxTelegram)) {
+        char             raw[300];
+        _EMS_PrintCursor c;
+        _printBegin(&c, raw, sizeof(raw));
+        for (int i = 0; i < length; i++) {
+            _printHex(&c, telegram[i]);
+            _printChar(&c, ' ');
+        }
+        myESP.myDebugLine(raw);
+    }
+
+    // here we know its a valid incoming telegram of at least 6 bytes
+    // we use this to see if we always have a connection to the boiler, in case of drop outs
+    EMS_Sys_Status.emsRxTimestamp  = EMS_RxTelegram.timestamp; // timestamp of last read
+    EMS_Sys_Status.emsBusConnected = true;
+
+    // the sender is on the bus
+    _bitmapSet(EMS_Discovery.present, telegram[0]);
+
+    // a reply to a raw telegram?
+    if ((telegram[1] & 0x7F) == EMS_ID_ME) {
+        _rawCheckReply(&EMS_RxTelegram);
+    }
+
+    if (EMS_Sniffer.enabled && (telegram[0] != EMS_ID_ME)) {
+        _snifferRecord(&EMS_RxTelegram);
+    }
+//lobocobra info check incoming telegram
+    // now lets process it and see what to do next
+
+    //lobocobra info here we have the lenght of the telegram.... if we need it longer... hack here if it is 20hex or 32
+    //    myDebug("<<<<<<<<<<<<<<<<<<<length: %d data %s",EMS_RxTelegram.length,EMS_RxTelegram.telegram);
+    //lobocobra end
+    _processType(&EMS_RxTelegram);
+}
+
+/**
+ * should the telegram be printed, from the logging mode and the log filter
+ * called before anything is formatted so the telegrams left out cost only a few bit tests
+ */
+bool _logFilterPass(_EMS_RxTelegram * EMS_RxTelegram) {
+    uint8_t  src       = EMS_RxTelegram->telegram[0] & 0x7F;
+    uint8_t  dest      = EMS_RxTelegram->telegram[1];
+    uint8_t  direction = EMS_LOGFILTER_DIR_WRITE;
+
+    if ((dest & 0x7F) == EMS_ID_NONE) {
+        direction = EMS_LOGFILTER_DIR_BROADCAST;
+    } else if (dest & 0x80) {
+        direction = EMS_LOGFILTER_DIR_READ;
+    }
+
+    // only ones to/from thermostat if logging is set to thermostat only
+    if ((EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_THERMOSTAT) && (src != EMS_Thermostat.type_id) && ((dest & 0x7F) != EMS_Thermostat.type_id)) {
+        return false;
+    }
+
+    return (EMS_LogFilter.direction & direction) && _bitmapRead(EMS_LogFilter.src, src) && _bitmapRead(EMS_LogFilter.dest, dest)
+           && _logFilterType(EMS_RxTelegram->type);
+}
+
+// is the type in the log filter. EMS 1.0 types are a bit test, EMS+ types are looked up in the short list
+bool _logFilterType(uint16_t type) {
+    if (type <= 0xFF) {
+        return ((EMS_LogFilter.type[type >> 5] >> (type & 0x1F)) & 0x01);
+    }
+
+    return (!(EMS_LogFilter.narrowed & (1 << EMS_LOGFILTER_TYPE)) || _logFilterHasPlus(type));
+}
+
+bool _logFilterHasPlus(uint16_t type) {
+    for (uint8_t i = 0; i < EMS_LogFilter.plusCount; i++) {
+        if (EMS_LogFilter.plusType[i] == type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * log all telegrams again
+ */
+void ems_clearLogFilter() {
+    EMS_LogFilter.narrowed  = 0;
+    EMS_LogFilter.direction = EMS_LOGFILTER_DIR_ALL;
+    memset(EMS_LogFilter.src, 0xFF, sizeof(EMS_LogFilter.src));
+    memset(EMS_LogFilter.dest, 0xFF, sizeof(EMS_LogFilter.dest));
+    memset(EMS_LogFilter.type, 0xFF, sizeof(EMS_LogFilter.type));
+    EMS_LogFilter.plusCount = 0;
+}
+
+/**
+ * add an ID, type or direction to the log filter. Only telegrams in every set are printed
+ * the first one added to a set replaces the match all
+ * returns false if the ID is out of range, or there's no room for another EMS+ type
+ */
+bool ems_addLogFilter(_EMS_LOGFILTER set, uint16_t id) {
+    bool narrow = !(EMS_LogFilter.narrowed & (1 << set));
+
+    if (set == EMS_LOGFILTER_SRC || set == EMS_LOGFILTER_DEST) {
+        if (id > 0x7F) {
+            return false;
+        }
+        uint32_t * map = (set == EMS_LOGFILTER_SRC) ? EMS_LogFilter.src : EMS_LogFilter.dest;
+        if (narrow) {
+            memset(map, 0, sizeof(EMS_LogFilter.src));
+        }
+        _bitmapSet(map, id);
+    } else if (set == EMS_LOGFILTER_TYPE) {
+        if (narrow) {
+            memset(EMS_LogFilter.type, 0, sizeof(EMS_LogFilter.type));
+            EMS_LogFilter.plusCount = 0;
+        }
+        if (id <= 0xFF) {
+            EMS_LogFilter.type[id >> 5] |= (1UL << (id & 0x1F));
+        } else if (!_logFilterHasPlus(id)) {
+            if (EMS_LogFilter.plusCount >= EMS_LOGFILTER_PLUS_MAX) {
+                return false;
+            }
+            EMS_LogFilter.plusType[EMS_LogFilter.plusCount++] = id;
+        }
+    } else if (set == EMS_LOGFILTER_DIR) {
+        if ((id & EMS_LOGFILTER_DIR_ALL) == 0) {
+            return false;
+        }
+        if (narrow) {
+            EMS_LogFilter.direction = 0;
+        }
+        EMS_LogFilter.direction |= (id & EMS_LOGFILTER_DIR_ALL);
+    } else {
+        return false;
+    }
+
+    EMS_LogFilter.narrowed |= (1 << set);
+    return true;
+}
+
+// the IDs in a bitmap of the log filter as hex, and for the types the EMS+ ones, "all" if it wasn't narrowed
+void _printLogFilterSet(const char * name, _EMS_LOGFILTER set, uint32_t * map, uint16_t bits) {
+    char             output_str[200];
+    _EMS_PrintCursor c;
+
+    _printBegin(&c, output_str, sizeof(output_str));
+    _printStr(&c, "  ");
+    _printStr(&c, name);
+    _printStr(&c, ": ");
+    if (!(EMS_LogFilter.narrowed & (1 << set))) {
+        _printStr(&c, "all");
+    } else {
+        for (uint16_t i = 0; i < bits; i++) {
+            if ((map[i >> 5] >> (i & 0x1F)) & 0x01) {
+                _printHex(&c, i);
+                _printChar(&c, ' ');
+            }
+        }
+        for (uint8_t i = 0; (set == EMS_LOGFILTER_TYPE) && (i < EMS_LogFilter.plusCount); i++) {
+            _printHex(&c, EMS_LogFilter.plusType[i] >> 8);
+            _printHex(&c, EMS_LogFilter.plusType[i] & 0xFF);
+            _printChar(&c, ' ');
+        }
+    }
+
+    myESP.myDebugLine(output_str);
+}
+
+/**
+ * show the log filter
+ */
+void ems_printLogFilter() {
+    myDebug("Log filter:");
+    _printLogFilterSet("src", EMS_LOGFILTER_SRC, EMS_LogFilter.src, 128);
+    _printLogFilterSet("dest", EMS_LOGFILTER_DEST, EMS_LogFilter.dest, 128);
+    _printLogFilterSet("type", EMS_LOGFILTER_TYPE, EMS_LogFilter.type, 256);
+    myDebug("  dir: %s%s%s",
+            (EMS_LogFilter.direction & EMS_LOGFILTER_DIR_READ) ? "read " : "",
+            (EMS_LogFilter.direction & EMS_LOGFILTER_DIR_WRITE) ? "write " : "",
+            (EMS_LogFilter.direction & EMS_LOGFILTER_DIR_BROADCAST) ? "broadcast" : "");
+}
+
+/*
+ * print the telegram
+ */
+void _printMessage(_EMS_RxTelegram * EMS_RxTelegram) {
+    uint8_t * telegram = EMS_RxTelegram->telegram;
+
+    // header info
+    uint8_t   src  = telegram[0] & 0x7F;
+    uint8_t   dest = telegram[1] & 0x7F; // remove 8th bit to handle both reads and writes
+    uint16_t  type = EMS_RxTelegram->type;
+    bool      emsp = EMS_RxTelegram->emsplus;
+
+    // destination name and color of the line
+    const char * dest_s  = NULL; // NULL prints the ID
+    const char * color_s = emsp ? COLOR_BRIGHT_MAGENTA : COLOR_MAGENTA;
+    if (dest == EMS_ID_ME) {
+        dest_s  = "me";
+        color_s = emsp ? COLOR_BRIGHT_YELLOW : COLOR_YELLOW;
+    } else if (dest == EMS_ID_NONE) {
+        dest_s  = "all";
+        color_s = emsp ? COLOR_BRIGHT_GREEN : COLOR_GREEN;
+    } else if (dest == EMS_Boiler.type_id) {
+        dest_s = emsp ? "Boiler+" : "Boiler";
+    } else if (dest == EMS_ID_SM10) {
+        dest_s  = "SM10";
+        color_s = COLOR_MAGENTA;
+    } else if (dest == EMS_Thermostat.type_id) {
+        dest_s = emsp ? "Thermostat+" : "Thermostat";
+    }
+
+    char             output_str[200];
+    _EMS_PrintCursor c;
+
+    _printBegin(&c, output_str, sizeof(output_str));
+    _printTelegramStart(&c, EMS_RxTelegram->timestamp, color_s);
+
+    // source
+    if (src == EMS_Boiler.type_id) {
+        _printStr(&c, "Boiler");
+    } else if (src == EMS_Thermostat.type_id) {
+        _printStr(&c, emsp ? "Thermostat+" : "Thermostat");
+    } else {
+        _printStr(&c, "0x");
+        _printHex(&c, src);
+    }
+
+    _printStr(&c, " -> ");
+
+    // destination
+    if (dest_s != NULL) {
+        _printStr(&c, dest_s);
+    } else {
+        _printStr(&c, "0x");
+        _printHex(&c, dest);
+    }
+
+    // type
+    _printStr(&c, ", type 0x");
+    if (type >= EMS_TYPE_PLUS) {
+        _printHex(&c, type >> 8);
+    }
+    _printHex(&c, type & 0xFF);
+
+    _printTelegramData(&c, EMS_RxTelegram);
+
+    myESP.myDebugLine(output_str);
+}
+
+/**
+ * print detailed telegram
+ * and then call its callback if there is one defined
+ */
+void _ems_processTelegram(_EMS_RxTelegram * EMS_RxTelegram) {
+    // header
+    uint8_t   src    = EMS_RxTelegram->telegram[0] & 0x7F; // removing 8th bit as we deal with both reads and writes here
+    uint16_t  type   = EMS_RxTelegram->type;
+    uint8_t   offset = EMS_RxTelegram->offset;
+    uint8_t * data   = EMS_RxTelegram->data;
+
+    // print out the telegram
+    if ((EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_THERMOSTAT) && _logFilterPass(EMS_RxTelegram)) {
+        _printMessage(EMS_RxTelegram);
+    }
+
+    // look up the sender in the device registry and the type for its model
+    // common types like Version are processed for everyone, the rest only for registered devices
+    // an EMS+ type below EMS_TYPE_PLUS would be taken for the EMS 1.0 type with the same number
+    _EMS_Device * device = _ems_findSender(src);
+    int           i      = (EMS_RxTelegram->emsplus == (type >= EMS_TYPE_PLUS)) ? _ems_findDeviceType(device, type) : -1;
+
+    if (device != NULL) {
+        _ems_updateShadow(device, type, offset, EMS_RxTelegram);
+    }
+
+    // a broadcast or a reply, either way these values are fresh now
+    _pollReceived(src, type, offset, EMS_RxTelegram->data_crc);
+    //myDebug("TTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTT OFFSET %d type: %d src:%d", offset,type,src); //lobocobra info
+    if ( src == 16 && type == 73 && offset == 85) { // lobocobra, ok we get the 0x49... handle it
+    //lobocobra start
+    EMS_Thermostat.pausezeit  = _toByte(0); //send 0b 90 49 55 01 (pos 0 as we read from 55)
+    EMS_Thermostat.partyzeit  = _toByte(1); //send 0b 90 49 56 01 (pos 1 as we read from 55)
+    //lobocobra end
+    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;  
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+    return;
+    }
+
+    if ( src == 16 && type == 71 && offset == 22) { // lobocobra, ok we get the 2nd part of 0x47... handle it
+    EMS_Thermostat.maxvorlauf         = _toByte(13); // read max temp temp send 0b 90 47 23 01 !!RC35 other offset
+    EMS_Thermostat.auslegungstemp     = _toByte(14); // read max temp at min outside temp send 0b 90 47 24 01 !!RC36 other offset
+    EMS_Thermostat.heizturbo_till_next =_toByte(15); // read max temp temp send 0b 90 47 25 01 !!RC35 other offset x2
+    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;  
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+    return; // we exit as we are done
+    }
+    // if it's a common type (across ems devices) or something specifically for us process it.
+    // dest will be EMS_ID_NONE and offset 0x00 for a broadcast message
+    if (i != -1) {
+        if ((EMS_Types[i].processType_cb) != (void *)NULL) {
+            // print non-verbose message
+            if ((EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_BASIC) || (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE)) {
+                myDebug("<--- %s(0x%0*X) received", EMS_Types[i].typeString, EMS_TYPE_DIGITS(type), type);
+            }
+            // call callback function to process it
+            // as we only handle complete telegrams (not partial) check that the offset is 0
+            if (offset == EMS_ID_NONE) {
+                (void)EMS_Types[i].processType_cb(src, type, data, EMS_RxTelegram->data_length);
+            }
+        }
+
+        // the device is talking again, so its values are no longer from the snapshot
+        if (EMS_Sys_Status.emsStale) {
+            if (src == EMS_Boiler.type_id) {
+                EMS_Sys_Status.emsStale &= ~EMS_STALE_BOILER;
+            } else if (src == EMS_Thermostat.type_id) {
+                EMS_Sys_Status.emsStale &= ~EMS_STALE_THERMOSTAT;
+            } else if (src == EMS_ID_SM10) {
+                EMS_Sys_Status.emsStale &= ~EMS_STALE_OTHER;
+            }
+        }
+    }
+
+    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+}
+
+/**
+ * Remove current Tx telegram from queue and release lock on Tx
+ * answered is true when it's removed because the read got its answer
+ */
+void _removeTxQueue(bool answered) {
+    if (!EMS_TxQueue.isEmpty()) {
+        _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.shift(); // remove item from top of the queue
+
+        // a write that's dropped has failed, as have the writes waiting on a validate
+        if ((EMS_TxTelegram.action == EMS_TX_TELEGRAM_VALIDATE) && (EMS_TxTelegram.validateBatch != EMS_TX_VALIDATE_NONE)) {
+            _EMS_TxValidateBatch * batch = &EMS_TxValidateBatches[EMS_TxTelegram.validateBatch];
+            for (uint8_t i = 0; i < batch->count; i++) {
+                _txResult(batch->items[i].tag, false, EMS_TxTelegram.retryCount);
+            }
+            batch->count = 0;
+        } else if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_WRITE) {
+            _txResult(EMS_TxTelegram.tag, false, EMS_TxTelegram.retryCount);
+        } else if ((EMS_TxTelegram.action == EMS_TX_TELEGRAM_READ) && (EMS_TxTelegram.type == EMS_TYPE_Version) && !answered) {
+            _discoveryLost(EMS_TxTelegram.dest & 0x7F); // whatever the reason it was dropped, ask again later
+        }
+    }
+    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+}
+
+/**
+ * deciphers the telegram packet, which has already been checked for valid CRC and has a complete header (min of 5 bytes)
+ * length is only data bytes, excluding the BRK
+ * We only remove from the Tx queue if the read or write was successful
+ */
+void _processType(_EMS_RxTelegram * EMS_RxTelegram) {
+    uint8_t * telegram = EMS_RxTelegram->telegram;
+
+    // header
+    uint8_t src = telegram[0] & 0x7F; // removing 8th bit as we deal with both reads and writes here
+
+    // if its an echo of ourselves from the master UBA, ignore
+    if (src == EMS_ID_ME) {
+        // _debugPrintTelegram("echo:", EMS_RxTelegram, COLOR_WHITE);
+        return;
+    }
+
+    // if its a broadcast and we didn't just send anything, process it and exit
+    if (EMS_Sys_Status.emsTxStatus == EMS_TX_STATUS_IDLE) {
+        _ems_processTelegram(EMS_RxTelegram);
+        return;
+    }
+
+    // release the lock on the TxQueue
+    EMS_Sys_Status.emsTxStatus = EMS_TX_STATUS_IDLE;
+
+    // at this point we can assume Txstatus is EMS_TX_STATUS_WAIT so we just sent a read/write/validate
+    // for READ, WRITE or VALIDATE the dest (telegram[1]) is always us, so check for this
+    // and if not we probably didn't get any response so remove the last Tx from the queue and process the telegram anyway
+    if ((telegram[1] & 0x7F) != EMS_ID_ME) {
+        if (!EMS_TxQueue.isEmpty()) {
+            _txDeviceFailed(EMS_TxQueue.first().dest);
+        }
+        _removeTxQueue();
+        _ems_processTelegram(EMS_RxTelegram);
+        return;
+    }
+
+    // first double check we actually have something in the queue
+    if (EMS_TxQueue.isEmpty()) {
+        _ems_processTelegram(EMS_RxTelegram);
+        return;
+    }
+
+    // get the Tx telegram we just sent
+    _EMS_TxTelegram EMS_TxTelegram = EMS_TxQueue.first();
+
+    // check action
+    // if READ, match the current inbound telegram to what we sent
+    // if WRITE, should not happen
+    // if VALIDATE, check the contents
+    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_READ) {
+        if ((src == EMS_TxTelegram.dest) && (EMS_RxTelegram->type == EMS_TxTelegram.type)) {
+            // all checks out, read was successful, remove tx from queue and continue to process telegram
+            _txDeviceResponse(EMS_TxTelegram.dest);
+            _removeTxQueue(true);
+            EMS_Sys_Status.emsRxPgks++; // increment counter
+            // myDebug("** Read from 0x%02X ok", type);
+            ems_setEmsRefreshed(EMS_TxTelegram.forceRefresh); // does mqtt need refreshing?
+        } else {
+            // read not OK, we didn't get back a telegram we expected
+            // leave on queue and try again, but continue to process what we received as it may be important
+            _txDeviceFailed(EMS_TxTelegram.dest);
+            uint8_t retries = _incrementTxRetry();
+            // if tried too many times, give up and remove it
+            if (retries >= EMS_TX_RETRY_MAX) {
+                if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+                    myDebug("Read failed. Giving up, removing from queue");
+                }
+                _removeTxQueue();
+            } else {
+                if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+                    myDebug("...Retrying read. Attempt %d/%d...", retries, EMS_TX_RETRY_MAX);
+                }
+            }
+        }
+        _ems_processTelegram(EMS_RxTelegram); // process it always
+    }
+
+    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_WRITE) {
+        // should not get here, since this is handled earlier receiving a 01 or 04
+        myDebug("** Error ! Write - should not be here");
+    }
+
+    if (EMS_TxTelegram.action == EMS_TX_TELEGRAM_VALIDATE) {
+        // this is a read telegram which we use to validate the last batch of writes
+        uint8_t * data     = EMS_RxTelegram->data;        // data block
+        uint8_t   offset   = EMS_RxTelegram->offset;      // offset of the first data byte
+        uint8_t   received = EMS_RxTelegram->data_length; // # data bytes, excluding header and CRC
+        uint8_t   failed   = 0;
+        uint8_t   retries  = EMS_TxTelegram.retryCount + 1;
+
+        // the batch of writes this validate was created for
+        _EMS_TxValidateBatch   none_batch = {};
+        _EMS_TxValidateBatch * batch      = &none_batch;
+        if (EMS_TxTelegram.validateBatch != EMS_TX_VALIDATE_NONE) {
+            batch = &EMS_TxValidateBatches[EMS_TxTelegram.validateBatch];
+        }
+        uint8_t count = batch->count;
+
+        _txDeviceResponse(EMS_TxTelegram.dest); // it answered, even if the values are wrong
+
+        for (uint8_t i = 0; i < count; i++) {
+            _EMS_TxValidateItem * item = &batch->items[i];
+            if (!_checkValidateItem(item, offset, data, received)) {
+                failed++;
+                if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+                    myDebug("Last write failed. Compared set value 0x%02X at offset %d with received value 0x%02X",
+                            item->value,
+                            item->offset,
+                            ((item->offset >= offset) && ((item->offset - offset) < received)) ? data[item->offset - offset] : 0);
+                }
+            }
+        }
+
+        _busStatsAdd(EMS_BUSSTATS_WRITEFAILS, failed);
+
+        if (failed == 0) {
+            // validate was successful, the writes changed the values
+            for (uint8_t i = 0; i < count; i++) {
+                _txResult(batch->items[i].tag, true, EMS_TxTelegram.retryCount);
+            }
+            batch->count = 0; // done, so removing the validate doesn't fail them
+            _removeTxQueue(); // now we can remove the Tx validate command the queue
+            if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+                myDebug("Write to 0x%02X was successful (%d value%s)", EMS_TxTelegram.dest, count, (count == 1) ? "" : "s");
+            }
+            // follow up with the post read commands, only once per type
+            for (uint8_t i = 0; i < count; i++) {
+                _queuePostRead(batch->items[i].postRead, EMS_TxTelegram.dest);
+            }
+        } else if (retries > EMS_TX_RETRY_MAX) {
+            if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+                myDebug("Write failed. Giving up, removing from queue");
+            }
+            for (uint8_t i = 0; i < count; i++) {
+                _EMS_TxValidateItem * item = &batch->items[i];
+                _txResult(item->tag, _checkValidateItem(item, offset, data, received), EMS_TxTelegram.retryCount);
+            }
+            batch->count = 0;
+            _removeTxQueue();
+        } else {
+            // retry, turn the failed values back into writes and try again
+            if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+                myDebug("...Retrying write. Attempt %d/%d...", retries, EMS_TX_RETRY_MAX);
+            }
+            EMS_TxQueue.shift(); // remove validate from queue
+
+            // add back to the queue in reverse, so they're next in line in the original order
+            for (int8_t i = count - 1; i >= 0; i--) {
+                _EMS_TxValidateItem * item = &batch->items[i];
+                if (_checkValidateItem(item, offset, data, received)) {
+                    _txResult(item->tag, true, EMS_TxTelegram.retryCount);
+                    _queuePostRead(item->postRead, EMS_TxTelegram.dest); // this one made it
+                    continue;
+                }
+
+                _EMS_TxTelegram new_EMS_TxTelegram    = EMS_TX_TELEGRAM_NEW;
+                new_EMS_TxTelegram.action             = EMS_TX_TELEGRAM_WRITE;
+                new_EMS_TxTelegram.timestamp          = millis();
+                new_EMS_TxTelegram.dest               = EMS_TxTelegram.dest;
+                new_EMS_TxTelegram.type               = EMS_TxTelegram.type;
+                new_EMS_TxTelegram.offset             = item->offset; // restore old value
+                new_EMS_TxTelegram.dataValue          = item->value;  // restore old value
+                new_EMS_TxTelegram.length             = EMS_MIN_TELEGRAM_LENGTH;
+                new_EMS_TxTelegram.type_validate      = EMS_TxTelegram.type_validate;
+                new_EMS_TxTelegram.comparisonOffset   = item->offset;
+                new_EMS_TxTelegram.comparisonValue    = item->value;
+                new_EMS_TxTelegram.comparisonPostRead = item->postRead;
+                new_EMS_TxTelegram.retryCount         = retries;
+                new_EMS_TxTelegram.tag                = item->tag;
+                EMS_TxQueue.unshift(new_EMS_TxTelegram);
+            }
+            batch->count = 0;
+        }
+    }
+
+    emsaurt_tx_poll(); // send Acknowledgement back to free the EMS bus since we have the telegram
+}
+
+
+/**
+ * Check if hot tap water or heating is active
+ * using a quick hack for checking the heating. Selected Flow Temp >= 70
+ */
+void _checkActive() {
+    // hot tap water, using flow to check instead of the burner power
+    if (EMS_Boiler.wWCurFlow != EMS_VALUE_INT_NOTSET && EMS_Boiler.burnGas != EMS_VALUE_INT_NOTSET) {
+        EMS_Boiler.tapwaterActive = ((EMS_Boiler.wWCurFlow != 0) && (EMS_Boiler.burnGas == EMS_VALUE_INT_ON));
+    }
+
+    // heating
+    if (EMS_Boiler.selFlowTemp != EMS_VALUE_INT_NOTSET && EMS_Boiler.burnGas != EMS_VALUE_INT_NOTSET) {
+        EMS_Boiler.heatingActive = ((EMS_Boiler.selFlowTemp >= EMS_BOILER_SELFLOWTEMP_HEATING) && (EMS_Boiler.burnGas == EMS_VALUE_INT_ON));
+    }
+}
+
+/**
+ * UBAParameterWW - type 0x33 - warm water parameters
+ * received only after requested (not broadcasted)
+ */
+void _process_UBAParameterWW(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getBoiler(src) == NULL) {
+        return; // not from our boiler
+    }
+
+    EMS_Boiler.wWActivated   = (_toByte(1) == 0xFF); // 0xFF means on
+    EMS_Boiler.wWSelTemp     = _toByte(2);
+    EMS_Boiler.wWCircPump    = (_toByte(6) == 0xFF); // 0xFF means on
+    EMS_Boiler.wWDesiredTemp = _toByte(8);
+    EMS_Boiler.wWComfort     = _toByte(EMS_OFFSET_UBAParameterWW_wwComfort);
+
+    EMS_Sys_Status.emsRefreshed = true; // when we receieve this, lets force an MQTT publish
+}
+
+/**
+ * UBATotalUptimeMessage - type 0x14 - total uptime
+ * received only after requested (not broadcasted)
+ */
+void _process_UBATotalUptimeMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getBoiler(src) == NULL) {
+        return; // not from our boiler
+    }
+
+    EMS_Boiler.UBAuptime        = _toLong(0);
+    EMS_Sys_Status.emsRefreshed = true; // when we receieve this, lets force an MQTT publish
+}
+
+/*
+ * UBAParametersMessage - type 0x16
+ */
+void _process_UBAParametersMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getBoiler(src) == NULL) {
+        return; // not from our boiler
+    }
+
+    EMS_Boiler.heating_temp = _toByte(1);
+    EMS_Boiler.pump_mod_max = _toByte(9);
+    EMS_Boiler.pump_mod_min = _toByte(10);
+    // lobocobra start read values MC10
+    EMS_Thermostat.ausschalthysterese   = _toByte(4);
+    EMS_Thermostat.einschalthysterese   = _toByte(5);
+    EMS_Thermostat.antipendelzeit       = _toByte(6);
+    EMS_Thermostat.kesselpumennachlauf  = _toByte(8);
+    // lobocobra end
+}
+
+/**
+ * UBAMonitorWWMessage - type 0x34 - warm water monitor. 19 bytes long
+ * received every 10 seconds
+ */
+void _process_UBAMonitorWWMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getBoiler(src) == NULL) {
+        return; // not from our boiler
+    }
+
+    EMS_Boiler.wWCurTmp  = _toShort(1);
+    EMS_Boiler.wWStarts  = _toLong(13);
+    EMS_Boiler.wWWorkM   = _toLong(10);
+    EMS_Boiler.wWOneTime = _bitRead(5, 1);
+    EMS_Boiler.wWCurFlow = _toByte(9);
+
+    if (abs(EMS_Boiler.wWCurTmp) < EMS_VALUE_SHORT_NOTSET) {
+        ems_historyAdd(EMS_HISTORY_WWTEMP, EMS_Boiler.wWCurTmp);
+    }
+}
+
+/**
+ * UBAMonitorFast - type 0x18 - central heating monitor part 1 (25 bytes long)
+ * received every 10 seconds
+ */
+void _process_UBAMonitorFast(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getBoiler(src) == NULL) {
+        return; // not from our boiler
+    }
+
+    EMS_Boiler.selFlowTemp = _toByte(0);
+    EMS_Boiler.curFlowTemp = _toShort(1);
+    EMS_Boiler.retTemp     = _toShort(13);
+
+    EMS_Boiler.burnGas = _bitRead(7, 0);
+    EMS_Boiler.fanWork = _bitRead(7, 2);
+    EMS_Boiler.ignWork = _bitRead(7, 3);
+    EMS_Boiler.heatPmp = _bitRead(7, 5);
+    EMS_Boiler.wWHeat  = _bitRead(7, 6);
+    EMS_Boiler.wWCirc  = _bitRead(7, 7);
+
+    EMS_Boiler.curBurnPow = _toByte(4);
+    EMS_Boiler.selBurnPow = _toByte(3); // burn power max setting
+
+    EMS_Boiler.flameCurr = _toShort(15);
+
+    // read the service code / installation status as appears on the display
+    EMS_Boiler.serviceCodeChar[0] = char(_toByte(18)); // ascii character 1
+    EMS_Boiler.serviceCodeChar[1] = char(_toByte(19)); // ascii character 2
+    EMS_Boiler.serviceCodeChar[2] = '\0';              // null terminate string
+
+    // read error code
+    EMS_Boiler.serviceCode = _toShort(20);
+
+    // system pressure. FF means missing
+    EMS_Boiler.sysPress = _toByte(17); // this is *10
+
+    if (abs(EMS_Boiler.curFlowTemp) < EMS_VALUE_SHORT_NOTSET) {
+        ems_historyAdd(EMS_HISTORY_FLOWTEMP, EMS_Boiler.curFlowTemp);
+    }
+    if (abs(EMS_Boiler.retTemp) < EMS_VALUE_SHORT_NOTSET) {
+        ems_historyAdd(EMS_HISTORY_RETTEMP, EMS_Boiler.retTemp);
+    }
+    if (EMS_Boiler.curBurnPow != EMS_VALUE_INT_NOTSET) {
+        ems_historyAdd(EMS_HISTORY_BURNPOW, EMS_Boiler.curBurnPow * 10);
+    }
+    if (EMS_Boiler.sysPress != EMS_VALUE_INT_NOTSET) {
+        ems_historyAdd(EMS_HISTORY_SYSPRESS, EMS_Boiler.sysPress);
+    }
+
+    _burnerStatsFrame();
+    // lobocobra start read value
+    //EMS_Boiler.airInflow = _toByte(25);  nicht vorhanden = 8300 bei GB125
+    // lobocobra end
+    // at this point do a quick check to see if the hot water or heating is active
+    _checkActive();
+}
+
+/**
+ * UBAMonitorSlow - type 0x19 - central heating monitor part 2 (27 bytes long)
+ * received every 60 seconds
+ */
+void _process_UBAMonitorSlow(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getBoiler(src) == NULL) {
+        return; // not from our boiler
+    }
+
+    EMS_Boiler.extTemp     = _toShort(0); // 0x8000 if not available
+    EMS_Boiler.abgasTemp   = _toShort(4); // 0x8000 if not available
+    EMS_Boiler.boilTemp    = _toShort(2); // 0x8000 if not available
+    EMS_Boiler.pumpMod     = _toByte(9);
+    EMS_Boiler.burnStarts  = _toLong(10);
+    EMS_Boiler.burnWorkMin = _toLong(13);
+    EMS_Boiler.heatWorkMin = _toLong(19);
+
+    // the boiler counts every start, even those too short to be seen between two UBAMonitorFast
+    EMS_BurnerStats.startsLast = EMS_Boiler.burnStarts;
+    if (EMS_BurnerStats.startsFirst == EMS_VALUE_LONG_NOTSET) {
+        EMS_BurnerStats.startsFirst = EMS_Boiler.burnStarts;
+    }
+
+    if (abs(EMS_Boiler.extTemp) < EMS_VALUE_SHORT_NOTSET) {
+        ems_historyAdd(EMS_HISTORY_OUTDOORTEMP, EMS_Boiler.extTemp);
+    }
+}
+
+/**
+ * type 0xB1 - data from the RC10 thermostat (0x17)
+ * For reading the temp values only
+ * received every 60 seconds
+ * e.g. 17 0B 91 00 80 1E 00 CB 27 00 00 00 00 05 01 00 CB 00 (CRC=47), #data=14
+ */
+void _process_RC10StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device == NULL) {
+        return;
+    }
+    _EMS_Thermostat_HC * thermostat = &device->circuit[0]; // only has one heating circuit
+
+    thermostat->active            = true;
+    thermostat->setpoint_roomTemp = _toByte(EMS_OFFSET_RC10StatusMessage_setpoint); // is * 2
+    thermostat->curr_roomTemp     = _toByte(EMS_OFFSET_RC10StatusMessage_curr);     // is * 10
+
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+}
+
+/**
+ * type 0x91 - data from the RC20 thermostat (0x17) - 15 bytes long
+ * For reading the temp values only
+ * received every 60 seconds
+ */
+void _process_RC20StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device == NULL) {
+        return;
+    }
+    _EMS_Thermostat_HC * thermostat = &device->circuit[0]; // only has one heating circuit
+
+    thermostat->active            = true;
+    thermostat->setpoint_roomTemp = _toByte(EMS_OFFSET_RC20StatusMessage_setpoint); // is * 2
+    thermostat->curr_roomTemp     = _toShort(EMS_OFFSET_RC20StatusMessage_curr);    // is * 10
+
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+}
+
+/**
+ * type 0x41 - data from the RC30 thermostat(0x10) - 14 bytes long
+ * For reading the temp values only * received every 60 seconds 
+*/
+void _process_RC30StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device == NULL) {
+        return;
+    }
+    _EMS_Thermostat_HC * thermostat = &device->circuit[0]; // only has one heating circuit
+
+    thermostat->active            = true;
+    thermostat->setpoint_roomTemp = _toByte(EMS_OFFSET_RC30StatusMessage_setpoint); // is * 2
+    thermostat->curr_roomTemp     = _toShort(EMS_OFFSET_RC30StatusMessage_curr);    // note, its 2 bytes here
+
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+}
+
+/**
+ * type 0x3E, 0x48, 0x52 and 0x5C - data from the RC35 thermostat (0x10) - 16 bytes
+ * For reading the temp values only, one type per heating circuit (HC1-HC4)
+ * received every 60 seconds
+ */
+void _process_RC35StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device == NULL) {
+        return;
+    }
+    _EMS_Thermostat_HC * thermostat = &device->circuit[_getRC35Circuit(type) - 1];
+
+    thermostat->active            = true;
+    thermostat->setpoint_roomTemp = _toByte(EMS_OFFSET_RC35StatusMessage_setpoint); // is * 2
+
+    // check if temp sensor is unavailable
+    if (data[3] == 0x7D) {
+        thermostat->curr_roomTemp = EMS_VALUE_SHORT_NOTSET;
+    } else {
+        thermostat->curr_roomTemp = _toShort(EMS_OFFSET_RC35StatusMessage_curr);
+    }
+    if (device == &EMS_Thermostat) {
+        EMS_Thermostat.urlaub_modus = bitRead(data[0], 5); // get urlaub mode flag
+        EMS_Thermostat.sommer_modus = bitRead(data[EMS_OFFSET_RC35Get_mode_day], 0); // get sommer mode flag
+        EMS_Thermostat.max_vorlauf_reached = bitRead(data[EMS_OFFSET_RC35Get_mode_day], 5); // get max vorlauf flag
+    }
+    thermostat->day_mode        = bitRead(data[EMS_OFFSET_RC35Get_mode_day], 1); // get day mode flag
+
+    thermostat->circuitcalctemp = data[EMS_OFFSET_RC35Set_circuitcalctemp]; // 0x48 calculated temperature Vorlauf bit 14
+
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+}
+
+/**
+ * type 0x0A - data from the Nefit Easy/TC100 thermostat (0x18) - 31 bytes long
+ * The Easy has a digital precision of its floats to 2 decimal places, so values must be divided by 100
+ */
+void _process_EasyStatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device == NULL) {
+        return;
+    }
+    _EMS_Thermostat_HC * thermostat = &device->circuit[0]; // only has one heating circuit
+
+    thermostat->active            = true;
+    thermostat->curr_roomTemp     = _toShort(EMS_OFFSET_EasyStatusMessage_curr);     // is *100
+    thermostat->setpoint_roomTemp = _toShort(EMS_OFFSET_EasyStatusMessage_setpoint); // is *100
+
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+}
+
+/**
+ * type 0x00 - data from the Nefit RC1010 thermostat (0x18) - 24 bytes long
+ * The 1010 has a digital precision of its floats to 1 decimal places for the current temperature, so values is divided by 10
+ * The 1010 has a digital precision of its floats to 1 decimal places for the set temperature, so values is divided by 2
+ */
+void _process_RC1010StatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device == NULL) {
+        return;
+    }
+    _EMS_Thermostat_HC * thermostat = &device->circuit[0]; // only has one heating circuit
+
+    thermostat->active            = true;
+    thermostat->curr_roomTemp     = _toShort(EMS_OFFSET_RC1010StatusMessage_curr);
+    thermostat->setpoint_roomTemp = _toByte(EMS_OFFSET_RC1010StatusMessage_setpoint); // is * 2
+}
+
+void _process_RC1010SetMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    // to complete
+}
+
+/**
+ * type 0xB0 - for reading the mode from the RC10 thermostat (0x17)
+ * received only after requested
+ */
+void _process_RC10Set(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    // mode not implemented yet
+}
+
+/**
+ * type 0xA8 - for reading the mode from the RC20 thermostat (0x17)
+ * received only after requested
+ */
+void _process_RC20Set(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device != NULL) {
+        device->circuit[0].mode = _toByte(EMS_OFFSET_RC20Set_mode);
+    }
+}
+
+/**
+ * type 0xA7 - for reading the mode from the RC30 thermostat (0x10)
+ * received only after requested
+ */
+void _process_RC30Set(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device != NULL) {
+        device->circuit[0].mode = _toByte(EMS_OFFSET_RC30Set_mode);
+    }
+}
+
+/** lobocobra start
+ * type 0xA5 - for reading the mode from the RC35 thermostat (0x10)
+ * received only after requested
+ */
+void _process_AnlageParamSet(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getThermostat(src) != &EMS_Thermostat) {
+        return; // only kept for the main thermostat
+    }
+    EMS_Thermostat.minoutsidetemp   = _toByte(5);
+    EMS_Thermostat.housetype        = _toByte(6);
+    EMS_Thermostat.tempaveragebool  = _toByte(21); //send 0b 90 a5 15 01 (position 21= hex 15)
+    //myDebug("************************************* Anlageparamset %d",EMS_Thermostat.housetype);    
+}
+ /* type 0x49 - for reading the mode from the RC35 thermostat (0x10)
+ * received only after requested
+ */
+void _process_HK2Schaltzeiten(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getThermostat(src) != &EMS_Thermostat) {
+        return; // only kept for the main thermostat
+    }
+    EMS_Thermostat.pausezeit  = _toByte(1); //send 0b 90 49 55 01 (pos 1 as we read from 55)
+    EMS_Thermostat.partyzeit  = _toByte(2); //send 0b 90 49 56 01 (pos 2 as we read from 55)
+    //myDebug("*********************************** Pause h %d Party h %d",EMS_Thermostat.pausezeit,EMS_Thermostat.partyzeit);
+}
+// lobocobra end
+
+/**
+ * type 0x3D, 0x47, 0x51 and 0x5B - for reading the mode from the RC35 thermostat (0x10)
+ * Working Mode Heating Circuit 1 to 4 (HC1-HC4), each circuit has its own type
+ * received only after requested
+ */
+void _process_RC35Set(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * device = _ems_getThermostat(src);
+    if (device == NULL) {
+        return;
+    }
+    uint8_t              hc         = _getRC35Circuit(type);
+    _EMS_Thermostat_HC * thermostat = &device->circuit[hc - 1];
+
+    thermostat->active      = true;
+    thermostat->mode        = _toByte(EMS_OFFSET_RC35Set_mode);
+    thermostat->daytemp     = _toByte(EMS_OFFSET_RC35Set_temp_day);     // is * 2
+    thermostat->nighttemp   = _toByte(EMS_OFFSET_RC35Set_temp_night);   // is * 2
+    thermostat->holidaytemp = _toByte(EMS_OFFSET_RC35Set_temp_holiday); // is * 2
+    thermostat->heatingtype = _toByte(EMS_OFFSET_RC35Set_heatingtype);  // byte 0 bit floor heating = 3 0x47
+
+    //lobocobra start only read if we have 0x47, if not offset goes back 0 (only mqtt not in reality)
+    if ((hc == 2) && (device == &EMS_Thermostat)) {
+        EMS_Thermostat.roomoffset           = _toByte(06); 
+        EMS_Thermostat.sommerschwelletemp   = _toByte(22);  // 
+        EMS_Thermostat.minvorlauf           = _toByte(16);  // read max temp temp send 0b 90 47 10 01 !!Max Vorlauf is other region
+    // read offset temp at min outside temp send 0b 90 47 06 01  
+    }
+    //lobocobra end
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+}
+
+/**
+ * type 0xA3 - for external temp settings from the the RC* thermostats
+ */
+void _process_RCOutdoorTempMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    // add support here if you're reading external sensors
+}
+
+/*
+ * SM10Monitor - type 0x97
+ */
+void _process_SM10Monitor(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getOther(src) == NULL) {
+        return; // not from the SM10
+    }
+
+    EMS_Other.SM10collectorTemp  = _toShort(2);    // collector temp from SM10, is *10
+    EMS_Other.SM10bottomTemp     = _toShort(5);    // bottom temp from SM10, is *10
+    EMS_Other.SM10pumpModulation = _toByte(4);     // modulation solar pump
+    EMS_Other.SM10pump           = _bitRead(7, 1); // active if bit 1 is set
+
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+}
+
+/*
+ * MMStatusMessage - type 0xAB - flow temperatures and valve of the MM10 mixer module
+ */
+void _process_MMStatusMessage(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    if (_ems_getMixer(src) == NULL) {
+        return; // not from the MM10
+    }
+
+    EMS_Mixer.MM10        = true;
+    EMS_Mixer.flowSetTemp = _toByte(EMS_OFFSET_MMStatusMessage_flow_set);
+    EMS_Mixer.flowTemp    = _toShort(EMS_OFFSET_MMStatusMessage_flow_temp); // is *10
+    EMS_Mixer.pumpMod     = _toByte(EMS_OFFSET_MMStatusMessage_pump_mod);
+    EMS_Mixer.valveStatus = _toByte(EMS_OFFSET_MMStatusMessage_valve_status);
+
+    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+}
+
+/**
+ * UBASetPoint 0x1A
+ */
+void _process_SetPoints(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    
+    if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE) {
+        if (length != 0) {
+            uint8_t setpoint = data[0]; // flow temp
+            //uint8_t ww_power = data[2]; // power in %
+
+            /* this logic if the value is *2
+            char s[5];
+            char s2[5];
+            strlcpy(s, itoa(setpoint >> 1, s2, 10), 5);
+            strlcat(s, ".", sizeof(s));
+            strlcat(s, ((setpoint & 0x01) ? "5" : "0"), 5);
+            myDebug(" Boiler flow temp %s C, Warm Water power %d %", s, ww_power);
+            */
+
+            myDebug(" Boiler flow temperature is %d C", setpoint);
+        }
+    }
+    
+}
+
+/**
+ * process_RCTime - type 0x06 - date and time from a thermostat - 14 bytes long
+ * common for all thermostats
+ */
+void _process_RCTime(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    _EMS_Thermostat * thermostat = _ems_getThermostat(src);
+    if (thermostat == NULL) {
+        return;
+    }
+
+    if ((thermostat->model_id == EMS_MODEL_EASY) || (thermostat->model_id == EMS_MODEL_BOSCHEASY)) {
+        return; // not supported
+    }
+
+    thermostat->hour   = _toByte(2);
+    thermostat->minute = _toByte(4);
+    thermostat->second = _toByte(5);
+    thermostat->day    = _toByte(3);
+    thermostat->month  = _toByte(1);
+    thermostat->year   = _toByte(0);
+}
+
+/**
+ * type 0x02 - get the firmware version and type of an EMS device
+ * look up known devices via the product id and setup if not already set
+ * new devices are added to the device cache so we don't have to ask again after a restart
+ */
+void _process_Version(uint8_t src, uint16_t type, uint8_t * data, uint8_t length) {
+    // ignore short messages that we can't interpret
+    if (length < 3) {
+        return;
+    }
+
+    uint8_t product_id  = _toByte(0);
+    char    version[10] = {0};
+    snprintf(version, sizeof(version), "%02d.%02d", _toByte(1), _toByte(2));
+
+    bool added   = _addDeviceCache(src, product_id, version);
+    bool changed = _ems_identifyDevice(src, product_id, version);
+
+    if (added || changed) {
+        myESP.fs_requestSaveConfig(); // save config to SPIFFS once the bus has settled
+    }
+}
+
+/**
+ * set up a device from its product id, either from a Version telegram or the device cache
+ * returns true if the boiler or thermostat settings changed
+ */
+bool _ems_identifyDevice(uint8_t src, uint8_t product_id, const char * version) {
+    _bitmapSet(EMS_Discovery.identified, src);
+
+    // see if its a known boiler
+    int  i         = 0;
+    bool typeFound = false;
+    while (i < _Boiler_Types_max) {
+        if (Boiler_Types[i].product_id == product_id) {
+            typeFound = true; // we have a matching product id. i is the index.
+            break;
+        }
+        i++;
+    }
+
+    if (typeFound) {
+        // its a boiler
+        myDebug("Boiler found. Model %s (TypeID:0x%02X ProductID:%d Version:%s)",
+                Boiler_Types[i].model_string,
+                Boiler_Types[i].type_id,
+                product_id,
+                version);
+
+        // if its a boiler set it, unless it already has been set by checking for a productID
+        // it will take the first one found in the list
+        if (((EMS_Boiler.type_id == EMS_ID_NONE) || (EMS_Boiler.type_id == Boiler_Types[i].type_id)) && EMS_Boiler.product_id == EMS_ID_NONE) {
+            myDebug("* Setting Boiler to model %s (TypeID:0x%02X ProductID:%d Version:%s)",
+                    Boiler_Types[i].model_string,
+                    Boiler_Types[i].type_id,
+                    product_id,
+                    version);
+
+            EMS_Boiler.type_id    = Boiler_Types[i].type_id;
+            EMS_Boiler.product_id = Boiler_Types[i].product_id;
+            strlcpy(EMS_Boiler.version, version, sizeof(EMS_Boiler.version));
+
+            (void)_ems_addDevice(src, EMS_DEVICE_CLASS_BOILER, Boiler_Types[i].model_id, product_id, version);
+
+            ems_getBoilerValues(); // get Boiler values that we would usually have to wait for
+            return true;
+        }
+
+        // another boiler or boiler module, only tracked
+        (void)_ems_addDevice(src, EMS_DEVICE_CLASS_BOILER, Boiler_Types[i].model_id, product_id, version);
+        return false;
+    }
+
+    // its not a boiler, maybe its a known thermostat?
+    i = 0;
+    while (i < _Thermostat_Types_max) {
+        if (Thermostat_Types[i].product_id == product_id) {
+            typeFound = true; // we have a matching product id. i is the index.
+            break;
+        }
+        i++;
+    }
+
+    if (typeFound) {
+        // its a known thermostat
+        if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
+            myDebug("Thermostat found. Model %s (TypeID:0x%02X ProductID:%d Version:%s)",
+                    Thermostat_Types[i].model_string,
+                    Thermostat_Types[i].type_id,
+                    product_id,
+                    version);
+        }
+
+        // if we don't have a thermostat set, use this one
+        if (((EMS_Thermostat.type_id == EMS_ID_NONE) || (EMS_Thermostat.model_id == EMS_MODEL_NONE)
+             || (EMS_Thermostat.type_id == Thermostat_Types[i].type_id))
+            && EMS_Thermostat.product_id == EMS_ID_NONE) {
+            myDebug("* Setting Thermostat model to %s (TypeID:0x%02X ProductID:%d Version:%s)",
+                    Thermostat_Types[i].model_string,
+                    Thermostat_Types[i].type_id,
+                    product_id,
+                    version);
+
+            EMS_Thermostat.model_id        = Thermostat_Types[i].model_id;
+            EMS_Thermostat.type_id         = Thermostat_Types[i].type_id;
+            EMS_Thermostat.read_supported  = Thermostat_Types[i].read_supported;
+            EMS_Thermostat.write_supported = Thermostat_Types[i].write_supported;
+            EMS_Thermostat.product_id      = product_id;
+            strlcpy(EMS_Thermostat.version, version, sizeof(EMS_Thermostat.version));
+
+            _EMS_Device * device = _ems_addDevice(src, EMS_DEVICE_CLASS_THERMOSTAT, Thermostat_Types[i].model_id, product_id, version);
+            if (device != NULL) {
+                device->read_supported  = Thermostat_Types[i].read_supported;
+                device->write_supported = Thermostat_Types[i].write_supported;
+            }
+
+            // get Thermostat values (if supported)
+            ems_getThermostatValues();
+            return true;
+        }
+
+        // a further thermostat, e.g. a room unit on another heating circuit. Its values go in the pool
+        _EMS_Device * device = _ems_addDevice(src, EMS_DEVICE_CLASS_THERMOSTAT, Thermostat_Types[i].model_id, product_id, version);
+        if (device == NULL) {
+            myDebug("No room left for Thermostat 0x%02X", src);
+            return false;
+        }
+        device->read_supported  = Thermostat_Types[i].read_supported;
+        device->write_supported = Thermostat_Types[i].write_supported;
+
+        if ((device->state != NULL) && (device->state != &EMS_Thermostat)) {
+            _EMS_Thermostat * thermostat = (_EMS_Thermostat *)device->state;
+            thermostat->model_id         = Thermostat_Types[i].model_id;
+            thermostat->product_id       = product_id;
+            thermostat->read_supported   = Thermostat_Types[i].read_supported;
+            thermostat->write_supported  = Thermostat_Types[i].write_supported;
+            strlcpy(thermostat->version, version, sizeof(thermostat->version));
+            myDebug("* Adding Thermostat model %s at 0x%02X", Thermostat_Types[i].model_string, src);
+        }
+        return false;
+    }
+
+    // finally look for the other EMS devices
+    i = 0;
+    while (i < _Other_Types_max) {
+        if (Other_Types[i].product_id == product_id) {
+            typeFound = true; // we have a matching product id. i is the index.
+            break;
+        }
+        i++;
+    }
+
+    if (typeFound) {
+        myDebug("Device found. Model %s with TypeID 0x%02X, ProductID %d, Version %s",
+                Other_Types[i].model_string,
+                Other_Types[i].type_id,
+                product_id,
+                version);
+
+        (void)_ems_addDevice(src, EMS_DEVICE_CLASS_OTHER, Other_Types[i].model_id, product_id, version);
+
+        // see if this is a Solar Module SM10
+        if (Other_Types[i].type_id == EMS_ID_SM10) {
+            EMS_Other.SM10 = true; // we have detected a SM10
+            myDebug("SM10 Solar Module support enabled.");
+        }
+
+        // or a Mixer Module MM10
+        if (Other_Types[i].type_id == EMS_ID_MM10) {
+            EMS_Mixer.MM10 = true;
+            myDebug("MM10 Mixer Module support enabled.");
+        }
+
+        // fetch other values
+        ems_getOtherValues();
+        return false;
+
+    } else {
+        myDebug("Unrecognized device found. TypeID 0x%02X, ProductID %d, Version %s", src, product_id, version);
+
+        // keep it anyway, so telegram types we know from modules are still decoded
+        if (ems_getDevice(src) == NULL) {
+            (void)_ems_addDevice(src, EMS_DEVICE_CLASS_OTHER, EMS_MODEL_OTHER, product_id, version);
+        }
+    }
 
-    EMS_Boiler.burnGas = _bitRead(7, 0);
-    EMS_Boiler.fanWork = _bitRead(7, 2);
-    EMS_Boiler.ignWork = _bitRead(7, 3);
-    EMS_Boiler.heatPmp = _bitRead(7, 5);
-    EMS_Boiler.wWHeat  = _bitRead(7, 6);
-    EMS_Boiler.wWCirc  = _bitRead(7, 7);
+    return false;
+}
 
-    EMS_Boiler.curBurnPow = _toByte(4);
-    EMS_Boiler.selBurnPow = _toByte(3); // burn power max setting
+/*
+ * Figure out the boiler and thermostat types
+ */
+void ems_discoverModels() {
+    myDebug("Starting auto discover of EMS devices...");
 
-    EMS_Boiler.flameCurr = _toShort(15);
+    // set up the devices we found last time without asking them again
+    for (uint8_t i = 0; i < EMS_DeviceCache_count; i++) {
+        myDebug("Using cached device 0x%02X (ProductID:%d Version:%s)",
+                EMS_DeviceCache[i].type_id,
+                EMS_DeviceCache[i].product_id,
+                EMS_DeviceCache[i].version);
+        (void)_ems_identifyDevice(EMS_DeviceCache[i].type_id, EMS_DeviceCache[i].product_id, EMS_DeviceCache[i].version);
+    }
 
-    // read the service code / installation status as appears on the display
-    EMS_Boiler.serviceCodeChar[0] = char(_toByte(18)); // ascii character 1
-    EMS_Boiler.serviceCodeChar[1] = char(_toByte(19)); // ascii character 2
-    EMS_Boiler.serviceCodeChar[2] = '\0';              // null terminate string
+    // anything else is asked for its version in free poll windows as soon as it shows up on the bus
+    // the boiler, solar module and a configured thermostat are checked straight away
+    _bitmapSet(EMS_Discovery.probe, EMS_Boiler.type_id);
+    _bitmapSet(EMS_Discovery.probe, EMS_ID_SM10);
+    if (EMS_Thermostat.type_id != EMS_ID_NONE) {
+        _bitmapSet(EMS_Discovery.probe, EMS_Thermostat.type_id);
+    }
+}
 
-    // read error code
-    EMS_Boiler.serviceCode = _toShort(20);
+/**
+ * print which devices have been seen on the bus and which have been identified
+ */
+void ems_printDiscovery() {
+    myDebug("Devices seen on the EMS bus:");
+    for (uint8_t id = 1; id < 0x80; id++) {
+        if (_bitmapRead(EMS_Discovery.present, id) && (id != EMS_ID_ME)) {
+            myDebug(" 0x%02X %s",
+                    id,
+                    _bitmapRead(EMS_Discovery.identified, id) ? "identified" : (_bitmapRead(EMS_Discovery.requested, id) ? "no version" : "waiting"));
+        }
+    }
 
-    // system pressure. FF means missing
-    EMS_Boiler.sysPress = _toByte(17); // this is *10
-    // lobocobra start read value
-    //EMS_Boiler.airInflow = _toByte(25);  nicht vorhanden = 8300 bei GB125
-    // lobocobra end
-    // at this point do a quick check to see if the hot water or heating is active
-    _checkActive();
+    static const char * device_classes[] = {"?", "boiler", "thermostat", "other"};
+
+    myDebug("Device registry (%d/%d):", EMS_Devices_count, EMS_DEVICES_MAX);
+    for (uint8_t i = 0; i < EMS_Devices_count; i++) {
+        _EMS_Device * device = &EMS_Devices[i];
+        myDebug(" 0x%02X %s ProductID:%d Version:%s Read:%c Write:%c %s, %d telegram type%s",
+                device->device_id,
+                device_classes[device->device_class],
+                device->product_id,
+                device->version,
+                device->read_supported ? 'y' : 'n',
+                device->write_supported ? 'y' : 'n',
+                (device->state != NULL) ? "decoded" : "tracked",
+                device->shadow_count,
+                (device->shadow_count == 1) ? "" : "s");
+
+        for (uint8_t j = 0; j < device->shadow_count; j++) {
+            _EMS_DeviceShadow * shadow = &device->shadow[j];
+            myDebug("   type 0x%0*X offset %d #data=%d received %d times, last %d seconds ago",
+                    EMS_TYPE_DIGITS(shadow->type),
+                    shadow->type,
+                    shadow->offset,
+                    shadow->length,
+                    shadow->count,
+                    (millis() - shadow->timestamp) / 1000);
+        }
+    }
 }
 
 /**
- * UBAMonitorSlow - type 0x19 - central heating monitor part 2 (27 bytes long)
- * received every 60 seconds
+ * moves the bus health window on to the current slot, clearing the slots it skipped
  */
-void _process_UBAMonitorSlow(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Boiler.extTemp     = _toShort(0); // 0x8000 if not available
-    EMS_Boiler.abgasTemp   = _toShort(4); // 0x8000 if not available
-    EMS_Boiler.boilTemp    = _toShort(2); // 0x8000 if not available
-    EMS_Boiler.pumpMod     = _toByte(9);
-    EMS_Boiler.burnStarts  = _toLong(10);
-    EMS_Boiler.burnWorkMin = _toLong(13);
-    EMS_Boiler.heatWorkMin = _toLong(19);
+void _busStatsRotate() {
+    uint32_t now = millis();
+    uint8_t  n   = 0;
+
+    while (((now - EMS_BusStats.slotStart) >= EMS_BUSSTATS_SLOT_TIME) && (n < EMS_BUSSTATS_SLOTS)) {
+        EMS_BusStats.slot = (EMS_BusStats.slot + 1) % EMS_BUSSTATS_SLOTS;
+        memset(EMS_BusStats.window[EMS_BusStats.slot], 0, sizeof(EMS_BusStats.window[0]));
+        EMS_BusStats.slotStart += EMS_BUSSTATS_SLOT_TIME;
+        n++;
+    }
+
+    // been quiet for longer than the whole window
+    if ((now - EMS_BusStats.slotStart) >= EMS_BUSSTATS_SLOT_TIME) {
+        EMS_BusStats.slotStart = now;
+    }
 }
 
 /**
- * type 0xB1 - data from the RC10 thermostat (0x17)
- * For reading the temp values only
- * received every 60 seconds
- * e.g. 17 0B 91 00 80 1E 00 CB 27 00 00 00 00 05 01 00 CB 00 (CRC=47), #data=14
+ * count for the bus health, both since power on and in the current slot of the window
  */
-void _process_RC10StatusMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.setpoint_roomTemp = _toByte(EMS_OFFSET_RC10StatusMessage_setpoint); // is * 2
-    EMS_Thermostat.curr_roomTemp     = _toByte(EMS_OFFSET_RC10StatusMessage_curr);     // is * 10
+void _busStatsAdd(_EMS_BUSSTATS counter, uint32_t n) {
+    if (n == 0) {
+        return;
+    }
 
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+    _busStatsRotate();
+    EMS_BusStats.total[counter] += n;
+    EMS_BusStats.window[EMS_BusStats.slot][counter] += n;
 }
 
 /**
- * type 0x91 - data from the RC20 thermostat (0x17) - 15 bytes long
- * For reading the temp values only
- * received every 60 seconds
+ * the boiler polls the IDs in ascending order, so a lower ID starts a new poll round
+ * a round in which we weren't polled is a poll miss
  */
-void _process_RC20StatusMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.setpoint_roomTemp = _toByte(EMS_OFFSET_RC20StatusMessage_setpoint); // is * 2
-    EMS_Thermostat.curr_roomTemp     = _toShort(EMS_OFFSET_RC20StatusMessage_curr);    // is * 10
+void _busStatsPoll(uint8_t id) {
+    if (id <= EMS_BusStats.lastPoll) {
+        _busStatsAdd(EMS_BUSSTATS_POLLROUNDS);
+        if (!EMS_BusStats.polledMe) {
+            _busStatsAdd(EMS_BUSSTATS_POLLMISSES);
+        }
+        EMS_BusStats.polledMe = false;
+    }
 
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+    if (id == EMS_ID_ME) {
+        EMS_BusStats.polledMe = true;
+    }
+    EMS_BusStats.lastPoll = id;
 }
 
 /**
- * type 0x41 - data from the RC30 thermostat(0x10) - 14 bytes long
- * For reading the temp values only * received every 60 seconds 
-*/
-void _process_RC30StatusMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.setpoint_roomTemp = _toByte(EMS_OFFSET_RC30StatusMessage_setpoint); // is * 2
-    EMS_Thermostat.curr_roomTemp     = _toShort(EMS_OFFSET_RC30StatusMessage_curr);    // note, its 2 bytes here
+ * x10 % of part in total, 0 if there is no total
+ */
+uint16_t _busStatsRate(uint32_t part, uint32_t total) {
+    if (total == 0) {
+        return 0;
+    }
 
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+    uint32_t rate = (part * 1000) / total;
+    return (rate > 1000) ? 1000 : rate;
 }
 
 /**
- * type 0x3E and 0x48 - data from the RC35 thermostat (0x10) - 16 bytes
- * For reading the temp values only
- * received every 60 seconds
+ * a bus health counter since power on
+ */
+uint32_t ems_getBusTotal(_EMS_BUSSTATS counter) {
+    return EMS_BusStats.total[counter];
+}
+
+/**
+ * bus health over the last minute, or since power on if that's shorter
  */
-void _process_RC35StatusMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.setpoint_roomTemp = _toByte(EMS_OFFSET_RC35StatusMessage_setpoint); // is * 2
+void ems_getBusHealth(_EMS_BusHealth * health) {
+    uint32_t sum[EMS_BUSSTATS_MAX] = {0};
 
-    // check if temp sensor is unavailable
-    if (data[3] == 0x7D) {
-        EMS_Thermostat.curr_roomTemp = EMS_VALUE_SHORT_NOTSET;
-    } else {
-        EMS_Thermostat.curr_roomTemp = _toShort(EMS_OFFSET_RC35StatusMessage_curr);
+    _busStatsRotate();
+    for (uint8_t i = 0; i < EMS_BUSSTATS_SLOTS; i++) {
+        for (uint8_t j = 0; j < EMS_BUSSTATS_MAX; j++) {
+            sum[j] += EMS_BusStats.window[i][j];
+        }
     }
-    EMS_Thermostat.urlaub_modus = bitRead(data[0], 5); // get urlaub mode flag
-    EMS_Thermostat.sommer_modus = bitRead(data[EMS_OFFSET_RC35Get_mode_day], 0); // get sommer mode flag
-    EMS_Thermostat.day_mode = bitRead(data[EMS_OFFSET_RC35Get_mode_day], 1); // get day mode flag
-    EMS_Thermostat.max_vorlauf_reached = bitRead(data[EMS_OFFSET_RC35Get_mode_day], 5); // get max vorlauf flag
 
-    EMS_Thermostat.circuitcalctemp = data[EMS_OFFSET_RC35Set_circuitcalctemp]; // 0x48 calculated temperature Vorlauf bit 14
+    // the window is the full slots plus what we've had of the current one
+    uint32_t now    = millis();
+    uint32_t window = ((EMS_BUSSTATS_SLOTS - 1) * EMS_BUSSTATS_SLOT_TIME) + (now - EMS_BusStats.slotStart);
+    if ((now - EMS_BusStats.started) < window) {
+        window = now - EMS_BusStats.started;
+    }
+    if (window == 0) {
+        window = 1;
+    }
 
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+    health->framesPerSec  = (sum[EMS_BUSSTATS_FRAMES] * 10000) / window;
+    health->bytesPerSec   = (sum[EMS_BUSSTATS_BYTES] * 1000) / window;
+    health->load          = _busStatsRate(health->bytesPerSec, EMS_BUS_BYTES_PER_SECOND);
+    health->crcErrRate    = _busStatsRate(sum[EMS_BUSSTATS_CRCERR], sum[EMS_BUSSTATS_FRAMES]);
+    health->noiseRate     = _busStatsRate(sum[EMS_BUSSTATS_NOISE], sum[EMS_BUSSTATS_FRAMES]);
+    health->pollMissRate  = _busStatsRate(sum[EMS_BUSSTATS_POLLMISSES], sum[EMS_BUSSTATS_POLLROUNDS]);
+    health->writeFailRate = _busStatsRate(sum[EMS_BUSSTATS_WRITEFAILS], sum[EMS_BUSSTATS_WRITES]);
 }
 
 /**
- * type 0x0A - data from the Nefit Easy/TC100 thermostat (0x18) - 31 bytes long
- * The Easy has a digital precision of its floats to 2 decimal places, so values must be divided by 100
+ * update the burner counters with a new UBAMonitorFast, a constant amount of work per frame
+ * the time since the previous frame is counted in the state of that frame
  */
-void _process_EasyStatusMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.curr_roomTemp     = _toShort(EMS_OFFSET_EasyStatusMessage_curr);     // is *100
-    EMS_Thermostat.setpoint_roomTemp = _toShort(EMS_OFFSET_EasyStatusMessage_setpoint); // is *100
+void _burnerStatsFrame() {
+    _EMS_BurnerStats * b   = &EMS_BurnerStats;
+    uint32_t           now = millis();
+    bool               on  = (EMS_Boiler.burnGas == EMS_VALUE_INT_ON);
+
+    if (b->lastFrame != 0) {
+        uint32_t elapsed = now - b->lastFrame;
+        if (elapsed <= EMS_BURNER_MAX_GAP) {
+            b->time += elapsed;
+            if (b->on) {
+                uint8_t band = (b->power == 0) ? 0 : (b->power - 1) / (100 / EMS_BURNER_MOD_BANDS);
+                b->onTime += elapsed;
+                b->modTime[(band < EMS_BURNER_MOD_BANDS) ? band : (EMS_BURNER_MOD_BANDS - 1)] += elapsed;
+                b->powerTime += (uint64_t)b->power * elapsed;
+                if (b->deltaT != (int16_t)EMS_VALUE_SHORT_NOTSET) {
+                    b->deltaTTime += (int64_t)b->deltaT * elapsed;
+                    b->deltaTOnTime += elapsed;
+                }
+            }
+        } else {
+            b->changed = 0; // missed frames, so we don't know how long this cycle or pause was
+        }
 
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+        if (on != b->on) {
+            if (b->changed != 0) {
+                uint32_t duration = now - b->changed;
+                if (b->on) {
+                    b->cycleMin = ((b->cycles == 0) || (duration < b->cycleMin)) ? duration : b->cycleMin;
+                    b->cycleMax = (duration > b->cycleMax) ? duration : b->cycleMax;
+                    b->cycleSum += duration;
+                    b->cycles++;
+                } else {
+                    b->pauseSum += duration;
+                    b->pauses++;
+                }
+            }
+            if (on) {
+                b->starts++;
+            }
+            b->changed = now;
+        }
+    }
+
+    b->lastFrame = now;
+    b->on        = on;
+    b->power     = (EMS_Boiler.curBurnPow <= 100) ? EMS_Boiler.curBurnPow : 0;
+    if ((abs(EMS_Boiler.curFlowTemp) < EMS_VALUE_SHORT_NOTSET) && (abs(EMS_Boiler.retTemp) < EMS_VALUE_SHORT_NOTSET)) {
+        b->deltaT = EMS_Boiler.curFlowTemp - EMS_Boiler.retTemp;
+    } else {
+        b->deltaT = EMS_VALUE_SHORT_NOTSET;
+    }
 }
 
 /**
- * type 0x00 - data from the Nefit RC1010 thermostat (0x18) - 24 bytes long
- * The 1010 has a digital precision of its floats to 1 decimal places for the current temperature, so values is divided by 10
- * The 1010 has a digital precision of its floats to 1 decimal places for the set temperature, so values is divided by 2
+ * the burner figures of the current interval, so far
  */
-void _process_RC1010StatusMessage(uint8_t type, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.curr_roomTemp     = _toShort(EMS_OFFSET_RC1010StatusMessage_curr);
-    EMS_Thermostat.setpoint_roomTemp = _toByte(EMS_OFFSET_RC1010StatusMessage_setpoint); // is * 2
-}
+void ems_getBurnerSummary(_EMS_BurnerSummary * summary) {
+    _EMS_BurnerStats * b      = &EMS_BurnerStats;
+    uint32_t           time   = (b->time != 0) ? b->time : 1;
+    uint32_t           starts = b->starts;
 
-void _process_RC1010SetMessage(uint8_t type, uint8_t * data, uint8_t length) {
-    // to complete
+    if ((b->startsFirst != EMS_VALUE_LONG_NOTSET) && (b->startsLast != EMS_VALUE_LONG_NOTSET) && (b->startsLast >= b->startsFirst)) {
+        starts = b->startsLast - b->startsFirst;
+    }
+
+    summary->interval      = (millis() - b->intervalStart) / 1000;
+    summary->starts        = starts;
+    summary->startsPerHour = ((uint64_t)starts * 36000000) / time;
+    summary->duty          = ((uint64_t)b->onTime * 1000) / time;
+    summary->modulation    = (b->onTime != 0) ? b->powerTime / b->onTime : 0;
+    summary->cycles        = b->cycles;
+    summary->cycleAvg      = (b->cycles != 0) ? b->cycleSum / b->cycles / 1000 : 0;
+    summary->cycleMin      = b->cycleMin / 1000;
+    summary->cycleMax      = b->cycleMax / 1000;
+    summary->pauseAvg      = (b->pauses != 0) ? b->pauseSum / b->pauses / 1000 : 0;
+    summary->deltaT        = (b->deltaTOnTime != 0) ? b->deltaTTime / b->deltaTOnTime : EMS_VALUE_SHORT_NOTSET;
+
+    // % x ms x kW, to Wh
+    summary->energy      = (b->powerTime * EMS_BURNER_POWER) / 360000;
+    summary->energyTotal = ((b->energyTotal + b->powerTime) * EMS_BURNER_POWER) / 360000;
+    summary->gas         = (summary->energy * 10) / EMS_BURNER_GAS_KWH;
+
+    for (uint8_t i = 0; i < EMS_BURNER_MOD_BANDS; i++) {
+        summary->modBands[i] = (b->onTime != 0) ? ((uint64_t)b->modTime[i] * 100) / b->onTime : 0;
+    }
 }
 
 /**
- * type 0xB0 - for reading the mode from the RC10 thermostat (0x17)
- * received only after requested
+ * start a new interval for the burner figures, after they have been published
+ * the state of the burner and the energy since power on are kept
  */
-void _process_RC10Set(uint8_t src, uint8_t * data, uint8_t length) {
-    // mode not implemented yet
+void ems_startBurnerInterval() {
+    _EMS_BurnerStats * b = &EMS_BurnerStats;
+
+    b->energyTotal += b->powerTime;
+    b->intervalStart = millis();
+    b->startsFirst   = b->startsLast;
+    b->time          = 0;
+    b->onTime        = 0;
+    b->powerTime     = 0;
+    b->deltaTTime    = 0;
+    b->deltaTOnTime  = 0;
+    b->starts        = 0;
+    b->cycles        = 0;
+    b->cycleSum      = 0;
+    b->cycleMin      = 0;
+    b->cycleMax      = 0;
+    b->pauses        = 0;
+    b->pauseSum      = 0;
+    memset(b->modTime, 0, sizeof(b->modTime));
 }
 
 /**
- * type 0xA8 - for reading the mode from the RC20 thermostat (0x17)
- * received only after requested
+ * a sample for the history, in tenths. Called from the telegram processors and for the Dallas sensors
+ * it's only added to the current 10 second bucket, which is rolled up into the longer ones when it's closed
  */
-void _process_RC20Set(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.mode = _toByte(EMS_OFFSET_RC20Set_mode);
+void ems_historyAdd(_EMS_HISTORY value, int16_t sample) {
+    ems_historyLoop();
+
+    _EMS_HistorySamples * samples = &EMS_History[0].samples[value];
+    if (samples->count == 0) {
+        samples->min = sample;
+        samples->max = sample;
+    } else {
+        samples->min = (sample < samples->min) ? sample : samples->min;
+        samples->max = (sample > samples->max) ? sample : samples->max;
+    }
+    samples->sum += sample;
+    samples->count++;
 }
 
 /**
- * type 0xA7 - for reading the mode from the RC30 thermostat (0x10)
- * received only after requested
+ * close the buckets whose time is up, shortest tier first so its last bucket is in the longer ones
+ * an empty bucket is still stored, so the time of each bucket follows from its position
  */
-void _process_RC30Set(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.mode = _toByte(EMS_OFFSET_RC30Set_mode);
+void ems_historyLoop() {
+    uint32_t now = millis();
+
+    for (uint8_t tier = 0; tier < EMS_HISTORY_TIERS; tier++) {
+        _EMS_HistoryTier * t = &EMS_History[tier];
+        uint16_t           n = 0;
+
+        while (((now - t->bucketStart) >= t->bucketTime) && (n < (EMS_HISTORY_BYTES / 2))) {
+            _historyClose(tier);
+            t->bucketStart += t->bucketTime;
+            n++;
+        }
+
+        // been away for longer than the ring can hold, start again from now
+        if ((now - t->bucketStart) >= t->bucketTime) {
+            t->bucketStart = now;
+        }
+    }
 }
 
-/** lobocobra start
- * type 0xA5 - for reading the mode from the RC35 thermostat (0x10)
- * received only after requested
- */
-void _process_AnlageParamSet(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.minoutsidetemp   = _toByte(5);
-    EMS_Thermostat.housetype        = _toByte(6);
-    EMS_Thermostat.tempaveragebool  = _toByte(21); //send 0b 90 a5 15 01 (position 21= hex 15)
-    //myDebug("************************************* Anlageparamset %d",EMS_Thermostat.housetype);    
+// zigzag, so small negative differences are small numbers too
+uint8_t _historyPutVarint(uint8_t * buffer, int32_t value) {
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    uint8_t  n      = 0;
+
+    while (zigzag >= 0x80) {
+        buffer[n++] = (zigzag & 0x7F) | 0x80;
+        zigzag >>= 7;
+    }
+    buffer[n++] = zigzag;
+    return n;
 }
- /* type 0x49 - for reading the mode from the RC35 thermostat (0x10)
- * received only after requested
- */
-void _process_HK2Schaltzeiten(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.pausezeit  = _toByte(1); //send 0b 90 49 55 01 (pos 1 as we read from 55)
-    EMS_Thermostat.partyzeit  = _toByte(2); //send 0b 90 49 56 01 (pos 2 as we read from 55)
-    //myDebug("*********************************** Pause h %d Party h %d",EMS_Thermostat.pausezeit,EMS_Thermostat.partyzeit);
+
+// read a varint from the ring, pos is moved past it
+int32_t _historyGetVarint(_EMS_HistoryTier * t, uint16_t * pos) {
+    uint32_t zigzag = 0;
+    uint8_t  shift  = 0;
+    uint8_t  b;
+
+    do {
+        b = t->ring[*pos];
+        *pos = (*pos + 1) % EMS_HISTORY_BYTES;
+        zigzag |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while ((b & 0x80) && (shift < 32));
+
+    return (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
 }
-// lobocobra end
 
-/**
- * type 0x3D and 0x47 - for reading the mode from the RC35 thermostat (0x10)
- * Working Mode Heating Circuit 1 & 2 (HC1, HC2)
- * received only after requested
- */
-void _process_RC35Set(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Thermostat.mode = _toByte(EMS_OFFSET_RC35Set_mode);
-if (EMS_Thermostat.hc =2 && src != 71) {return; }; // lobocobra desperate attempt to avoid that status messages from 3d overwrite values if you are on HC2
-    EMS_Thermostat.daytemp              = _toByte(EMS_OFFSET_RC35Set_temp_day);     // is * 2
-    EMS_Thermostat.nighttemp            = _toByte(EMS_OFFSET_RC35Set_temp_night);   // is * 2
-    EMS_Thermostat.holidaytemp          = _toByte(EMS_OFFSET_RC35Set_temp_holiday); // is * 2
-    //lobocobra start only read if we have 0x47, if not offset goes back 0 (only mqtt not in reality)
-        EMS_Thermostat.roomoffset           = _toByte(06); 
-        EMS_Thermostat.heatingtype          = _toByte(EMS_OFFSET_RC35Set_heatingtype);  // byte 0 bit floor heating = 3 0x47
-        EMS_Thermostat.sommerschwelletemp   = _toByte(22);  // 
-        EMS_Thermostat.minvorlauf           = _toByte(16);  // read max temp temp send 0b 90 47 10 01 !!Max Vorlauf is other region
-    // read offset temp at min outside temp send 0b 90 47 06 01  
+// decode the bucket at pos, the values are deltas of what's in values. Returns the bitmap
+uint16_t _historyDecode(_EMS_HistoryTier * t, uint16_t * pos, int16_t values[][3]) {
+    uint16_t present = _historyGetVarint(t, pos);
 
-    //lobocobra end
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+    for (uint8_t i = 0; i < EMS_HISTORY_MAX; i++) {
+        if (present & (1 << i)) {
+            for (uint8_t j = 0; j < 3; j++) {
+                values[i][j] += _historyGetVarint(t, pos);
+            }
+        }
+    }
+
+    return present;
 }
 
 /**
- * type 0xA3 - for external temp settings from the the RC* thermostats
+ * store the current bucket of a tier and start a new one
+ * the oldest buckets are dropped to make room, their values become the base the next one is a delta of
  */
-void _process_RCOutdoorTempMessage(uint8_t src, uint8_t * data, uint8_t length) {
-    // add support here if you're reading external sensors
+void _historyClose(uint8_t tier) {
+    _EMS_HistoryTier * t = &EMS_History[tier];
+    uint8_t            record[EMS_HISTORY_RECORD_MAX];
+    uint16_t           present = 0;
+    uint8_t            length;
+
+    for (uint8_t i = 0; i < EMS_HISTORY_MAX; i++) {
+        if (t->samples[i].count != 0) {
+            present |= (1 << i);
+        }
+    }
+
+    length = _historyPutVarint(record, present);
+    for (uint8_t i = 0; i < EMS_HISTORY_MAX; i++) {
+        _EMS_HistorySamples * samples = &t->samples[i];
+        if (samples->count == 0) {
+            continue;
+        }
+
+        int16_t bucket[3] = {samples->min, (int16_t)(samples->sum / samples->count), samples->max};
+        for (uint8_t j = 0; j < 3; j++) {
+            length += _historyPutVarint(&record[length], bucket[j] - t->last[i][j]);
+            t->last[i][j] = bucket[j];
+        }
+
+        // roll up into the next tier, the average there is weighted by the # samples
+        if (tier < (EMS_HISTORY_TIERS - 1)) {
+            _EMS_HistorySamples * next = &EMS_History[tier + 1].samples[i];
+            if (next->count == 0) {
+                next->min = samples->min;
+                next->max = samples->max;
+            } else {
+                next->min = (samples->min < next->min) ? samples->min : next->min;
+                next->max = (samples->max > next->max) ? samples->max : next->max;
+            }
+            next->sum += samples->sum;
+            next->count += samples->count;
+        }
+    }
+
+    memset(t->samples, 0, sizeof(t->samples));
+
+    // make room
+    while ((t->used + length) > EMS_HISTORY_BYTES) {
+        uint16_t pos = t->head;
+        _historyDecode(t, &pos, t->base);
+        t->used -= (pos + EMS_HISTORY_BYTES - t->head) % EMS_HISTORY_BYTES;
+        t->head = pos;
+        t->buckets--;
+    }
+
+    uint16_t pos = (t->head + t->used) % EMS_HISTORY_BYTES;
+    for (uint8_t i = 0; i < length; i++) {
+        t->ring[(pos + i) % EMS_HISTORY_BYTES] = record[i];
+    }
+    t->used += length;
+    t->buckets++;
 }
 
-/*
- * SM10Monitor - type 0x97
+/**
+ * start reading the buckets of a tier from the oldest, with ems_historyNext()
  */
-void _process_SM10Monitor(uint8_t src, uint8_t * data, uint8_t length) {
-    EMS_Other.SM10collectorTemp  = _toShort(2);    // collector temp from SM10, is *10
-    EMS_Other.SM10bottomTemp     = _toShort(5);    // bottom temp from SM10, is *10
-    EMS_Other.SM10pumpModulation = _toByte(4);     // modulation solar pump
-    EMS_Other.SM10pump           = _bitRead(7, 1); // active if bit 1 is set
+void ems_historyFirst(_EMS_HistoryBucket * bucket, uint8_t tier) {
+    _EMS_HistoryTier * t = &EMS_History[tier];
 
-    EMS_Sys_Status.emsRefreshed = true; // triggers a send the values back via MQTT
+    bucket->tier  = tier;
+    bucket->pos   = t->head;
+    bucket->index = 0;
+    memcpy(bucket->value, t->base, sizeof(bucket->value));
 }
 
 /**
- * UBASetPoint 0x1A
+ * the next bucket, false when there are no more
+ * values that had no samples in the bucket keep what they were before, check present
  */
-void _process_SetPoints(uint8_t src, uint8_t * data, uint8_t length) {
-    
-    if (EMS_Sys_Status.emsLogging == EMS_SYS_LOGGING_VERBOSE) {
-        if (length != 0) {
-            uint8_t setpoint = data[0]; // flow temp
-            //uint8_t ww_power = data[2]; // power in %
+bool ems_historyNext(_EMS_HistoryBucket * bucket) {
+    _EMS_HistoryTier * t = &EMS_History[bucket->tier];
 
-            /* this logic if the value is *2
-            char s[5];
-            char s2[5];
-            strlcpy(s, itoa(setpoint >> 1, s2, 10), 5);
-            strlcat(s, ".", sizeof(s));
-            strlcat(s, ((setpoint & 0x01) ? "5" : "0"), 5);
-            myDebug(" Boiler flow temp %s C, Warm Water power %d %", s, ww_power);
-            */
+    if (bucket->index >= t->buckets) {
+        return false;
+    }
 
-            myDebug(" Boiler flow temperature is %d C", setpoint);
+    bucket->present = _historyDecode(t, &bucket->pos, bucket->value);
+    bucket->index++;
+    return true;
+}
+
+/**
+ * tier from its name, e.g. "1m", or -1
+ */
+int8_t ems_historyFindTier(const char * name) {
+    for (uint8_t i = 0; i < EMS_HISTORY_TIERS; i++) {
+        if (strcmp(name, EMS_HistoryTierNames[i]) == 0) {
+            return i;
         }
     }
-    
+    return -1;
 }
 
 /**
- * process_RCTime - type 0x06 - date and time from a thermostat - 14 bytes long
- * common for all thermostats
+ * value from its name, the same as the keys in the JSON packages, e.g. "curFlowTemp", or -1
+ * the Dallas sensors are temp_1, temp_2, ... like in the sensors package
  */
-void _process_RCTime(uint8_t src, uint8_t * data, uint8_t length) {
-    if ((EMS_Thermostat.model_id == EMS_MODEL_EASY) || (EMS_Thermostat.model_id == EMS_MODEL_BOSCHEASY)) {
-        return; // not supported
+int8_t ems_historyFindValue(const char * name) {
+    for (uint8_t i = 0; i < EMS_HISTORY_SENSOR1; i++) {
+        if (strcmp(name, EMS_HistoryValueNames[i]) == 0) {
+            return i;
+        }
+    }
+
+    if ((strncmp(name, "temp_", 5) == 0) && (name[5] >= '1') && (name[5] < ('1' + EMS_HISTORY_SENSORS_MAX)) && (name[6] == '\0')) {
+        return EMS_HISTORY_SENSOR1 + (name[5] - '1');
     }
 
-    EMS_Thermostat.hour   = _toByte(2);
-    EMS_Thermostat.minute = _toByte(4);
-    EMS_Thermostat.second = _toByte(5);
-    EMS_Thermostat.day    = _toByte(3);
-    EMS_Thermostat.month  = _toByte(1);
-    EMS_Thermostat.year   = _toByte(0);
+    return -1;
+}
+
+const char * ems_historyTierName(uint8_t tier) {
+    return EMS_HistoryTierNames[tier];
+}
+
+const char * ems_historyValueName(uint8_t value) {
+    static char name[8];
+
+    if (value < EMS_HISTORY_SENSOR1) {
+        return EMS_HistoryValueNames[value];
+    }
+
+    snprintf(name, sizeof(name), "temp_%d", value - EMS_HISTORY_SENSOR1 + 1);
+    return name;
 }
 
 /**
- * type 0x02 - get the firmware version and type of an EMS device
- * look up known devices via the product id and setup if not already set
+ * print the buckets of a tier for one value, or how full each tier is if value is -1
  */
-void _process_Version(uint8_t src, uint8_t * data, uint8_t length) {
-    // ignore short messages that we can't interpret
-    if (length < 3) {
+void ems_printHistory(uint8_t tier, int8_t value) {
+    _EMS_HistoryBucket bucket;
+    char               s[3][10];
+
+    if (value < 0) {
+        for (uint8_t i = 0; i < EMS_HISTORY_TIERS; i++) {
+            _EMS_HistoryTier * t = &EMS_History[i];
+            myDebug("  %-3s %d buckets (%d minutes) in %d of %d bytes, %d.%d bytes per bucket",
+                    EMS_HistoryTierNames[i],
+                    t->buckets,
+                    (t->buckets * (t->bucketTime / 1000)) / 60,
+                    t->used,
+                    EMS_HISTORY_BYTES,
+                    t->buckets ? t->used / t->buckets : 0,
+                    t->buckets ? ((t->used * 10) / t->buckets) % 10 : 0);
+        }
         return;
     }
 
-    uint8_t product_id  = _toByte(0);
-    char    version[10] = {0};
-    snprintf(version, sizeof(version), "%02d.%02d", _toByte(1), _toByte(2));
+    uint32_t age = (millis() - EMS_History[tier].bucketStart) / 1000; // since the newest bucket was closed
+    myDebug("%s every %s, newest closed %d seconds ago:", ems_historyValueName(value), EMS_HistoryTierNames[tier], age);
+    myDebug("  seconds ago       min       avg       max");
 
-    // see if its a known boiler
-    int  i         = 0;
-    bool typeFound = false;
-    while (i < _Boiler_Types_max) {
-        if (Boiler_Types[i].product_id == product_id) {
-            typeFound = true; // we have a matching product id. i is the index.
-            break;
+    ems_historyFirst(&bucket, tier);
+    uint16_t buckets = EMS_History[tier].buckets;
+    while (ems_historyNext(&bucket)) {
+        if (!(bucket.present & (1 << value))) {
+            continue;
         }
-        i++;
+        for (uint8_t j = 0; j < 3; j++) {
+            int16_t v = bucket.value[value][j];
+            snprintf(s[j], sizeof(s[j]), "%s%d.%d", (v < 0) ? "-" : "", abs(v) / 10, abs(v) % 10);
+        }
+        myDebug("  %11d %9s %9s %9s", age + (buckets - bucket.index) * (EMS_History[tier].bucketTime / 1000), s[0], s[1], s[2]);
     }
+}
 
-    if (typeFound) {
-        // its a boiler
-        myDebug("Boiler found. Model %s (TypeID:0x%02X ProductID:%d Version:%s)",
-                Boiler_Types[i].model_string,
-                Boiler_Types[i].type_id,
-                product_id,
-                version);
-
-        // if its a boiler set it, unless it already has been set by checking for a productID
-        // it will take the first one found in the list
-        if (((EMS_Boiler.type_id == EMS_ID_NONE) || (EMS_Boiler.type_id == Boiler_Types[i].type_id)) && EMS_Boiler.product_id == EMS_ID_NONE) {
-            myDebug("* Setting Boiler to model %s (TypeID:0x%02X ProductID:%d Version:%s)",
-                    Boiler_Types[i].model_string,
-                    Boiler_Types[i].type_id,
-                    product_id,
-                    version);
-
-            EMS_Boiler.type_id    = Boiler_Types[i].type_id;
-            EMS_Boiler.product_id = Boiler_Types[i].product_id;
-            strlcpy(EMS_Boiler.version, version, sizeof(EMS_Boiler.version));
-
-            myESP.fs_saveConfig(); // save config to SPIFFS
-
-            ems_getBoilerValues(); // get Boiler values that we would usually have to wait for
+/**
+ * count a valid telegram in the sniffer statistics
+ * the slot is found by hashing sender and type and probing linearly, so any type is tracked, decoded or not
+ * the CRC32 of the data is used to see if the contents changed since the last one
+ */
+void _snifferRecord(_EMS_RxTelegram * EMS_RxTelegram) {
+    uint8_t * telegram = EMS_RxTelegram->telegram;
+    uint8_t   src      = telegram[0] & 0x7F;
+    uint16_t  type     = EMS_RxTelegram->type;
+    uint32_t  crc      = EMS_RxTelegram->data_crc;
+    uint8_t   slot     = ((src * 31) ^ type ^ (type >> 8)) & (EMS_SNIFFER_SIZE - 1);
+
+    EMS_Sniffer.telegrams++;
+
+    for (uint8_t i = 0; i < EMS_SNIFFER_SIZE; i++) {
+        _EMS_SnifferEntry * entry = &EMS_Sniffer.table[slot];
+
+        if (entry->src == EMS_ID_NONE) {
+            // first time we see this one
+            entry->src        = src;
+            entry->type       = type;
+            entry->length     = EMS_RxTelegram->data_length;
+            entry->crc        = crc;
+            entry->count      = 1;
+            entry->changes    = 0;
+            entry->first_seen = EMS_RxTelegram->timestamp;
+            entry->last_seen  = EMS_RxTelegram->timestamp;
+            EMS_Sniffer.used++;
+            return;
         }
-        return;
-    }
 
-    // its not a boiler, maybe its a known thermostat?
-    i = 0;
-    while (i < _Thermostat_Types_max) {
-        if (Thermostat_Types[i].product_id == product_id) {
-            typeFound = true; // we have a matching product id. i is the index.
-            break;
+        if ((entry->src == src) && (entry->type == type)) {
+            if (entry->crc != crc) {
+                entry->changes++;
+                entry->crc = crc;
+            }
+            if (entry->count < 0xFFFF) {
+                entry->count++;
+            }
+            entry->length    = EMS_RxTelegram->data_length;
+            entry->last_seen = EMS_RxTelegram->timestamp;
+            return;
         }
-        i++;
+
+        slot = (slot + 1) & (EMS_SNIFFER_SIZE - 1);
     }
 
-    if (typeFound) {
-        // its a known thermostat
-        if (EMS_Sys_Status.emsLogging >= EMS_SYS_LOGGING_BASIC) {
-            myDebug("Thermostat found. Model %s (TypeID:0x%02X ProductID:%d Version:%s)",
-                    Thermostat_Types[i].model_string,
-                    Thermostat_Types[i].type_id,
-                    product_id,
-                    version);
-        }
+    EMS_Sniffer.dropped++; // table is full
+}
 
-        // if we don't have a thermostat set, use this one
-        if (((EMS_Thermostat.type_id == EMS_ID_NONE) || (EMS_Thermostat.model_id == EMS_MODEL_NONE)
-             || (EMS_Thermostat.type_id == Thermostat_Types[i].type_id))
-            && EMS_Thermostat.product_id == EMS_ID_NONE) {
-            myDebug("* Setting Thermostat model to %s (TypeID:0x%02X ProductID:%d Version:%s)",
-                    Thermostat_Types[i].model_string,
-                    Thermostat_Types[i].type_id,
-                    product_id,
-                    version);
+/**
+ * start or stop the sniffer
+ * listenOnly also stops us from transmitting while it runs, so the statistics only show the other devices
+ */
+void ems_setSniffer(bool enabled, bool listenOnly) {
+    if (enabled && !EMS_Sniffer.enabled) {
+        ems_clearSniffer();
+    }
 
-            EMS_Thermostat.model_id        = Thermostat_Types[i].model_id;
-            EMS_Thermostat.type_id         = Thermostat_Types[i].type_id;
-            EMS_Thermostat.read_supported  = Thermostat_Types[i].read_supported;
-            EMS_Thermostat.write_supported = Thermostat_Types[i].write_supported;
-            EMS_Thermostat.product_id      = product_id;
-            strlcpy(EMS_Thermostat.version, version, sizeof(EMS_Thermostat.version));
+    // give back the Tx setting we had before
+    if (EMS_Sniffer.listenOnly && (!enabled || !listenOnly)) {
+        EMS_Sys_Status.emsTxDisabled = EMS_Sniffer.txWasDisabled;
+        EMS_Sniffer.listenOnly       = false;
+    }
 
-            myESP.fs_saveConfig(); // save config to SPIFFS
+    if (enabled && listenOnly && !EMS_Sniffer.listenOnly) {
+        EMS_Sniffer.txWasDisabled    = EMS_Sys_Status.emsTxDisabled;
+        EMS_Sniffer.listenOnly       = true;
+        EMS_Sys_Status.emsTxDisabled = true;
+    }
 
-            // get Thermostat values (if supported)
-            ems_getThermostatValues();
-        }
-        return;
+    EMS_Sniffer.enabled = enabled;
+}
+
+/**
+ * wipe the sniffer statistics and start counting again
+ */
+void ems_clearSniffer() {
+    memset(EMS_Sniffer.table, 0, sizeof(EMS_Sniffer.table));
+    for (uint8_t i = 0; i < EMS_SNIFFER_SIZE; i++) {
+        EMS_Sniffer.table[i].src = EMS_ID_NONE;
     }
+    EMS_Sniffer.since     = millis();
+    EMS_Sniffer.telegrams = 0;
+    EMS_Sniffer.bytes     = 0;
+    EMS_Sniffer.dropped   = 0;
+    EMS_Sniffer.used      = 0;
+}
 
-    // finally look for the other EMS devices
-    i = 0;
-    while (i < _Other_Types_max) {
-        if (Other_Types[i].product_id == product_id) {
-            typeFound = true; // we have a matching product id. i is the index.
-            break;
-        }
-        i++;
+/**
+ * bus load in % since the sniffer statistics were cleared
+ */
+uint8_t ems_getSnifferLoad() {
+    uint32_t elapsed = (millis() - EMS_Sniffer.since) / 1000;
+    if (elapsed == 0) {
+        return 0;
     }
 
-    if (typeFound) {
-        myDebug("Device found. Model %s with TypeID 0x%02X, ProductID %d, Version %s",
-                Other_Types[i].model_string,
-                Other_Types[i].type_id,
-                product_id,
-                version);
+    // in 64 bits, as bytes * 100 no longer fits in 32 after about 43M bytes, a day or so of sniffing
+    uint32_t load = ((uint64_t)EMS_Sniffer.bytes * 100) / ((uint64_t)elapsed * EMS_BUS_BYTES_PER_SECOND);
+    return (load > 100) ? 100 : load;
+}
 
-        // see if this is a Solar Module SM10
-        if (Other_Types[i].type_id == EMS_ID_SM10) {
-            EMS_Other.SM10 = true; // we have detected a SM10
-            myDebug("SM10 Solar Module support enabled.");
-        }
+/**
+ * fills slots with the table positions of the most frequent telegram types, busiest first
+ * returns the # found
+ */
+uint8_t ems_getSnifferTop(uint8_t * slots, uint8_t max) {
+    uint8_t found = 0;
 
-        // fetch other values
-        ems_getOtherValues();
-        return;
+    for (uint8_t i = 0; i < EMS_SNIFFER_SIZE; i++) {
+        if (EMS_Sniffer.table[i].src == EMS_ID_NONE) {
+            continue;
+        }
 
-    } else {
-        myDebug("Unrecognized device found. TypeID 0x%02X, ProductID %d, Version %s", src, product_id, version);
+        // insertion into the sorted list, dropping the last one when full
+        uint8_t j = (found < max) ? found++ : max;
+        while ((j > 0) && (EMS_Sniffer.table[slots[j - 1]].count < EMS_Sniffer.table[i].count)) {
+            if (j < max) {
+                slots[j] = slots[j - 1];
+            }
+            j--;
+        }
+        if (j < max) {
+            slots[j] = i;
+        }
     }
+
+    return found;
 }
 
-/*
- * Figure out the boiler and thermostat types
+/**
+ * print the sniffer statistics, sorted by sender and type
  */
-void ems_discoverModels() {
-    myDebug("Starting auto discover of EMS devices...");
+void ems_printSniffer() {
+    uint32_t now = millis();
+
+    myDebug("Sniffer is %s%s, %d telegrams in %d seconds, bus load %d%%, %d/%d types%s",
+            EMS_Sniffer.enabled ? "on" : "off",
+            EMS_Sniffer.listenOnly ? " (listen only)" : "",
+            EMS_Sniffer.telegrams,
+            (now - EMS_Sniffer.since) / 1000,
+            ems_getSnifferLoad(),
+            EMS_Sniffer.used,
+            EMS_SNIFFER_SIZE,
+            (EMS_Sniffer.dropped != 0) ? " (table full, some were not counted)" : "");
+
+    if (EMS_Sniffer.used == 0) {
+        return;
+    }
 
-    // boiler
-    ems_doReadCommand(EMS_TYPE_Version, EMS_Boiler.type_id); // get version details of boiler
+    // sort the slots in use on sender and type
+    uint8_t slots[EMS_SNIFFER_SIZE];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < EMS_SNIFFER_SIZE; i++) {
+        _EMS_SnifferEntry * entry = &EMS_Sniffer.table[i];
+        if (entry->src == EMS_ID_NONE) {
+            continue;
+        }
 
-    // solar module
-    ems_doReadCommand(EMS_TYPE_Version, EMS_ID_SM10); // check if there is Solar Module available
+        uint32_t key = ((uint32_t)entry->src << 16) | entry->type;
+        uint8_t  j   = n++;
+        while ((j > 0) && ((((uint32_t)EMS_Sniffer.table[slots[j - 1]].src << 16) | EMS_Sniffer.table[slots[j - 1]].type) > key)) {
+            slots[j] = slots[j - 1];
+            j--;
+        }
+        slots[j] = i;
+    }
 
-    // thermostat
-    // if it hasn't been set, auto discover it
-    if (EMS_Thermostat.type_id == EMS_ID_NONE) {
-        ems_scanDevices(); // auto-discover it
-    } else {
-        // set the model as hardcoded (see my_devices.h) and fetch the version and product id
-        ems_doReadCommand(EMS_TYPE_Version, EMS_Thermostat.type_id);
+    myDebug(" src  type  count  changed  #data  every  last seen");
+    for (uint8_t i = 0; i < n; i++) {
+        _EMS_SnifferEntry * entry = &EMS_Sniffer.table[slots[i]];
+        uint32_t interval         = (entry->count > 1) ? (entry->last_seen - entry->first_seen) / (entry->count - 1) / 1000 : 0;
+
+        myDebug(" 0x%02X 0x%-4X %6d %6d%% %6d %5ds %6ds ago%s",
+                entry->src,
+                entry->type,
+                entry->count,
+                (entry->count > 1) ? (entry->changes * 100) / (entry->count - 1) : 0,
+                entry->length,
+                interval,
+                (now - entry->last_seen) / 1000,
+                (_ems_findDeviceType(ems_getDevice(entry->src), entry->type) == -1) ? " (not decoded)" : "");
     }
 }
 
@@ -1586,11 +3903,12 @@ void ems_printTxQueue() {
                  (uint8_t)((upt / (1000 * 60)) % 60),
                  (uint8_t)((upt / 1000) % 60));
 
-        myDebug(" [%d] action=%s dest=0x%02x type=0x%02x offset=%d length=%d dataValue=%d "
-                "comparisonValue=%d type_validate=0x%02x comparisonPostRead=0x%02x @ %s",
+        myDebug(" [%d] action=%s dest=0x%02x type=0x%0*x offset=%d length=%d dataValue=%d "
+                "comparisonValue=%d type_validate=0x%02x comparisonPostRead=0x%02x retries=%d @ %s",
                 i + 1,
                 sType,
                 EMS_TxTelegram.dest & 0x7F,
+                EMS_TYPE_DIGITS(EMS_TxTelegram.type),
                 EMS_TxTelegram.type,
                 EMS_TxTelegram.offset,
                 EMS_TxTelegram.length,
@@ -1598,10 +3916,175 @@ void ems_printTxQueue() {
                 EMS_TxTelegram.comparisonValue,
                 EMS_TxTelegram.type_validate,
                 EMS_TxTelegram.comparisonPostRead,
+                EMS_TxTelegram.retryCount,
                 addedTime);
     }
 }
 
+/**
+ * print the Tx statistics per device
+ */
+void ems_printTxDeviceStats() {
+    for (uint8_t i = 0; i < EMS_TxDeviceStats_count; i++) {
+        _EMS_TxDeviceStats * stats = &EMS_TxDeviceStats[i];
+        myDebug("  Tx device 0x%02X: sent=%d, answered=%d, failed=%d, response avg=%d ms max=%d ms, timeout=%d ms%s",
+                stats->dest,
+                stats->sent,
+                stats->success,
+                stats->failed,
+                stats->latencyAvg,
+                stats->latencyMax,
+                _txDeviceTimeout(stats->dest),
+                (stats->backoffUntil != 0) ? ", backing off" : "");
+    }
+}
+
+/**
+ * the poll entry of a type, created with its policy the first time it's read
+ * NULL if the table is full
+ */
+_EMS_PollEntry * _pollFind(uint8_t dest, uint16_t type, uint8_t offset, bool create) {
+    for (uint8_t i = 0; i < EMS_Poll_count; i++) {
+        if ((EMS_Poll[i].dest == dest) && (EMS_Poll[i].type == type) && (EMS_Poll[i].offset == offset)) {
+            return &EMS_Poll[i];
+        }
+    }
+
+    if (!create || (EMS_Poll_count >= EMS_POLL_MAX)) {
+        return NULL;
+    }
+
+    const _EMS_PollPolicy * policy = &EMS_PollDefault;
+    for (uint8_t i = 0; i < ArraySize(EMS_PollPolicies); i++) {
+        if (EMS_PollPolicies[i].type == type) {
+            policy = &EMS_PollPolicies[i];
+            break;
+        }
+    }
+
+    _EMS_PollEntry * entry = &EMS_Poll[EMS_Poll_count++];
+    memset(entry, 0, sizeof(_EMS_PollEntry));
+    entry->dest     = dest;
+    entry->type     = type;
+    entry->offset   = offset;
+    entry->minAge   = policy->minAge;
+    entry->maxAge   = policy->maxAge;
+    entry->interval = policy->minAge;
+    return entry;
+}
+
+/**
+ * read a type. When called from ems_pollDue() only if it's due:
+ * the values are older than the interval, we haven't asked within minAge and the Tx queue isn't busy
+ */
+void _pollRead(uint16_t type, uint8_t dest, uint8_t offset) {
+    if ((type == EMS_ID_NONE) || (dest == EMS_ID_NONE)) {
+        return;
+    }
+
+    uint32_t         now   = millis();
+    _EMS_PollEntry * entry = _pollFind(dest, type, offset, true);
+
+    if (EMS_PollScheduled) {
+        if ((entry == NULL) || (EMS_TxQueue.size() > EMS_POLL_QUEUE_MAX)) {
+            return;
+        }
+        if ((entry->refreshed != 0) && ((now - entry->refreshed) < entry->interval)) {
+            return; // still fresh, e.g. from a broadcast
+        }
+        if ((entry->polled != 0) && ((now - entry->polled) < entry->minAge)) {
+            return; // asked recently and no answer yet
+        }
+    }
+
+    bool queued;
+    if (offset == 0) {
+        queued = ems_doReadCommand(type, dest);
+    } else {
+        // ems_doReadCommand() always reads from the start
+        char telegram[25];
+        if (type >= EMS_TYPE_PLUS) {
+            snprintf(telegram, sizeof(telegram), "%02X %02X FF %02X %02X %02X %02X", EMS_ID_ME, dest | 0x80, offset, EMS_POLL_PARTIAL_LENGTH, type >> 8, type & 0xFF);
+        } else {
+            snprintf(telegram, sizeof(telegram), "%02X %02X %02X %02X %02X", EMS_ID_ME, dest | 0x80, type, offset, EMS_POLL_PARTIAL_LENGTH);
+        }
+        queued = (ems_sendRawTelegram(telegram) == EMS_RAW_OK);
+    }
+
+    // a read that wasn't queued, e.g. with Tx disabled or the queue full, is tried again on the next round
+    if (queued && (entry != NULL)) {
+        entry->polled = now;
+        entry->polls++;
+    }
+}
+
+/**
+ * a type was received, as a broadcast or the answer to a read
+ * if the values changed it's read more often, down to minAge, and if not less, up to maxAge
+ */
+void _pollReceived(uint8_t src, uint16_t type, uint8_t offset, uint32_t crc) {
+    _EMS_PollEntry * entry = _pollFind(src, type, offset, false);
+    if (entry == NULL) {
+        return;
+    }
+
+    if ((entry->received != 0) && (crc != entry->crc)) {
+        entry->interval = entry->interval / 2;
+    } else {
+        entry->interval += entry->interval / 2;
+    }
+    entry->interval = (entry->interval < entry->minAge) ? entry->minAge : entry->interval;
+    entry->interval = (entry->interval > entry->maxAge) ? entry->maxAge : entry->interval;
+
+    entry->refreshed = millis();
+    entry->crc       = crc;
+    entry->received++;
+}
+
+/**
+ * read the values that are due, called regularly
+ * types that are broadcast are skipped as long as the broadcasts come in
+ */
+void ems_pollDue() {
+    EMS_PollScheduled = true;
+    ems_getThermostatValues();
+    ems_getBoilerValues();
+    ems_getOtherValues();
+    EMS_PollScheduled = false;
+}
+
+/**
+ * show the types the poll scheduler reads, and when
+ */
+void ems_printPollSchedule() {
+    uint32_t now = millis();
+
+    if (EMS_Poll_count == 0) {
+        myDebug("Nothing read yet");
+        return;
+    }
+
+    myDebug(" dest  type  offset  interval  age     polls  received");
+    for (uint8_t i = 0; i < EMS_Poll_count; i++) {
+        _EMS_PollEntry * entry = &EMS_Poll[i];
+        char             age[10];
+        if (entry->refreshed == 0) {
+            strlcpy(age, "-", sizeof(age));
+        } else {
+            snprintf(age, sizeof(age), "%ds", (now - entry->refreshed) / 1000);
+        }
+        myDebug(" 0x%02X  0x%0*X  %6d  %7ds  %-6s  %5d  %8d",
+                entry->dest,
+                EMS_TYPE_DIGITS(entry->type),
+                entry->type,
+                entry->offset,
+                entry->interval / 1000,
+                age,
+                entry->polls,
+                entry->received);
+    }
+}
+
 /**
  * Generic function to return various settings from the thermostat
  */
@@ -1616,48 +4099,47 @@ void ems_getThermostatValues() {
     }
     uint8_t model_id = EMS_Thermostat.model_id;
     uint8_t type     = EMS_Thermostat.type_id;
-    EMS_Thermostat.hc =2 ; // lobocobra IT WAS 0 after a while, so I force it to 2 here... ugly hack, but who cares
-    uint8_t hc       = EMS_Thermostat.hc;
-    
+
     if (model_id == EMS_MODEL_RC20) {
-        ems_doReadCommand(EMS_TYPE_RC20StatusMessage, type); // to get the setpoint temp
-        ems_doReadCommand(EMS_TYPE_RC20Set, type);           // to get the mode
+        _pollRead(EMS_TYPE_RC20StatusMessage, type); // to get the setpoint temp
+        _pollRead(EMS_TYPE_RC20Set, type);           // to get the mode
     } else if (model_id == EMS_MODEL_RC30) {
-        ems_doReadCommand(EMS_TYPE_RC30StatusMessage, type); // to get the setpoint temp
-        ems_doReadCommand(EMS_TYPE_RC30Set, type);           // to get the mode
+        _pollRead(EMS_TYPE_RC30StatusMessage, type); // to get the setpoint temp
+        _pollRead(EMS_TYPE_RC30Set, type);           // to get the mode
     } else if ((model_id == EMS_MODEL_RC35) || (model_id == EMS_MODEL_ES73)) {
-        if (hc == 1) {
-            ems_doReadCommand(EMS_TYPE_RC35StatusMessage_HC1, type); // to get the setpoint temp
-            ems_doReadCommand(EMS_TYPE_RC35Set_HC1, type);           // to get the mode
-        } else if (hc == 2) {
-            ems_doReadCommand(EMS_TYPE_RC35StatusMessage_HC2, type); // to get the setpoint temp
-            ems_doReadCommand(EMS_TYPE_RC35Set_HC2, type);           // to get the mode
+        // the selected circuit and every other circuit we've seen on the bus
+        uint8_t max_hc = (model_id == EMS_MODEL_ES73) ? 1 : EMS_THERMOSTAT_MAXHC;
+        for (uint8_t hc = 1; hc <= max_hc; hc++) {
+            if ((hc == EMS_Thermostat.hc) || (EMS_Thermostat.circuit[hc - 1].active)) {
+                _pollRead(EMS_RC35StatusMessage_HC[hc - 1], type); // to get the setpoint temp
+                _pollRead(EMS_RC35Set_HC[hc - 1], type);           // to get the mode
+            }
+        }
+
+        if ((model_id == EMS_MODEL_RC35) && ((EMS_Thermostat.hc == 2) || (EMS_Thermostat.circuit[1].active))) {
             //lobocobra start here we read regularily the data
-            ems_doReadCommand(EMS_TYPE_AnlageParamSet, type);        // get PARAM settings
+            _pollRead(EMS_TYPE_AnlageParamSet, type);                // get PARAM settings
             //ems_doReadCommand(EMS_TYPE_HK2Schaltzeiten, type);     // would read from 0 I need 56
-            char Str2[] = "0b 90 49 55 20";                          // read 2nd part of 0x49 starting from DEC 85 
-                ems_sendRawTelegram((char *)&Str2);                  // read 2nd part of 0x49 starting from DEC 85
-            //ems_doReadCommand(EMS_TYPE_RC35Set_HC2, type, 21);     // => did not work, so I write it directly
-            char Str[] = "0b 90 47 16 20";                           // read 2nd part of 0x47 starting from DEC 22 
-                ems_sendRawTelegram((char *)&Str);                   // read 2nd part of 0x47 starting from DEC 22 
+            _pollRead(EMS_TYPE_HK2Schaltzeiten, type, 85);           // read 2nd part of 0x49 starting from DEC 85
+            _pollRead(EMS_TYPE_RC35Set_HC2, type, 22);               // read 2nd part of 0x47 starting from DEC 22
             //lobocobra end
         }
     } else if ((model_id == EMS_MODEL_EASY) || (model_id == EMS_MODEL_BOSCHEASY)) {
-        ems_doReadCommand(EMS_TYPE_EasyStatusMessage, type);
+        _pollRead(EMS_TYPE_EasyStatusMessage, type);
     }
 
-    ems_doReadCommand(EMS_TYPE_RCTime, type); // get Thermostat time
+    _pollRead(EMS_TYPE_RCTime, type); // get Thermostat time
 }
 
 /**
  * Generic function to return various settings from the thermostat
  */
 void ems_getBoilerValues() {
-    ems_doReadCommand(EMS_TYPE_UBAMonitorFast, EMS_Boiler.type_id); // get boiler stats, instead of waiting 10secs for the broadcast
-    ems_doReadCommand(EMS_TYPE_UBAMonitorSlow, EMS_Boiler.type_id); // get more boiler stats, instead of waiting 60secs for the broadcast
-    ems_doReadCommand(EMS_TYPE_UBAParameterWW, EMS_Boiler.type_id); // get Warm Water values
-    ems_doReadCommand(EMS_TYPE_UBAParametersMessage, EMS_Boiler.type_id);  // get MC10 boiler values
-    ems_doReadCommand(EMS_TYPE_UBATotalUptimeMessage, EMS_Boiler.type_id); // get uptime from boiler
+    _pollRead(EMS_TYPE_UBAMonitorFast, EMS_Boiler.type_id);        // get boiler stats, instead of waiting 10secs for the broadcast
+    _pollRead(EMS_TYPE_UBAMonitorSlow, EMS_Boiler.type_id);        // get more boiler stats, instead of waiting 60secs for the broadcast
+    _pollRead(EMS_TYPE_UBAParameterWW, EMS_Boiler.type_id);        // get Warm Water values
+    _pollRead(EMS_TYPE_UBAParametersMessage, EMS_Boiler.type_id);  // get MC10 boiler values
+    _pollRead(EMS_TYPE_UBATotalUptimeMessage, EMS_Boiler.type_id); // get uptime from boiler
 }
 
 /*
@@ -1665,7 +4147,11 @@ void ems_getBoilerValues() {
  */
 void ems_getOtherValues() {
     if (EMS_Other.SM10) {
-        ems_doReadCommand(EMS_TYPE_SM10Monitor, EMS_ID_SM10); // fetch all from SM10Monitor, e.g. 0B B0 97 00 16
+        _pollRead(EMS_TYPE_SM10Monitor, EMS_ID_SM10); // fetch all from SM10Monitor, e.g. 0B B0 97 00 16
+    }
+
+    if (EMS_Mixer.MM10) {
+        _pollRead(EMS_TYPE_MMStatusMessage, EMS_ID_MM10);
     }
 }
 
@@ -1750,31 +4236,24 @@ char * ems_getBoilerDescription(char * buffer) {
 void ems_scanDevices() {
     myDebug("Started scan on EMS bus for known devices");
 
-    std::list<uint8_t> Device_Ids; // create a new list
+    // forget what we know, so everything gets asked again
+    memset(EMS_Discovery.identified, 0, sizeof(EMS_Discovery.identified));
+    memset(EMS_Discovery.requested, 0, sizeof(EMS_Discovery.requested));
+    EMS_Discovery.holdUntil = 0;
+    EMS_DeviceCache_count   = 0;
 
-    // copy over boilers
+    // mark all the known device IDs so they are probed one by one in free poll windows
+    // kept apart from present, which only has the IDs actually heard on the bus
     for (_Boiler_Type bt : Boiler_Types) {
-        Device_Ids.push_back(bt.type_id);
+        _bitmapSet(EMS_Discovery.probe, bt.type_id);
     }
 
-    // copy over thermostats
     for (_Thermostat_Type tt : Thermostat_Types) {
-        Device_Ids.push_back(tt.type_id);
+        _bitmapSet(EMS_Discovery.probe, tt.type_id);
     }
 
-    // copy over others
     for (_Other_Type ot : Other_Types) {
-        Device_Ids.push_back(ot.type_id);
-    }
-
-    // remove duplicates and reserved IDs (like our own device)
-    Device_Ids.sort();
-    Device_Ids.unique();
-    Device_Ids.remove(EMS_MODEL_NONE);
-
-    // send the read command with Version command
-    for (uint8_t type_id : Device_Ids) {
-        ems_doReadCommand(EMS_TYPE_Version, type_id);
+        _bitmapSet(EMS_Discovery.probe, ot.type_id);
     }
 }
 
@@ -1807,7 +4286,7 @@ void ems_printAllTypes() {
     myDebug("\nThe following telegram type IDs are recognized:");
     for (i = 0; i < _EMS_Types_max; i++) {
         if ((EMS_Types[i].model_id == EMS_MODEL_ALL) || (EMS_Types[i].model_id == EMS_MODEL_UBA)) {
-            myDebug(" type %02X (%s)", EMS_Types[i].type, EMS_Types[i].typeString);
+            myDebug(" type %0*X (%s)", EMS_TYPE_DIGITS(EMS_Types[i].type), EMS_Types[i].type, EMS_Types[i].typeString);
         }
     }
 
@@ -1827,30 +4306,34 @@ void ems_printAllTypes() {
 /**
  * Send a command to UART Tx to Read from another device
  * Read commands when sent must respond by the destination (target) immediately (or within 10ms)
+ * returns false if the read wasn't queued
  */
-void ems_doReadCommand(uint8_t type, uint8_t dest, bool forceRefresh) {
+bool ems_doReadCommand(uint16_t type, uint8_t dest, bool forceRefresh) {
     // if not a valid type of boiler is not accessible then quits
     if ((type == EMS_ID_NONE) || (dest == EMS_ID_NONE)) {
-        return;
+        return false;
     }
     // if we're preventing all outbound traffic, quit
     if (EMS_Sys_Status.emsTxDisabled) {
         myDebug("in Silent Mode. All Tx is disabled.");
-        return;
+        return false;
+    }
+
+    if (EMS_TxQueue.isFull()) {
+        return false;
     }
 
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
 
     // see if its a known type
     int i = _ems_findType(type);
 
     if ((ems_getLogging() == EMS_SYS_LOGGING_BASIC) || (ems_getLogging() == EMS_SYS_LOGGING_VERBOSE)) {
         if (i == -1) {
-            myDebug("Requesting type (0x%02X) from dest 0x%02X", type, dest);
+            myDebug("Requesting type (0x%0*X) from dest 0x%02X", EMS_TYPE_DIGITS(type), type, dest);
         } else {
-            myDebug("Requesting type %s(0x%02X) from dest 0x%02X", EMS_Types[i].typeString, type, dest);
+            myDebug("Requesting type %s(0x%0*X) from dest 0x%02X", EMS_Types[i].typeString, EMS_TYPE_DIGITS(type), type, dest);
         }
     }
     EMS_TxTelegram.action             = EMS_TX_TELEGRAM_READ;    // read command
@@ -1859,6 +4342,9 @@ void ems_doReadCommand(uint8_t type, uint8_t dest, bool forceRefresh) {
     EMS_TxTelegram.length             = EMS_MIN_TELEGRAM_LENGTH; // is always 6 bytes long (including CRC at end)
     EMS_TxTelegram.type               = type;
     EMS_TxTelegram.dataValue          = EMS_MAX_TELEGRAM_LENGTH; // for a read this is the # bytes we want back
+    if (type >= EMS_TYPE_PLUS) {
+        EMS_TxTelegram.dataValue -= EMS_PLUS_HEADER_EXTRA; // the answer has the longer EMS+ header
+    }
     EMS_TxTelegram.type_validate      = EMS_ID_NONE;
     EMS_TxTelegram.comparisonValue    = 0;
     EMS_TxTelegram.comparisonOffset   = 0;
@@ -1866,57 +4352,220 @@ void ems_doReadCommand(uint8_t type, uint8_t dest, bool forceRefresh) {
     EMS_TxTelegram.forceRefresh       = forceRefresh; // should we send to MQTT after a successful read?
 
     EMS_TxQueue.push(EMS_TxTelegram);
+    return true;
 }
 
 /**
  * Send a raw telegram to the bus
- * telegram is a string of hex values
+ * telegram is a string of hex values, separated by spaces or commas, without the CRC
+ * with a reply_tag other than 0 the reply is kept and can be fetched with ems_getRawReply()
+ * only a read has a reply, anything else is reported as EMS_RAW_SENT once it's on the bus
  */
-void ems_sendRawTelegram(char * telegram) {
+_EMS_RAW_STATUS ems_sendRawTelegram(char * telegram, uint16_t reply_tag) {
     uint8_t count = 0;
     char *  p;
-    char    value[10] = {0};
+    char *  end;
 
     if (EMS_Sys_Status.emsTxDisabled) {
-        return; // user has disabled all Tx
+        return EMS_RAW_TX_DISABLED; // user has disabled all Tx
     }
 
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
-
-    // get first value, which should be the src
-    if ((p = strtok(telegram, " ,"))) { // delimiter
-        strlcpy(value, p, sizeof(value));
-        EMS_TxTelegram.data[0] = (uint8_t)strtol(value, 0, 16);
-    }
-    // and interate until end
-    while (p != 0) {
-        if ((p = strtok(NULL, " ,"))) {
-            strlcpy(value, p, sizeof(value));
-            uint8_t val                  = (uint8_t)strtol(value, 0, 16);
-            EMS_TxTelegram.data[++count] = val;
-            if (count == 1) {
-                EMS_TxTelegram.dest = val;
-            } else if (count == 2) {
-                EMS_TxTelegram.type = val;
-            } else if (count == 3) {
-                EMS_TxTelegram.offset = val;
-            }
+
+    // read all the values, leaving room for the CRC
+    for (p = strtok(telegram, " ,"); p != NULL; p = strtok(NULL, " ,")) {
+        long val = strtol(p, &end, 16);
+        if ((*end != '\0') || (val < 0) || (val > 0xFF)) {
+            return EMS_RAW_INVALID;
         }
+        if (count >= EMS_MAX_TELEGRAM_LENGTH - 1) {
+            return EMS_RAW_TOO_LONG;
+        }
+        EMS_TxTelegram.data[count++] = val;
     }
 
     if (count == 0) {
-        return; // nothing to send
+        return EMS_RAW_EMPTY; // nothing to send
+    }
+
+    if (count < 4) {
+        return EMS_RAW_TOO_SHORT; // need at least src, dest, type and offset
+    }
+
+    if (EMS_TxQueue.isFull()) {
+        return EMS_RAW_QUEUE_FULL;
     }
 
-    // calculate length including header and CRC
-    EMS_TxTelegram.length        = count + 2;
+    EMS_TxTelegram.dest   = EMS_TxTelegram.data[1];
+    EMS_TxTelegram.type   = EMS_TxTelegram.data[2];
+    EMS_TxTelegram.offset = EMS_TxTelegram.data[3];
+
+    // calculate length including the CRC
+    EMS_TxTelegram.length        = count + 1;
     EMS_TxTelegram.type_validate = EMS_ID_NONE;
     EMS_TxTelegram.action        = EMS_TX_TELEGRAM_RAW;
 
-    // add to Tx queue. Assume it's not full.
+    // keep a slot to catch the reply in
+    if (reply_tag != 0) {
+        _EMS_RawPending * pending = NULL;
+        for (uint8_t i = 0; i < EMS_RAW_PENDING_MAX; i++) {
+            if (EMS_RawPending[i].tag == 0) {
+                pending = &EMS_RawPending[i];
+                break;
+            }
+        }
+        if (pending == NULL) {
+            return EMS_RAW_BUSY;
+        }
+
+        _EMS_RxTelegram header;
+        header.telegram = EMS_TxTelegram.data;
+        header.length   = EMS_TxTelegram.length;
+        if (!_ems_parseHeader(&header)) {
+            return EMS_RAW_TOO_SHORT;
+        }
+
+        pending->tag       = reply_tag;
+        pending->status    = EMS_RAW_OK;
+        pending->read      = (EMS_TxTelegram.dest & 0x80);
+        pending->dest      = EMS_TxTelegram.dest & 0x7F;
+        pending->type      = header.type;
+        pending->timestamp = EMS_TxTelegram.timestamp;
+        pending->length    = 0;
+        EMS_TxTelegram.tag = reply_tag;
+    } else if (!(EMS_TxTelegram.dest & 0x80)) {
+        _tagTxWrite(&EMS_TxTelegram); // a write from an MQTT command, see ems_setTxTag()
+    }
+
     EMS_TxQueue.push(EMS_TxTelegram);
+    return EMS_RAW_OK;
+}
+
+/**
+ * a raw telegram went out on the bus, start waiting for its reply
+ * a tagged write without a reply slot is done now, as nothing more comes back
+ */
+void _rawSent(_EMS_TxTelegram * EMS_TxTelegram) {
+    if (EMS_TxTelegram->tag == 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < EMS_RAW_PENDING_MAX; i++) {
+        _EMS_RawPending * pending = &EMS_RawPending[i];
+        if ((pending->tag == EMS_TxTelegram->tag) && (pending->status == EMS_RAW_OK)) {
+            pending->status    = EMS_RAW_SENT;
+            pending->timestamp = millis();
+            return;
+        }
+    }
+
+    _txResult(EMS_TxTelegram->tag, true, EMS_TxTelegram->retryCount, true);
+}
+
+/**
+ * keep the telegram if it's the reply to a raw read we're waiting for
+ */
+void _rawCheckReply(_EMS_RxTelegram * EMS_RxTelegram) {
+    uint8_t src = EMS_RxTelegram->telegram[0] & 0x7F;
+
+    for (uint8_t i = 0; i < EMS_RAW_PENDING_MAX; i++) {
+        _EMS_RawPending * pending = &EMS_RawPending[i];
+        if ((pending->tag != 0) && pending->read && (pending->status == EMS_RAW_SENT) && (pending->dest == src) && (pending->type == EMS_RxTelegram->type)) {
+            pending->status = EMS_RAW_REPLY;
+            pending->length = EMS_RxTelegram->length;
+            memcpy(pending->data, EMS_RxTelegram->telegram, EMS_RxTelegram->length);
+            return;
+        }
+    }
+}
+
+/**
+ * fetch a raw telegram that's done: replied, sent without a reply or timed out
+ * the slot is freed. returns false if none are done yet
+ */
+bool ems_getRawReply(_EMS_RawPending * reply) {
+    uint32_t now = millis();
+
+    for (uint8_t i = 0; i < EMS_RAW_PENDING_MAX; i++) {
+        _EMS_RawPending * pending = &EMS_RawPending[i];
+        if (pending->tag == 0) {
+            continue;
+        }
+
+        if (((pending->status == EMS_RAW_SENT) && pending->read && ((now - pending->timestamp) > EMS_RAW_REPLY_TIMEOUT))
+            || ((pending->status == EMS_RAW_OK) && ((now - pending->timestamp) > EMS_RAW_QUEUE_TIMEOUT))) {
+            pending->status = EMS_RAW_TIMEOUT;
+        }
+
+        // a write is done once it's sent, a read when the reply is in or it timed out
+        if ((pending->status == EMS_RAW_REPLY) || (pending->status == EMS_RAW_TIMEOUT) || ((pending->status == EMS_RAW_SENT) && !pending->read)) {
+            memcpy(reply, pending, sizeof(_EMS_RawPending));
+            pending->tag = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * text for a raw telegram status, for logging and MQTT
+ */
+const char * ems_getRawStatusString(_EMS_RAW_STATUS status) {
+    static const char * raw_status[] = {"queued", "empty", "invalid", "too short", "too long", "tx disabled", "queue full", "busy", "sent", "ok", "timeout"};
+    return raw_status[status];
+}
+
+/**
+ * tag the writes queued from now on, so their outcome can be fetched with ems_getTxResult()
+ * call with 0 when done. returns the # writes that were queued with the previous tag
+ */
+uint8_t ems_setTxTag(uint16_t tag) {
+    uint8_t count  = EMS_TxTagCount;
+    EMS_TxTag      = tag;
+    EMS_TxTagCount = 0;
+    return count;
+}
+
+/**
+ * called by the ems_set* functions and for raw writes just before a write goes on the Tx queue
+ */
+void _tagTxWrite(_EMS_TxTelegram * EMS_TxTelegram) {
+    EMS_TxTelegram->tag = EMS_TxTag;
+    if (EMS_TxTag != 0) {
+        EMS_TxTagCount++;
+    }
+}
+
+/**
+ * a tagged write is done, either verified or given up on
+ * if nobody fetches the results the oldest is overwritten
+ */
+void _txResult(uint16_t tag, bool success, uint8_t retries, bool raw) {
+    if (tag == 0) {
+        return;
+    }
+
+    _EMS_TxResult result;
+    result.tag       = tag;
+    result.success   = success;
+    result.raw       = raw;
+    result.retries   = retries;
+    result.timestamp = millis();
+    EMS_TxResults.push(result);
+}
+
+/**
+ * fetch the outcome of the next tagged write that's done. returns false if there is none
+ */
+bool ems_getTxResult(_EMS_TxResult * result) {
+    if (EMS_TxResults.isEmpty()) {
+        return false;
+    }
+
+    *result = EMS_TxResults.shift();
+    return true;
 }
 
 /**
@@ -1935,11 +4584,11 @@ void ems_setThermostatTemp(float temperature, uint8_t temptype) {
 
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
 
-    uint8_t model_id = EMS_Thermostat.model_id;
-    uint8_t type     = EMS_Thermostat.type_id;
-    uint8_t hc       = EMS_Thermostat.hc; // heating circuit
+    uint8_t              model_id   = EMS_Thermostat.model_id;
+    uint8_t              type       = EMS_Thermostat.type_id;
+    uint8_t              hc         = EMS_Thermostat.hc; // heating circuit
+    _EMS_Thermostat_HC * thermostat = ems_getThermostatCircuit(hc);
 
     EMS_TxTelegram.action = EMS_TX_TELEGRAM_WRITE;
     EMS_TxTelegram.dest   = type;
@@ -1973,23 +4622,16 @@ void ems_setThermostatTemp(float temperature, uint8_t temptype) {
             break;
         default:
         case 0: // automatic selection, if no type is defined, we use the standard code
-            if (EMS_Thermostat.day_mode == 0) {
+            if (thermostat->day_mode == 0) {
                 EMS_TxTelegram.offset = EMS_OFFSET_RC35Set_temp_night;
-            } else if (EMS_Thermostat.day_mode == 1) {
+            } else if (thermostat->day_mode == 1) {
                 EMS_TxTelegram.offset = EMS_OFFSET_RC35Set_temp_day;
             }
             break;
         }
 
-        if (hc == 1) {
-            // heating circuit 1
-            EMS_TxTelegram.type               = EMS_TYPE_RC35Set_HC1;
-            EMS_TxTelegram.comparisonPostRead = EMS_TYPE_RC35StatusMessage_HC1;
-        } else {
-            // heating circuit 2
-            EMS_TxTelegram.type               = EMS_TYPE_RC35Set_HC2;
-            EMS_TxTelegram.comparisonPostRead = EMS_TYPE_RC35StatusMessage_HC2;
-        }
+        EMS_TxTelegram.type               = EMS_RC35Set_HC[hc - 1];
+        EMS_TxTelegram.comparisonPostRead = EMS_RC35StatusMessage_HC[hc - 1];
     }
 
     EMS_TxTelegram.length           = EMS_MIN_TELEGRAM_LENGTH;
@@ -1999,6 +4641,8 @@ void ems_setThermostatTemp(float temperature, uint8_t temptype) {
     EMS_TxTelegram.comparisonValue  = EMS_TxTelegram.dataValue;
 
     EMS_TxTelegram.forceRefresh = false; // send to MQTT is done automatically in EMS_TYPE_RC*StatusMessage
+
+    _tagTxWrite(&EMS_TxTelegram);
     EMS_TxQueue.push(EMS_TxTelegram);
 }
 
@@ -2024,7 +4668,6 @@ void ems_setThermostatMode(uint8_t mode) {
 
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
 
     EMS_TxTelegram.action    = EMS_TX_TELEGRAM_WRITE;
     EMS_TxTelegram.dest      = type;
@@ -2039,7 +4682,7 @@ void ems_setThermostatMode(uint8_t mode) {
         EMS_TxTelegram.type   = EMS_TYPE_RC30Set;
         EMS_TxTelegram.offset = EMS_OFFSET_RC30Set_mode;
     } else if ((model_id == EMS_MODEL_RC35) || (model_id == EMS_MODEL_ES73)) {
-        EMS_TxTelegram.type   = (hc == 2) ? EMS_TYPE_RC35Set_HC2 : EMS_TYPE_RC35Set_HC1;
+        EMS_TxTelegram.type   = EMS_RC35Set_HC[hc - 1];
         EMS_TxTelegram.offset = EMS_OFFSET_RC35Set_mode;
     }
 
@@ -2049,6 +4692,7 @@ void ems_setThermostatMode(uint8_t mode) {
     EMS_TxTelegram.comparisonPostRead = EMS_TxTelegram.type;
     EMS_TxTelegram.forceRefresh       = false; // send to MQTT is done automatically in 0xA8 process
 
+    _tagTxWrite(&EMS_TxTelegram);
     EMS_TxQueue.push(EMS_TxTelegram);
 }
 
@@ -2065,7 +4709,6 @@ void ems_setWarmWaterTemp(uint8_t temperature) {
 
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
 
     EMS_TxTelegram.action    = EMS_TX_TELEGRAM_WRITE;
     EMS_TxTelegram.dest      = EMS_Boiler.type_id;
@@ -2080,6 +4723,7 @@ void ems_setWarmWaterTemp(uint8_t temperature) {
     EMS_TxTelegram.comparisonPostRead = EMS_TYPE_UBAParameterWW;
     EMS_TxTelegram.forceRefresh       = false; // no need to send since this is done by 0x33 process
 
+    _tagTxWrite(&EMS_TxTelegram);
     EMS_TxQueue.push(EMS_TxTelegram);
 }
 
@@ -2092,7 +4736,6 @@ void ems_setFlowTemp(uint8_t temperature) {
 
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
 
     EMS_TxTelegram.action    = EMS_TX_TELEGRAM_WRITE;
     EMS_TxTelegram.dest      = EMS_Boiler.type_id;
@@ -2107,6 +4750,7 @@ void ems_setFlowTemp(uint8_t temperature) {
     EMS_TxTelegram.comparisonPostRead = EMS_TYPE_UBASetPoints;
     EMS_TxTelegram.forceRefresh       = false;
 
+    _tagTxWrite(&EMS_TxTelegram);
     EMS_TxQueue.push(EMS_TxTelegram);
    
 }
@@ -2118,7 +4762,6 @@ void ems_setFlowTemp(uint8_t temperature) {
 void ems_setWarmWaterModeComfort(uint8_t comfort) {
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
 
     if (comfort == 1) {
         myDebug("Setting boiler warm water comfort mode to Hot");
@@ -2140,6 +4783,7 @@ void ems_setWarmWaterModeComfort(uint8_t comfort) {
     EMS_TxTelegram.length        = EMS_MIN_TELEGRAM_LENGTH;
     EMS_TxTelegram.type_validate = EMS_ID_NONE; // don't validate
 
+    _tagTxWrite(&EMS_TxTelegram);
     EMS_TxQueue.push(EMS_TxTelegram);
 }
 
@@ -2152,7 +4796,6 @@ void ems_setWarmWaterActivated(bool activated) {
 
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
 
     EMS_TxTelegram.action        = EMS_TX_TELEGRAM_WRITE;
     EMS_TxTelegram.dest          = EMS_Boiler.type_id;
@@ -2162,6 +4805,7 @@ void ems_setWarmWaterActivated(bool activated) {
     EMS_TxTelegram.type_validate = EMS_ID_NONE;               // don't validate
     EMS_TxTelegram.dataValue     = (activated ? 0xFF : 0x00); // 0xFF is on, 0x00 is off
 
+    _tagTxWrite(&EMS_TxTelegram);
     EMS_TxQueue.push(EMS_TxTelegram);
 }
 
@@ -2175,7 +4819,6 @@ void ems_setWarmTapWaterActivated(bool activated) {
 
     _EMS_TxTelegram EMS_TxTelegram = EMS_TX_TELEGRAM_NEW; // create new Tx
     EMS_TxTelegram.timestamp       = millis();            // set timestamp
-    EMS_Sys_Status.txRetryCount    = 0;                   // reset retry counter
 
     // clear Tx to make sure all data is set to 0x00
     for (int i = 0; (i < EMS_MAX_TELEGRAM_LENGTH); i++) {
@@ -2211,6 +4854,7 @@ void ems_setWarmTapWaterActivated(bool activated) {
         EMS_TxTelegram.data[8] = 0xFF; // 3-way valve hot water only
     }
 
+    _tagTxWrite(&EMS_TxTelegram);
     EMS_TxQueue.push(EMS_TxTelegram); // add to queue
 }
 
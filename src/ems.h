@@ -14,10 +14,10 @@
 
 // EMS IDs
 #define EMS_ID_NONE 0x00      // Fixed - used as a dest in broadcast messages and empty type IDs
-#define EMS_PLUS_ID_NONE 0x01 // Fixed - used as a dest in broadcast messages and empty type IDs
 #define EMS_ID_ME 0x0B        // Fixed - our device, hardcoded as the "Service Key"
 #define EMS_ID_DEFAULT_BOILER 0x08
 #define EMS_ID_SM10 0x30 // Solar Module SM10
+#define EMS_ID_MM10 0x21 // Mixer Module MM10
 #define EMS_0x49 0x49 // lobocobra new data
 
 #define EMS_MIN_TELEGRAM_LENGTH 6 // minimal length for a validation telegram, including CRC
@@ -25,6 +25,16 @@
 // max length of a telegram, including CRC, for Rx and Tx.
 #define EMS_MAX_TELEGRAM_LENGTH 32 // lobocobra was 32, I need more data
 
+// EMS+ telegrams have 0xF0 or higher in the type byte. With 0xFF the 16-bit type follows the offset,
+// the layout of the others (e.g. 0xF7 and 0xF9) isn't known so they are only logged
+// EMS+ types are kept as the 16-bit type from the telegram. The EMS 1.0 types are all below EMS_TYPE_PLUS,
+// so EMS+ types below that can't be told apart from them and aren't decoded or sent
+#define EMS_PLUS_FRAME_MIN 0xF0
+#define EMS_PLUS_FRAME 0xFF
+#define EMS_TYPE_PLUS 0x100
+#define EMS_PLUS_HEADER_EXTRA 2                              // the EMS+ header is 2 bytes longer
+#define EMS_TYPE_DIGITS(type) (((type) >= EMS_TYPE_PLUS) ? 4 : 2) // # hex digits to print a type with, as on the bus
+
 // default values
 #define EMS_VALUE_INT_ON 1             // boolean true
 #define EMS_VALUE_INT_OFF 0            // boolean false
@@ -46,6 +56,82 @@
 
 #define EMS_TX_TELEGRAM_QUEUE_MAX 50 // max size of Tx FIFO queue
 
+// Tx retries and timeouts, tracked per device
+#define EMS_TX_RETRY_MAX 2             // # retries of a write before giving up, a read gets this many attempts in all
+#define EMS_TX_DEVICES_MAX 8           // # devices we keep Tx stats for
+#define EMS_TX_TIMEOUT_DEFAULT 500     // ms to wait for a response from a device we haven't measured yet
+#define EMS_TX_TIMEOUT_MIN 50          // lower limit of the adaptive timeout in ms
+#define EMS_TX_TIMEOUT_MAX 2000        // upper limit of the adaptive timeout in ms
+#define EMS_TX_TIMEOUT_FACTOR 4        // timeout is this many times the average response time
+#define EMS_TX_BACKOFF_THRESHOLD 2     // # failures in a row before a device is backed off
+#define EMS_TX_BACKOFF_BASE 2000       // first backoff in ms, doubled on each further failure
+#define EMS_TX_BACKOFF_MAX 120000      // longest backoff in ms
+
+#define EMS_DISCOVERY_CACHE_MAX 8     // max # of identified devices kept in SPIFFS
+#define EMS_DISCOVERY_RETRY_TIME 60000 // in ms, wait before asking again after a Version read got no answer
+
+// registry of the devices we decode telegrams from
+#define EMS_DEVICES_MAX 8       // max # of devices in the registry
+#define EMS_DEVICE_SHADOW_MAX 8 // max # of telegram types remembered per device
+#define EMS_THERMOSTATS_MAX 2   // max # of thermostats we keep values for, the first is EMS_Thermostat
+
+// warm-start snapshot of the last decoded values, kept in SPIFFS
+#define EMS_SNAPSHOT_FILE "/ems_state.bin"
+#define EMS_SNAPSHOT_MAGIC 0x454D5353 // "EMSS"
+#define EMS_SNAPSHOT_VERSION 2        // bump when _EMS_Boiler, _EMS_Thermostat or _EMS_Other change
+#define EMS_SNAPSHOT_INTERVAL 900000  // write at most every 15 minutes to spare the flash
+
+// flags in EMS_Sys_Status.emsStale, set while values still come from the snapshot
+#define EMS_STALE_BOILER 0x01
+#define EMS_STALE_THERMOSTAT 0x02
+#define EMS_STALE_OTHER 0x04
+#define EMS_STALE_ALL (EMS_STALE_BOILER | EMS_STALE_THERMOSTAT | EMS_STALE_OTHER)
+
+// passive sniffer, statistics per sender and telegram type
+#define EMS_SNIFFER_SIZE 64          // # slots in the hash table, must be a power of 2
+#define EMS_SNIFFER_TOP 10           // # busiest types in the MQTT summary
+#define EMS_BUS_BYTES_PER_SECOND 960 // 9600 baud with 10 bits per byte, for the bus load
+
+// raw telegrams waiting for a reply, see ems_sendRawTelegram()
+#define EMS_RAW_PENDING_MAX 8        // # raw telegrams that can wait for a reply at the same time
+#define EMS_RAW_REPLY_TIMEOUT 2000   // in ms, how long to wait for the reply once sent
+#define EMS_RAW_QUEUE_TIMEOUT 30000  // in ms, how long a raw telegram may wait in the Tx queue
+
+#define EMS_TX_RESULTS_MAX 8 // # outcomes of tagged writes kept until fetched with ems_getTxResult()
+
+// bus health metrics, counted in a rolling window of slots
+#define EMS_BUSSTATS_SLOTS 6         // # slots in the window
+#define EMS_BUSSTATS_SLOT_TIME 10000 // in ms, so the window is the last minute
+
+// poll scheduler, reads each type only when its values are due, see ems_pollDue()
+#define EMS_POLL_MAX 24         // # types tracked
+#define EMS_POLL_QUEUE_MAX 2    // only queue reads while there are no more than this many telegrams waiting, so writes go first
+#define EMS_POLL_PARTIAL_LENGTH 0x20 // # bytes asked for in a read from an offset
+
+// log filter directions, see ems_addLogFilter()
+#define EMS_LOGFILTER_DIR_READ 0x01      // read requests, dest has the 8th bit set
+#define EMS_LOGFILTER_DIR_WRITE 0x02     // writes and replies to a device
+#define EMS_LOGFILTER_DIR_BROADCAST 0x04 // to all, dest 0x00
+#define EMS_LOGFILTER_DIR_ALL (EMS_LOGFILTER_DIR_READ | EMS_LOGFILTER_DIR_WRITE | EMS_LOGFILTER_DIR_BROADCAST)
+#define EMS_LOGFILTER_PLUS_MAX 8 // # EMS+ types the log filter can hold
+
+// burner analytics, from UBAMonitorFast and UBAMonitorSlow, see _burnerStatsFrame()
+#define EMS_BURNER_POWER 24         // nominal power of the boiler in kW, for the energy estimate
+#define EMS_BURNER_GAS_KWH 105      // x10 kWh per m3 of natural gas, for the gas estimate
+#define EMS_BURNER_MAX_GAP 30000    // in ms, if UBAMonitorFast is missing for longer the time in between isn't counted
+#define EMS_BURNER_MOD_BANDS 10     // modulation histogram in bands of 10%
+
+// history of the main boiler values, as min/avg/max per bucket in tiers of 10 seconds, 1 minute and 15 minutes
+#define EMS_HISTORY_TIERS 3
+#define EMS_HISTORY_BYTES 1536     // per tier, for the delta encoded buckets. About 100-250 buckets depending on how much changes
+#define EMS_HISTORY_SENSORS_MAX 4  // # Dallas sensors kept
+#define EMS_HISTORY_RECORD_MAX (3 + (EMS_HISTORY_MAX * 3 * 3)) // largest encoded bucket, the bitmap and 3 varints per value
+
+#define EMS_TX_VALIDATE_BATCH_MAX 8                                             // max # of writes verified by a single read
+#define EMS_TX_VALIDATE_SPAN_MAX (EMS_MAX_TELEGRAM_LENGTH - EMS_MIN_TELEGRAM_LENGTH + 1) // max # of data bytes in one validate read
+#define EMS_TX_VALIDATE_BATCHES 4                                               // # batches that can wait for their validate at the same time
+#define EMS_TX_VALIDATE_NONE 0xFF                                               // no batch
+
 //#define EMS_SYS_LOGGING_DEFAULT EMS_SYS_LOGGING_VERBOSE
 #define EMS_SYS_LOGGING_DEFAULT EMS_SYS_LOGGING_NONE
 
@@ -80,13 +166,216 @@ typedef enum {
     EMS_SYS_LOGGING_VERBOSE     // everything
 } _EMS_SYS_LOGGING;
 
+// bus health counters, see _busStatsAdd()
+typedef enum {
+    EMS_BUSSTATS_FRAMES,      // everything received, including polls and our own echo
+    EMS_BUSSTATS_BYTES,       // # bytes including the BRK
+    EMS_BUSSTATS_CRCERR,      // telegrams with a bad CRC
+    EMS_BUSSTATS_NOISE,       // frames too short to be a telegram
+    EMS_BUSSTATS_POLLROUNDS,  // # times the boiler went through its poll list
+    EMS_BUSSTATS_POLLMISSES,  // # poll rounds without a poll for us
+    EMS_BUSSTATS_WRITES,      // # write telegrams we sent
+    EMS_BUSSTATS_WRITEFAILS,  // # writes rejected, not answered or not validated
+    EMS_BUSSTATS_MAX
+} _EMS_BUSSTATS;
+
+// the sets of the log filter
+typedef enum {
+    EMS_LOGFILTER_SRC,  // sender ID
+    EMS_LOGFILTER_DEST, // destination ID, without the 8th bit
+    EMS_LOGFILTER_TYPE, // telegram type
+    EMS_LOGFILTER_DIR   // EMS_LOGFILTER_DIR_*
+} _EMS_LOGFILTER;
+
+// which telegrams are printed when logging, checked before anything is formatted
+// each set matches everything until the first ID is added to it
+typedef struct {
+    uint8_t  narrowed;                          // bit per _EMS_LOGFILTER set that no longer matches everything
+    uint8_t  direction;                         // EMS_LOGFILTER_DIR_*
+    uint32_t src[4];                            // bit per ID
+    uint32_t dest[4];
+    uint32_t type[8];                           // bit per EMS 1.0 type
+    uint16_t plusType[EMS_LOGFILTER_PLUS_MAX];  // EMS+ types by all 16 bits, too many for a bitmap
+    uint8_t  plusCount;
+} _EMS_LogFilter;
+
+typedef struct {
+    uint32_t started;                                        // millis when counting started
+    uint32_t slotStart;                                      // millis when the current slot started
+    uint8_t  slot;                                           // current slot in the window
+    uint8_t  lastPoll;                                       // last ID polled, to see when a poll round starts again
+    bool     polledMe;                                       // we were polled in this poll round
+    uint32_t total[EMS_BUSSTATS_MAX];                        // since power on
+    uint32_t window[EMS_BUSSTATS_SLOTS][EMS_BUSSTATS_MAX];   // per slot
+} _EMS_BusStats;
+
+// bus health over the rolling window, rates are in tenths
+typedef struct {
+    uint16_t framesPerSec;  // x10
+    uint16_t bytesPerSec;
+    uint16_t load;          // % x10 of what fits at 9600 baud
+    uint16_t crcErrRate;    // % x10 of the frames
+    uint16_t noiseRate;     // % x10 of the frames
+    uint16_t pollMissRate;  // % x10 of the poll rounds
+    uint16_t writeFailRate; // % x10 of the writes
+} _EMS_BusHealth;
+
+// how often a type needs reading. The interval starts at minAge and grows to maxAge while the values don't change
+// for a type that's broadcast maxAge is a little over the broadcast time, so it's only read if the broadcasts stop
+typedef struct {
+    uint16_t type;
+    uint32_t minAge; // in ms, never read more often
+    uint32_t maxAge; // in ms, never let the values get older
+} _EMS_PollPolicy;
+
+// a type read by the poll scheduler
+typedef struct {
+    uint8_t  dest;
+    uint16_t type;
+    uint8_t  offset;    // for types read in parts
+    uint32_t minAge;    // from the policy
+    uint32_t maxAge;
+    uint32_t interval;  // in ms, between minAge and maxAge
+    uint32_t refreshed; // millis last received, broadcast or read. 0 if never
+    uint32_t polled;    // millis last read requested. 0 if never
+    uint32_t crc;       // CRC32 of the last data, to see if the values changed
+    uint16_t polls;     // # reads requested
+    uint16_t received;  // # times received
+} _EMS_PollEntry;
+
+// burner counters for the current interval, updated with every UBAMonitorFast
+// the state of a frame is taken to last until the next one
+typedef struct {
+    uint32_t lastFrame;                          // millis of the last UBAMonitorFast, 0 if none yet
+    bool     on;                                 // burnGas in the last frame
+    uint8_t  power;                              // curBurnPow in the last frame
+    int16_t  deltaT;                             // flow - return x10 in the last frame, EMS_VALUE_SHORT_NOTSET if unknown
+    uint32_t changed;                            // millis the burner last went on or off, 0 if not seen yet
+    uint32_t intervalStart;                      // millis
+    uint32_t startsFirst;                        // burnStarts of the boiler at the start of the interval
+    uint32_t startsLast;                         // and the latest
+    uint32_t time;                               // ms counted in this interval
+    uint32_t onTime;                             // ms the burner was on
+    uint32_t modTime[EMS_BURNER_MOD_BANDS];      // ms on per modulation band
+    uint64_t powerTime;                          // sum of curBurnPow x ms, for the average modulation and energy
+    int64_t  deltaTTime;                         // sum of deltaT x ms while on
+    uint32_t deltaTOnTime;                       // ms on with a known deltaT
+    uint16_t starts;                             // burner on seen
+    uint16_t cycles;                             // # on periods that ended
+    uint32_t cycleSum;                           // ms
+    uint32_t cycleMin;
+    uint32_t cycleMax;
+    uint16_t pauses;                             // # off periods that ended
+    uint32_t pauseSum;                           // ms
+    uint64_t energyTotal;                        // sum of curBurnPow x ms since power on, of the previous intervals
+} _EMS_BurnerStats;
+
+// summary of the burner counters, see ems_getBurnerSummary()
+typedef struct {
+    uint32_t interval;                      // seconds
+    uint16_t starts;                        // the boiler's own counter if it's known, it sees even the shortest ones
+    uint16_t startsPerHour;                 // x10
+    uint16_t duty;                          // % x10 of the time on
+    uint8_t  modulation;                    // average curBurnPow while on
+    uint16_t cycles;                        // on periods that ended in the interval
+    uint32_t cycleAvg;                      // seconds
+    uint32_t cycleMin;
+    uint32_t cycleMax;
+    uint32_t pauseAvg;                      // seconds between cycles
+    int16_t  deltaT;                        // x10, average flow - return while on, EMS_VALUE_SHORT_NOTSET if unknown
+    uint32_t energy;                        // Wh estimated in the interval
+    uint32_t energyTotal;                   // Wh estimated since power on
+    uint32_t gas;                           // litres estimated in the interval
+    uint8_t  modBands[EMS_BURNER_MOD_BANDS]; // % of the on time per band of 10%
+} _EMS_BurnerSummary;
+
+// values kept in the history, all in tenths (e.g. 21.5 C is 215)
+typedef enum {
+    EMS_HISTORY_FLOWTEMP,    // curFlowTemp
+    EMS_HISTORY_RETTEMP,     // retTemp
+    EMS_HISTORY_BURNPOW,     // curBurnPow
+    EMS_HISTORY_SYSPRESS,    // sysPress
+    EMS_HISTORY_WWTEMP,      // wWCurTmp
+    EMS_HISTORY_OUTDOORTEMP, // extTemp
+    EMS_HISTORY_SENSOR1,     // the Dallas sensors follow
+    EMS_HISTORY_MAX = EMS_HISTORY_SENSOR1 + EMS_HISTORY_SENSORS_MAX
+} _EMS_HISTORY;
+
+// samples of one value in the current bucket
+typedef struct {
+    int32_t  sum;
+    int16_t  min;
+    int16_t  max;
+    uint16_t count;
+} _EMS_HistorySamples;
+
+// one tier of the history. A bucket is stored as a bitmap of the values it has, followed by
+// min, avg and max of each as the zigzag varint of the difference with that value's previous bucket
+typedef struct {
+    uint32_t            bucketTime;                      // in ms
+    uint32_t            bucketStart;                     // millis when the current bucket started
+    _EMS_HistorySamples samples[EMS_HISTORY_MAX];        // current bucket
+    uint8_t             ring[EMS_HISTORY_BYTES];         // the buckets, oldest first
+    uint16_t            head;                            // where the oldest bucket starts
+    uint16_t            used;                            // # bytes in the ring
+    uint16_t            buckets;                         // # buckets in the ring
+    int16_t             base[EMS_HISTORY_MAX][3];        // the values before the oldest bucket, what it's a delta of
+    int16_t             last[EMS_HISTORY_MAX][3];        // the values of the newest bucket
+} _EMS_HistoryTier;
+
+// a bucket read back from the history, see ems_historyNext()
+typedef struct {
+    uint8_t  tier;
+    uint16_t pos;                                // in the ring, of the next bucket
+    uint16_t index;                              // # of the next bucket, 0 is the oldest
+    uint16_t present;                            // bitmap of the values that had samples in this bucket
+    int16_t  value[EMS_HISTORY_MAX][3];          // min, avg, max
+} _EMS_HistoryBucket;
+
+// result of a raw telegram, see ems_sendRawTelegram()
+typedef enum {
+    EMS_RAW_OK,          // queued
+    EMS_RAW_EMPTY,       // nothing to send
+    EMS_RAW_INVALID,     // not a list of hex bytes
+    EMS_RAW_TOO_SHORT,   // no complete header
+    EMS_RAW_TOO_LONG,    // doesn't fit in EMS_MAX_TELEGRAM_LENGTH
+    EMS_RAW_TX_DISABLED, // all Tx is disabled
+    EMS_RAW_QUEUE_FULL,  // the Tx queue is full, try again later
+    EMS_RAW_BUSY,        // too many waiting for a reply, try again later
+    EMS_RAW_SENT,        // sent, no reply expected
+    EMS_RAW_REPLY,       // reply received
+    EMS_RAW_TIMEOUT      // no reply, or never sent
+} _EMS_RAW_STATUS;
+
+// a raw telegram waiting for its reply
+typedef struct {
+    uint16_t        tag;       // from the caller to match the reply, 0 if the slot is free
+    _EMS_RAW_STATUS status;    // EMS_RAW_OK until it's sent, then EMS_RAW_SENT
+    bool            read;      // a read, so there will be a reply
+    uint8_t         dest;      // who should reply
+    uint16_t        type;      // with which type
+    uint32_t        timestamp; // when it was queued or sent (millis)
+    uint8_t         length;    // length of the reply including CRC
+    uint8_t         data[EMS_MAX_TELEGRAM_LENGTH];
+} _EMS_RawPending;
+
+// the outcome of a write tagged with ems_setTxTag()
+typedef struct {
+    uint16_t tag;
+    bool     success;   // the value was read back, or the device accepted a write that can't be validated
+    bool     raw;       // a raw telegram, which is only known to be on the bus
+    uint8_t  retries;   // # times it was sent again
+    uint32_t timestamp; // when it was done, from millis()
+} _EMS_TxResult;
+
 // status/counters since last power on
 typedef struct {
     _EMS_RX_STATUS   emsRxStatus;
     _EMS_TX_STATUS   emsTxStatus;
-    uint16_t         emsRxPgks;        // received
-    uint16_t         emsTxPkgs;        // sent
-    uint16_t         emxCrcErr;        // CRC errors
+    uint32_t         emsRxPgks;        // received
+    uint32_t         emsTxPkgs;        // sent
+    uint32_t         emxCrcErr;        // CRC errors
+    uint32_t         emsTxCollisions;  // echo of our Tx didn't match what we sent
     bool             emsPollEnabled;   // flag enable the response to poll messages
     _EMS_SYS_LOGGING emsLogging;       // logging
     bool             emsRefreshed;     // fresh data, needs to be pushed out to MQTT
@@ -95,33 +384,161 @@ typedef struct {
     uint32_t         emsPollFrequency; // time between EMS polls
     bool             emsTxCapable;     // able to send via Tx
     bool             emsTxDisabled;    // true to prevent all Tx
-    uint8_t          txRetryCount;     // # times the last Tx was re-sent
+    uint8_t          emsStale;         // values restored from the snapshot and not yet refreshed, see EMS_STALE_*
 } _EMS_Sys_Status;
 
 // The Tx send package
 typedef struct {
     _EMS_TX_TELEGRAM_ACTION action; // read, write, validate, init
     uint8_t                 dest;
-    uint8_t                 type;
+    uint16_t                type; // EMS+ types from EMS_TYPE_PLUS up
     uint8_t                 offset;
     uint8_t                 length;
     uint8_t                 dataValue;          // value to validate against
-    uint8_t                 type_validate;      // type to call after a successful Write command
+    uint16_t                type_validate;      // type to call after a successful Write command
     uint8_t                 comparisonValue;    // value to compare against during a validate
     uint8_t                 comparisonOffset;   // offset of where the byte is we want to compare too later
-    uint8_t                 comparisonPostRead; // after a successful write call this to read
+    uint16_t                comparisonPostRead; // after a successful write call this to read
     bool                    forceRefresh;       // should we send to MQTT after a successful Tx?
+    uint8_t                 retryCount;         // # times this telegram was re-sent
+    uint16_t                tag;                // from the caller to report back on, 0 if none
+    uint8_t                 validateBatch;      // for a validate, its batch in EMS_TxValidateBatches. EMS_TX_VALIDATE_NONE if none
     uint32_t                timestamp;          // when created
     uint8_t                 data[EMS_MAX_TELEGRAM_LENGTH];
 } _EMS_TxTelegram;
 
 // The Rx receive package
 typedef struct {
-    uint32_t  timestamp; // timestamp from millis()
-    uint8_t * telegram;  // the full data package
-    uint8_t   length;    // length in bytes
+    uint32_t  timestamp;   // timestamp from millis()
+    uint8_t * telegram;    // the full data package
+    uint8_t   length;      // length in bytes
+    uint16_t  type;        // from the header, see _ems_parseHeader()
+    uint8_t   offset;      // offset of the first data byte
+    uint8_t * data;        // the data block
+    uint8_t   data_length; // # data bytes, excluding the CRC
+    uint32_t  data_crc;    // CRC32 of the data block, to tell if the values changed
+    bool      emsplus;     // EMS+ framing
 } _EMS_RxTelegram;
 
+// a write waiting to be verified
+typedef struct {
+    uint8_t  offset;   // where the byte was written
+    uint8_t  value;    // the value written
+    uint16_t postRead; // type to read after a successful validate
+    uint16_t tag;      // of the write, see ems_setTxTag()
+} _EMS_TxValidateItem;
+
+// consecutive writes to the same dest and type, verified together by one read spanning their offsets
+// a write to an offset already in the batch replaces the older one
+typedef struct {
+    uint8_t             dest;
+    uint16_t            type;
+    uint8_t             count;      // # writes in the batch, 0 if the batch is free
+    uint8_t             retryCount; // highest # retries of the writes in the batch
+    _EMS_TxValidateItem items[EMS_TX_VALIDATE_BATCH_MAX];
+} _EMS_TxValidateBatch;
+
+// device discovery. A bit per bus ID 0x00-0x7F
+typedef struct {
+    uint32_t present[4];    // seen on the bus as a sender
+    uint32_t probe[4];      // not heard yet but asked for its Version once, e.g. the known IDs after a scan
+    uint32_t identified[4]; // product id is known
+    uint32_t requested[4];  // Version has been asked for, cleared again if it got no answer
+    uint32_t holdUntil;     // millis, no Version reads before this after one got no answer. 0 if none
+} _EMS_Discovery;
+
+// product id and version of an identified device, stored in SPIFFS
+typedef struct {
+    uint8_t type_id;
+    uint8_t product_id;
+    char    version[10];
+} _EMS_DeviceCache;
+
+// what a device is, decides which telegram types it gets and where its values go
+typedef enum {
+    EMS_DEVICE_CLASS_NONE,
+    EMS_DEVICE_CLASS_BOILER,
+    EMS_DEVICE_CLASS_THERMOSTAT,
+    EMS_DEVICE_CLASS_OTHER // solar, mixer and switch modules etc
+} _EMS_DEVICE_CLASS;
+
+// the last telegram of a type received from a device
+typedef struct {
+    uint16_t type;
+    uint8_t  offset;
+    uint8_t  length;    // # data bytes
+    uint32_t crc;       // CRC32 of the data, to tell if it changed
+    uint16_t count;     // # times received
+    uint32_t timestamp; // when last received (millis)
+} _EMS_DeviceShadow;
+
+// a device on the bus, keyed by its bus ID
+typedef struct {
+    uint8_t           device_id; // bus ID, e.g. 0x08 for the boiler
+    _EMS_DEVICE_CLASS device_class;
+    uint8_t           model_id; // see _EMS_MODEL_ID, EMS_MODEL_NONE if not known yet
+    uint8_t           product_id;
+    bool              read_supported;
+    bool              write_supported;
+    char              version[10];
+    void *            state;        // the decoded values, e.g. &EMS_Boiler. NULL if we have nowhere to put them
+    uint8_t           shadow_count; // # telegram types in shadow
+    _EMS_DeviceShadow shadow[EMS_DEVICE_SHADOW_MAX];
+} _EMS_Device;
+
+// sniffer statistics of a telegram type from a sender
+typedef struct {
+    uint8_t  src;        // EMS_ID_NONE if the slot is free
+    uint8_t  length;     // # data bytes of the last one
+    uint16_t type;
+    uint32_t crc;        // CRC32 of the last data, to count the changes
+    uint16_t count;      // # received
+    uint16_t changes;    // # times it differed from the one before
+    uint32_t first_seen; // millis
+    uint32_t last_seen;  // millis
+} _EMS_SnifferEntry;
+
+// passive sniffer, an open addressing hash table keyed on sender and type
+typedef struct {
+    bool              enabled;
+    bool              listenOnly;    // Tx was disabled by the sniffer
+    bool              txWasDisabled; // Tx setting to go back to when the sniffer stops
+    uint32_t          since;         // when the statistics were cleared
+    uint32_t          telegrams;     // # valid telegrams
+    uint32_t          bytes;         // # bytes on the bus, including polls and breaks
+    uint16_t          dropped;       // # telegrams not counted because the table was full
+    uint8_t           used;          // # slots in use
+    _EMS_SnifferEntry table[EMS_SNIFFER_SIZE];
+} _EMS_Sniffer;
+
+// Tx statistics and retry state per destination
+typedef struct {
+    uint8_t  dest;
+    uint16_t sent;         // # telegrams sent
+    uint16_t success;      // # telegrams answered
+    uint16_t failed;       // # telegrams not answered or answered wrongly
+    uint8_t  failStreak;   // # failures in a row
+    uint16_t latencyAvg;   // moving average response time in ms
+    uint16_t latencyMax;   // slowest response time in ms
+    uint32_t backoffUntil; // no Tx to this device before this time (millis), 0 if not backed off
+} _EMS_TxDeviceStats;
+
+// copy of the last Tx, to compare against its echo on the bus
+typedef struct {
+    bool    pending; // waiting for the echo
+    bool    retry;   // re-send the telegram on a collision
+    uint8_t length;  // length in bytes, including the CRC
+    uint8_t data[EMS_MAX_TELEGRAM_LENGTH];
+} _EMS_TxEcho;
+
+// header of the warm-start snapshot file, followed by EMS_Boiler, EMS_Thermostat and EMS_Other
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; // size of the data after the header
+    uint32_t crc;  // CRC32 of the data after the header
+} _EMS_SnapshotHeader;
+
 // default empty Tx
 const _EMS_TxTelegram EMS_TX_TELEGRAM_NEW = {
     EMS_TX_TELEGRAM_INIT, // action
@@ -135,6 +552,9 @@ const _EMS_TxTelegram EMS_TX_TELEGRAM_NEW = {
     0,                    // comparisonOffset
     EMS_ID_NONE,          // comparisonPostRead
     false,                // forceRefresh
+    0,                    // retryCount
+    0,                    // tag
+    EMS_TX_VALIDATE_NONE, // validateBatch
     0,                    // timestamp
     {0x00}                // data
 };
@@ -241,6 +661,33 @@ typedef struct {
     uint8_t SM10pump;           // pump active
 } _EMS_Other;
 
+/*
+ * Telegram package defintions for the MM10 Mixer Module
+ */
+typedef struct {
+    bool    MM10;        // set true if there is a MM10 available
+    uint8_t flowSetTemp; // selected flow temperature
+    int16_t flowTemp;    // current flow temperature, is *10
+    uint8_t pumpMod;     // pump modulation in %
+    uint8_t valveStatus; // mixing valve position in %
+} _EMS_Mixer;
+
+#define EMS_THERMOSTAT_MAXHC 4 // max # of heating circuits on a thermostat
+
+// Thermostat data per heating circuit
+typedef struct {
+    bool    active;            // we've had a telegram for this circuit
+    int16_t setpoint_roomTemp; // current set temp
+    int16_t curr_roomTemp;     // current room temp
+    uint8_t mode;              // 0=low, 1=manual, 2=auto
+    bool    day_mode;          // 0=night, 1=day
+    uint8_t daytemp;
+    uint8_t nighttemp;
+    uint8_t holidaytemp;
+    uint8_t heatingtype;
+    uint8_t circuitcalctemp;
+} _EMS_Thermostat_HC;
+
 // Thermostat data
 typedef struct {
     uint8_t type_id;  // the type ID of the thermostat
@@ -248,23 +695,16 @@ typedef struct {
     uint8_t product_id;
     bool    read_supported;
     bool    write_supported;
-    uint8_t hc; // heating circuit 1 or 2
+    uint8_t hc; // selected heating circuit 1-4, used for the commands
     char    version[10];
-    int16_t setpoint_roomTemp; // current set temp
-    int16_t curr_roomTemp;     // current room temp
-    uint8_t mode;              // 0=low, 1=manual, 2=auto
-    bool    day_mode;          // 0=night, 1=day
     uint8_t hour;
     uint8_t minute;
     uint8_t second;
     uint8_t day;
     uint8_t month;
     uint8_t year;
-    uint8_t daytemp;
-    uint8_t nighttemp;
-    uint8_t holidaytemp;
-    uint8_t heatingtype;
-    uint8_t circuitcalctemp;
+
+    _EMS_Thermostat_HC circuit[EMS_THERMOSTAT_MAXHC]; // per heating circuit, HC1 is the first
     // lobocobra start
     uint8_t ausschalthysterese   ; // positive value heating off when above x°
     uint8_t einschalthysterese   ; // negative value heating on when below x°
@@ -288,22 +728,25 @@ typedef struct {
 } _EMS_Thermostat;
 
 // call back function signature for processing telegram types
-typedef void (*EMS_processType_cb)(uint8_t src, uint8_t * data, uint8_t length);
+typedef void (*EMS_processType_cb)(uint8_t src, uint16_t type, uint8_t * data, uint8_t length);
 
 // Definition for each EMS type, including the relative callback function
 typedef struct {
     uint8_t            model_id;
-    uint8_t            type;
+    uint16_t           type; // EMS+ types from EMS_TYPE_PLUS up
     const char         typeString[50];
     EMS_processType_cb processType_cb;
-    bool               emsplus;
 } _EMS_Type;
 
 // function definitions
 extern void ems_parseTelegram(uint8_t * telegram, uint8_t len);
 void        ems_init();
-void        ems_doReadCommand(uint8_t type, uint8_t dest, bool forceRefresh = false);
-void        ems_sendRawTelegram(char * telegram);
+bool        ems_doReadCommand(uint16_t type, uint8_t dest, bool forceRefresh = false);
+_EMS_RAW_STATUS ems_sendRawTelegram(char * telegram, uint16_t reply_tag = 0);
+bool            ems_getRawReply(_EMS_RawPending * reply);
+uint8_t         ems_setTxTag(uint16_t tag);
+bool            ems_getTxResult(_EMS_TxResult * result);
+const char *    ems_getRawStatusString(_EMS_RAW_STATUS status);
 // lobocobra 
 char * _hextoa(uint8_t value, char * buffer);
 
@@ -337,6 +780,8 @@ void             ems_discoverModels();
 bool             ems_getTxCapable();
 uint32_t         ems_getPollFrequency();
 
+_EMS_Thermostat_HC * ems_getThermostatCircuit(uint8_t hc = 0);
+
 void   ems_scanDevices();
 void   ems_printAllTypes();
 char * ems_getThermostatDescription(char * buffer);
@@ -344,6 +789,36 @@ void   ems_printTxQueue();
 char * ems_getBoilerDescription(char * buffer);
 
 void ems_startupTelegrams();
+void ems_printTxDeviceStats();
+void ems_printDiscovery();
+_EMS_Device * ems_getDevice(uint8_t device_id);
+void   ems_getBusHealth(_EMS_BusHealth * health);
+uint32_t ems_getBusTotal(_EMS_BUSSTATS counter);
+void   ems_setSniffer(bool enabled, bool listenOnly = false);
+void   ems_clearSniffer();
+void   ems_printSniffer();
+uint8_t ems_getSnifferLoad();
+uint8_t ems_getSnifferTop(uint8_t * slots, uint8_t max);
+char * ems_getDeviceCache(char * buffer, size_t size);
+void   ems_setDeviceCache(const char * cache);
+void   ems_loadSnapshot();
+void   ems_saveSnapshot(bool force);
+void   ems_pollDue();
+void   ems_clearLogFilter();
+bool   ems_addLogFilter(_EMS_LOGFILTER set, uint16_t id);
+void   ems_printLogFilter();
+void   ems_printPollSchedule();
+void   ems_getBurnerSummary(_EMS_BurnerSummary * summary);
+void   ems_startBurnerInterval();
+void   ems_historyAdd(_EMS_HISTORY value, int16_t sample);
+void   ems_historyLoop();
+void   ems_historyFirst(_EMS_HistoryBucket * bucket, uint8_t tier);
+bool   ems_historyNext(_EMS_HistoryBucket * bucket);
+int8_t ems_historyFindTier(const char * name);
+int8_t ems_historyFindValue(const char * name);
+const char * ems_historyTierName(uint8_t tier);
+const char * ems_historyValueName(uint8_t value);
+void   ems_printHistory(uint8_t tier, int8_t value);
 
 // private functions
 uint8_t _crcCalculator(uint8_t * data, uint8_t len);
@@ -352,11 +827,51 @@ void    _debugPrintPackage(const char * prefix, _EMS_RxTelegram * EMS_RxTelegram
 void    _ems_clearTxData();
 int     _ems_findBoilerModel(uint8_t model_id);
 bool    _ems_setModel(uint8_t model_id);
-void    _removeTxQueue();
+void    _removeTxQueue(bool answered = false);
 void    _ems_readTelegram(uint8_t * telegram, uint8_t length);
+void    _recordTxEcho(uint8_t * data, uint8_t length, bool retry);
+bool    _checkTxEcho(_EMS_RxTelegram * EMS_RxTelegram);
+void    _flushValidateBatch();
+void    _discoveryNext();
+void    _discoveryLost(uint8_t id);
+bool    _addDeviceCache(uint8_t type_id, uint8_t product_id, const char * version);
+bool    _ems_identifyDevice(uint8_t src, uint8_t product_id, const char * version);
+_EMS_Device * _ems_addDevice(uint8_t device_id, _EMS_DEVICE_CLASS device_class, uint8_t model_id, uint8_t product_id, const char * version);
+int     _ems_findDeviceType(_EMS_Device * device, uint16_t type);
+_EMS_Device * _ems_findSender(uint8_t src);
+void    _ems_updateShadow(_EMS_Device * device, uint16_t type, uint8_t offset, _EMS_RxTelegram * EMS_RxTelegram);
+bool    _ems_parseHeader(_EMS_RxTelegram * EMS_RxTelegram);
+void    _ems_setPlusHeader(_EMS_TxTelegram * EMS_TxTelegram);
+void    _ems_buildTypeIndex();
+void *  _ems_getState(uint8_t src, _EMS_DEVICE_CLASS device_class);
+_EMS_Thermostat * _ems_getThermostat(uint8_t src);
+_EMS_Boiler *     _ems_getBoiler(uint8_t src);
+_EMS_Other *      _ems_getOther(uint8_t src);
+_EMS_Mixer *      _ems_getMixer(uint8_t src);
+void    _snifferRecord(_EMS_RxTelegram * EMS_RxTelegram);
+void    _busStatsAdd(_EMS_BUSSTATS counter, uint32_t n = 1);
+void    _busStatsPoll(uint8_t id);
+void    _rawSent(_EMS_TxTelegram * EMS_TxTelegram);
+void    _rawCheckReply(_EMS_RxTelegram * EMS_RxTelegram);
+void    _txResult(uint16_t tag, bool success, uint8_t retries, bool raw = false);
+void    _tagTxWrite(_EMS_TxTelegram * EMS_TxTelegram);
+void    _historyClose(uint8_t tier);
+void    _burnerStatsFrame();
+void    _pollRead(uint16_t type, uint8_t dest, uint8_t offset = 0);
+void    _pollReceived(uint8_t src, uint16_t type, uint8_t offset, uint32_t crc);
+bool    _logFilterPass(_EMS_RxTelegram * EMS_RxTelegram);
+bool    _logFilterType(uint16_t type);
+bool    _logFilterHasPlus(uint16_t type);
 
 // global so can referenced in other classes
 extern _EMS_Sys_Status EMS_Sys_Status;
 extern _EMS_Boiler     EMS_Boiler;
 extern _EMS_Thermostat EMS_Thermostat;
 extern _EMS_Other      EMS_Other;
+extern _EMS_Mixer      EMS_Mixer;
+extern _EMS_Device     EMS_Devices[EMS_DEVICES_MAX];
+extern uint8_t         EMS_Devices_count;
+extern _EMS_Sniffer    EMS_Sniffer;
+extern _EMS_BusStats   EMS_BusStats;
+extern _EMS_HistoryTier EMS_History[EMS_HISTORY_TIERS];
+extern _EMS_BurnerStats EMS_BurnerStats;
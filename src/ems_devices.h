@@ -44,6 +44,13 @@
 // Other
 #define EMS_TYPE_SM10Monitor 0x97 // SM10Monitor
 
+// MM10 Mixer Module
+#define EMS_TYPE_MMStatusMessage 0xAB                // is an automatic monitor broadcast
+#define EMS_OFFSET_MMStatusMessage_flow_set 0        // selected flow temp
+#define EMS_OFFSET_MMStatusMessage_flow_temp 1       // current flow temp, 2 bytes *10
+#define EMS_OFFSET_MMStatusMessage_pump_mod 3        // pump modulation
+#define EMS_OFFSET_MMStatusMessage_valve_status 4    // mixing valve position
+
 /*
  * Thermostats...
  */
@@ -80,6 +87,10 @@
 #define EMS_TYPE_RC35StatusMessage_HC2 0x48     // is an automatic thermostat broadcast giving us temps on HC2
 #define EMS_TYPE_RC35Set_HC1 0x3D               // for setting values like temp and mode (Working mode HC1)
 #define EMS_TYPE_RC35Set_HC2 0x47               // for setting values like temp and mode (Working mode HC2)
+#define EMS_TYPE_RC35StatusMessage_HC3 0x52     // is an automatic thermostat broadcast giving us temps on HC3
+#define EMS_TYPE_RC35StatusMessage_HC4 0x5C     // is an automatic thermostat broadcast giving us temps on HC4
+#define EMS_TYPE_RC35Set_HC3 0x51               // for setting values like temp and mode (Working mode HC3)
+#define EMS_TYPE_RC35Set_HC4 0x5B               // for setting values like temp and mode (Working mode HC4)
 //lobocobra start 
 #define EMS_TYPE_AnlageParamSet 0xA5            // AnlageParamSet
 #define EMS_TYPE_HK2Schaltzeiten 0x49           // AnlageParamSet
@@ -99,9 +110,9 @@
 #define EMS_OFFSET_EasyStatusMessage_setpoint 10 // setpoint temp
 #define EMS_OFFSET_EasyStatusMessage_curr 8      // current temp
 
-// RC1010 specific
-#define EMS_TYPE_RC1010StatusMessage 0x00         // is an automatic thermostat broadcast giving us temps
-#define EMS_TYPE_RC1010Set 0x03                   // setpoint temp message
+// RC1010 specific, EMS+ so the types are the 16-bit type from the telegram
+#define EMS_TYPE_RC1010StatusMessage 0x01A5       // is an automatic thermostat broadcast giving us temps
+#define EMS_TYPE_RC1010Set 0x01B9                 // setpoint temp message
 #define EMS_OFFSET_RC1010StatusMessage_setpoint 3 // setpoint temp
 #define EMS_OFFSET_RC1010StatusMessage_curr 1     // current temp
 
@@ -0,0 +1,74 @@
+/*
+ * ems_print.h
+ *
+ * Writes log lines in a single pass into a fixed buffer, without allocating
+ * Used for the telegram logging, which runs for every telegram on the bus
+ *
+ * Paul Derbyshire - https://github.com/proddy/EMS-ESP
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the position in the buffer. Output that doesn't fit is cut off, the buffer is always null terminated
+typedef struct {
+    char * p;
+    char * end; // the last char of the buffer, kept for the '\0'
+} _EMS_PrintCursor;
+
+inline void _printBegin(_EMS_PrintCursor * c, char * buffer, size_t size) {
+    c->p   = buffer;
+    c->end = buffer + size - 1;
+    *c->p  = '\0';
+}
+
+inline void _printStr(_EMS_PrintCursor * c, const char * s) {
+    while ((*s != '\0') && (c->p < c->end)) {
+        *c->p++ = *s++;
+    }
+    *c->p = '\0';
+}
+
+inline void _printChar(_EMS_PrintCursor * c, char ch) {
+    if (c->p < c->end) {
+        *c->p++ = ch;
+    }
+    *c->p = '\0';
+}
+
+// 2 hex digits, upper case
+inline void _printHex(_EMS_PrintCursor * c, uint8_t value) {
+    static const char hex[] = "0123456789ABCDEF";
+    _printChar(c, hex[value >> 4]);
+    _printChar(c, hex[value & 0x0F]);
+}
+
+// bytes as 2 hex digits each, separated by a space, e.g. "08 0B 02 00"
+inline void _printHexBytes(_EMS_PrintCursor * c, const uint8_t * data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (i != 0) {
+            _printChar(c, ' ');
+        }
+        _printHex(c, data[i]);
+    }
+}
+
+// decimal, padded with zeros to at least digits
+inline void _printDec(_EMS_PrintCursor * c, uint32_t value, uint8_t digits = 1) {
+    char    tmp[10];
+    uint8_t n = 0;
+    do {
+        tmp[n++] = '0' + (value % 10);
+        value /= 10;
+    } while ((value != 0) && (n < sizeof(tmp)));
+
+    while (digits > n) {
+        _printChar(c, '0');
+        digits--;
+    }
+    while (n > 0) {
+        _printChar(c, tmp[--n]);
+    }
+}
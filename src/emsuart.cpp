@@ -17,8 +17,36 @@ _EMSRxBuf * pEMSRxBuf;
 _EMSRxBuf * paEMSRxBuf[EMS_MAXBUFFERS];
 uint8_t     emsRxBufIdx = 0;
 
+volatile _EMSUART_TX_STATE emsTxState = EMSUART_TX_IDLE; // Tx state machine, driven by the UART and timer1 interrupts
+uint16_t                   emsTxDropped = 0;               // # sends refused because the UART was still busy
+
 os_event_t recvTaskQueue[EMSUART_recvTaskQueueLen]; // our Rx queue
 
+//
+// timer1 interrupt, fired when the BRK has been held long enough
+// Important: do not use ICACHE_FLASH_ATTR !
+//
+static void ICACHE_RAM_ATTR emsuart_tx_brk_timer_handler() {
+    USC0(EMSUART_UART) &= ~(1 << UCBRK); // clear bit, release the line
+    emsTxState = EMSUART_TX_IDLE;
+}
+
+//
+// Tx FIFO is empty, so start the BRK and let timer1 end it
+// Important: do not use ICACHE_FLASH_ATTR !
+//
+static inline void ICACHE_RAM_ATTR emsuart_tx_brk_start() {
+    uint32_t tmp = ((1 << UCRXRST) | (1 << UCTXRST)); // bit mask
+    USC0(EMSUART_UART) |= (tmp);                      // set bits
+    USC0(EMSUART_UART) &= ~(tmp);                     // clear bits
+
+    // To create a 11-bit <BRK> we set TXD_BRK bit so the break signal will
+    // automatically be sent when the tx fifo is empty
+    USC0(EMSUART_UART) |= (1 << UCBRK); // set bit
+    emsTxState = EMSUART_TX_BRK;
+    timer1_write(EMSUART_TX_BRK_TICKS); // 2070us - based on trial and error using an oscilloscope
+}
+
 //
 // Main interrupt handler
 // Important: do not use ICACHE_FLASH_ATTR !
@@ -27,6 +55,18 @@ static void emsuart_rx_intr_handler(void * para) {
     static uint8_t length;
     static uint8_t uart_buffer[EMS_MAXBUFFERSIZE];
 
+    // Tx FIFO has drained. Disable the interrupt as it stays active while the FIFO is empty
+    if (USIS(EMSUART_UART) & (1 << UITXE)) {
+        USIE(EMSUART_UART) &= ~(1 << UITXE);
+        USIC(EMSUART_UART) = (1 << UITXE);
+        emsuart_tx_brk_start();
+    }
+
+    // nothing received, so we're done
+    if (!(USIS(EMSUART_UART) & ((1 << UIFF) | (1 << UITO) | (1 << UIBD)))) {
+        return;
+    }
+
     // is a new buffer? if so init the thing for a new telegram
     if (EMS_Sys_Status.emsRxStatus == EMS_RX_STATUS_IDLE) {
         EMS_Sys_Status.emsRxStatus = EMS_RX_STATUS_BUSY; // status set to busy
@@ -111,15 +151,23 @@ void ICACHE_FLASH_ATTR emsuart_init() {
     // UCFFT = RX FIFO Full Threshold (7 bit) = want this to be 31 for 32 bytes of buffer. (default was 127).
     USC1(EMSUART_UART) = 0;                                              // reset config first
     //USC1(EMSUART_UART) = (31 << UCFFT) | (0x02 << UCTOT) | (1 << UCTOE); // enable interupts
-    USC1(EMSUART_UART) = ((EMS_MAX_TELEGRAM_LENGTH - 1) << UCFFT) | (0x02 << UCTOT) | (1 << UCTOE); // enable interupts
+    // UCFET = TX FIFO Empty Threshold (7 bit) = want the UITXE interrupt only when the FIFO is completely empty
+    USC1(EMSUART_UART) = ((EMS_MAX_TELEGRAM_LENGTH - 1) << UCFFT) | (0x02 << UCTOT) | (1 << UCTOE) | (EMSUART_TX_FIFO_EMPTY << UCFET); // enable interupts
     // set interrupts for triggers
     USIC(EMSUART_UART) = 0xffff; // clear all interupts
     USIE(EMSUART_UART) = 0;      // disable all interrupts
 
     // enable rx break, fifo full and timeout.
     // not frame error UIFR (because they are too frequent) or overflow UIOF because our buffer is only max 32 bytes
+    // the tx fifo empty UITXE is only enabled while a telegram is being sent
     USIE(EMSUART_UART) = (1 << UIBD) | (1 << UIFF) | (1 << UITO);
 
+    // timer1 is used as a one-shot to time the length of the Tx BRK
+    emsTxState = EMSUART_TX_IDLE;
+    timer1_isr_init();
+    timer1_attachInterrupt(emsuart_tx_brk_timer_handler);
+    timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+
     // set up interrupt callbacks for Rx
     system_os_task(emsuart_recvTask, EMSUART_recvTaskPrio, recvTaskQueue, EMSUART_recvTaskQueueLen);
 
@@ -151,41 +199,60 @@ void ICACHE_FLASH_ATTR emsuart_start() {
     ETS_UART_INTR_ENABLE();
 }
 
+/*
+ * returns true if a telegram or BRK is still going out on the Tx line
+ */
+bool emsuart_tx_busy() {
+    return (emsTxState != EMSUART_TX_IDLE);
+}
+
+/*
+ * # telegrams and polls not sent because the UART was still busy
+ */
+uint16_t emsuart_tx_dropped() {
+    return emsTxDropped;
+}
+
 /*
  * Send a BRK signal
  * Which is a 11-bit set of zero's (11 cycles)
+ * This doesn't block. The BRK is started from the UART interrupt once the Tx FIFO is empty and
+ * ended by timer1, so the CPU is free while the telegram drains
  */
 void ICACHE_FLASH_ATTR emsuart_tx_brk() {
-    // must make sure Tx FIFO is empty
-    while (((USS(EMSUART_UART) >> USTXC) & 0xff) != 0)
-        ;
-
-    uint32_t tmp = ((1 << UCRXRST) | (1 << UCTXRST)); // bit mask
-    USC0(EMSUART_UART) |= (tmp);                      // set bits
-    USC0(EMSUART_UART) &= ~(tmp);                     // clear bits
-
-    // To create a 11-bit <BRK> we set TXD_BRK bit so the break signal will
-    // automatically be sent when the tx fifo is empty
-    USC0(EMSUART_UART) |= (1 << UCBRK);  // set bit
-    delayMicroseconds(EMS_TX_BRK_WAIT);  // 2070 - based on trial and error using an oscilloscope
-    USC0(EMSUART_UART) &= ~(1 << UCBRK); // clear bit
+    emsTxState         = EMSUART_TX_SENDING;
+    USIC(EMSUART_UART) = (1 << UITXE);  // clear any old Tx FIFO empty interrupt
+    USIE(EMSUART_UART) |= (1 << UITXE); // and fire a new one as soon as the Tx FIFO is empty
 }
 
 /*
  * Send to Tx, ending with a <BRK>
+ * returns false and counts it as dropped if the previous telegram hasn't finished yet
  */
-void ICACHE_FLASH_ATTR emsuart_tx_buffer(uint8_t * buf, uint8_t len) {
+bool ICACHE_FLASH_ATTR emsuart_tx_buffer(uint8_t * buf, uint8_t len) {
+    if (emsuart_tx_busy()) {
+        emsTxDropped++;
+        return false;
+    }
+
     for (uint8_t i = 0; i < len; i++) {
         USF(EMSUART_UART) = buf[i];
-        //delayMicroseconds(EMS_TX_BRK_WAIT);
     }
     emsuart_tx_brk();
+    return true;
 }
 
 /*
  * Send the Poll (our own ID) to Tx as a single byte and end with a <BRK>
+ * returns false and counts it as dropped if the previous telegram hasn't finished yet
  */
-void ICACHE_FLASH_ATTR emsaurt_tx_poll() {
+bool ICACHE_FLASH_ATTR emsaurt_tx_poll() {
+    if (emsuart_tx_busy()) {
+        emsTxDropped++;
+        return false;
+    }
+
     USF(EMSUART_UART) = EMS_ID_ME;
     emsuart_tx_brk();
+    return true;
 }
@@ -21,9 +21,23 @@
 // the BRK from Boiler master is roughly 1.039ms, so accounting for hardware lag using around 2078 (for half-duplex) - 8 (lag)
 #define EMS_TX_BRK_WAIT 2070
 
+// the BRK is timed by hardware timer1, clocked at 80MHz/16 = 5 ticks per microsecond
+// timer1 is claimed by the UART, so anything else using it (analogWrite on older cores, tone(), Servo) can't be used
+#define EMSUART_TX_BRK_TICKS (EMS_TX_BRK_WAIT * 5)
+
+// TX FIFO empty threshold. The UITXE interrupt fires when the FIFO holds fewer bytes than this
+#define EMSUART_TX_FIFO_EMPTY 1
+
 #define EMSUART_recvTaskPrio 1
 #define EMSUART_recvTaskQueueLen 64
 
+// states of the interrupt driven Tx
+typedef enum {
+    EMSUART_TX_IDLE,    // nothing being sent, ready for a new telegram
+    EMSUART_TX_SENDING, // bytes are draining from the Tx FIFO, waiting for the FIFO empty interrupt
+    EMSUART_TX_BRK      // BRK is being held on the line, waiting for timer1 to release it
+} _EMSUART_TX_STATE;
+
 typedef struct {
     uint8_t writePtr;
     uint8_t buffer[EMS_MAXBUFFERSIZE];
@@ -32,6 +46,8 @@ typedef struct {
 void ICACHE_FLASH_ATTR emsuart_init();
 void ICACHE_FLASH_ATTR emsuart_stop();
 void ICACHE_FLASH_ATTR emsuart_start();
-void ICACHE_FLASH_ATTR emsuart_tx_buffer(uint8_t * buf, uint8_t len);
-void ICACHE_FLASH_ATTR emsaurt_tx_poll();
+bool ICACHE_FLASH_ATTR emsuart_tx_buffer(uint8_t * buf, uint8_t len);
+bool ICACHE_FLASH_ATTR emsaurt_tx_poll();
 void ICACHE_FLASH_ATTR emsuart_tx_brk();
+bool                   emsuart_tx_busy();
+uint16_t               emsuart_tx_dropped();
@@ -0,0 +1,92 @@
+/*
+ * Home Assistant MQTT discovery
+ * Every value published to MQTT with how Home Assistant should show it, see publishDiscovery()
+ *
+ * See ChangeLog.md for History
+ * See README.md for Acknowledgments
+ *
+ */
+
+#pragma once
+
+#include "my_config.h"
+
+typedef enum {
+    HA_SENSOR,       // a value, optionally with a unit
+    HA_BINARY_SENSOR // "on" or "off", see _bool_to_char()
+} _HA_COMPONENT;
+
+// the values are published already scaled (e.g. sysPress in bar), so there is no scale here
+typedef struct {
+    _HA_COMPONENT component;
+    const char *  topic; // state topic, without MQTT_BASE/hostname
+    const char *  key;   // in the JSON payload of the topic, NULL if the payload is the value itself
+    const char *  name;
+    const char *  unit; // NULL if it has none
+} _HA_Field;
+
+// the Dallas sensors are added to these at runtime, one per sensor found
+const _HA_Field HA_Fields[] = {
+
+    // boiler
+    {HA_SENSOR, TOPIC_BOILER_DATA, "wWSelTemp", "Warm water selected temperature", "°C"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "selFlowTemp", "Selected flow temperature", "°C"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "outdoorTemp", "Outdoor temperature", "°C"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "abgasTemp", "Exhaust temperature", "°C"},
+    {HA_BINARY_SENSOR, TOPIC_BOILER_DATA, "wWActivated", "Warm water activated", NULL},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "wWComfort", "Warm water comfort", NULL},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "wWCurTmp", "Warm water current temperature", "°C"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "wWCurFlow", "Warm water flow rate", "l/min"},
+    {HA_BINARY_SENSOR, TOPIC_BOILER_DATA, "wWHeat", "Warm water 3-way valve", NULL},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "curFlowTemp", "Current flow temperature", "°C"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "retTemp", "Return temperature", "°C"},
+    {HA_BINARY_SENSOR, TOPIC_BOILER_DATA, "burnGas", "Gas", NULL},
+    {HA_BINARY_SENSOR, TOPIC_BOILER_DATA, "heatPmp", "Boiler pump", NULL},
+    {HA_BINARY_SENSOR, TOPIC_BOILER_DATA, "fanWork", "Fan", NULL},
+    {HA_BINARY_SENSOR, TOPIC_BOILER_DATA, "ignWork", "Ignition", NULL},
+    {HA_BINARY_SENSOR, TOPIC_BOILER_DATA, "wWCirc", "Warm water circulation pump", NULL},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "selBurnPow", "Burner selected max power", "%"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "curBurnPow", "Burner current power", "%"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "sysPress", "System pressure", "bar"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "boilTemp", "Boiler temperature", "°C"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "pumpMod", "Pump modulation", "%"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "ServiceCode", "Service code", NULL},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "ServiceCodeNumber", "Service code number", NULL},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "burnerDays", "Burner working days", "d"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "burnerHours", "Burner working hours", "h"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "burnerMin", "Burner working minutes", "min"},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "burnerStarts", "Burner starts", NULL},
+    {HA_SENSOR, TOPIC_BOILER_DATA, "flameCurr", "Flame current", "µA"},
+
+    // thermostat
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_CURRTEMP, "Current room temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_SELTEMP, "Selected room temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_MODE, "Thermostat mode", NULL},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_HC, "Heating circuit", NULL},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_DAYTEMP, "Day temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_NIGHTTEMP, "Night temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_HOLIDAYTEMP, "Holiday temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_CIRCUITCALCTEMP, "Calculated flow temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_MINVORLAUF, "Min flow temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_MAXVORLAUF, "Max flow temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_AUSLEGUNGSTEMP, "Design flow temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_ROOMOFFSET, "Room temperature offset", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT_DATA, THERMOSTAT_SOMMERSCHWELLE_TEMP, "Summer mode threshold", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT2_DATA, THERMOSTAT_MINOUTSIDETEMP, "Min outdoor temperature", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT2_DATA, THERMOSTAT_AUSSCHALTHYSTERESE, "Switch off hysteresis", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT2_DATA, THERMOSTAT_EINSCHALTHYSTERESE, "Switch on hysteresis", "°C"},
+    {HA_SENSOR, TOPIC_THERMOSTAT2_DATA, THERMOSTAT_ANTIPENDELZEIT, "Burner anti cycle time", "min"},
+    {HA_SENSOR, TOPIC_THERMOSTAT2_DATA, THERMOSTAT_KESSELPUMENNACHLAUF, "Boiler pump overrun", "min"},
+    {HA_SENSOR, TOPIC_THERMOSTAT2_DATA, THERMOSTAT_SOMMER_MODUS, "Summer mode", NULL},
+    {HA_SENSOR, TOPIC_THERMOSTAT2_DATA, THERMOSTAT_URLAUB_MODUS, "Holiday mode", NULL},
+
+    // SM10 Solar Module
+    {HA_SENSOR, TOPIC_SM10_DATA, SM10_COLLECTORTEMP, "Solar collector temperature", "°C"},
+    {HA_SENSOR, TOPIC_SM10_DATA, SM10_BOTTOMTEMP, "Solar bottom temperature", "°C"},
+    {HA_SENSOR, TOPIC_SM10_DATA, SM10_PUMPMODULATION, "Solar pump modulation", "%"},
+    {HA_BINARY_SENSOR, TOPIC_SM10_DATA, SM10_PUMP, "Solar pump", NULL},
+
+    // shower
+    {HA_SENSOR, TOPIC_SHOWERTIME, NULL, "Last shower duration", NULL}
+
+};
@@ -20,19 +20,39 @@
 #define MQTT_RETAIN false
 #define MQTT_KEEPALIVE 120 // 2 minutes
 #define MQTT_QOS 1
+#define MQTT_BINARY_PAYLOAD false // also publish boiler, thermostat and SM10 values as MessagePack, see publishBinaryValues()
+#define MQTT_BINARY_SUFFIX "_bin"  // added to the JSON topic for the MessagePack one, e.g. boiler_data_bin
 #define MQTT_MAX_SIZE 700 // max size of a JSON object. See https://arduinojson.org/v6/assistant/ //lobocobra was 700
 
 // MQTT CMD for thermostat
 #define TOPIC_THERMOSTAT_DATA "thermostat_data"                    // for sending thermostat values to MQTT
 #define TOPIC_THERMOSTAT2_DATA "thermostat2_data"                  // for sending thermostat values to MQTT lobocobra, MQTT was too long so I made 2nd
+#define TOPIC_THERMOSTAT_HC_DATA "thermostat_data_hc"              // for sending the values of each heating circuit, followed by the HC number
+#define TOPIC_THERMOSTAT_DEVICE_DATA "thermostat_data_"          // for sending the values of a further thermostat, followed by its bus ID in hex
 #define TOPIC_THERMOSTAT_CMD_TEMP "thermostat_cmd_temp"            // for received thermostat temp changes via MQTT
 #define TOPIC_THERMOSTAT_CMD_MODE "thermostat_cmd_mode"            // for received thermostat mode changes via MQTT
 #define TOPIC_THERMOSTAT_CMD_HC "thermostat_cmd_hc"                // for received thermostat hc number changes via MQTT
 #define TOPIC_THERMOSTAT_CMD_DAYTEMP "thermostat_daytemp"          // RC35 specific
 #define TOPIC_THERMOSTAT_CMD_NIGHTTEMP "thermostat_nighttemp"      // RC35 specific
 #define TOPIC_THERMOSTAT_CMD_HOLIDAYTEMP "thermostat_holidaytemp"  // RC35 specific
+#define TOPIC_CMD_RESPONSE "cmd_response"                          // ack or nack of commands sent with an id
+#define CMD_ID "id"                                                // correlation id of a JSON command, echoed back
+#define CMD_VALUE "value"                                          // the value of a JSON command
+#define CMD_TOPIC "topic"                                          // the topic the command came in on
+#define CMD_STATUS "status"                                        // ack, nack, timeout, busy or none
+#define CMD_LATENCY "latency"                                      // ms from the command until its writes were done
+#define CMD_RETRIES "retries"                                      // # times a write was sent again
 //lobocobra start
 #define TOPIC_MQTT_CMD_RAW "mqtt_cmd_raw"                           // send a RAW command
+#define TOPIC_MQTT_RAW_RESPONSE "mqtt_raw_response"                 // outcome and replies of RAW commands sent as JSON
+#define RAW_ID "id"                                                 // correlation id of a JSON RAW command, echoed back
+#define RAW_REPLY "reply"                                           // true to get the reply of each telegram
+#define RAW_TELEGRAMS "telegrams"                                   // array of telegrams as hex strings
+#define RAW_QUEUED "queued"                                         // # telegrams queued
+#define RAW_FAILED "failed"                                         // telegrams that were not queued
+#define RAW_INDEX "index"                                           // position of the telegram in the batch
+#define RAW_STATUS "status"                                         // ok, sent, timeout or why it wasn't queued
+#define RAW_TELEGRAM "telegram"                                     // the reply as hex
 #define THERMOSTAT_CMD_AUSSCHALTHYSTERESE "ausschalthysterese"      // positive value heating on when above x° 
 #define THERMOSTAT_CMD_EINSCHALTHYSTERESE "einschalthysterese"      // negative value heating on when below x°
 #define THERMOSTAT_CMD_ANTIPENDELZEIT "antipendelzeit"              // min time between 2 starts
@@ -98,12 +118,77 @@
 #define SM10_PUMPMODULATION "pumpmodulation" // pump modulation
 #define SM10_PUMP "pump"                     // pump active
 
+// MQTT for MM10 Mixer Module
+#define TOPIC_MM10_DATA "mm10_data"    // topic name
+#define MM10_FLOWSETTEMP "flowsettemp" // selected flow temp
+#define MM10_FLOWTEMP "flowtemp"       // current flow temp
+#define MM10_PUMPMOD "pumpmodulation"  // pump modulation
+#define MM10_VALVESTATUS "valvestatus" // mixing valve position
+
+// MQTT for the EMS bus health, over the last minute
+#define TOPIC_BUS_DATA "bus_data"           // topic name
+#define BUS_FRAMES "frames"                 // frames per second
+#define BUS_BYTES "bytes"                   // bytes per second
+#define BUS_LOAD "load"                     // % of what fits at 9600 baud
+#define BUS_CRCERRORS "crcerrors"           // % of frames with a bad CRC
+#define BUS_NOISE "noise"                   // % of frames too short to be a telegram
+#define BUS_POLLMISSES "pollmisses"         // % of poll rounds where we weren't polled
+#define BUS_WRITEFAILS "writefails"         // % of writes that failed
+#define BUS_RXTOTAL "rx"                    // telegrams read since power on
+#define BUS_CRCTOTAL "crctotal"             // CRC errors since power on
+#define BUS_NOISETOTAL "noisetotal"         // frames too short to be a telegram since power on
+#define BUS_POLLMISSTOTAL "pollmisstotal"   // poll rounds where we weren't polled since power on
+#define BUS_WRITETOTAL "writetotal"         // writes sent since power on
+#define BUS_WRITEFAILTOTAL "writefailtotal" // writes that failed since power on
+
+// MQTT for the sniffer summary
+#define TOPIC_SNIFFER_DATA "sniffer_data" // topic name
+#define SNIFFER_TELEGRAMS "telegrams"     // # telegrams since the statistics were cleared
+#define SNIFFER_LOAD "busload"            // bus load in %
+#define SNIFFER_TYPES "types"             // # different sender/type combinations
+#define SNIFFER_DROPPED "dropped"         // # not counted as the table was full
+#define SNIFFER_TOP "top"                 // busiest types as "src.type": "count,changes,#data"
+
+// MQTT for the burner analytics, published every BURNER_PUBLISH_TIME for the interval since the last one
+#define TOPIC_BURNER_DATA "burner_data"  // topic name
+#define BURNER_INTERVAL "interval"       // seconds
+#define BURNER_STARTS "starts"           // # burner starts
+#define BURNER_STARTSPERHOUR "startsph"  // burner starts per hour
+#define BURNER_DUTY "duty"               // % of the time the burner was on
+#define BURNER_MODULATION "modulation"   // average burner power while on, in %
+#define BURNER_CYCLES "cycles"           // # burner cycles that ended
+#define BURNER_CYCLEAVG "cycleavg"       // average cycle in seconds
+#define BURNER_CYCLEMIN "cyclemin"       // shortest cycle in seconds
+#define BURNER_CYCLEMAX "cyclemax"       // longest cycle in seconds
+#define BURNER_PAUSEAVG "pauseavg"       // average time off between cycles in seconds
+#define BURNER_DELTAT "deltat"           // average flow - return temperature while on
+#define BURNER_ENERGY "energy"           // estimated kWh
+#define BURNER_ENERGYTOTAL "energytotal" // estimated kWh since power on
+#define BURNER_GAS "gas"                 // estimated m3 of gas
+#define BURNER_MODBANDS "modbands"       // % of the on time at 1-10%, 11-20%, ... burner power
+
+// MQTT for the history of the main boiler values, see ems_historyAdd()
+#define TOPIC_HISTORY_CMD "history_cmd"   // for receiving requests as "<10s | 1m | 15m> <value> [count]", e.g. "1m curFlowTemp 20"
+#define TOPIC_HISTORY_DATA "history_data" // topic name for the reply
+#define HISTORY_MQTT_POINTS 20            // max # buckets in a reply
+#define HISTORY_TIER "tier"               // 10s, 1m or 15m
+#define HISTORY_VALUE "value"             // e.g. curFlowTemp or temp_1
+#define HISTORY_INTERVAL "interval"       // seconds per bucket
+#define HISTORY_AGE "age"                 // seconds since the newest bucket was closed
+#define HISTORY_MIN "min"                 // per bucket, oldest first
+#define HISTORY_AVG "avg"
+#define HISTORY_MAX "max"
+
 // shower time
 #define TOPIC_SHOWERTIME "showertime"           // for sending shower time results
 #define TOPIC_SHOWER_TIMER "shower_timer"       // toggle switch for enabling the shower logic
 #define TOPIC_SHOWER_ALERT "shower_alert"       // toggle switch for enabling the shower alarm logic
 #define TOPIC_SHOWER_COLDSHOT "shower_coldshot" // used to trigger a coldshot from an MQTT command
 
+// Home Assistant MQTT discovery
+#define HA_DISCOVERY_PREFIX "homeassistant" // discovery prefix set in Home Assistant, "" to not publish the discovery configs
+#define TOPIC_HA_DISCOVERY "ha_discovery"   // hash of the discovery configs last published, retained
+
 // MQTT for EXTERNAL SENSORS
 #define TOPIC_EXTERNAL_SENSORS "sensors"   // for sending sensor values to MQTT
 #define PAYLOAD_EXTERNAL_SENSORS "temp_%d" // for formatting the payload for each external dallas sensor
@@ -0,0 +1,173 @@
+/*
+ * Host benchmark of the telegram log line formatting, the old strlcat() version against ems_print.h
+ *
+ *   g++ -O2 -Isrc tools/bench_telegram_print.cpp -o bench_telegram_print && ./bench_telegram_print
+ *
+ * Both build the line _printMessage() prints for a UBAMonitorFast telegram. Only the formatting
+ * is timed, not the printing.
+ *
+ * Typical result on a PC: 1736 ns against 224 ns per line, 7.7x faster. The ratio varies
+ * between runs and machines, roughly 7x to 11x, and says nothing exact about the ESP8266.
+ */
+
+#include "ems_print.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COLOR_RESET "\x1B[0m"
+#define COLOR_CYAN "\x1B[0;36m"
+#define COLOR_MAGENTA "\x1B[0;35m"
+
+static const uint8_t telegram[] = {0x08, 0x00, 0x18, 0x00, 0x05, 0x01, 0x9A, 0x64, 0x00, 0x00, 0x21, 0x00, 0x00, 0x02,
+                                   0x01, 0x80, 0x00, 0x01, 0x5A, 0x80, 0x00, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x00, 0x00, 0x6A};
+static const uint32_t timestamp  = 45296789; // 12:34:56.789
+
+// the old implementation
+static size_t my_strlcpy(char * dst, const char * src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = (len >= size) ? size - 1 : len;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+static size_t my_strlcat(char * dst, const char * src, size_t size) {
+    size_t len = strlen(dst);
+    return len + my_strlcpy(dst + len, src, size - len);
+}
+
+static char * _hextoa(uint8_t value, char * buffer) {
+    uint8_t nib1 = (value >> 4) & 0x0F;
+    uint8_t nib2 = (value >> 0) & 0x0F;
+    buffer[0]    = nib1 < 0xA ? '0' + nib1 : 'A' + nib1 - 0xA;
+    buffer[1]    = nib2 < 0xA ? '0' + nib2 : 'A' + nib2 - 0xA;
+    buffer[2]    = '\0';
+    return buffer;
+}
+
+static char * _smallitoa(uint8_t value, char * buffer) {
+    buffer[0] = ((value / 10) == 0) ? '0' : (value / 10) + '0';
+    buffer[1] = (value % 10) + '0';
+    buffer[2] = '\0';
+    return buffer;
+}
+
+static char * _smallitoa3(uint16_t value, char * buffer) {
+    buffer[0] = ((value / 100) == 0) ? '0' : (value / 100) + '0';
+    buffer[1] = (((value % 100) / 10) == 0) ? '0' : ((value % 100) / 10) + '0';
+    buffer[2] = (value % 10) + '0';
+    buffer[3] = '\0';
+    return buffer;
+}
+
+static void format_old(char * output_str, size_t size) {
+    char    prefix[200] = {0};
+    char    buffer[16]  = {0};
+    uint8_t len         = sizeof(telegram);
+
+    my_strlcpy(prefix, "Boiler", sizeof(prefix));
+    my_strlcat(prefix, " -> ", sizeof(prefix));
+    my_strlcat(prefix, "all", sizeof(prefix));
+    my_strlcat(prefix, ", type 0x", sizeof(prefix));
+    my_strlcat(prefix, _hextoa(telegram[2], buffer), sizeof(prefix));
+
+    my_strlcpy(output_str, "(", size);
+    my_strlcat(output_str, COLOR_CYAN, size);
+    my_strlcat(output_str, _smallitoa((uint8_t)((timestamp / 3600000) % 24), buffer), size);
+    my_strlcat(output_str, ":", size);
+    my_strlcat(output_str, _smallitoa((uint8_t)((timestamp / 60000) % 60), buffer), size);
+    my_strlcat(output_str, ":", size);
+    my_strlcat(output_str, _smallitoa((uint8_t)((timestamp / 1000) % 60), buffer), size);
+    my_strlcat(output_str, ".", size);
+    my_strlcat(output_str, _smallitoa3(timestamp % 1000, buffer), size);
+    my_strlcat(output_str, COLOR_RESET, size);
+    my_strlcat(output_str, ") ", size);
+    my_strlcat(output_str, COLOR_MAGENTA, size);
+    my_strlcat(output_str, prefix, size);
+    my_strlcat(output_str, " telegram: ", size);
+    for (int i = 0; i < len - 1; i++) {
+        my_strlcat(output_str, _hextoa(telegram[i], buffer), size);
+        my_strlcat(output_str, " ", size);
+    }
+    my_strlcat(output_str, "(CRC=", size);
+    my_strlcat(output_str, _hextoa(telegram[len - 1], buffer), size);
+    my_strlcat(output_str, ")", size);
+    if (len > 5) {
+        my_strlcat(output_str, ", #data=", size);
+        snprintf(buffer, sizeof(buffer), "%d", len - 5);
+        my_strlcat(output_str, buffer, size);
+    }
+    my_strlcat(output_str, COLOR_RESET, size);
+}
+
+// the same steps as _printTelegramStart(), _printMessage() and _printTelegramData()
+static void format_new(char * output_str, size_t size) {
+    _EMS_PrintCursor c;
+    uint8_t          len = sizeof(telegram);
+
+    _printBegin(&c, output_str, size);
+    _printChar(&c, '(');
+    _printStr(&c, COLOR_CYAN);
+    _printDec(&c, (timestamp / 3600000) % 24, 2);
+    _printChar(&c, ':');
+    _printDec(&c, (timestamp / 60000) % 60, 2);
+    _printChar(&c, ':');
+    _printDec(&c, (timestamp / 1000) % 60, 2);
+    _printChar(&c, '.');
+    _printDec(&c, timestamp % 1000, 3);
+    _printStr(&c, COLOR_RESET);
+    _printStr(&c, ") ");
+    _printStr(&c, COLOR_MAGENTA);
+    _printStr(&c, "Boiler");
+    _printStr(&c, " -> ");
+    _printStr(&c, "all");
+    _printStr(&c, ", type 0x");
+    _printHex(&c, telegram[2]);
+    _printStr(&c, " telegram: ");
+    for (int i = 0; i < len - 1; i++) {
+        _printHex(&c, telegram[i]);
+        _printChar(&c, ' ');
+    }
+    _printStr(&c, "(CRC=");
+    _printHex(&c, telegram[len - 1]);
+    _printChar(&c, ')');
+    if (len > 5) {
+        _printStr(&c, ", #data=");
+        _printDec(&c, len - 5);
+    }
+    _printStr(&c, COLOR_RESET);
+}
+
+static double bench(void (*format)(char *, size_t), char * output_str, size_t size) {
+    const int runs  = 200000;
+    auto      start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        format(output_str, size);
+        __asm__ __volatile__("" : : "r"(output_str) : "memory"); // keep the result
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / runs;
+}
+
+int main() {
+    char old_str[200];
+    char new_str[200];
+
+    format_old(old_str, sizeof(old_str));
+    format_new(new_str, sizeof(new_str));
+    if (strcmp(old_str, new_str) != 0) {
+        printf("output differs:\n old: %s\n new: %s\n", old_str, new_str);
+        return 1;
+    }
+
+    double t_old = bench(format_old, old_str, sizeof(old_str));
+    double t_new = bench(format_new, new_str, sizeof(new_str));
+    printf("%s\n", new_str);
+    printf("strlcat:     %7.1f ns per line\n", t_old);
+    printf("ems_print.h: %7.1f ns per line (%.1fx)\n", t_new, t_old / t_new);
+    return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * Host stand-in for the ESP8266 Arduino core, just enough to compile src/emsuart.cpp, src/ems.h and lib/MyESP/MqttQueue.cpp
+ * The UART registers are simulated in uart_sim.h
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ICACHE_RAM_ATTR
+#define ICACHE_FLASH_ATTR
+
+typedef uint8_t byte;
+
+// the ESP8266 core has strlcpy, older glibc doesn't
+static inline size_t _host_strlcpy(char * dst, const char * src, size_t size) {
+    size_t length = strlen(src);
+    if (size != 0) {
+        size_t n = (length >= size) ? size - 1 : length;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return length;
+}
+#define strlcpy _host_strlcpy
+
+#include "uart_sim.h"
@@ -0,0 +1,132 @@
+/*
+ * Simulated UART0 and timer1 of the ESP8266 for the host tests, see tools/test/test_emsuart.cpp
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+
+// bits, as in esp8266_peri.h
+#define UCBRK 8
+#define UCRXRST 17
+#define UCTXRST 18
+#define UCFFT 0
+#define UCTOT 24
+#define UCTOE 31
+#define UCFET 8
+#define USRXC 0
+#define UIFF 0
+#define UITXE 1
+#define UITO 8
+#define UIBD 7
+
+#define UART_CLK_FREQ 80000000
+#define TIM_DIV16 1
+#define TIM_EDGE 0
+#define TIM_SINGLE 0
+
+typedef struct {
+    uint32_t sig;
+    uint32_t par;
+} os_event_t;
+
+typedef void (*os_task_t)(os_event_t * events);
+typedef void (*timercallback)();
+typedef void (*uart_intr_handler_t)(void * para);
+
+// writes to the FIFO register go to tx, reads come from rx
+struct UartSimFifo {
+    std::deque<uint8_t> tx;
+    std::deque<uint8_t> rx;
+
+    UartSimFifo & operator=(uint32_t value) {
+        tx.push_back((uint8_t)value);
+        return *this;
+    }
+
+    operator uint32_t() {
+        uint8_t value = rx.front();
+        rx.pop_front();
+        return value;
+    }
+};
+
+struct UartSim {
+    UartSimFifo         fifo;
+    uint32_t            conf0;
+    uint32_t            conf1;
+    uint32_t            clkdiv;
+    uint32_t            int_ena;
+    uint32_t            int_raw; // pending interrupts, cleared by writing to int_clr
+    uint32_t            timer1_ticks;
+    timercallback       timer1_handler;
+    uart_intr_handler_t uart_handler;
+    os_task_t           task;
+    int                 posted; // # system_os_post() not yet run
+
+    // what the interrupt status register reads as
+    uint32_t status() {
+        return int_raw & int_ena;
+    }
+};
+
+extern UartSim uart_sim;
+
+// register access, as used by emsuart.cpp
+struct UartSimClear {
+    UartSimClear & operator=(uint32_t value) {
+        uart_sim.int_raw &= ~value;
+        return *this;
+    }
+};
+extern UartSimClear uart_sim_clear;
+
+#define USF(u) uart_sim.fifo
+#define USC0(u) uart_sim.conf0
+#define USC1(u) uart_sim.conf1
+#define USD(u) uart_sim.clkdiv
+#define USIE(u) uart_sim.int_ena
+#define USIC(u) uart_sim_clear
+#define USIS(u) uart_sim.status()
+#define USS(u) ((uint32_t)uart_sim.fifo.rx.size())
+#define U0IS USIS(0)
+#define U0IC USIC(0)
+
+#define ETS_UART_INTR_DISABLE()
+#define ETS_UART_INTR_ENABLE()
+#define ETS_UART_INTR_ATTACH(handler, arg) (uart_sim.uart_handler = (handler))
+
+#define PIN_PULLUP_DIS(pin)
+#define PIN_FUNC_SELECT(pin, func)
+#define PERIPHS_IO_MUX_U0TXD_U 0
+#define PERIPHS_IO_MUX_U0RXD_U 0
+#define FUNC_U0TXD 0
+#define FUNC_U0RXD 0
+
+#define os_memcpy memcpy
+
+inline void timer1_isr_init() {
+}
+inline void timer1_attachInterrupt(timercallback handler) {
+    uart_sim.timer1_handler = handler;
+}
+inline void timer1_enable(uint8_t, uint8_t, uint8_t) {
+}
+inline void timer1_write(uint32_t ticks) {
+    uart_sim.timer1_ticks = ticks;
+}
+
+inline bool system_os_task(os_task_t task, uint8_t, os_event_t *, uint8_t) {
+    uart_sim.task = task;
+    return true;
+}
+inline bool system_os_post(uint8_t, uint32_t, uint32_t) {
+    uart_sim.posted++;
+    return true;
+}
+inline void system_set_os_print(uint8_t) {
+}
+inline void system_uart_swap() {
+}
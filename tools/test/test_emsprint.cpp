@@ -0,0 +1,95 @@
+/*
+ * Host test of the hex output in src/ems_print.h, as used for the raw replies published over MQTT
+ *
+ *   g++ -std=gnu++11 -Isrc tools/test/test_emsprint.cpp -o test_emsprint && ./test_emsprint
+ *
+ * Exits with 1 if a check fails
+ */
+
+#include "ems_print.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EMS_MAX_TELEGRAM_LENGTH 32 // as in src/ems.h
+
+static int failed = 0;
+
+#define CHECK(cond)                                                \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failed++;                                              \
+        }                                                          \
+    } while (0)
+
+// read the bytes back the way ems_sendRawTelegram() does, returns the count or -1 if one isn't valid
+static int parse(char * text, uint8_t * data) {
+    int    count = 0;
+    char * end;
+    for (char * p = strtok(text, " ,"); p != NULL; p = strtok(NULL, " ,")) {
+        long val = strtol(p, &end, 16);
+        if ((*end != '\0') || (val < 0) || (val > 0xFF)) {
+            return -1;
+        }
+        data[count++] = val;
+    }
+    return count;
+}
+
+// a full reply, without its CRC, comes back byte for byte from the buffer publishRawReplies() uses
+static void testRoundTrip() {
+    uint8_t reply[EMS_MAX_TELEGRAM_LENGTH - 1];
+    for (uint8_t i = 0; i < sizeof(reply); i++) {
+        reply[i] = (i * 37 + 8) & 0xFF;
+    }
+
+    char             telegram[EMS_MAX_TELEGRAM_LENGTH * 3 + 1];
+    _EMS_PrintCursor c;
+    _printBegin(&c, telegram, sizeof(telegram));
+    _printHexBytes(&c, reply, sizeof(reply));
+    CHECK(strlen(telegram) == sizeof(reply) * 3 - 1);
+
+    uint8_t back[EMS_MAX_TELEGRAM_LENGTH];
+    CHECK(parse(telegram, back) == (int)sizeof(reply));
+    CHECK(memcmp(back, reply, sizeof(reply)) == 0);
+}
+
+static void testFormat() {
+    const uint8_t    reply[] = {0x08, 0x0B, 0x02, 0x00, 0xFF};
+    char             telegram[20];
+    _EMS_PrintCursor c;
+
+    _printBegin(&c, telegram, sizeof(telegram));
+    _printHexBytes(&c, reply, sizeof(reply));
+    CHECK(strcmp(telegram, "08 0B 02 00 FF") == 0);
+
+    _printBegin(&c, telegram, sizeof(telegram));
+    _printHexBytes(&c, reply, 0);
+    CHECK(telegram[0] == '\0');
+}
+
+// output that doesn't fit is cut off and still null terminated
+static void testTruncated() {
+    const uint8_t    reply[] = {0x08, 0x0B, 0x02, 0x00, 0xFF};
+    char             telegram[8];
+    _EMS_PrintCursor c;
+
+    _printBegin(&c, telegram, sizeof(telegram));
+    _printHexBytes(&c, reply, sizeof(reply));
+    CHECK(strcmp(telegram, "08 0B 0") == 0);
+}
+
+int main() {
+    testRoundTrip();
+    testFormat();
+    testTruncated();
+
+    if (failed) {
+        printf("%d check(s) failed\n", failed);
+        return 1;
+    }
+    printf("emsprint: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Host test of the interrupt driven Tx and the Rx of src/emsuart.cpp against a simulated UART
+ *
+ *   g++ -std=gnu++11 -Itools/test/stubs -Isrc tools/test/test_emsuart.cpp -o test_emsuart && ./test_emsuart
+ *
+ * Exits with 1 if a check fails
+ */
+
+#include "emsuart.cpp"
+
+#include <stdio.h>
+
+UartSim         uart_sim;
+UartSimClear    uart_sim_clear;
+_EMS_Sys_Status EMS_Sys_Status;
+
+static uint8_t received[EMS_MAXBUFFERSIZE];
+static int     received_length = -1;
+
+void ems_parseTelegram(uint8_t * telegram, uint8_t len) {
+    memcpy(received, telegram, len);
+    received_length = len;
+}
+
+static int failed = 0;
+
+#define CHECK(cond)                                                \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failed++;                                              \
+        }                                                          \
+    } while (0)
+
+// the UART has sent everything in the Tx FIFO
+static void txFifoDrained() {
+    uart_sim.fifo.tx.clear();
+    uart_sim.int_raw |= (1 << UITXE);
+    uart_sim.uart_handler(NULL);
+}
+
+// timer1 has run out
+static void timerExpired() {
+    uart_sim.timer1_handler();
+}
+
+// bytes came in on Rx, ending with a BRK (read as a 0x00)
+static void rxTelegram(const uint8_t * data, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        uart_sim.fifo.rx.push_back(data[i]);
+    }
+    uart_sim.fifo.rx.push_back(0x00);
+    uart_sim.int_raw |= (1 << UIFF) | (1 << UIBD);
+    uart_sim.uart_handler(NULL);
+    while (uart_sim.posted > 0) {
+        uart_sim.posted--;
+        uart_sim.task(NULL);
+    }
+}
+
+static void testTx() {
+    uint8_t telegram[] = {0x0B, 0x88, 0x33, 0x00, 0x01, 0xA4};
+
+    // idle, so it goes straight into the FIFO and waits for the FIFO empty interrupt
+    CHECK(!emsuart_tx_busy());
+    CHECK(emsuart_tx_buffer(telegram, sizeof(telegram)));
+    CHECK(uart_sim.fifo.tx.size() == sizeof(telegram));
+    CHECK(uart_sim.fifo.tx.front() == 0x0B);
+    CHECK(uart_sim.int_ena & (1 << UITXE));
+    CHECK(emsuart_tx_busy());
+
+    // still sending, so both are refused and counted
+    CHECK(!emsuart_tx_buffer(telegram, sizeof(telegram)));
+    CHECK(!emsaurt_tx_poll());
+    CHECK(emsuart_tx_dropped() == 2);
+    CHECK(uart_sim.fifo.tx.size() == sizeof(telegram));
+
+    // FIFO drained, the BRK is held and timed by timer1
+    txFifoDrained();
+    CHECK(uart_sim.conf0 & (1 << UCBRK));
+    CHECK(!(uart_sim.int_ena & (1 << UITXE)));
+    CHECK(uart_sim.timer1_ticks == EMSUART_TX_BRK_TICKS);
+    CHECK(emsuart_tx_busy());
+    CHECK(!emsaurt_tx_poll());
+    CHECK(emsuart_tx_dropped() == 3);
+
+    // timer1 releases the line
+    timerExpired();
+    CHECK(!(uart_sim.conf0 & (1 << UCBRK)));
+    CHECK(!emsuart_tx_busy());
+
+    // a poll is our ID on its own
+    CHECK(emsaurt_tx_poll());
+    CHECK(uart_sim.fifo.tx.size() == 1);
+    CHECK(uart_sim.fifo.tx.front() == EMS_ID_ME);
+    txFifoDrained();
+    timerExpired();
+    CHECK(!emsuart_tx_busy());
+    CHECK(emsuart_tx_dropped() == 3);
+}
+
+static void testRx() {
+    uint8_t telegram[] = {0x08, 0x00, 0x18, 0x00, 0x05, 0x01, 0x9A, 0x64};
+
+    rxTelegram(telegram, sizeof(telegram));
+    CHECK(received_length == sizeof(telegram)); // without the BRK
+    CHECK(memcmp(received, telegram, sizeof(telegram)) == 0);
+    CHECK(EMS_Sys_Status.emsRxStatus == EMS_RX_STATUS_IDLE);
+
+    // the next one goes into the next buffer
+    uint8_t poll[] = {0x8B};
+    rxTelegram(poll, sizeof(poll));
+    CHECK(received_length == 1);
+    CHECK(received[0] == 0x8B);
+}
+
+int main() {
+    emsuart_init();
+    testTx();
+    testRx();
+
+    if (failed) {
+        printf("%d check(s) failed\n", failed);
+        return 1;
+    }
+    printf("emsuart: all checks passed\n");
+    return 0;
+}
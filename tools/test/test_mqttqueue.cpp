@@ -0,0 +1,231 @@
+/*
+ * Host test of the MQTT publish queue and the retained payloads in lib/MyESP/MqttQueue.cpp against a broker stand-in
+ *
+ *   g++ -std=gnu++11 -Itools/test/stubs -Ilib/MyESP tools/test/test_mqttqueue.cpp -o test_mqttqueue && ./test_mqttqueue
+ *
+ * Exits with 1 if a check fails
+ */
+
+#include "MqttQueue.cpp"
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// keeps the retained payload of each topic like a real broker, and can refuse publishes
+// like AsyncMqttClient does when it's offline or its send buffer is full
+class Broker {
+  public:
+    bool                               connected = true;
+    int                                room      = -1; // # publishes taken before the send buffer is full, -1 for no limit
+    std::map<std::string, std::string> retained;
+    std::vector<std::string>           received; // topic=payload, in order
+
+    bool publish(const char * topic, const char * payload, size_t length, bool retain) {
+        if (!connected || (room == 0)) {
+            return false;
+        }
+        if (room > 0) {
+            room--;
+        }
+        std::string value(payload, length);
+        received.push_back(std::string(topic) + "=" + value);
+        if (retain) {
+            retained[topic] = value;
+        }
+        return true;
+    }
+
+    // a restart without persistence loses everything retained
+    void restart() {
+        retained.clear();
+        received.clear();
+    }
+};
+
+static int failed = 0;
+
+#define CHECK(cond)                                                \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failed++;                                              \
+        }                                                          \
+    } while (0)
+
+static void start(MqttQueue & queue, Broker & broker) {
+    queue.begin([&broker](const char * topic, const char * payload, size_t length, bool retain) { return broker.publish(topic, payload, length, retain); });
+}
+
+static void pub(MqttQueue & queue, const char * topic, const char * payload, bool retain = false) {
+    queue.publish(topic, payload, strlen(payload), retain);
+}
+
+// sent straight away when the broker takes it, nothing waits
+static void testDirect() {
+    MqttQueue queue;
+    Broker    broker;
+    start(queue, broker);
+
+    pub(queue, "boiler_data", "{\"a\":1}");
+    CHECK(broker.received.size() == 1);
+    CHECK(broker.received[0] == "boiler_data={\"a\":1}");
+    CHECK(queue.published == 1);
+    CHECK(queue.queued == 0);
+    CHECK(queue.empty());
+    CHECK(broker.retained.empty());
+}
+
+// offline: only the latest payload per topic waits, in the order the topics came in
+static void testOffline() {
+    MqttQueue queue;
+    Broker    broker;
+    start(queue, broker);
+
+    broker.connected = false;
+    pub(queue, "boiler_data", "1");
+    pub(queue, "thermostat_data", "2");
+    pub(queue, "boiler_data", "3");
+    CHECK(queue.waiting == 2);
+    CHECK(queue.queued == 2);
+    CHECK(queue.coalesced == 1);
+    CHECK(!queue.empty());
+
+    queue.flush(); // still offline
+    CHECK(queue.waiting == 2);
+
+    broker.connected = true;
+    queue.flush();
+    CHECK(queue.empty());
+    CHECK(broker.received.size() == 2);
+    CHECK(broker.received[0] == "boiler_data=3");
+    CHECK(broker.received[1] == "thermostat_data=2");
+}
+
+// a full queue drops the oldest topic
+static void testFull() {
+    MqttQueue queue;
+    Broker    broker;
+    start(queue, broker);
+
+    broker.connected = false;
+    char topic[10];
+    for (int i = 0; i <= MQTT_PUBLISH_QUEUE_MAX; i++) {
+        snprintf(topic, sizeof(topic), "t%d", i);
+        pub(queue, topic, "x");
+    }
+    CHECK(queue.waiting == MQTT_PUBLISH_QUEUE_MAX);
+    CHECK(queue.dropped == 1);
+
+    broker.connected = true;
+    queue.flush();
+    CHECK(broker.received.size() == MQTT_PUBLISH_QUEUE_MAX);
+    CHECK(broker.received[0] == "t1=x");
+}
+
+// anything waiting goes before a new publish, so the order per topic is kept
+static void testOrder() {
+    MqttQueue queue;
+    Broker    broker;
+    start(queue, broker);
+
+    broker.room = 0;
+    pub(queue, "a", "1");
+    broker.room = -1;
+    pub(queue, "b", "2");
+    CHECK(broker.received.empty());
+    CHECK(queue.waiting == 2);
+
+    queue.flush();
+    CHECK(broker.received.size() == 2);
+    CHECK(broker.received[0] == "a=1");
+    CHECK(broker.received[1] == "b=2");
+}
+
+// after a reconnect the last retained payload of each topic is sent again, also to a broker that lost them
+static void testRetainedReconnect() {
+    MqttQueue queue;
+    Broker    broker;
+    start(queue, broker);
+
+    pub(queue, "boiler_data", "1", true);
+    pub(queue, "boiler_data", "2", true);
+    pub(queue, "thermostat_data", "3", true);
+    pub(queue, "bus_data", "4"); // not retained, not kept
+    CHECK(queue.retained == 2);
+    CHECK(broker.retained["boiler_data"] == "2");
+
+    broker.connected = false;
+    broker.restart();
+    pub(queue, "thermostat_data", "5", true); // changed while offline
+    broker.connected = true;
+
+    queue.reconnected();
+    CHECK(queue.empty());
+    CHECK(broker.retained.size() == 2);
+    CHECK(broker.retained["boiler_data"] == "2");
+    CHECK(broker.retained["thermostat_data"] == "5");
+    CHECK(broker.received.back() == "thermostat_data=5"); // the newest last
+}
+
+// the retained payloads are sent as the send buffer has room, without pushing anything out of the queue
+static void testRetainedSlow() {
+    MqttQueue queue;
+    Broker    broker;
+    start(queue, broker);
+
+    char topic[10];
+    for (int i = 0; i < MQTT_RETAINED_MAX; i++) {
+        snprintf(topic, sizeof(topic), "r%d", i);
+        pub(queue, topic, "x", true);
+    }
+    pub(queue, "extra", "x", true); // beyond MQTT_RETAINED_MAX
+    CHECK(queue.retained == MQTT_RETAINED_MAX);
+
+    broker.restart();
+    broker.room = 3;
+    queue.reconnected();
+    CHECK(broker.retained.size() == 3);
+    CHECK(!queue.empty());
+
+    for (int i = 0; (i < MQTT_RETAINED_MAX) && !queue.empty(); i++) {
+        broker.room = 3;
+        queue.flush();
+    }
+    CHECK(queue.empty());
+    CHECK(broker.retained.size() == MQTT_RETAINED_MAX);
+    CHECK(queue.dropped == 0);
+}
+
+// binary payloads keep their length
+static void testBinary() {
+    MqttQueue queue;
+    Broker    broker;
+    start(queue, broker);
+
+    const char payload[] = {(char)0x81, 0x00, 0x01};
+    broker.connected     = false;
+    queue.publish("boiler_data_bin", payload, sizeof(payload), false);
+    broker.connected = true;
+    queue.flush();
+    CHECK(broker.received.size() == 1);
+    CHECK(broker.received[0] == std::string("boiler_data_bin=") + std::string(payload, sizeof(payload)));
+}
+
+int main() {
+    testDirect();
+    testOffline();
+    testFull();
+    testOrder();
+    testRetainedReconnect();
+    testRetainedSlow();
+    testBinary();
+
+    if (failed) {
+        printf("%d check(s) failed\n", failed);
+        return 1;
+    }
+    printf("mqttqueue: all checks passed\n");
+    return 0;
+}